@@ -30,6 +30,7 @@
 #include <QtCore/QThread>
 
 #include "Mixer.h"
+#include "SampleConverter.h"
 #include "TabWidget.h"
 
 
@@ -136,6 +137,15 @@ protected:
 						int_sample_t * _output_buffer,
 						const bool _convert_endian = false );
 
+	// same for any format SampleConverter supports, dithered as
+	// configured in setup dialog
+	int convertBuffer( const surroundSampleFrame * _ab,
+					const fpp_t _frames,
+					const float _master_gain,
+					void * _output_buffer,
+					SampleConverter::Format _format,
+					const bool _convert_endian = false );
+
 	// clear given signed-int-16-buffer
 	void clearS16Buffer( int_sample_t * _outbuf,
 							const fpp_t _frames );
@@ -177,6 +187,8 @@ private:
 
 	surroundSampleFrame * m_buffer;
 
+	SampleConverter m_converter;
+
 } ;
 
 
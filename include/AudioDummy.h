@@ -95,12 +95,14 @@ private:
 		while( true )
 		{
 			timer.reset();
+			// buffer belongs to the mixer's period ring, nothing to
+			// do with it but handing it back
 			const surroundSampleFrame* b = mixer()->nextBuffer();
+			mixer()->releaseNextBuffer();
 			if( !b )
 			{
 				break;
 			}
-			delete[] b;
 
 			const int microseconds = static_cast<int>( mixer()->framesPerPeriod() * 1000000.0f / mixer()->processingSampleRate() - timer.elapsed() );
 			if( microseconds > 0 )
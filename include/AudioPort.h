@@ -32,6 +32,7 @@
 #include "Mixer.h"
 #include "MemoryManager.h"
 #include "PlayHandle.h"
+#include "RealtimeGuard.h"
 
 class EffectChain;
 class FloatModel;
@@ -105,30 +106,61 @@ public:
 	{
 		return true;
 	}
+	virtual const char * jobName() const
+	{
+		return "AudioPort";
+	}
 
 	void addPlayHandle( PlayHandle * handle );
 	void removePlayHandle( PlayHandle * handle );
 
+	// per-period render graph: the port is queued for processing as soon as
+	// all its play handles have been processed
+	void prepareGraph();
+	inline void addGraphInput()
+	{
+		m_pendingInputs.ref();
+	}
+	void graphInputDone();
+
+	// FX channel the port delivers its output to in current period
+	inline fx_ch_t graphFxChannel() const
+	{
+		return m_graphFxChannel;
+	}
+
+	// MixerProfiler node the play handles of this port are timed with
+	inline int playHandleProfilerNode() const
+	{
+		return m_playHandleProfilerNode;
+	}
+
 private:
 	volatile bool m_bufferUsage;
 
 	sampleFrame * m_portBuffer;
-	QMutex m_portBufferLock;
+	GuardedMutex m_portBufferLock;
 
 	bool m_extOutputEnabled;
 	fx_ch_t m_nextFxChannel;
 
+	QAtomicInt m_pendingInputs;
+	fx_ch_t m_graphFxChannel;
+
 	QString m_name;
 
 	EffectChain * m_effects;
 
 	PlayHandleList m_playHandles;
-	QMutex m_playHandleLock;
+	GuardedMutex m_playHandleLock;
 
 	FloatModel * m_volumeModel;
 	FloatModel * m_panningModel;
 	BoolModel * m_mutedModel;
 
+	int m_profilerNode;
+	int m_playHandleProfilerNode;
+
 	friend class Mixer;
 	friend class MixerWorkerThread;
 
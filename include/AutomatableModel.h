@@ -182,6 +182,10 @@ public:
 	void setInitValue( const float value );
 
 	void setAutomatedValue( const float value );
+	//! @brief Writes sample-exact automation for @frames frames starting
+	//! at @offset into this period's valueBuffer(). Values are unscaled
+	//! like the ones passed to setAutomatedValue().
+	void setAutomatedValues( const float * values, int offset, int frames );
 	void setValue( const float value );
 
 	void incValue( int steps )
@@ -322,6 +326,9 @@ private:
 	//! @param value will be modified to rounded value
 	template<class T> void roundAt( T &value, const T &where ) const;
 
+	//! takes a buffer for the current period from ValueBufferArena
+	bool allocValueBuffer();
+
 
 	DataType m_dataType;
 	ScaleType m_scaleType; //! scale type, linear by default
@@ -353,8 +360,11 @@ private:
 
 	static float s_copiedValue;
 
+	// data lives in ValueBufferArena and is only valid during the period
+	// given by m_lastUpdatedPeriod
 	ValueBuffer m_valueBuffer;
 	long m_lastUpdatedPeriod;
+	long m_lastAutomatedPeriod;
 	static long s_periodCounter;
 
 	bool m_hasSampleExactData;
@@ -0,0 +1,109 @@
+/*
+ * AutomationCurve.h - precompiled form of an automation pattern
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef AUTOMATION_CURVE_H
+#define AUTOMATION_CURVE_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QVector>
+
+#include "AutomationPattern.h"
+
+
+/*! Flat array of the segments between the points of an AutomationPattern.
+ * Every segment stores a cubic polynomial over the position within the
+ * segment (0..1), so discrete, linear and cubic Hermite progressions are
+ * all evaluated the same way without looking at neighbouring points or
+ * tangents. Positions are given in ticks relative to the start of the
+ * pattern and may be fractional. A curve is never modified after being
+ * built - AutomationPattern builds a new one after edits. */
+class AutomationCurve
+{
+public:
+	AutomationCurve( const AutomationPattern & pattern );
+	AutomationCurve( const AutomationPattern::timeMap & values,
+			const AutomationPattern::timeMap & tangents,
+			AutomationPattern::ProgressionTypes progression,
+							float tension );
+
+	// a new curve has one reference, which is held by the pattern - the
+	// curve is deleted once the last reference is released
+	void ref() const
+	{
+		m_refCount.ref();
+	}
+
+	static void release( const AutomationCurve * curve )
+	{
+		if( curve && !curve->m_refCount.deref() )
+		{
+			delete curve;
+		}
+	}
+
+	bool isEmpty() const
+	{
+		return m_segments.isEmpty();
+	}
+
+	float valueAt( float tick ) const;
+
+	// same as above, but starts searching at segment given by cursor
+	// and updates it - O(1) when called with increasing positions
+	float valueAt( float tick, int & cursor ) const;
+
+	// writes values at tick, tick + ticksPerFrame, ... to values
+	void fill( float * values, int frames, float tick, float ticksPerFrame,
+							int & cursor ) const;
+
+
+private:
+	struct Segment
+	{
+		float start;
+		float invLength;	// 0 for last segment (constant)
+		float c0, c1, c2, c3;	// c0 + c1*t + c2*t^2 + c3*t^3
+	} ;
+
+	static inline float evaluate( const Segment & s, float tick )
+	{
+		const float t = ( tick - s.start ) * s.invLength;
+		return ( ( s.c3 * t + s.c2 ) * t + s.c1 ) * t + s.c0;
+	}
+
+	// index of segment containing tick or -1 if tick is before first
+	// point
+	int find( float tick, int first ) const;
+	int seek( float tick, int cursor ) const;
+
+	void build( const AutomationPattern::timeMap & values,
+			const AutomationPattern::timeMap & tangents,
+			AutomationPattern::ProgressionTypes progression,
+							float tension );
+
+	QVector<Segment> m_segments;
+	mutable QAtomicInt m_refCount;
+
+} ;
+
+
+#endif
@@ -27,12 +27,15 @@
 #ifndef AUTOMATION_PATTERN_H
 #define AUTOMATION_PATTERN_H
 
+#include <QtCore/QAtomicPointer>
 #include <QtCore/QMap>
+#include <QtCore/QMutex>
 #include <QtCore/QPointer>
 
 #include "Track.h"
 
 
+class AutomationCurve;
 class AutomationTrack;
 class MidiTime;
 
@@ -130,6 +133,15 @@ public:
 	float valueAt( const MidiTime & _time ) const;
 	float *valuesAfter( const MidiTime & _time ) const;
 
+	// compiled form of time map, replaced after every change - only to be
+	// used while holding the mixer lock, as a change waits for the mixer
+	// before releasing the previous curve
+	const AutomationCurve * curve() const;
+
+	// reference to current curve for threads not holding the mixer lock,
+	// e.g. the GUI - has to be released with AutomationCurve::release()
+	const AutomationCurve * acquireCurve() const;
+
 	const QString name() const;
 
 	// settings-management
@@ -140,6 +152,8 @@ public:
 	QString nodeName() const { return classNodeName(); }
 
 	void processMidiTime( const MidiTime & _time );
+	void processValueBuffers( float _tick, const fpp_t _frames,
+						const f_cnt_t _frame_base );
 
 	virtual TrackContentObjectView * createView( TrackView * _tv );
 
@@ -166,7 +180,7 @@ private:
 	void cleanObjects();
 	void generateTangents();
 	void generateTangents( timeMap::const_iterator it, int numToGenerate );
-	float valueAt( timeMap::const_iterator v, int offset ) const;
+	void updateCurve();
 
 	AutomationTrack * m_autoTrack;
 	QVector<jo_id_t> m_idsToResolve;
@@ -178,6 +192,10 @@ private:
 	bool m_hasAutomation;
 	ProgressionTypes m_progressionType;
 
+	QAtomicPointer<AutomationCurve> m_curve;
+	mutable QMutex m_curveMutex;	// guards replacing and acquiring m_curve
+	int m_playCursor;	// segment of m_curve last played
+
 	bool m_dragging;
 	
 	bool m_isRecording;
@@ -40,6 +40,11 @@ public:
 	virtual bool play( const MidiTime & _start, const fpp_t _frames,
 						const f_cnt_t _frame_base, int _tco_num = -1 );
 
+	// write sample-exact automation for given part of the current period
+	// into the ValueBuffers of automated models, _tick may be fractional
+	void processValueBuffers( float _tick, const fpp_t _frames,
+						const f_cnt_t _frame_base, int _tco_num = -1 );
+
 	virtual QString nodeName() const
 	{
 		return "automationtrack";
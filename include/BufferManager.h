@@ -26,31 +26,82 @@
 #ifndef BUFFER_MANAGER_H
 #define BUFFER_MANAGER_H
 
+#include <QtCore/QAtomicInt>
+
 #include "export.h"
 #include "lmms_basics.h"
 
-class QAtomicInt;
+class BufferCache;
 
 const int BM_INITIAL_BUFFERS = 512;
-//const int BM_INCREMENT = 64;
+const int BM_BLOCK_BUFFERS = 256; // buffers added at a time when growing
+const int BM_MAX_BLOCKS = 255; // buffer indices have to fit into 16 bits
+const int BM_CACHE_BUFFERS = 32; // max. free buffers kept by each thread
+const int BM_BATCH_BUFFERS = 16; // buffers exchanged with global list at a time
+
+struct BufferInfo
+{
+	int next; // index of next buffer in free list or -1
+#ifdef LMMS_DEBUG
+	const void * owner;
+	bool inUse;
+#endif
+};
+
+struct BufferBlock
+{
+	char * memory;
+	BufferInfo info[BM_BLOCK_BUFFERS];
+};
 
+
+/*! Pool of period-sized sample buffers. Every thread keeps a small free
+ * list of its own, so acquire() and release() usually don't touch shared
+ * state. These lists are refilled from and flushed to a global lock-free
+ * free list in batches. When the pool runs dry, more buffers are added
+ * instead of giving up - refresh() adds them ahead of time in between
+ * periods when only few free buffers are left. */
 class EXPORT BufferManager
 {
 public:
 	static void init( fpp_t framesPerPeriod );
-	static sampleFrame * acquire();
+	static sampleFrame * acquire( const void * owner = NULL );
 	static void release( sampleFrame * buf );
 	static void refresh();
-//	static void extend( int c );
+
+	// total number of buffers
+	static int size()
+	{
+		return s_blockCount.fetchAndAddAcquire( 0 ) * BM_BLOCK_BUFFERS;
+	}
+
+#ifdef LMMS_DEBUG
+	// number of buffers acquired but not released yet by given owner
+	static int outstandingBuffers( const void * owner );
+	// print all owners of outstanding buffers
+	static void dumpOutstandingBuffers();
+#endif
 
 private:
-	static sampleFrame ** s_available;
-	static QAtomicInt s_availableIndex;
+	static BufferCache * cache();
+	static void grow();
 
-	static sampleFrame ** s_released;
-	static QAtomicInt s_releasedIndex;
-//	static QReadWriteLock s_mutex;
-	static int s_size;
-};
+	static sampleFrame * buffer( int index );
+	static int index( sampleFrame * buf );
+	static BufferInfo & info( int index );
+
+	static int pop();
+	static void push( int first, int last, int count );
+
+	static BufferBlock * s_blocks[BM_MAX_BLOCKS];
+	static QAtomicInt s_blockCount; // blocks stored in s_blocks
+	static QAtomicInt s_blocksReserved; // blocks stored or being set up
+	static QAtomicInt s_freeList; // (tag << 16) | ( index + 1 ), 0 if empty
+	static QAtomicInt s_freeBuffers; // buffers in global list
+	static int s_stride; // bytes per buffer including index header
+	static fpp_t s_framesPerPeriod;
+
+	friend class BufferCache;
+} ;
 
 #endif
@@ -44,6 +44,7 @@ public:
 
 protected:
 	virtual void paintEvent( QPaintEvent * _ev );
+	virtual void mousePressEvent( QMouseEvent * _me );
 
 
 protected slots:
@@ -51,8 +52,15 @@ protected slots:
 
 
 private:
+	void updateNodeToolTip();
+	void updateToolTip();
+
 	int m_currentLoad;
 
+	// position in history of MixerProfiler while node profiling is
+	// enabled
+	int m_historyCursor;
+
 	QPixmap m_temp;
 	QPixmap m_background;
 	QPixmap m_leds;
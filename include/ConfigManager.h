@@ -45,6 +45,7 @@ const QString SAMPLES_PATH = "samples/";
 const QString DEFAULT_THEME_PATH = "themes/default/";
 const QString TRACK_ICON_PATH = "track_icons/";
 const QString LOCALE_PATH = "locale/";
+const QString SAMPLE_CACHE_PATH = "cache/samples/";
 
 
 class EXPORT ConfigManager
@@ -85,6 +86,11 @@ public:
 		return workingDir() + SAMPLES_PATH;
 	}
 
+	QString sampleCacheDir() const
+	{
+		return workingDir() + SAMPLE_CACHE_PATH;
+	}
+
 	QString factoryProjectsDir() const
 	{
 		return dataDir() + PROJECTS_PATH;
@@ -181,6 +187,7 @@ public:
 
 
 	void setWorkingDir( const QString & _wd );
+	void setPluginDir( const QString & _pd );
 	void setVSTDir( const QString & _vd );
 	void setArtworkDir( const QString & _ad );
 	void setFLDir( const QString & _fd );
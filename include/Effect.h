@@ -217,6 +217,8 @@ private:
 	
 	bool m_autoQuitDisabled;
 
+	int m_profilerNode;
+
 	SRC_DATA m_srcData[2];
 	SRC_STATE * m_srcState[2];
 
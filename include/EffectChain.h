@@ -55,6 +55,8 @@ public:
 	void moveUp( Effect * _effect );
 	bool processAudioBuffer( sampleFrame * _buf, const fpp_t _frames, bool hasInputNoise );
 	void startRunning();
+	// whether any effect would produce output (e.g. a tail) without input
+	bool isRunning() const;
 
 	void clear();
 
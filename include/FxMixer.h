@@ -30,6 +30,7 @@
 #include "EffectChain.h"
 #include "JournallingObject.h"
 #include "ThreadableJob.h"
+#include "RealtimeGuard.h"
 
 
 class FxRoute;
@@ -47,6 +48,9 @@ class FxChannel : public ThreadableJob
 		bool m_hasInput;
 		// set to true if any effect in the channel is enabled and running
 		bool m_stillRunning;
+		// set to true if effects wrote to m_buffer, so it has to be
+		// cleared after the master mix
+		bool m_bufferUsed;
 
 		float m_peakLeft;
 		float m_peakRight;
@@ -56,7 +60,7 @@ class FxChannel : public ThreadableJob
 		BoolModel m_soloModel;
 		FloatModel m_volumeModel;
 		QString m_name;
-		QMutex m_lock;
+		GuardedMutex m_lock;
 		int m_channelIndex; // what channel index are we
 		bool m_queued; // are we queued up for rendering yet?
 		bool m_muted; // are we muted? updated per period so we don't have to call m_muteModel.value() twice
@@ -68,13 +72,20 @@ class FxChannel : public ThreadableJob
 		FxRouteVector m_receives;
 
 		virtual bool requiresProcessing() const { return true; }
+		virtual const char * jobName() const { return "FxChannel"; }
 		void unmuteForSolo();
 
-	
-		QAtomicInt m_dependenciesMet;
-		void incrementDeps();
+
+		// number of senders and audio ports we still wait for during
+		// current period (plus one while inputs are being registered)
+		QAtomicInt m_pendingInputs;
+
+		// MixerProfiler node - has to be renamed along with m_name
+		int m_profilerNode;
+
+		void inputDone();
 		void processed();
-		
+
 	private:
 		virtual void doProcessing();
 };
@@ -131,6 +142,18 @@ public:
 	void mixToChannel( const sampleFrame * _buf, fx_ch_t _ch );
 
 	void prepareMasterMix();
+
+	// per-period render graph: channels are queued for processing as soon
+	// as all audio ports and channels sending to them are done, so there's
+	// no barrier between audio ports and the FX mixer
+	void prepareChannelGraph();
+	// an audio port is going to deliver its output to given channel
+	void addChannelInput( fx_ch_t _ch );
+	// all inputs have been registered - queue channels without pending inputs
+	void startChannelGraph();
+	// an audio port is done delivering its output to given channel
+	void channelInputDone( fx_ch_t _ch );
+
 	void masterMix( sampleFrame * _buf );
 
 	virtual void saveSettings( QDomDocument & _doc, QDomElement & _parent );
@@ -207,7 +230,10 @@ private:
 
 	// make sure we have at least num channels
 	void allocateChannelsTo(int num);
-	QMutex m_sendsMutex;
+	GuardedMutex m_sendsMutex;
+	// whether channels are processed in current period - not the case if
+	// routing is being changed
+	bool m_channelGraphActive;
 
 	int m_lastSoloed;
 
@@ -27,6 +27,7 @@
 
 #include "PlayHandle.h"
 #include "Instrument.h"
+#include "InstrumentTrack.h"
 #include "NotePlayHandle.h"
 #include "export.h"
 
@@ -46,6 +47,7 @@ public:
 		if( m_instrument->flags() & Instrument::IsMidiBased )
 		{
 			m_instrument->play( _working_buffer );
+			setSilent( m_instrumentTrack->isOutputSilent() );
 			return;
 		}
 		
@@ -69,6 +71,7 @@ public:
 		while( nphsLeft );
 		
 		m_instrument->play( _working_buffer );
+		setSilent( m_instrumentTrack->isOutputSilent() );
 	}
 
 	virtual bool isFinished() const
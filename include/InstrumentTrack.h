@@ -26,6 +26,8 @@
 #ifndef INSTRUMENT_TRACK_H
 #define INSTRUMENT_TRACK_H
 
+#include <QtCore/QAtomicInt>
+
 #include "AudioPort.h"
 #include "InstrumentFunctions.h"
 #include "InstrumentSoundShaping.h"
@@ -35,6 +37,7 @@
 #include "Piano.h"
 #include "PianoView.h"
 #include "Pitch.h"
+#include "RealtimeGuard.h"
 #include "Track.h"
 
 
@@ -54,6 +57,7 @@ class Knob;
 class LcdSpinBox;
 class midiPortMenu;
 class DataFile;
+class Pattern;
 class PluginView;
 class TabWidget;
 class TrackLabelButton;
@@ -73,6 +77,13 @@ public:
 	void processAudioBuffer( sampleFrame * _buf, const fpp_t _frames,
 							NotePlayHandle * _n );
 
+	// whether last buffer of a single-streamed instrument was skipped by
+	// processAudioBuffer() because of silence
+	bool isOutputSilent() const
+	{
+		return m_silentOutput;
+	}
+
 	MidiEvent applyMasterKey( const MidiEvent& event );
 
 	virtual void processInEvent( const MidiEvent& event, const MidiTime& time = MidiTime(), f_cnt_t offset = 0 );
@@ -214,6 +225,11 @@ signals:
 	void nameChanged();
 
 
+public slots:
+	// to be called whenever notes or patterns of this track change
+	void invalidateNoteEvents();
+
+
 protected:
 	virtual QString nodeName() const
 	{
@@ -228,22 +244,52 @@ protected slots:
 
 
 private:
+	// note-on event of a pattern in song, see m_noteEvents
+	struct NoteEvent
+	{
+		tick_t pos; // song-global position
+		Note * note;
+		Pattern * pattern;
+
+		bool operator<( const NoteEvent & other ) const
+		{
+			return pos < other.pos;
+		}
+
+		bool operator<( tick_t otherPos ) const
+		{
+			return pos < otherPos;
+		}
+	} ;
+	typedef QVector<NoteEvent> NoteEventVector;
+
+	void updateNoteEvents();
+	bool playNoteEvents( const MidiTime & _start, const f_cnt_t _offset );
+
 	MidiPort m_midiPort;
 
 	NotePlayHandle* m_notes[NumKeys];
-	QMutex m_notesMutex;
+	GuardedMutex m_notesMutex;
 
 	int m_runningMidiNotes[NumKeys];
-	QMutex m_midiNotesMutex;
+	GuardedMutex m_midiNotesMutex;
 
 	bool m_sustainPedalPressed;
 
 	bool m_silentBuffersProcessed;
+	bool m_silentOutput;
 
 	IntModel m_baseNoteModel;
 
 	NotePlayHandleList m_processHandles;
 
+	// notes of all patterns sorted by song position - collected once
+	// after changes, so playing a song doesn't search all patterns and
+	// notes in every tick
+	NoteEventVector m_noteEvents;
+	int m_noteEventCursor;
+	QAtomicInt m_noteEventsValid;
+
 	FloatModel m_volumeModel;
 	FloatModel m_panningModel;
 	
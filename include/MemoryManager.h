@@ -26,81 +26,77 @@
 #ifndef MEMORY_MANAGER_H
 #define MEMORY_MANAGER_H
 
-#include <QtCore/QVector>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QAtomicPointer>
 #include <QtCore/QMutex>
-#include <QtCore/QHash>
 #include "MemoryHelper.h"
 #include "export.h"
 
-class QReadWriteLock;
+class MemoryCache;
 
-const int MM_CHUNK_SIZE = 64; // granularity of managed memory
-const int MM_INITIAL_CHUNKS = 1024 * 1024; // how many chunks to allocate at startup - TODO: make configurable
-const int MM_INCREMENT_CHUNKS = 16 * 1024; // min. amount of chunks to increment at a time
+const int MM_HEADER_SIZE = 16; // bytes in front of each block, keeps payload 16-byte aligned
+const int MM_MIN_BLOCK_SIZE = 32; // payload size of smallest size class
+const int MM_SIZE_CLASSES = 12; // power-of-two classes from 32 bytes up to 64 KB
+const int MM_SLAB_SIZE = 256 * 1024; // min. amount of memory to carve blocks from at a time
+const int MM_CACHE_BLOCKS = 64; // max. blocks per size class held in a thread cache
+const int MM_BATCH_BLOCKS = 32; // blocks exchanged with global free lists at a time
 
-struct MemoryPool
+struct MemoryBlock
 {
-	void * m_pool;
-	char * m_free;
-	int m_chunks;
-	QMutex m_mutex;
-
-	MemoryPool() :
-		m_pool( NULL ),
-		m_free( NULL ),
-		m_chunks( 0 )
-	{}
-
-	MemoryPool( int chunks ) :
-		m_chunks( chunks )
-	{
-		m_free = (char*) MemoryHelper::alignedMalloc( chunks );
-		memset( m_free, 1, chunks );
-	}
-
-	MemoryPool( const MemoryPool & mp ) :
-		m_pool( mp.m_pool ),
-		m_free( mp.m_free ),
-		m_chunks( mp.m_chunks ),
-		m_mutex()
-	{}
-
-	MemoryPool & operator = ( const MemoryPool & mp )
-	{
-		m_pool = mp.m_pool;
-		m_free = mp.m_free;
-		m_chunks = mp.m_chunks;
-		return *this;
-	}
-
-	void * getChunks( int chunksNeeded );
-	void releaseChunks( void * ptr, int chunks );
+	MemoryBlock * next; // free list link, only valid while block is free
+	int sizeClass; // -1 for large allocations served by system allocator
+	int magic;
 };
 
-struct PtrInfo
+struct MemorySizeClass
 {
-	int chunks;
-	MemoryPool * memPool;
+	QAtomicInt lock; // only taken when exchanging batches with thread caches
+	MemoryBlock * freeList;
+	int freeBlocks;
 };
 
-typedef QVector<MemoryPool> MemoryPoolVector;
-typedef QHash<void*, PtrInfo> PointerInfoMap;
 
+/*! Size-class allocator. Every thread owns a small cache of free blocks per
+ * size class so alloc() and free() usually neither lock nor search. Caches
+ * are refilled from and flushed to global per-class free lists in batches.
+ * The size class is stored in a header in front of each block, so free()
+ * needs no pointer lookup. Requests larger than the biggest class go to
+ * the system allocator. */
 class EXPORT MemoryManager
 {
 public:
 	static bool init();
 	static void * alloc( size_t size );
 	static void free( void * ptr );
-	static int extend( int chunks ); // returns index of created pool (for use by alloc)
 	static void cleanup();
 
+	// total number of alloc() calls since init(), summed over all threads -
+	// never blocks, so it may return the previous total while a thread
+	// is setting up or tearing down its cache
+	static int allocations();
+
 private:
-	static MemoryPoolVector s_memoryPools;
-	static QReadWriteLock s_poolMutex;
+	static int sizeClass( size_t size );
+	static int blockSize( int sizeClass );
+	static MemoryCache * cache();
+
+	static void refill( MemoryCache * cache, int sizeClass );
+	static void flush( MemoryCache * cache, int sizeClass, int blocks );
+	static MemoryBlock * carve( int sizeClass, int * blocks );
+
+	static void lockClass( int sizeClass );
+	static void unlockClass( int sizeClass );
+
+	static MemorySizeClass s_sizeClasses[MM_SIZE_CLASSES];
+	static QAtomicPointer<void> s_slabs;
+	static QAtomicInt s_retiredAllocations;
+	static QAtomicInt s_lastAllocations;	// last result of allocations()
+	static bool s_cleanedUp;
+
+	static MemoryCache * s_caches;
+	static QMutex s_cacheMutex;
 
-	static PointerInfoMap s_pointerInfo;
-	static QMutex s_pointerMutex;
+	friend class MemoryCache;
 };
 
 
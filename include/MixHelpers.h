@@ -31,10 +31,23 @@ class ValueBuffer;
 namespace MixHelpers
 {
 
+/*! \brief Select the fastest implementation supported by the CPU - until
+ * called, the scalar reference implementation is used */
+void init();
+
+/*! \brief Name of the instruction set currently used */
+const char * instructionSet();
+
 bool isSilent( const sampleFrame* src, int frames );
 
 bool sanitize( sampleFrame * src, int frames );
 
+/*! \brief Get absolute peak values of both channels */
+void peak( const sampleFrame* src, int frames, float& left, float& right );
+
+/*! \brief Get RMS of both channels */
+void rms( const sampleFrame* src, int frames, float& left, float& right );
+
 /*! \brief Add samples from src to dst */
 void add( sampleFrame* dst, const sampleFrame* src, int frames );
 
@@ -69,6 +82,21 @@ void multiplyAndAddMultiplied( sampleFrame* dst, const sampleFrame* src, float c
 /*! \brief Multiply dst by coeffDst and add samples from srcLeft/srcRight multiplied by coeffSrc */
 void multiplyAndAddMultipliedJoined( sampleFrame* dst, const sample_t* srcLeft, const sample_t* srcRight, float coeffDst, float coeffSrc, int frames );
 
+/*! \brief Multiply samples in dst by coeffBuf */
+void multiplyByBuffer( sampleFrame* dst, ValueBuffer * coeffBuf, int frames );
+
+/*! \brief Multiply samples in dst by volume and panning (both in percent) -
+ * per frame if volBuf/panBuf are given, constant vol/pan otherwise */
+void multiplyByVolumeAndPanning( sampleFrame* dst, ValueBuffer * volBuf, float vol, ValueBuffer * panBuf, float pan, int frames );
+
+/*! \brief Add samples from src multiplied by two gains to dst - each gain is
+ * taken per frame from its buffer if given, constant otherwise. Results are
+ * the same as with the according addMultiplied* function. */
+void addMultipliedByGains( sampleFrame* dst, const sampleFrame* src,
+				float gain1, ValueBuffer * gainBuf1,
+				float gain2, ValueBuffer * gainBuf2,
+				bool sanitized, int frames );
+
 }
 
 #endif
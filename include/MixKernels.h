@@ -0,0 +1,81 @@
+/*
+ * MixKernels.h - instruction set specific implementations of MixHelpers
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef MIX_KERNELS_H
+#define MIX_KERNELS_H
+
+#include "lmms_basics.h"
+
+
+/*! Table of MixHelpers operations for one instruction set. Buffers of
+ * per-frame coefficients are passed as plain arrays. Apart from
+ * sumOfSquares() all kernels return exactly the same results as the
+ * scalar reference. */
+struct MixKernels
+{
+	const char * name;
+
+	bool (*isSilent)( const sampleFrame * src, int frames );
+	bool (*sanitize)( sampleFrame * src, int frames );
+	void (*peak)( const sampleFrame * src, int frames, float * left, float * right );
+	void (*sumOfSquares)( const sampleFrame * src, int frames, float * left, float * right );
+
+	void (*add)( sampleFrame * dst, const sampleFrame * src, int frames );
+	void (*addMultiplied)( sampleFrame * dst, const sampleFrame * src, float coeffSrc, int frames );
+	void (*addSwappedMultiplied)( sampleFrame * dst, const sampleFrame * src, float coeffSrc, int frames );
+	void (*addMultipliedByBuffer)( sampleFrame * dst, const sampleFrame * src, float coeffSrc, const float * coeffSrcBuf, int frames );
+	void (*addMultipliedByBuffers)( sampleFrame * dst, const sampleFrame * src, const float * coeffSrcBuf1, const float * coeffSrcBuf2, int frames );
+	void (*addSanitizedMultiplied)( sampleFrame * dst, const sampleFrame * src, float coeffSrc, int frames );
+	void (*addSanitizedMultipliedByBuffer)( sampleFrame * dst, const sampleFrame * src, float coeffSrc, const float * coeffSrcBuf, int frames );
+	void (*addSanitizedMultipliedByBuffers)( sampleFrame * dst, const sampleFrame * src, const float * coeffSrcBuf1, const float * coeffSrcBuf2, int frames );
+	void (*addMultipliedStereo)( sampleFrame * dst, const sampleFrame * src, float coeffSrcLeft, float coeffSrcRight, int frames );
+	void (*multiplyAndAddMultiplied)( sampleFrame * dst, const sampleFrame * src, float coeffDst, float coeffSrc, int frames );
+	void (*multiplyAndAddMultipliedJoined)( sampleFrame * dst, const sample_t * srcLeft, const sample_t * srcRight, float coeffDst, float coeffSrc, int frames );
+	void (*multiplyByBuffer)( sampleFrame * dst, const float * coeffBuf, int frames );
+	void (*multiplyByVolumeAndPanning)( sampleFrame * dst, const float * volBuf, float vol, const float * panBuf, float pan, int frames );
+
+} ;
+
+
+namespace MixHelpers
+{
+
+// kernel tables compiled into this build - functions return NULL if the
+// instruction set isn't supported by the target architecture
+const MixKernels * scalarKernels();
+const MixKernels * sse2Kernels();
+const MixKernels * avx2Kernels();
+const MixKernels * neonKernels();
+
+/*! \brief Kernel tables usable on this CPU, scalar reference first and
+ * the one selected by init() last */
+int numKernels();
+const MixKernels * kernels( int index );
+
+/*! \brief Kernel table currently used by MixHelpers functions */
+const MixKernels * currentKernels();
+
+void setCurrentKernels( const MixKernels * kernels );
+
+}
+
+#endif
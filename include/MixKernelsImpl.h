@@ -0,0 +1,521 @@
+/*
+ * MixKernelsImpl.h - MixHelpers operations written against a vector type
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef MIX_KERNELS_IMPL_H
+#define MIX_KERNELS_IMPL_H
+
+#include <cfloat>
+
+#include "MixKernels.h"
+
+
+/*
+ * Only to be included by the MixKernels*.cpp files, which are compiled with
+ * flags for their instruction set. Everything in here therefore has
+ * internal linkage and doesn't use any inline functions from other headers -
+ * otherwise the linker might pick e.g. an AVX2 copy of some function for
+ * code running on CPUs without AVX2.
+ *
+ * V has to provide a vector type holding V::Width floats (an even number,
+ * so each vector holds whole sample frames) and following operations:
+ *
+ *	load/store		unaligned load/store of Width floats
+ *	set1( x )		all lanes x
+ *	setPair( l, r )		l, r, l, r, ...
+ *	add/sub/mul		lane-wise arithmetic
+ *	maxOf( a, acc )		lane-wise maximum, acc where a is NaN
+ *	abs( a )		lane-wise absolute value
+ *	notAbove( a, b, x, y )	x where a <= b, y otherwise (and where a or
+ *				b is NaN)
+ *	finite( a, ref )	a where ref is finite, 0 otherwise
+ *	anyNonFinite( a )	whether any lane is inf or NaN
+ *	anyNotBelow( a, t )	whether |a| >= t in any lane
+ *	dupPairs( p )		p[0], p[0], p[1], p[1], ... (loads Width/2 floats)
+ *	swapPairs( a )		a[1], a[0], a[3], a[2], ...
+ *	interleave( l, r, lo, hi )	loads Width floats from l and r and
+ *				returns them as 2 * Width interleaved floats
+ */
+
+namespace
+{
+
+
+inline float kernelAbs( float x )
+{
+	return x < 0.0f ? -x : x;
+}
+
+
+inline bool kernelIsFinite( float x )
+{
+	// false for NaNs as well
+	return kernelAbs( x ) <= FLT_MAX;
+}
+
+
+// gains of AudioPort for volume v and panning p (both already scaled to
+// 0..1 and -1..1)
+inline void kernelVolumePanning( float v, float p, float * left, float * right )
+{
+	*left = ( p <= 0 ? 1.0f : 1.0f - p ) * v;
+	*right = ( p >= 0 ? 1.0f : 1.0f + p ) * v;
+}
+
+
+
+
+template<class V>
+struct MixKernelsImpl
+{
+	typedef typename V::Vec Vec;
+
+	// sample frames per vector
+	static const int Frames = V::Width / DEFAULT_CHANNELS;
+
+
+	static float * ptr( sampleFrame * buf, int frame )
+	{
+		return &buf[frame][0];
+	}
+
+	static const float * ptr( const sampleFrame * buf, int frame )
+	{
+		return &buf[frame][0];
+	}
+
+
+	static bool isSilent( const sampleFrame * src, int frames )
+	{
+		const float silenceThreshold = 0.0000001f;
+		const Vec t = V::set1( silenceThreshold );
+
+		int f = 0;
+		for( ; f + Frames <= frames; f += Frames )
+		{
+			if( V::anyNotBelow( V::load( ptr( src, f ) ), t ) )
+			{
+				return false;
+			}
+		}
+		for( ; f < frames; ++f )
+		{
+			if( kernelAbs( src[f][0] ) >= silenceThreshold ||
+				kernelAbs( src[f][1] ) >= silenceThreshold )
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+
+	static bool sanitize( sampleFrame * src, int frames )
+	{
+		bool found = false;
+
+		int f = 0;
+		for( ; f + Frames <= frames; f += Frames )
+		{
+			const Vec s = V::load( ptr( src, f ) );
+			if( V::anyNonFinite( s ) )
+			{
+				V::store( ptr( src, f ), V::finite( s, s ) );
+				found = true;
+			}
+		}
+		for( ; f < frames; ++f )
+		{
+			for( int c = 0; c < DEFAULT_CHANNELS; ++c )
+			{
+				if( !kernelIsFinite( src[f][c] ) )
+				{
+					src[f][c] = 0.0f;
+					found = true;
+				}
+			}
+		}
+		return found;
+	}
+
+
+	static void peak( const sampleFrame * src, int frames, float * left, float * right )
+	{
+		Vec acc = V::set1( 0.0f );
+
+		int f = 0;
+		for( ; f + Frames <= frames; f += Frames )
+		{
+			acc = V::maxOf( V::abs( V::load( ptr( src, f ) ) ), acc );
+		}
+
+		float lanes[V::Width];
+		V::store( lanes, acc );
+		float l = 0.0f;
+		float r = 0.0f;
+		for( int i = 0; i < V::Width; i += 2 )
+		{
+			l = l < lanes[i] ? lanes[i] : l;
+			r = r < lanes[i+1] ? lanes[i+1] : r;
+		}
+
+		for( ; f < frames; ++f )
+		{
+			const float al = kernelAbs( src[f][0] );
+			const float ar = kernelAbs( src[f][1] );
+			l = l < al ? al : l;
+			r = r < ar ? ar : r;
+		}
+
+		*left = l;
+		*right = r;
+	}
+
+
+	static void sumOfSquares( const sampleFrame * src, int frames, float * left, float * right )
+	{
+		Vec acc = V::set1( 0.0f );
+
+		int f = 0;
+		for( ; f + Frames <= frames; f += Frames )
+		{
+			const Vec s = V::load( ptr( src, f ) );
+			acc = V::add( acc, V::mul( s, s ) );
+		}
+
+		float lanes[V::Width];
+		V::store( lanes, acc );
+		float l = 0.0f;
+		float r = 0.0f;
+		for( int i = 0; i < V::Width; i += 2 )
+		{
+			l += lanes[i];
+			r += lanes[i+1];
+		}
+
+		for( ; f < frames; ++f )
+		{
+			l += src[f][0] * src[f][0];
+			r += src[f][1] * src[f][1];
+		}
+
+		*left = l;
+		*right = r;
+	}
+
+
+	static void add( sampleFrame * dst, const sampleFrame * src, int frames )
+	{
+		int f = 0;
+		for( ; f + Frames <= frames; f += Frames )
+		{
+			V::store( ptr( dst, f ), V::add( V::load( ptr( dst, f ) ),
+							V::load( ptr( src, f ) ) ) );
+		}
+		for( ; f < frames; ++f )
+		{
+			dst[f][0] += src[f][0];
+			dst[f][1] += src[f][1];
+		}
+	}
+
+
+	static void addMultiplied( sampleFrame * dst, const sampleFrame * src, float coeffSrc, int frames )
+	{
+		const Vec c = V::set1( coeffSrc );
+
+		int f = 0;
+		for( ; f + Frames <= frames; f += Frames )
+		{
+			V::store( ptr( dst, f ), V::add( V::load( ptr( dst, f ) ),
+					V::mul( V::load( ptr( src, f ) ), c ) ) );
+		}
+		for( ; f < frames; ++f )
+		{
+			dst[f][0] += src[f][0] * coeffSrc;
+			dst[f][1] += src[f][1] * coeffSrc;
+		}
+	}
+
+
+	static void addSwappedMultiplied( sampleFrame * dst, const sampleFrame * src, float coeffSrc, int frames )
+	{
+		const Vec c = V::set1( coeffSrc );
+
+		int f = 0;
+		for( ; f + Frames <= frames; f += Frames )
+		{
+			V::store( ptr( dst, f ), V::add( V::load( ptr( dst, f ) ),
+				V::mul( V::swapPairs( V::load( ptr( src, f ) ) ), c ) ) );
+		}
+		for( ; f < frames; ++f )
+		{
+			dst[f][0] += src[f][1] * coeffSrc;
+			dst[f][1] += src[f][0] * coeffSrc;
+		}
+	}
+
+
+	static void addMultipliedByBuffer( sampleFrame * dst, const sampleFrame * src, float coeffSrc, const float * coeffSrcBuf, int frames )
+	{
+		const Vec c = V::set1( coeffSrc );
+
+		int f = 0;
+		for( ; f + Frames <= frames; f += Frames )
+		{
+			const Vec s = V::mul( V::mul( V::load( ptr( src, f ) ), c ),
+							V::dupPairs( coeffSrcBuf + f ) );
+			V::store( ptr( dst, f ), V::add( V::load( ptr( dst, f ) ), s ) );
+		}
+		for( ; f < frames; ++f )
+		{
+			dst[f][0] += src[f][0] * coeffSrc * coeffSrcBuf[f];
+			dst[f][1] += src[f][1] * coeffSrc * coeffSrcBuf[f];
+		}
+	}
+
+
+	static void addMultipliedByBuffers( sampleFrame * dst, const sampleFrame * src, const float * coeffSrcBuf1, const float * coeffSrcBuf2, int frames )
+	{
+		int f = 0;
+		for( ; f + Frames <= frames; f += Frames )
+		{
+			const Vec s = V::mul( V::mul( V::load( ptr( src, f ) ),
+						V::dupPairs( coeffSrcBuf1 + f ) ),
+						V::dupPairs( coeffSrcBuf2 + f ) );
+			V::store( ptr( dst, f ), V::add( V::load( ptr( dst, f ) ), s ) );
+		}
+		for( ; f < frames; ++f )
+		{
+			dst[f][0] += src[f][0] * coeffSrcBuf1[f] * coeffSrcBuf2[f];
+			dst[f][1] += src[f][1] * coeffSrcBuf1[f] * coeffSrcBuf2[f];
+		}
+	}
+
+
+	static void addSanitizedMultiplied( sampleFrame * dst, const sampleFrame * src, float coeffSrc, int frames )
+	{
+		const Vec c = V::set1( coeffSrc );
+
+		int f = 0;
+		for( ; f + Frames <= frames; f += Frames )
+		{
+			const Vec s = V::load( ptr( src, f ) );
+			V::store( ptr( dst, f ), V::add( V::load( ptr( dst, f ) ),
+						V::finite( V::mul( s, c ), s ) ) );
+		}
+		for( ; f < frames; ++f )
+		{
+			dst[f][0] += kernelIsFinite( src[f][0] ) ? src[f][0] * coeffSrc : 0.0f;
+			dst[f][1] += kernelIsFinite( src[f][1] ) ? src[f][1] * coeffSrc : 0.0f;
+		}
+	}
+
+
+	static void addSanitizedMultipliedByBuffer( sampleFrame * dst, const sampleFrame * src, float coeffSrc, const float * coeffSrcBuf, int frames )
+	{
+		const Vec c = V::set1( coeffSrc );
+
+		int f = 0;
+		for( ; f + Frames <= frames; f += Frames )
+		{
+			const Vec s = V::load( ptr( src, f ) );
+			const Vec m = V::mul( V::mul( s, c ), V::dupPairs( coeffSrcBuf + f ) );
+			V::store( ptr( dst, f ), V::add( V::load( ptr( dst, f ) ),
+							V::finite( m, s ) ) );
+		}
+		for( ; f < frames; ++f )
+		{
+			dst[f][0] += kernelIsFinite( src[f][0] ) ? src[f][0] * coeffSrc * coeffSrcBuf[f] : 0.0f;
+			dst[f][1] += kernelIsFinite( src[f][1] ) ? src[f][1] * coeffSrc * coeffSrcBuf[f] : 0.0f;
+		}
+	}
+
+
+	static void addSanitizedMultipliedByBuffers( sampleFrame * dst, const sampleFrame * src, const float * coeffSrcBuf1, const float * coeffSrcBuf2, int frames )
+	{
+		int f = 0;
+		for( ; f + Frames <= frames; f += Frames )
+		{
+			const Vec s = V::load( ptr( src, f ) );
+			const Vec m = V::mul( V::mul( s, V::dupPairs( coeffSrcBuf1 + f ) ),
+						V::dupPairs( coeffSrcBuf2 + f ) );
+			V::store( ptr( dst, f ), V::add( V::load( ptr( dst, f ) ),
+							V::finite( m, s ) ) );
+		}
+		for( ; f < frames; ++f )
+		{
+			dst[f][0] += kernelIsFinite( src[f][0] ) ? src[f][0] * coeffSrcBuf1[f] * coeffSrcBuf2[f] : 0.0f;
+			dst[f][1] += kernelIsFinite( src[f][1] ) ? src[f][1] * coeffSrcBuf1[f] * coeffSrcBuf2[f] : 0.0f;
+		}
+	}
+
+
+	static void addMultipliedStereo( sampleFrame * dst, const sampleFrame * src, float coeffSrcLeft, float coeffSrcRight, int frames )
+	{
+		const Vec c = V::setPair( coeffSrcLeft, coeffSrcRight );
+
+		int f = 0;
+		for( ; f + Frames <= frames; f += Frames )
+		{
+			V::store( ptr( dst, f ), V::add( V::load( ptr( dst, f ) ),
+					V::mul( V::load( ptr( src, f ) ), c ) ) );
+		}
+		for( ; f < frames; ++f )
+		{
+			dst[f][0] += src[f][0] * coeffSrcLeft;
+			dst[f][1] += src[f][1] * coeffSrcRight;
+		}
+	}
+
+
+	static void multiplyAndAddMultiplied( sampleFrame * dst, const sampleFrame * src, float coeffDst, float coeffSrc, int frames )
+	{
+		const Vec cd = V::set1( coeffDst );
+		const Vec cs = V::set1( coeffSrc );
+
+		int f = 0;
+		for( ; f + Frames <= frames; f += Frames )
+		{
+			V::store( ptr( dst, f ), V::add( V::mul( V::load( ptr( dst, f ) ), cd ),
+					V::mul( V::load( ptr( src, f ) ), cs ) ) );
+		}
+		for( ; f < frames; ++f )
+		{
+			dst[f][0] = dst[f][0] * coeffDst + src[f][0] * coeffSrc;
+			dst[f][1] = dst[f][1] * coeffDst + src[f][1] * coeffSrc;
+		}
+	}
+
+
+	static void multiplyAndAddMultipliedJoined( sampleFrame * dst, const sample_t * srcLeft, const sample_t * srcRight, float coeffDst, float coeffSrc, int frames )
+	{
+		const Vec cd = V::set1( coeffDst );
+		const Vec cs = V::set1( coeffSrc );
+
+		// each step handles Width frames = two vectors
+		int f = 0;
+		for( ; f + V::Width <= frames; f += V::Width )
+		{
+			Vec lo, hi;
+			V::interleave( srcLeft + f, srcRight + f, lo, hi );
+			V::store( ptr( dst, f ), V::add( V::mul( V::load( ptr( dst, f ) ), cd ),
+								V::mul( lo, cs ) ) );
+			V::store( ptr( dst, f + Frames ), V::add( V::mul(
+					V::load( ptr( dst, f + Frames ) ), cd ),
+							V::mul( hi, cs ) ) );
+		}
+		for( ; f < frames; ++f )
+		{
+			dst[f][0] = dst[f][0] * coeffDst + srcLeft[f] * coeffSrc;
+			dst[f][1] = dst[f][1] * coeffDst + srcRight[f] * coeffSrc;
+		}
+	}
+
+
+	static void multiplyByBuffer( sampleFrame * dst, const float * coeffBuf, int frames )
+	{
+		int f = 0;
+		for( ; f + Frames <= frames; f += Frames )
+		{
+			V::store( ptr( dst, f ), V::mul( V::load( ptr( dst, f ) ),
+						V::dupPairs( coeffBuf + f ) ) );
+		}
+		for( ; f < frames; ++f )
+		{
+			dst[f][0] *= coeffBuf[f];
+			dst[f][1] *= coeffBuf[f];
+		}
+	}
+
+
+	static void multiplyByVolumeAndPanning( sampleFrame * dst, const float * volBuf, float vol, const float * panBuf, float pan, int frames )
+	{
+		const Vec scale = V::set1( 0.01f );
+		const Vec zero = V::set1( 0.0f );
+		const Vec one = V::set1( 1.0f );
+		// negated panning in right lanes, so both channels use the pan
+		// law of the left one: 1 - p for p > 0, 1 otherwise
+		const Vec flip = V::setPair( 1.0f, -1.0f );
+
+		const float v = vol * 0.01f;
+		const float p = pan * 0.01f;
+		float panLeft, panRight;
+		kernelVolumePanning( 1.0f, p, &panLeft, &panRight );
+		const Vec constVol = V::set1( v );
+		const Vec constPan = V::setPair( panLeft, panRight );
+
+		int f = 0;
+		for( ; f + Frames <= frames; f += Frames )
+		{
+			Vec g = constPan;
+			if( panBuf )
+			{
+				const Vec q = V::mul( V::mul( V::dupPairs( panBuf + f ),
+								scale ), flip );
+				g = V::notAbove( q, zero, one, V::sub( one, q ) );
+			}
+			g = V::mul( g, volBuf ? V::mul( V::dupPairs( volBuf + f ), scale ) :
+								constVol );
+			V::store( ptr( dst, f ), V::mul( V::load( ptr( dst, f ) ), g ) );
+		}
+		for( ; f < frames; ++f )
+		{
+			float l, r;
+			kernelVolumePanning( volBuf ? volBuf[f] * 0.01f : v,
+						panBuf ? panBuf[f] * 0.01f : p, &l, &r );
+			dst[f][0] *= l;
+			dst[f][1] *= r;
+		}
+	}
+
+} ;
+
+
+}
+
+
+// initializer for a MixKernels table - a constant expression, so no code
+// compiled for the instruction set runs before we know it's supported
+#define MIX_KERNELS_TABLE( name, Impl )				\
+	{							\
+		name,						\
+		&Impl::isSilent,				\
+		&Impl::sanitize,				\
+		&Impl::peak,					\
+		&Impl::sumOfSquares,				\
+		&Impl::add,					\
+		&Impl::addMultiplied,				\
+		&Impl::addSwappedMultiplied,			\
+		&Impl::addMultipliedByBuffer,			\
+		&Impl::addMultipliedByBuffers,			\
+		&Impl::addSanitizedMultiplied,			\
+		&Impl::addSanitizedMultipliedByBuffer,		\
+		&Impl::addSanitizedMultipliedByBuffers,		\
+		&Impl::addMultipliedStereo,			\
+		&Impl::multiplyAndAddMultiplied,		\
+		&Impl::multiplyAndAddMultipliedJoined,		\
+		&Impl::multiplyByBuffer,			\
+		&Impl::multiplyByVolumeAndPanning		\
+	}
+
+
+#endif
@@ -46,6 +46,7 @@
 #endif
 
 
+#include <QtCore/QAtomicInt>
 #include <QtCore/QMutex>
 #include <QtCore/QThread>
 #include <QtCore/QVector>
@@ -54,8 +55,11 @@
 
 #include "lmms_basics.h"
 #include "Note.h"
-#include "fifo_buffer.h"
+#include "PeriodBufferRing.h"
 #include "MixerProfiler.h"
+#include "RealtimeGuard.h"
+#include "RenderAheadController.h"
+#include "RenderTrace.h"
 
 
 class AudioDevice;
@@ -64,6 +68,8 @@ class AudioPort;
 
 
 const fpp_t DEFAULT_BUFFER_SIZE = 256;
+// default upper bound of buffer size if it's adapted to render load
+const fpp_t DEFAULT_MAX_ADAPTIVE_BUFFER_SIZE = 4096;
 
 const int BYTES_PER_SAMPLE = sizeof( sample_t );
 const int BYTES_PER_INT_SAMPLE = sizeof( int_sample_t );
@@ -215,12 +221,18 @@ public:
 	}
 
 
-	// play-handle stuff
+	// play-handle stuff - adding and removing single play handles never
+	// blocks and can be done from any thread, both take effect with the
+	// next period
 	bool addPlayHandle( PlayHandle* handle );
 
+	// handle must not have finished yet, as the mixer deletes finished
+	// play handles on its own
 	void removePlayHandle( PlayHandle* handle );
 
-	inline PlayHandleList& playHandles()
+	// only to be modified by the mixer - lock play handle removal when
+	// accessing it from outside of rendering
+	inline LinkedPlayHandleList& playHandles()
 	{
 		return m_playHandles;
 	}
@@ -252,6 +264,19 @@ public:
 		return m_profiler.cpuLoad();
 	}
 
+	// periods rendered ahead of the audio device and how that changed
+	RenderAheadController::Stats renderAheadStats() const
+	{
+		return m_renderAhead->stats();
+	}
+
+	// plugins whose output lags behind their input (e.g. pipelined remote
+	// plugins) report it here - there's no delay compensation within the
+	// render graph, pluginLatency() is just the largest latency reported
+	void addPluginLatency( f_cnt_t _frames );
+	void removePluginLatency( f_cnt_t _frames );
+	f_cnt_t pluginLatency() const;
+
 	const qualitySettings & currentQualitySettings() const
 	{
 		return m_qualitySettings;
@@ -330,8 +355,9 @@ public:
 						const f_cnt_t _offset = 0 );
 #endif
 
-	static float peakValueLeft( sampleFrame * _ab, const f_cnt_t _frames );
-	static float peakValueRight( sampleFrame * _ab, const f_cnt_t _frames );
+	// peaks of both channels in a single pass over the buffer
+	static void peakValues( const sampleFrame * _ab, const f_cnt_t _frames,
+						float & _left, float & _right );
 
 
 	bool criticalXRuns() const;
@@ -353,9 +379,24 @@ public:
 		return m_inputBufferFrames[ m_inputBufferRead ];
 	}
 
+	// returned buffer is valid until releaseNextBuffer() is called
 	inline const surroundSampleFrame * nextBuffer()
 	{
-		return hasFifoWriter() ? m_fifo->read() : renderNextBuffer();
+		if( hasFifoWriter() )
+		{
+			// blocks while the fifo is empty
+			RenderTraceScope trace( RenderTrace::CategoryFifo, "pop" );
+			return m_fifo->waitForReadBuffer();
+		}
+		return renderNextBuffer();
+	}
+
+	inline void releaseNextBuffer()
+	{
+		if( hasFifoWriter() )
+		{
+			m_fifo->pop();
+		}
 	}
 
 	void changeQuality( const struct qualitySettings & _qs );
@@ -368,7 +409,7 @@ signals:
 
 
 private:
-	typedef fifoBuffer<surroundSampleFrame *> fifo;
+	typedef PeriodBufferRing fifo;
 
 	class fifoWriter : public QThread
 	{
@@ -401,6 +442,11 @@ private:
 
 	const surroundSampleFrame * renderNextBuffer();
 
+	// the following require play handle removal to be locked
+	void adoptNewPlayHandles();
+	void removeRequestedPlayHandles();
+	void deletePlayHandle( PlayHandle * handle );
+
 
 
 	QVector<AudioPort *> m_audioPorts;
@@ -433,11 +479,10 @@ private:
 	int m_numWorkers;
 	QWaitCondition m_queueReadyWaitCond;
 
-	PlayHandleList m_newPlayHandles;	// place where new playhandles are added temporarily
-	QMutex m_playHandleMutex;			// mutex used only for adding playhandles
-
-	PlayHandleList m_playHandles;
-	ConstPlayHandleList m_playHandlesToRemove;
+	LinkedPlayHandleList m_playHandles;
+	PlayHandleInbox m_newPlayHandles;	// added with next period
+	PlayHandleInbox m_playHandlesToRemove;	// removed with next period
+	QAtomicInt m_clearPlayHandles;		// set by clear()
 
 	struct qualitySettings m_qualitySettings;
 	float m_masterGain;
@@ -452,16 +497,21 @@ private:
 	QString m_midiClientName;
 
 
-	QMutex m_globalMutex;
-	QMutex m_inputFramesMutex;
+	GuardedMutex m_globalMutex;
+	GuardedMutex m_inputFramesMutex;
 
-	QMutex m_playHandleRemovalMutex;
+	GuardedMutex m_playHandleRemovalMutex;
 
 	fifo * m_fifo;
 	fifoWriter * m_fifoWriter;
+	RenderAheadController * m_renderAhead;	// used by m_fifoWriter
 
 	MixerProfiler m_profiler;
 
+	// never locked while rendering
+	mutable QMutex m_pluginLatencyMutex;
+	QVector<f_cnt_t> m_pluginLatencies;
+
 	friend class Engine;
 	friend class MixerWorkerThread;
 
@@ -26,18 +26,118 @@
 #define MIXER_PROFILER_H
 
 #include <QFile>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+
+#include "lmmsconfig.h"
+
+#if defined( LMMS_HOST_X86 ) || defined( LMMS_HOST_X86_64 )
+#include <x86intrin.h>
+#elif defined( LMMS_BUILD_LINUX )
+#include <time.h>
+#else
+#include <sys/time.h>
+#endif
 
 #include "MicroTimer.h"
+#include "MemoryManager.h"
 
 class MixerProfiler
 {
 public:
+	// parts of Mixer::renderNextBuffer() timed separately
+	enum Stages
+	{
+		StagePrepare,	// removing play handles, processing song
+		StageRender,	// running render graph
+		StageMasterMix,	// cleaning up play handles, master mix
+		StageFinish,	// LFOs, controllers, buffer refresh
+		NumStages
+	} ;
+	typedef Stages Stage;
+
+	// nodes of the render graph which can skip their work when silent
+	enum NodeTypes
+	{
+		NodePlayHandle,	// all play handles of an audio port
+		NodeAudioPort,
+		NodeEffect,
+		NodeFxChannel,
+		NumNodeTypes
+	} ;
+	typedef NodeTypes NodeType;
+
+	enum
+	{
+		MaxNodes = 1024,
+		HistoryLength = 256,	// periods kept for the GUI
+		TopNodes = 8		// most expensive nodes kept per period
+	} ;
+
+	// timing statistics of a node, times in microseconds
+	struct NodeStats
+	{
+		QString name;
+		NodeType type;
+		int periods;	// periods the node did any work in
+		int lastTime;
+		int minTime;
+		int maxTime;
+		qint64 totalTime;
+		int xruns;	// periods exceeding their deadline with this
+				// node being the most expensive one
+	} ;
+
+	// entry of the history ring buffer, written once per period while
+	// node profiling is enabled
+	struct PeriodRecord
+	{
+		int period;
+		int periodTime;
+		int deadline;
+		int nodes[TopNodes];	// most expensive first, -1 if unused
+		int nodeTimes[TopNodes];
+	} ;
+
 	MixerProfiler();
 	~MixerProfiler();
 
 	void startPeriod()
 	{
+		if( m_nodeProfiling )
+		{
+			m_periodStartTicks = ticks();
+		}
 		m_periodTimer.reset();
+		m_stageTimer.reset();
+		m_periodStartAllocations = MemoryManager::allocations();
+	}
+
+	// called when given stage is done - stages have to be finished in order
+	void finishStage( Stage stage )
+	{
+		m_stageTimes[stage] = m_stageTimer.elapsed();
+		m_stageTimer.reset();
+	}
+
+	// time spent in given stage during last period in microseconds
+	int stageTime( Stage stage ) const
+	{
+		return m_stageTimes[stage];
+	}
+
+	// duration of last period in microseconds
+	int periodTime() const
+	{
+		return m_periodTime;
+	}
+
+	// real time a period lasts in microseconds, as of last period
+	int deadline() const
+	{
+		return m_deadline;
 	}
 
 	void finishPeriod( sample_rate_t sampleRate, fpp_t framesPerPeriod );
@@ -49,12 +149,179 @@ public:
 
 	void setOutputFile( const QString& outputFile );
 
+	// maximum number of jobs queued at once during last period
+	void setPeriodJobs( int jobs )
+	{
+		m_periodJobs = jobs;
+		m_jobsHighWaterMark = qMax( m_jobsHighWaterMark, jobs );
+	}
+
+	int periodJobs() const
+	{
+		return m_periodJobs;
+	}
+
+	int jobsHighWaterMark() const
+	{
+		return m_jobsHighWaterMark;
+	}
+
+	// number of MemoryManager allocations (in any thread) during last period
+	int periodAllocations() const
+	{
+		return m_periodAllocations;
+	}
+
+	// called by render graph nodes from any worker thread once per period
+	void countNode( NodeType type, bool silent )
+	{
+		( silent ? m_silentNodeCounters : m_activeNodeCounters )[type].ref();
+	}
+
+	// node timing - nodes are registered from outside the audio threads,
+	// timed by any worker thread and only while node profiling is
+	// enabled. Times of effects aren't included in the times of the audio
+	// port or FX channel they belong to.
+	int registerNode( NodeType type, const QString & name );
+	void unregisterNode( int node );
+	void setNodeName( int node, const QString & name );
+
+	bool nodeProfiling() const
+	{
+		return m_nodeProfiling;
+	}
+
+	void setNodeProfiling( bool enabled );
+	void resetNodeStats();
+
+	// ticks of a cycle counter (or the best clock available otherwise),
+	// converted to microseconds by comparing with the period time
+	static qint64 ticks()
+	{
+#if defined( LMMS_HOST_X86 ) || defined( LMMS_HOST_X86_64 )
+		return __rdtsc();
+#elif defined( LMMS_BUILD_LINUX )
+		struct timespec t;
+		clock_gettime( CLOCK_MONOTONIC, &t );
+		return t.tv_sec * 1000000000LL + t.tv_nsec;
+#else
+		struct timeval t;
+		gettimeofday( &t, NULL );
+		return t.tv_sec * 1000000LL + t.tv_usec;
+#endif
+	}
+
+	void addNodeTicks( int node, qint64 ticks )
+	{
+		// 32 bits are enough for a few hundred ms per period
+		m_nodeTicks[node].fetchAndAddOrdered( (int) qMin<qint64>( ticks, 1 << 30 ) );
+	}
+
+	// copy of statistics of given node, name empty if not registered
+	NodeStats nodeStats( int node ) const;
+
+	// ids of all registered nodes
+	QList<int> nodes() const;
+
+	// copies up to maxRecords periods recorded since cursor to records
+	// and advances cursor - for a single reader, usually the GUI
+	int readHistory( int & cursor, PeriodRecord * records, int maxRecords ) const;
+
+	// write statistics of all nodes to given file (CSV) or record top
+	// nodes per period in Chrome trace format (file name ending in .json)
+	void setNodeOutputFile( const QString & outputFile );
+	void finishNodeOutput();
+
+	// number of nodes of given type which did (not) process any signal
+	// during last period
+	int activeNodes( NodeType type ) const
+	{
+		return m_activeNodes[type];
+	}
+
+	int silentNodes( NodeType type ) const
+	{
+		return m_silentNodes[type];
+	}
+
 
 private:
 	MicroTimer m_periodTimer;
+	MicroTimer m_stageTimer;
+	int m_stageTimes[NumStages];
+	int m_periodTime;
+	int m_deadline;
 	int m_cpuLoad;
+	int m_periodJobs;
+	int m_jobsHighWaterMark;
+	int m_periodStartAllocations;
+	int m_periodAllocations;
+	QAtomicInt m_activeNodeCounters[NumNodeTypes];
+	QAtomicInt m_silentNodeCounters[NumNodeTypes];
+	int m_activeNodes[NumNodeTypes];
+	int m_silentNodes[NumNodeTypes];
 	QFile m_outputFile;
 
+	void finishNodePeriod( int periodTime, int deadline );
+	void writeTraceRecord( const PeriodRecord & record );
+
+	volatile bool m_nodeProfiling;
+	qint64 m_periodStartTicks;
+	int m_period;
+	mutable QMutex m_nodeMutex;	// guards registration and statistics
+	bool m_nodeUsed[MaxNodes];
+	int m_nodeCount;		// highest registered node + 1
+	QAtomicInt m_nodeTicks[MaxNodes];
+	NodeStats m_nodeStats[MaxNodes];
+	PeriodRecord m_history[HistoryLength];
+	mutable QAtomicInt m_historyWritten;
+	QFile m_nodeOutputFile;
+	bool m_nodeOutputTrace;
+
 };
 
+
+// adds time between construction (or start()) and destruction (or stop())
+// to given node if node profiling is enabled
+class MixerProfilerNodeTimer
+{
+public:
+	MixerProfilerNodeTimer( MixerProfiler & profiler, int node ) :
+		m_profiler( profiler ),
+		m_node( node ),
+		m_start( 0 )
+	{
+		start();
+	}
+
+	~MixerProfilerNodeTimer()
+	{
+		stop();
+	}
+
+	void start()
+	{
+		if( m_node >= 0 && m_profiler.nodeProfiling() )
+		{
+			m_start = MixerProfiler::ticks();
+		}
+	}
+
+	void stop()
+	{
+		if( m_start )
+		{
+			m_profiler.addNodeTicks( m_node, MixerProfiler::ticks() - m_start );
+			m_start = 0;
+		}
+	}
+
+
+private:
+	MixerProfiler & m_profiler;
+	int m_node;
+	qint64 m_start;
+
+} ;
+
 #endif
@@ -25,6 +25,7 @@
 #ifndef MIXER_WORKER_THREAD_H
 #define MIXER_WORKER_THREAD_H
 
+#include <QtCore/QAtomicInt>
 #include <QtCore/QAtomicPointer>
 #include <QtCore/QThread>
 
@@ -35,6 +36,32 @@ class ThreadableJob;
 class MixerWorkerThread : public QThread
 {
 public:
+	typedef QAtomicPointer<ThreadableJob> JobSlot;
+
+	// growable storage for job pointers - it consists of fixed-size segments
+	// which are allocated on demand and never moved or freed before
+	// destruction, so growing it never invalidates slots other threads are
+	// accessing concurrently
+	class JobSegments
+	{
+	public:
+		JobSegments();
+		~JobSegments();
+
+		// returns slot for given index (allocating its segment if
+		// requested) or NULL if segment is not available
+		JobSlot * slot( int _index, bool _allocate );
+
+		// make sure segments for given number of jobs are allocated
+		void reserve( int _jobs );
+
+	private:
+#define JOB_SEGMENT_SIZE 1024
+#define JOB_MAX_SEGMENTS 256
+		QAtomicPointer<JobSlot> m_segments[JOB_MAX_SEGMENTS];
+
+	} ;
+
 	// internal representation of the job queue - all functions are thread-safe
 	class JobQueue
 	{
@@ -55,20 +82,63 @@ public:
 
 		void reset( OperationMode _opMode );
 
-		void addJob( ThreadableJob * _job );
+		void reserve( int _jobs )
+		{
+			m_items.reserve( _jobs );
+		}
+
+		bool addJob( ThreadableJob * _job );
+
+		// jobs queued since last reset
+		int queued() const
+		{
+			return m_queueSize;
+		}
 
 		void run();
 		void wait();
 
 	private:
-#define JOB_QUEUE_SIZE 1024
-		QAtomicPointer<ThreadableJob> m_items[JOB_QUEUE_SIZE];
+		JobSegments m_items;
 		QAtomicInt m_queueSize;
 		QAtomicInt m_itemsDone;
 		OperationMode m_opMode;
 
 	} ;
 
+	// per-worker job deque used for work-stealing scheduling - push() and
+	// pop() may only be called by the owning thread while steal() can be
+	// called by any thread
+	class JobDeque
+	{
+	public:
+		JobDeque();
+
+		// returns false if deque is full
+		bool push( ThreadableJob * _job );
+		ThreadableJob * pop();
+		ThreadableJob * steal();
+
+		int capacity() const
+		{
+			return m_capacity;
+		}
+
+		// grow capacity to at least given number of jobs - this is only
+		// done while the deque is empty as the index mapping changes, so
+		// either by the owning thread or while no jobs are processed
+		void reserve( int _jobs );
+
+	private:
+		JobSegments m_items;
+		// always a power of 2 so index mapping survives index wrap-around
+		QAtomicInt m_capacity;
+		// indices grow monotonically and are allowed to wrap around
+		QAtomicInt m_top;
+		QAtomicInt m_bottom;
+
+	} ;
+
 
 	MixerWorkerThread( Mixer* mixer );
 	virtual ~MixerWorkerThread();
@@ -76,15 +146,10 @@ public:
 	virtual void quit();
 
 	static void resetJobQueue( JobQueue::OperationMode _opMode =
-													JobQueue::Static )
-	{
-		globalJobQueue.reset( _opMode );
-	}
+													JobQueue::Static );
 
-	static void addJob( ThreadableJob * _job )
-	{
-		globalJobQueue.addJob( _job );
-	}
+	// returns false if job didn't require processing and hence wasn't queued
+	static bool addJob( ThreadableJob * _job );
 
 	// a convenient helper function allowing to pass a container with pointers
 	// to ThreadableJob objects
@@ -102,13 +167,44 @@ public:
 	static void startAndWaitForJobs();
 
 
+	// whether jobs are distributed via per-worker deques (default) or via
+	// the single global job queue
+	static bool isWorkStealing()
+	{
+		return s_workStealing;
+	}
+
+	// called by mixer once per period - returns maximum number of jobs queued
+	// at once during the period and grows the job storage accordingly, so
+	// adding jobs never has to allocate
+	static int finishPeriod();
+
+
 private:
 	virtual void run();
 
+	// process jobs from own deque and steal from other workers' deques -
+	// returns as soon as no more jobs are left if _untilDone is false
+	void processJobs( bool _untilDone );
+
+	static MixerWorkerThread * currentWorker();
+
+	static void updateJobsHighWaterMark( int _jobs );
+
 	static JobQueue globalJobQueue;
 	static QWaitCondition * queueReadyWaitCond;
 	static QList<MixerWorkerThread *> workerThreads;
 
+	static bool s_workStealing;
+	static JobQueue::OperationMode s_opMode;
+	static QAtomicInt s_pendingJobs;
+
+	// maximum number of jobs queued at once in current period
+	static QAtomicInt s_jobsHighWaterMark;
+	static int s_lastPeriodJobs;
+
+	JobDeque m_jobDeque;
+	int m_index;
 	volatile bool m_quit;
 
 } ;
@@ -119,6 +119,12 @@ public:
 		return (bool) ((int) ( *lhs ).pos() < (int) ( *rhs ).pos());
 	}
 
+	// for searching a position in notes sorted by position
+	static inline bool posLessThan( const Note * note, const MidiTime & pos )
+	{
+		return note->pos() < pos;
+	}
+
 	inline bool selected() const
 	{
 		return m_selected;
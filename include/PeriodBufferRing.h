@@ -0,0 +1,135 @@
+/*
+ * PeriodBufferRing.h - preallocated SPSC ring of period buffers between
+ *                      Mixer::fifoWriter and the audio device
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef PERIOD_BUFFER_RING_H
+#define PERIOD_BUFFER_RING_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+
+#include "lmms_basics.h"
+
+
+/*! Ring of preallocated period buffers for exactly one producer and one
+ * consumer thread. The producer fills writeBuffer() and publishes it with
+ * push(), the consumer reads readBuffer() in place and hands it back with
+ * pop(). All of these are wait-free; only waitForWriteBuffer() and
+ * waitForReadBuffer() block - after spinning shortly - while the ring is
+ * full or empty respectively. The ring counts as full once depth() buffers
+ * are published, so the render-ahead can be changed at runtime without
+ * reallocating. */
+class PeriodBufferRing
+{
+public:
+	PeriodBufferRing( int size, fpp_t frames );
+	~PeriodBufferRing();
+
+	int size() const
+	{
+		return m_size;
+	}
+
+	// number of buffers published but not popped yet
+	int available() const
+	{
+		return m_filled.fetchAndAddOrdered( 0 );
+	}
+
+	// number of buffers the producer may publish ahead of the consumer
+	int depth() const
+	{
+		return m_depth.fetchAndAddOrdered( 0 );
+	}
+
+	// clamped to 1..size() - when lowered, buffers already published are
+	// still read, the producer just waits until the ring drained below it
+	void setDepth( int depth );
+
+	// number of times the consumer had to sleep as the ring was empty
+	int underruns() const
+	{
+		return m_underruns.fetchAndAddOrdered( 0 );
+	}
+
+
+	// producer side: buffer to write next or NULL if ring is full
+	surroundSampleFrame * writeBuffer()
+	{
+		return available() < depth() ? buffer( m_writeSlot ) : NULL;
+	}
+
+	surroundSampleFrame * waitForWriteBuffer();
+
+	// publish buffer returned by writeBuffer() - the consumer gets NULL
+	// instead of it if endOfStream is set
+	void push( bool endOfStream = false );
+
+
+	// consumer side: oldest published buffer or NULL if ring is empty
+	// (check available() to tell apart from end of stream)
+	const surroundSampleFrame * readBuffer() const
+	{
+		return available() > 0 && !m_endOfStream[m_readSlot] ?
+						buffer( m_readSlot ) : NULL;
+	}
+
+	// returns NULL at end of stream
+	const surroundSampleFrame * waitForReadBuffer();
+
+	// hand back buffer returned by readBuffer() to producer
+	void pop();
+
+
+private:
+	surroundSampleFrame * buffer( int slot ) const
+	{
+		return m_buffers + slot * m_frames;
+	}
+
+	// wakes up other side if it's sleeping
+	void wake( QAtomicInt & waiting, QWaitCondition & cond );
+
+	int m_size;
+	fpp_t m_frames;
+	surroundSampleFrame * m_buffers;
+	bool * m_endOfStream;
+
+	// only accessed by producer and consumer respectively
+	int m_writeSlot;
+	int m_readSlot;
+
+	mutable QAtomicInt m_filled;
+	mutable QAtomicInt m_depth;
+	mutable QAtomicInt m_underruns;
+
+	QMutex m_waitMutex;
+	QWaitCondition m_writable;
+	QWaitCondition m_readable;
+	QAtomicInt m_writerWaiting;
+	QAtomicInt m_readerWaiting;
+
+} ;
+
+
+#endif
@@ -25,15 +25,20 @@
 #ifndef PLAY_HANDLE_H
 #define PLAY_HANDLE_H
 
+#include <QtCore/QAtomicInt>
+#include <QtCore/QAtomicPointer>
 #include <QtCore/QThread>
 #include <QtCore/QVector>
 #include <QtCore/QMutex>
 
 #include "ThreadableJob.h"
 #include "lmms_basics.h"
+#include "RealtimeGuard.h"
 
 class Track;
 class AudioPort;
+class LinkedPlayHandleList;
+class PlayHandleInbox;
 
 class PlayHandle : public ThreadableJob
 {
@@ -56,6 +61,7 @@ public:
 		m_offset = p.m_offset;
 		m_affinity = p.m_affinity;
 		m_usesBuffer = p.m_usesBuffer;
+		m_silent = p.m_silent;
 		m_audioPort = p.m_audioPort;
 		return *this;
 	}
@@ -85,6 +91,8 @@ public:
 		return !isFinished();
 	}
 
+	virtual const char * jobName() const;
+
 	void lock()
 	{
 		m_processingLock.lock();
@@ -124,6 +132,18 @@ public:
 	{
 		m_usesBuffer = b;
 	}
+
+	// whether buffer of current period contains nothing but silence, so
+	// the audio port can skip it - reset before every call of play()
+	bool isSilent() const
+	{
+		return m_silent;
+	}
+
+	void setSilent( const bool silent )
+	{
+		m_silent = silent;
+	}
 	
 	AudioPort * audioPort()
 	{
@@ -142,15 +162,39 @@ public:
 		return m_playHandleBuffer;
 	}
 
+	// used by Mixer to queue a removal request only once - returns false
+	// if removal has been requested before
+	bool requestRemoval()
+	{
+		return m_removalRequested.testAndSetOrdered( 0, 1 );
+	}
+
+	bool isRemovalRequested() const
+	{
+		return m_removalRequested != 0;
+	}
+
 private:
 	Type m_type;
 	f_cnt_t m_offset;
 	QThread* m_affinity;
-	QMutex m_processingLock;
+	GuardedMutex m_processingLock;
 	sampleFrame * m_playHandleBuffer;
 	bool m_usesBuffer;
+	bool m_silent;
 	AudioPort * m_audioPort;
 
+	// links of LinkedPlayHandleList and PlayHandleInbox, so neither of
+	// them ever allocates
+	PlayHandle * m_prevLinked;
+	PlayHandle * m_nextLinked;
+	LinkedPlayHandleList * m_linkedList;
+	PlayHandle * m_nextInInbox[2];
+	QAtomicInt m_removalRequested;
+
+	friend class LinkedPlayHandleList;
+	friend class PlayHandleInbox;
+
 } ;
 
 
@@ -158,4 +202,199 @@ typedef QList<PlayHandle *> PlayHandleList;
 typedef QList<const PlayHandle *> ConstPlayHandleList;
 
 
+
+
+/*! Intrusive list of play handles in order of insertion. Appending and
+ * removing a handle is O(1) and never allocates. A handle can be member
+ * of one list at a time and never moves while it is, so iterators stay
+ * valid unless the handle they point to is removed. Not thread-safe. */
+class LinkedPlayHandleList
+{
+public:
+	class Iterator
+	{
+	public:
+		Iterator( PlayHandle * handle = NULL ) :
+			m_handle( handle )
+		{
+		}
+
+		PlayHandle * operator*() const
+		{
+			return m_handle;
+		}
+
+		Iterator & operator++()
+		{
+			m_handle = m_handle->m_nextLinked;
+			return *this;
+		}
+
+		bool operator==( const Iterator & other ) const
+		{
+			return m_handle == other.m_handle;
+		}
+
+		bool operator!=( const Iterator & other ) const
+		{
+			return m_handle != other.m_handle;
+		}
+
+	private:
+		PlayHandle * m_handle;
+
+	} ;
+	typedef Iterator ConstIterator;
+
+	LinkedPlayHandleList() :
+		m_first( NULL ),
+		m_last( NULL ),
+		m_size( 0 )
+	{
+	}
+
+	Iterator begin() const
+	{
+		return Iterator( m_first );
+	}
+
+	Iterator end() const
+	{
+		return Iterator();
+	}
+
+	int size() const
+	{
+		return m_size;
+	}
+
+	bool isEmpty() const
+	{
+		return m_size == 0;
+	}
+
+	bool contains( const PlayHandle * handle ) const
+	{
+		return handle->m_linkedList == this;
+	}
+
+	void append( PlayHandle * handle )
+	{
+		handle->m_prevLinked = m_last;
+		handle->m_nextLinked = NULL;
+		handle->m_linkedList = this;
+		if( m_last )
+		{
+			m_last->m_nextLinked = handle;
+		}
+		else
+		{
+			m_first = handle;
+		}
+		m_last = handle;
+		++m_size;
+	}
+
+	// returns iterator to the handle following the removed one
+	Iterator erase( Iterator it )
+	{
+		PlayHandle * handle = *it;
+		PlayHandle * prev = handle->m_prevLinked;
+		PlayHandle * next = handle->m_nextLinked;
+		if( prev )
+		{
+			prev->m_nextLinked = next;
+		}
+		else
+		{
+			m_first = next;
+		}
+		if( next )
+		{
+			next->m_prevLinked = prev;
+		}
+		else
+		{
+			m_last = prev;
+		}
+		handle->m_prevLinked = handle->m_nextLinked = NULL;
+		handle->m_linkedList = NULL;
+		--m_size;
+		return Iterator( next );
+	}
+
+	// returns false if handle isn't member of this list
+	bool remove( PlayHandle * handle )
+	{
+		if( !contains( handle ) )
+		{
+			return false;
+		}
+		erase( Iterator( handle ) );
+		return true;
+	}
+
+private:
+	PlayHandle * m_first;
+	PlayHandle * m_last;
+	int m_size;
+
+} ;
+
+
+
+
+/*! Lock-free multi-producer single-consumer queue of play handles. Any
+ * thread may push() handles while only one thread at a time may take
+ * them. Each handle has link fields for two inboxes, so it can be queued
+ * for being added and for being removed at the same time, but only once
+ * per inbox. */
+class PlayHandleInbox
+{
+public:
+	PlayHandleInbox( int link ) :
+		m_link( link ),
+		m_head( NULL )
+	{
+	}
+
+	void push( PlayHandle * handle )
+	{
+		PlayHandle * head;
+		do
+		{
+			head = m_head;
+			handle->m_nextInInbox[m_link] = head;
+		} while( !m_head.testAndSetRelease( head, handle ) );
+	}
+
+	// takes all handles pushed so far - they're returned in the order
+	// they were pushed, iterate them using next()
+	PlayHandle * takeAll()
+	{
+		// taking the whole stack at once means there's no ABA problem
+		PlayHandle * handle = m_head.fetchAndStoreAcquire( NULL );
+		PlayHandle * first = NULL;
+		while( handle )
+		{
+			PlayHandle * next = handle->m_nextInInbox[m_link];
+			handle->m_nextInInbox[m_link] = first;
+			first = handle;
+			handle = next;
+		}
+		return first;
+	}
+
+	PlayHandle * next( const PlayHandle * handle ) const
+	{
+		return handle->m_nextInInbox[m_link];
+	}
+
+private:
+	int m_link;
+	QAtomicPointer<PlayHandle> m_head;
+
+} ;
+
+
 #endif
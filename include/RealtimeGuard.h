@@ -0,0 +1,132 @@
+/*
+ * RealtimeGuard.h - detect real-time unsafe operations in audio threads
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef REALTIME_GUARD_H
+#define REALTIME_GUARD_H
+
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <stddef.h>
+
+#include "export.h"
+
+const int RT_GUARD_MAX_VIOLATIONS = 4096; // recorded violations, further ones are only counted
+const int RT_GUARD_STACK_DEPTH = 16; // frames captured per violation
+
+
+/*! Opt-in checker for operations that must not happen while a period is
+ * rendered. Threads taking part in rendering (the mixer thread and the
+ * MixerWorkerThreads) mark themselves as real-time. While a period is in
+ * progress, every MemoryManager::alloc(), operator new (all variants) and
+ * lock() of a GuardedMutex in such a thread is recorded together with its
+ * call site. Recording uses preallocated storage only; the collected report
+ * is written by dump() when LMMS exits.
+ *
+ * Not covered: plain malloc() calls, QMutex and locking a GuardedMutex
+ * through QMutexLocker (use GuardedMutexLocker) or QWaitCondition::wait(),
+ * which relocks the mutex by itself. */
+class EXPORT RealtimeGuard
+{
+public:
+	enum Violations
+	{
+		MemoryManagerAlloc,
+		OperatorNew,
+		MutexLock,
+		NumViolations
+	} ;
+	typedef Violations Violation;
+
+	// output file may be "-" to write to stderr
+	static void enable( const QString & outputFile );
+
+	static inline bool isEnabled()
+	{
+		return s_enabled;
+	}
+
+	static void setRealtimeThread( bool realtime );
+
+	// called by Mixer around rendering of each period
+	static void startPeriod();
+	static void finishPeriod();
+
+	static inline void check( Violation type, size_t size = 0 )
+	{
+		if( s_enabled )
+		{
+			report( type, size );
+		}
+	}
+
+	static void report( Violation type, size_t size );
+
+	static void dump();
+
+private:
+	static bool s_enabled;
+	static QString s_outputFile;
+
+} ;
+
+
+// QMutex which reports blocking lock() calls to RealtimeGuard - lock() of
+// QMutex isn't virtual, so this only works when called as GuardedMutex
+class GuardedMutex : public QMutex
+{
+public:
+	GuardedMutex( RecursionMode mode = NonRecursive ) :
+		QMutex( mode )
+	{
+	}
+
+	void lock()
+	{
+		RealtimeGuard::check( RealtimeGuard::MutexLock );
+		QMutex::lock();
+	}
+
+} ;
+
+
+// QMutexLocker for GuardedMutex, which calls the checked lock()
+class GuardedMutexLocker
+{
+public:
+	GuardedMutexLocker( GuardedMutex * mutex ) :
+		m_mutex( mutex )
+	{
+		m_mutex->lock();
+	}
+
+	~GuardedMutexLocker()
+	{
+		m_mutex->unlock();
+	}
+
+private:
+	GuardedMutex * m_mutex;
+
+} ;
+
+
+#endif
@@ -45,6 +45,10 @@
 #define USE_QT_SEMAPHORES
 #endif
 
+#if defined( LMMS_BUILD_LINUX ) && !defined( USE_QT_SEMAPHORES )
+#define USE_FUTEX
+#endif
+
 
 #ifdef USE_QT_SEMAPHORES
 
@@ -67,6 +71,15 @@
 
 #endif
 
+#ifdef USE_FUTEX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <climits>
+#include <ctime>
+#include <stdint.h>
+#endif
+
 
 #ifdef USE_QT_SHMEM
 
@@ -102,6 +115,8 @@ typedef int32_t key_t;
 #include <QtCore/QMutex>
 #include <QtCore/QProcess>
 #include <QtCore/QThread>
+
+#include "MicroTimer.h"
 #endif
 
 // sometimes we need to exchange bigger messages (e.g. for VST parameter dumps)
@@ -110,6 +125,12 @@ const int SHM_FIFO_SIZE = 512*1024;
 
 
 // implements a FIFO inside a shared memory segment
+//
+// With futexes available it's a lock-free ring for exactly one reading and
+// one writing process: lock() only serializes the threads of one process
+// and a reader or writer only enters the kernel for sleeping while there's
+// no message or no space left. Otherwise the FIFO is guarded by a semaphore
+// shared by both processes.
 class shmFifo
 {
 	// need this union to handle different sizes of sem_t on 32 bit
@@ -124,11 +145,19 @@ class shmFifo
 	} ;
 	struct shmData
 	{
+#ifdef USE_FUTEX
+		volatile int32_t messages;	// complete messages not read yet
+		volatile int32_t messageWaiters;
+		volatile int32_t readPos;	// running byte counts, only
+		volatile int32_t writePos;	// changed by reader/writer
+		volatile int32_t writerWaiting;	// writer waits for space
+#else
 		sem32_t dataSem;	// semaphore for locking this
 					// FIFO management data
 		sem32_t messageSem;	// semaphore for incoming messages
 		volatile int32_t startPtr; // current start of FIFO in memory
 		volatile int32_t endPtr;   // current end of FIFO in memory
+#endif
 		char data[SHM_FIFO_SIZE];  // actual data
 	} ;
 
@@ -147,7 +176,7 @@ public:
 #ifdef USE_QT_SEMAPHORES
 		m_dataSem( QString::null ),
 		m_messageSem( QString::null ),
-#else
+#elif !defined( USE_FUTEX )
 		m_dataSem( NULL ),
 		m_messageSem( NULL ),
 #endif
@@ -169,7 +198,13 @@ public:
 		m_data = (shmData *) shmat( m_shmID, 0, 0 );
 #endif
 		assert( m_data != NULL );
+#ifdef USE_FUTEX
+		m_data->messages = m_data->messageWaiters = 0;
+		m_data->readPos = m_data->writePos = 0;
+		m_data->writerWaiting = 0;
+#else
 		m_data->startPtr = m_data->endPtr = 0;
+#endif
 #ifdef USE_QT_SEMAPHORES
 		static int k = 0;
 		m_data->dataSem.semKey = ( getpid()<<10 ) + ++k;
@@ -179,7 +214,7 @@ public:
 		m_messageSem.setKey( QString::number(
 						m_data->messageSem.semKey ),
 						0, QSystemSemaphore::Create );
-#else
+#elif !defined( USE_FUTEX )
 		m_dataSem = &m_data->dataSem.sem;
 		m_messageSem = &m_data->messageSem.sem;
 
@@ -210,7 +245,7 @@ public:
 #ifdef USE_QT_SEMAPHORES
 		m_dataSem( QString::null ),
 		m_messageSem( QString::null ),
-#else
+#elif !defined( USE_FUTEX )
 		m_dataSem( NULL ),
 		m_messageSem( NULL ),
 #endif
@@ -232,7 +267,7 @@ public:
 		m_dataSem.setKey( QString::number( m_data->dataSem.semKey ) );
 		m_messageSem.setKey( QString::number(
 						m_data->messageSem.semKey ) );
-#else
+#elif !defined( USE_FUTEX )
 		m_dataSem = &m_data->dataSem.sem;
 		m_messageSem = &m_data->messageSem.sem;
 #endif
@@ -249,7 +284,7 @@ public:
 #ifndef USE_QT_SHMEM
 			shmctl( m_shmID, IPC_RMID, NULL );
 #endif
-#ifndef USE_QT_SEMAPHORES
+#if !defined( USE_QT_SEMAPHORES ) && !defined( USE_FUTEX )
 			sem_destroy( m_dataSem );
 			sem_destroy( m_messageSem );
 #endif
@@ -272,6 +307,81 @@ public:
 		return m_master;
 	}
 
+#ifdef USE_FUTEX
+	// lock against other threads of this process - not recursive
+	inline void lock()
+	{
+		if( isInvalid() )
+		{
+			return;
+		}
+		int32_t c = __sync_val_compare_and_swap( &m_lockDepth, 0, 1 );
+		if( c != 0 )
+		{
+			// mark as contended and sleep until unlocked
+			if( c != 2 )
+			{
+				c = __sync_lock_test_and_set( &m_lockDepth, 2 );
+			}
+			while( c != 0 )
+			{
+				futexWait( &m_lockDepth, 2 );
+				c = __sync_lock_test_and_set( &m_lockDepth, 2 );
+			}
+		}
+	}
+
+	inline void unlock()
+	{
+		if( m_lockDepth == 0 )
+		{
+			// lock() skipped as we were invalid
+			return;
+		}
+		if( __sync_fetch_and_sub( &m_lockDepth, 1 ) != 1 )
+		{
+			m_lockDepth = 0;
+			futexWake( &m_lockDepth, 1 );
+		}
+	}
+
+	// wait until a message is available and take it
+	inline void waitForMessage()
+	{
+		while( !isInvalid() )
+		{
+			const int32_t n = m_data->messages;
+			if( n > 0 )
+			{
+				if( __sync_bool_compare_and_swap(
+						&m_data->messages, n, n - 1 ) )
+				{
+					return;
+				}
+				continue;
+			}
+			// announce ourselves before checking the last time -
+			// both are full barriers, so messageSent() either sees
+			// us or we see its message
+			__sync_fetch_and_add( &m_data->messageWaiters, 1 );
+			if( m_data->messages == 0 )
+			{
+				futexWait( &m_data->messages, 0 );
+			}
+			__sync_fetch_and_sub( &m_data->messageWaiters, 1 );
+		}
+	}
+
+	// publish message written so far
+	inline void messageSent()
+	{
+		__sync_fetch_and_add( &m_data->messages, 1 );
+		if( m_data->messageWaiters )
+		{
+			futexWake( &m_data->messages, INT_MAX );
+		}
+	}
+#else
 	// recursive lock
 	inline void lock()
 	{
@@ -320,6 +430,7 @@ public:
 		sem_post( m_messageSem );
 #endif
 	}
+#endif
 
 
 	inline int32_t readInt()
@@ -364,7 +475,9 @@ public:
 		{
 			return false;
 		}
-#ifdef USE_QT_SEMAPHORES
+#if defined( USE_FUTEX )
+		return m_data->messages > 0;
+#elif defined( USE_QT_SEMAPHORES )
 		lock();
 		const bool empty = ( m_data->startPtr == m_data->endPtr );
 		unlock();
@@ -383,6 +496,22 @@ public:
 	}
 
 
+#ifdef USE_FUTEX
+	// futex calls on words in memory shared between processes
+	static inline void futexWait( volatile int32_t * _addr, int32_t _val,
+				const struct timespec * _timeout = NULL )
+	{
+		syscall( SYS_futex, _addr, FUTEX_WAIT, _val, _timeout,
+								NULL, 0 );
+	}
+
+	static inline void futexWake( volatile int32_t * _addr, int _count )
+	{
+		syscall( SYS_futex, _addr, FUTEX_WAKE, _count, NULL, NULL, 0 );
+	}
+#endif
+
+
 private:
 	static inline void fastMemCpy( void * _dest, const void * _src,
 							const int _len )
@@ -398,6 +527,72 @@ private:
 		}
 	}
 
+#ifdef USE_FUTEX
+	// bytes written but not read yet
+	inline int used() const
+	{
+		return (uint32_t) m_data->writePos - (uint32_t) m_data->readPos;
+	}
+
+	// only called for messages counted already, so all of it is there
+	void read( void * _buf, int _len )
+	{
+		if( isInvalid() )
+		{
+			memset( _buf, 0, _len );
+			return;
+		}
+		const int pos = (uint32_t) m_data->readPos % SHM_FIFO_SIZE;
+		const int first = _len < SHM_FIFO_SIZE - pos ? _len : SHM_FIFO_SIZE - pos;
+		fastMemCpy( _buf, m_data->data + pos, first );
+		if( first < _len )
+		{
+			memcpy( (char *) _buf + first, m_data->data,
+							_len - first );
+		}
+		// full barrier - data is copied before the space is handed
+		// back to the writer
+		__sync_fetch_and_add( &m_data->readPos, _len );
+		if( m_data->writerWaiting )
+		{
+			futexWake( &m_data->readPos, 1 );
+		}
+	}
+
+	void write( const void * _buf, int _len )
+	{
+		if( isInvalid() || _len > SHM_FIFO_SIZE )
+		{
+			return;
+		}
+		while( SHM_FIFO_SIZE - used() < _len )
+		{
+			if( isInvalid() )
+			{
+				return;
+			}
+			const int32_t readPos = m_data->readPos;
+			__sync_fetch_and_add( &m_data->writerWaiting, 1 );
+			if( SHM_FIFO_SIZE - used() < _len )
+			{
+				// wake up regularly to notice a dead reader
+				struct timespec timeout = { 0, 10000000 };
+				futexWait( &m_data->readPos, readPos, &timeout );
+			}
+			__sync_fetch_and_sub( &m_data->writerWaiting, 1 );
+		}
+		const int pos = (uint32_t) m_data->writePos % SHM_FIFO_SIZE;
+		const int first = _len < SHM_FIFO_SIZE - pos ? _len : SHM_FIFO_SIZE - pos;
+		fastMemCpy( m_data->data + pos, _buf, first );
+		if( first < _len )
+		{
+			memcpy( m_data->data, (const char *) _buf + first,
+							_len - first );
+		}
+		// full barrier - data is visible before its position
+		__sync_fetch_and_add( &m_data->writePos, _len );
+	}
+#else
 	void read( void * _buf, int _len )
 	{
 		if( isInvalid() )
@@ -455,6 +650,7 @@ private:
 		m_data->endPtr += _len;
 		unlock();
 	}
+#endif
 
 	volatile bool m_invalid;
 	bool m_master;
@@ -468,11 +664,11 @@ private:
 #ifdef USE_QT_SEMAPHORES
 	QSystemSemaphore m_dataSem;
 	QSystemSemaphore m_messageSem;
-#else
+#elif !defined( USE_FUTEX )
 	sem_t * m_dataSem;
 	sem_t * m_messageSem;
 #endif
-	volatile int m_lockDepth;
+	volatile int32_t m_lockDepth;	// lock word with futexes
 
 } ;
 
@@ -500,11 +696,107 @@ enum RemoteMessageIDs
 	IdSavePresetFile,
 	IdLoadPresetFile,
 	IdDebugMessage,
+	IdProcessEvents,
 	IdUserBase = 64
 } ;
 
 
 
+// version of the layout of the shared memory used for processing - has to
+// be increased with every change to RemoteShmHeader, RemoteEvent or the
+// audio buffers following them
+const int32_t REMOTE_PLUGIN_PROTOCOL_VERSION = 3;
+const int32_t REMOTE_SHM_MAGIC = 0x4c4d4d53;	// "LMMS"
+
+// periods of audio buffers (inputs followed by outputs) in shared memory -
+// IdStartProcessing tells which one to process, so a pipelined master can
+// fill the next one while the remote process is still busy
+const int REMOTE_AUDIO_SLOTS = 2;
+
+// events queued for a single period at most, power of 2
+const int REMOTE_EVENT_RING_SIZE = 1024;
+
+
+enum RemoteEventTypes
+{
+	RemoteEventMidi,	// data: type, channel, param 0, param 1
+	RemoteEventParameter	// data: index, value in value
+} ;
+
+
+struct RemoteEvent
+{
+	int32_t type;
+	int32_t offset;		// frames into period the event belongs to
+	int32_t data[4];
+	float value;
+} ;
+
+
+// placed at the beginning of the shared memory used for processing,
+// REMOTE_AUDIO_SLOTS audio buffers follow at REMOTE_SHM_HEADER_SIZE. Events
+// are written by the master (while holding RemotePlugin::lock()) and read
+// by the thread of the remote process which processes audio, without any
+// locking.
+struct RemoteShmHeader
+{
+	int32_t magic;
+	int32_t version;		// set by master
+	volatile int32_t clientVersion;	// set by client once attached
+	volatile int32_t eventsWritten;	// running counts
+	volatile int32_t eventsRead;
+	RemoteEvent events[REMOTE_EVENT_RING_SIZE];
+
+	void init()
+	{
+		magic = REMOTE_SHM_MAGIC;
+		version = REMOTE_PLUGIN_PROTOCOL_VERSION;
+		clientVersion = 0;
+		eventsWritten = eventsRead = 0;
+	}
+
+	// master side - whether client uses the same version as we do
+	bool isAccepted() const
+	{
+		return clientVersion == REMOTE_PLUGIN_PROTOCOL_VERSION;
+	}
+
+	// master side - returns false if ring is full
+	bool pushEvent( const RemoteEvent & _e )
+	{
+		const int32_t w = eventsWritten;
+		if( (uint32_t) w - (uint32_t) eventsRead >=
+					(uint32_t) REMOTE_EVENT_RING_SIZE )
+		{
+			return false;
+		}
+		events[w & ( REMOTE_EVENT_RING_SIZE - 1 )] = _e;
+		// full barrier - event is visible before the count
+		__sync_fetch_and_add( &eventsWritten, 1 );
+		return true;
+	}
+
+	// client side - returns false if ring is empty
+	bool popEvent( RemoteEvent & _e )
+	{
+		const int32_t r = eventsRead;
+		if( r == eventsWritten )
+		{
+			return false;
+		}
+		__sync_synchronize();
+		_e = events[r & ( REMOTE_EVENT_RING_SIZE - 1 )];
+		__sync_fetch_and_add( &eventsRead, 1 );
+		return true;
+	}
+
+} ;
+
+// keep audio buffers following the header aligned
+const int REMOTE_SHM_HEADER_SIZE = ( sizeof( RemoteShmHeader ) + 63 ) & ~63;
+
+
+
 class EXPORT RemotePluginBase
 {
 public:
@@ -711,10 +1003,24 @@ public:
 
 	virtual bool processMessage( const message & _m );
 
+	// in pipelined mode returns output of the previous period while
+	// remote process computes the current one concurrently
 	bool process( const sampleFrame * _in_buf, sampleFrame * _out_buf );
 
+	inline bool isPipelined() const
+	{
+		return m_pipelined;
+	}
+
+	// frames output of process() lags behind its input
+	f_cnt_t latency() const;
+
 	void processMidiEvent( const MidiEvent&, const f_cnt_t _offset );
 
+	// queues parameter change for the next period - returns false if the
+	// remote process doesn't support this and a message has to be sent
+	bool processParameterChange( int _index, float _value );
+
 	void updateSampleRate( sample_rate_t _sr )
 	{
 		lock();
@@ -768,6 +1074,29 @@ protected:
 private:
 	void resizeSharedProcessingMemory();
 
+	// inputs followed by outputs of given slot
+	float * slotBuffer( int _slot ) const;
+	void writeInputs( const sampleFrame * _in_buf, float * _buf );
+	void readOutputs( const float * _buf, sampleFrame * _out_buf );
+
+	// queues event in shared memory, false if that's not possible and a
+	// message has to be sent instead - if the ring is full, the remote
+	// process is told to apply the queued events first, so that message
+	// doesn't overtake them
+	bool pushEvent( const RemoteEvent & _e )
+	{
+		if( m_shmHeader == NULL || !m_shmHeader->isAccepted() )
+		{
+			return false;
+		}
+		if( !m_shmHeader->pushEvent( _e ) )
+		{
+			sendMessage( IdProcessEvents );
+			return false;
+		}
+		return true;
+	}
+
 
 	bool m_failed;
 
@@ -782,7 +1111,15 @@ private:
 	int m_shmID;
 #endif
 	size_t m_shmSize;
-	float * m_shm;
+	RemoteShmHeader * m_shmHeader;
+	float * m_shm;	// audio buffers following m_shmHeader
+
+	// time since last process() call
+	MicroTimer m_processTimer;
+
+	bool m_pipelined;
+	int m_periodsSubmitted;
+	volatile int m_periodsDone;	// counted by processMessage()
 
 	int m_inputCount;
 	int m_outputCount;
@@ -812,6 +1149,15 @@ public:
 	{
 	}
 
+	virtual void processParameterChange( int /* _index */, float /* _value */ )
+	{
+	}
+
+	// dispatch events queued by master to processMidiEvent() and
+	// processParameterChange() - only to be called by the thread
+	// processing audio
+	void processEvents();
+
 	inline float * sharedMemory()
 	{
 		return m_shm;
@@ -865,14 +1211,15 @@ public:
 
 private:
 	void setShmKey( key_t _key, int _size );
-	void doProcessing();
+	void doProcessing( int _slot );
 
 #ifdef USE_QT_SHMEM
 	QSharedMemory m_shmObj;
 	QSharedMemory m_shmQtID;
 #endif
 	VstSyncData * m_vstSyncData;
-	float * m_shm;
+	RemoteShmHeader * m_shmHeader;
+	float * m_shm;	// audio buffers following m_shmHeader
 
 	int m_inputCount;
 	int m_outputCount;
@@ -1002,6 +1349,7 @@ RemotePluginClient::RemotePluginClient( key_t _shm_in, key_t _shm_out ) :
 	m_shmQtID( "/usr/bin/lmms" ),
 #endif
 	m_vstSyncData( NULL ),
+	m_shmHeader( NULL ),
 	m_shm( NULL ),
 	m_inputCount( 0 ),
 	m_outputCount( 0 ),
@@ -1068,7 +1416,7 @@ RemotePluginClient::~RemotePluginClient()
 	sendMessage( IdQuit );
 
 #ifndef USE_QT_SHMEM
-	shmdt( m_shm );
+	shmdt( m_shmHeader );
 #endif
 }
 
@@ -1116,11 +1464,15 @@ bool RemotePluginClient::processMessage( const message & _m )
 			break;
 
 		case IdStartProcessing:
-			doProcessing();
+			doProcessing( _m.getInt( 0 ) );
 			reply_message.id = IdProcessingDone;
 			reply = true;
 			break;
 
+		case IdProcessEvents:
+			processEvents();
+			break;
+
 		case IdChangeSharedMemoryKey:
 			setShmKey( _m.getInt( 0 ), _m.getInt( 1 ) );
 			break;
@@ -1149,11 +1501,12 @@ bool RemotePluginClient::processMessage( const message & _m )
 
 void RemotePluginClient::setShmKey( key_t _key, int _size )
 {
+	void * shm = NULL;
 #ifdef USE_QT_SHMEM
 	m_shmObj.setKey( QString::number( _key ) );
 	if( m_shmObj.attach() || m_shmObj.error() == QSharedMemory::NoError )
 	{
-		m_shm = (float *) m_shmObj.data();
+		shm = m_shmObj.data();
 	}
 	else
 	{
@@ -1162,9 +1515,10 @@ void RemotePluginClient::setShmKey( key_t _key, int _size )
 		debugMessage( buf );
 	}
 #else
-	if( m_shm != NULL )
+	if( m_shmHeader != NULL )
 	{
-		shmdt( m_shm );
+		shmdt( m_shmHeader );
+		m_shmHeader = NULL;
 		m_shm = NULL;
 	}
 
@@ -1181,20 +1535,80 @@ void RemotePluginClient::setShmKey( key_t _key, int _size )
 	}
 	else
 	{
-		m_shm = (float *) shmat( shm_id, 0, 0 );
+		shm = shmat( shm_id, 0, 0 );
+	}
+#endif
+	if( shm == NULL )
+	{
+		return;
 	}
+
+	RemoteShmHeader * header = (RemoteShmHeader *) shm;
+	if( header->magic != REMOTE_SHM_MAGIC ||
+			header->version != REMOTE_PLUGIN_PROTOCOL_VERSION )
+	{
+		char buf[96];
+		sprintf( buf, "shared memory has protocol version %d, "
+					"expected %d\n", (int) header->version,
+					(int) REMOTE_PLUGIN_PROTOCOL_VERSION );
+		debugMessage( buf );
+#ifndef USE_QT_SHMEM
+		shmdt( shm );
 #endif
+		return;
+	}
+
+	m_shmHeader = header;
+	m_shm = (float *)( (char *) shm + REMOTE_SHM_HEADER_SIZE );
+	// let master know it can queue events for us now
+	__sync_synchronize();
+	m_shmHeader->clientVersion = REMOTE_PLUGIN_PROTOCOL_VERSION;
 }
 
 
 
 
-void RemotePluginClient::doProcessing()
+void RemotePluginClient::processEvents()
 {
-	if( m_shm != NULL )
+	RemoteEvent e;
+	while( m_shmHeader != NULL && m_shmHeader->popEvent( e ) )
+	{
+		switch( e.type )
+		{
+			case RemoteEventMidi:
+				processMidiEvent(
+					MidiEvent( static_cast<MidiEventTypes>(
+								e.data[0] ),
+							e.data[1],
+							e.data[2],
+							e.data[3] ),
+								e.offset );
+				break;
+
+			case RemoteEventParameter:
+				processParameterChange( e.data[0], e.value );
+				break;
+
+			default:
+				break;
+		}
+	}
+}
+
+
+
+
+void RemotePluginClient::doProcessing( int _slot )
+{
+	// events of the period to render
+	processEvents();
+
+	if( m_shm != NULL && _slot >= 0 && _slot < REMOTE_AUDIO_SLOTS )
 	{
-		process( (sampleFrame *)( m_inputCount > 0 ? m_shm : NULL ),
-				(sampleFrame *)( m_shm +
+		float * buf = m_shm + _slot *
+			( m_inputCount + m_outputCount ) * m_bufferSize;
+		process( (sampleFrame *)( m_inputCount > 0 ? buf : NULL ),
+				(sampleFrame *)( buf +
 					( m_inputCount*m_bufferSize ) ) );
 	}
 	else
@@ -0,0 +1,93 @@
+/*
+ * RenderAheadController.h - adapts number of periods rendered ahead of the
+ *                           audio device to the current render load
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef RENDER_AHEAD_CONTROLLER_H
+#define RENDER_AHEAD_CONTROLLER_H
+
+#include "export.h"
+
+
+/*! Decides how many periods Mixer::fifoWriter renders ahead of the audio
+ * device. update() is called by the fifoWriter after every period with the
+ * time it took to render and the device underruns counted so far. The
+ * depth grows right away when a period came close to its deadline or the
+ * device had to wait, and shrinks again by one period at a time after a
+ * few seconds without any of that. With minDepth == maxDepth the depth is
+ * fixed and only the statistics are collected. */
+class EXPORT RenderAheadController
+{
+public:
+	enum
+	{
+		GrowLoad = 80,		// percentage of deadline
+		ShrinkLoad = 40,
+		ShrinkTime = 3000	// ms below ShrinkLoad before shrinking
+	} ;
+
+	struct Stats
+	{
+		int depth;
+		int minDepth;
+		int maxDepth;
+		int peakDepth;	// highest depth used so far
+		int grows;
+		int shrinks;
+		int underruns;	// device waited for a period
+		int lateRenders;	// periods above GrowLoad
+	} ;
+
+	RenderAheadController( int minDepth, int maxDepth );
+
+	bool isAdaptive() const
+	{
+		return m_stats.minDepth < m_stats.maxDepth;
+	}
+
+	int depth() const
+	{
+		return m_stats.depth;
+	}
+
+	// times in microseconds, returns depth to use from now on
+	int update( int periodTime, int deadline, int underruns );
+
+	// copy of current statistics - might be slightly inconsistent when
+	// called from other threads than the one calling update()
+	Stats stats() const
+	{
+		return m_stats;
+	}
+
+
+private:
+	void setDepth( int depth );
+
+	Stats m_stats;
+	int m_lastUnderruns;
+	int m_holdOff;		// periods to wait before growing again
+	int m_quietTime;	// us spent below ShrinkLoad
+
+} ;
+
+
+#endif
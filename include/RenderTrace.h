@@ -0,0 +1,125 @@
+/*
+ * RenderTrace.h - record a timeline of render threads in Chrome trace format
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef RENDER_TRACE_H
+#define RENDER_TRACE_H
+
+#include <QtCore/QString>
+
+#include "export.h"
+
+const int RENDER_TRACE_MAX_THREADS = 64; // threads which can record events
+const int RENDER_TRACE_THREAD_EVENTS = 1 << 19; // events recorded per thread
+
+
+/*! Opt-in timeline of what the threads taking part in rendering are doing:
+ * processing of ThreadableJobs, waiting for other threads, pushing to and
+ * popping from the mixer's FIFO and audio device callbacks. Every thread
+ * records into its own preallocated buffer without any locking; further
+ * events of a thread are dropped once its buffer is full. dump() writes
+ * all events in Chrome's JSON trace format (chrome://tracing, Perfetto)
+ * when LMMS exits. */
+class EXPORT RenderTrace
+{
+public:
+	enum Categories
+	{
+		CategoryStage,	// stages of Mixer::renderNextBuffer()
+		CategoryJob,
+		CategoryWait,
+		CategoryFifo,
+		CategoryDevice,
+		NumCategories
+	} ;
+	typedef Categories Category;
+
+	static void enable( const QString & outputFile );
+
+	static inline bool isEnabled()
+	{
+		return s_enabled;
+	}
+
+	// name shown for the calling thread, index is appended if not negative
+	static void setThreadName( const char * name, int index = -1 );
+
+	// timestamp to pass to finish() or 0 if tracing is disabled
+	static inline qint64 start()
+	{
+		return s_enabled ? now() : 0;
+	}
+
+	// records a span of given category from start until now - name has
+	// to be a static string, id is shown for telling apart objects
+	static inline void finish( Category category, const char * name,
+					qint64 start, const void * id = NULL )
+	{
+		if( start )
+		{
+			record( category, name, start, id );
+		}
+	}
+
+	// monotonic time in nanoseconds
+	static qint64 now();
+
+	static void record( Category category, const char * name,
+					qint64 start, const void * id );
+
+	static void dump();
+
+private:
+	static bool s_enabled;
+	static QString s_outputFile;
+
+} ;
+
+
+// records a span from construction until destruction
+class RenderTraceScope
+{
+public:
+	RenderTraceScope( RenderTrace::Category category, const char * name,
+						const void * id = NULL ) :
+		m_category( category ),
+		m_name( name ),
+		m_id( id ),
+		m_start( RenderTrace::start() )
+	{
+	}
+
+	~RenderTraceScope()
+	{
+		RenderTrace::finish( m_category, m_name, m_start, m_id );
+	}
+
+
+private:
+	RenderTrace::Category m_category;
+	const char * m_name;
+	const void * m_id;
+	qint64 m_start;
+
+} ;
+
+
+#endif
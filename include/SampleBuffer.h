@@ -42,6 +42,8 @@
 
 
 class QPainter;
+class CachedSample;
+class SampleStream;
 
 // values for buffer margins, used for various libsamplerate interpolation modes
 // the array positions correspond to the converter_type parameter values in libsamplerate
@@ -217,11 +219,24 @@ public:
 		m_varLock.unlock();
 	}
 
+	// not available for streamed samples (see setStreamingAllowed())
 	inline const sampleFrame * data() const
 	{
 		return m_data;
 	}
 
+	// allow playing large files from disk instead of loading them into
+	// memory - only possible if data() isn't used directly
+	void setStreamingAllowed( bool _allowed )
+	{
+		m_streamingAllowed = _allowed;
+	}
+
+	bool isStreamed() const
+	{
+		return m_stream != NULL;
+	}
+
     QString openAudioFile() const;
     QString openAndSetAudioFile();
 	QString openAndSetWaveformFile();
@@ -271,6 +286,8 @@ public slots:
 
 private:
 	void update( bool _keep_settings = false );
+	bool loadStream( const QString & _file, bool _keep_settings );
+	void freeData();
 
     void convertIntToFloat ( int_sample_t * & _ibuf, f_cnt_t _frames, int _channels);
     void directFloatWrite ( sample_t * & _fbuf, f_cnt_t _frames, int _channels);
@@ -301,10 +318,16 @@ private:
 	bool m_reversed;
 	float m_frequency;
 	sample_rate_t m_sampleRate;
+	SampleStream * m_stream;
+	bool m_streamingAllowed;
+	// if set, m_data belongs to this shared cache entry
+	CachedSample * m_cachedSample;
+
+	void fetchFrames( sampleFrame * _dst, f_cnt_t _index, f_cnt_t _frames ) const;
+	void fetchFramesBackwards( sampleFrame * _dst, f_cnt_t _index, f_cnt_t _frames ) const;
 
 	sampleFrame * getSampleFragment( f_cnt_t _index, f_cnt_t _frames,
 						LoopMode _loopmode,
-						sampleFrame * * _tmp,
 						bool * _backwards, f_cnt_t _loopstart, f_cnt_t _loopend,
 						f_cnt_t _end ) const;
 	f_cnt_t getLoopedIndex( f_cnt_t _index, f_cnt_t _startf, f_cnt_t _endf  ) const;
@@ -0,0 +1,108 @@
+/*
+ * SampleCache.h - process-wide cache of decoded samples
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef SAMPLE_CACHE_H
+#define SAMPLE_CACHE_H
+
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+
+#include "lmms_basics.h"
+#include "shared_object.h"
+
+
+/*! Decoded and resampled data of a sample file, shared by all SampleBuffers
+ * which loaded the same file at the same sample rate. The data must not
+ * be modified. */
+class CachedSample : public sharedObject
+{
+public:
+	const sampleFrame * data() const
+	{
+		return m_data;
+	}
+
+	f_cnt_t frames() const
+	{
+		return m_frames;
+	}
+
+private:
+	CachedSample( const QString & key, sampleFrame * data, f_cnt_t frames );
+	virtual ~CachedSample();
+
+	QString m_key;
+	sampleFrame * m_data;
+	f_cnt_t m_frames;
+
+	friend class SampleCache;
+	friend class sharedObject;
+
+} ;
+
+
+
+
+/*! Looks up decoded samples by file path, modification time, target
+ * sample rate and direction, so loading the same file again doesn't
+ * decode and resample it again. Entries are dropped as soon as the last
+ * SampleBuffer using them releases them. If mixer/samplediskcache is set,
+ * resampled data is also stored below ConfigManager::sampleCacheDir()
+ * and picked up from there on later runs. */
+class SampleCache
+{
+public:
+	// returns referenced entry or NULL if file needs to be decoded
+	static CachedSample * acquire( const QString & file,
+					sample_rate_t sampleRate, bool reversed );
+
+	// takes ownership of data (allocated with MM_ALLOC) and returns
+	// referenced entry - resampled data is written to disk cache if
+	// enabled
+	static CachedSample * insert( const QString & file,
+					sample_rate_t sampleRate, bool reversed,
+					sampleFrame * data, f_cnt_t frames,
+					bool resampled );
+
+	static void release( CachedSample * sample );
+
+	static int size();
+
+
+private:
+	static QString key( const QString & file, sample_rate_t sampleRate,
+								bool reversed );
+	static QString diskCacheFile( const QString & key );
+	static bool diskCacheEnabled();
+	static CachedSample * loadFromDisk( const QString & key );
+	static void saveToDisk( const CachedSample * sample );
+
+	static QHash<QString, CachedSample *> s_samples;
+	static QMutex s_mutex;
+
+	friend class CachedSample;
+
+} ;
+
+
+#endif
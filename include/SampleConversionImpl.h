@@ -0,0 +1,336 @@
+/*
+ * SampleConversionImpl.h - sample conversions written against a vector type
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef SAMPLE_CONVERSION_IMPL_H
+#define SAMPLE_CONVERSION_IMPL_H
+
+#include <math.h>
+
+#include "SampleConverter.h"
+
+
+/*
+ * Only to be included by SampleConverter.cpp and the SampleConversion*.cpp
+ * files, which are compiled with flags for their instruction set - see
+ * MixKernelsImpl.h on why everything in here has internal linkage.
+ *
+ * The scalar functions are the reference all vectorized kernels have to
+ * match bit by bit: the same single precision operations in the same
+ * order, rounding to nearest like cvtps2dq does, and min/max written so
+ * NaNs end up like with minps/maxps (as the lower bound).
+ *
+ * V has to provide a float vector type Vec and an int32 vector type IVec,
+ * both with V::Width lanes (a divisor of SAMPLE_CONVERSION_RNG_LANES), and
+ * following operations:
+ *
+ *	load/store		unaligned load/store of Width floats
+ *	loadInt/storeInt	unaligned load/store of an IVec
+ *	set1( x )		all lanes x
+ *	add/sub/mul		lane-wise arithmetic
+ *	maxOf( a, b )		lane-wise a > b ? a : b
+ *	minOf( a, b )		lane-wise a < b ? a : b
+ *	round( a )		to int32, nearest
+ *	toFloat( a )		int32 to float
+ *	xorshift( a )		one xorshift32 step of each lane
+ *	shiftRight8( a )	logical shift of each lane
+ *	storeS16( p, a )	stores lanes as Width int16
+ *	swap16/swap32( a )	byte order of 16/32 bit elements swapped
+ */
+
+namespace
+{
+
+
+inline uint32_t conversionRandom( uint32_t & x )
+{
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return x;
+}
+
+
+// difference of two uniform random numbers in 0..1, so -1..1 with
+// triangular distribution
+inline float conversionDither( uint32_t & x )
+{
+	const float a = (float)( conversionRandom( x ) >> 8 ) *
+						( 1.0f / 16777216.0f );
+	const float b = (float)( conversionRandom( x ) >> 8 ) *
+						( 1.0f / 16777216.0f );
+	return a - b;
+}
+
+
+inline float conversionClip( float s, float gain )
+{
+	float v = s * gain;
+	v = v > -1.0f ? v : -1.0f;
+	return v < 1.0f ? v : 1.0f;
+}
+
+
+inline int32_t conversionQuantize( float v, float low, float high )
+{
+	v = v > low ? v : low;
+	v = v < high ? v : high;
+	return (int32_t) lrintf( v );
+}
+
+
+inline int32_t conversionSample( float s, float gain, float scale,
+					float low, float high, uint32_t * rng )
+{
+	float v = conversionClip( s, gain ) * scale;
+	if( rng )
+	{
+		v = v + conversionDither( *rng );
+	}
+	return conversionQuantize( v, low, high );
+}
+
+
+inline uint16_t conversionSwap16( uint16_t x )
+{
+	return ( ( x & 0x00ff ) << 8 ) | ( ( x & 0xff00 ) >> 8 );
+}
+
+
+inline uint32_t conversionSwap32( uint32_t x )
+{
+	return ( ( x & 0xff000000 ) >> 24 ) | ( ( x & 0x00ff0000 ) >> 8 ) |
+		( ( x & 0x0000ff00 ) << 8 ) | ( ( x & 0x000000ff ) << 24 );
+}
+
+
+
+
+template<class V>
+struct SampleConversionImpl
+{
+	typedef typename V::Vec Vec;
+	typedef typename V::IVec IVec;
+
+	static const int Width = V::Width;
+	// vectors per block of samples, one random generator per lane
+	static const int Vectors = SAMPLE_CONVERSION_RNG_LANES / Width;
+	static const int Block = SAMPLE_CONVERSION_RNG_LANES;
+
+
+	static Vec dither( IVec & r )
+	{
+		const Vec unit = V::set1( 1.0f / 16777216.0f );
+		r = V::xorshift( r );
+		const Vec a = V::mul( V::toFloat( V::shiftRight8( r ) ), unit );
+		r = V::xorshift( r );
+		const Vec b = V::mul( V::toFloat( V::shiftRight8( r ) ), unit );
+		return V::sub( a, b );
+	}
+
+
+	template<bool DITHER>
+	static IVec convert( const float * src, Vec gain, Vec scale,
+					Vec low, Vec high, IVec & r )
+	{
+		Vec v = V::mul( V::load( src ), gain );
+		v = V::maxOf( v, V::set1( -1.0f ) );
+		v = V::minOf( v, V::set1( 1.0f ) );
+		v = V::mul( v, scale );
+		if( DITHER )
+		{
+			v = V::add( v, dither( r ) );
+		}
+		v = V::maxOf( v, low );
+		v = V::minOf( v, high );
+		return V::round( v );
+	}
+
+
+	template<bool DITHER, typename T>
+	static int convertBlocks( const float * src, int samples, float gain,
+					float scale, float low, float high,
+					uint32_t * rng, T * dst )
+	{
+		const Vec g = V::set1( gain );
+		const Vec s = V::set1( scale );
+		const Vec l = V::set1( low );
+		const Vec h = V::set1( high );
+
+		IVec r[Vectors];
+		if( DITHER )
+		{
+			for( int j = 0; j < Vectors; ++j )
+			{
+				r[j] = V::loadInt( rng + j * Width );
+			}
+		}
+
+		const int blocks = samples - samples % Block;
+		for( int i = 0; i < blocks; i += Block )
+		{
+			for( int j = 0; j < Vectors; ++j )
+			{
+				store( dst + i + j * Width, convert<DITHER>(
+					src + i + j * Width, g, s, l, h, r[j] ) );
+			}
+		}
+
+		if( DITHER )
+		{
+			for( int j = 0; j < Vectors; ++j )
+			{
+				V::storeInt( rng + j * Width, r[j] );
+			}
+		}
+		return blocks;
+	}
+
+
+	static void store( int16_t * dst, IVec a )
+	{
+		V::storeS16( dst, a );
+	}
+
+	static void store( int32_t * dst, IVec a )
+	{
+		V::storeInt( dst, a );
+	}
+
+
+	static void toS16( const float * src, int samples, float gain,
+					uint32_t * rng, int16_t * dst )
+	{
+		const int done = rng ?
+			convertBlocks<true>( src, samples, gain, 32767.0f,
+					-32768.0f, 32767.0f, rng, dst ) :
+			convertBlocks<false>( src, samples, gain, 32767.0f,
+					-32768.0f, 32767.0f, rng, dst );
+
+		for( int i = done; i < samples; ++i )
+		{
+			dst[i] = conversionSample( src[i], gain, 32767.0f,
+					-32768.0f, 32767.0f, rng ?
+				&rng[i % SAMPLE_CONVERSION_RNG_LANES] : NULL );
+		}
+	}
+
+
+	static void toS32( const float * src, int samples, float gain,
+				float scale, float low, float high,
+					uint32_t * rng, int32_t * dst )
+	{
+		const int done = rng ?
+			convertBlocks<true>( src, samples, gain, scale,
+						low, high, rng, dst ) :
+			convertBlocks<false>( src, samples, gain, scale,
+						low, high, rng, dst );
+
+		for( int i = done; i < samples; ++i )
+		{
+			dst[i] = conversionSample( src[i], gain, scale, low, high,
+				rng ? &rng[i % SAMPLE_CONVERSION_RNG_LANES] : NULL );
+		}
+	}
+
+
+	static void toFloat( const float * src, int samples, float gain,
+						bool clip, float * dst )
+	{
+		const Vec g = V::set1( gain );
+		const Vec lo = V::set1( -1.0f );
+		const Vec hi = V::set1( 1.0f );
+
+		int i = 0;
+		if( clip )
+		{
+			for( ; i + Width <= samples; i += Width )
+			{
+				Vec v = V::mul( V::load( src + i ), g );
+				v = V::maxOf( v, lo );
+				V::store( dst + i, V::minOf( v, hi ) );
+			}
+		}
+		else
+		{
+			for( ; i + Width <= samples; i += Width )
+			{
+				V::store( dst + i, V::mul( V::load( src + i ), g ) );
+			}
+		}
+
+		for( ; i < samples; ++i )
+		{
+			dst[i] = clip ? conversionClip( src[i], gain ) :
+							src[i] * gain;
+		}
+	}
+
+
+	static void swap16( int16_t * buf, int samples )
+	{
+		const int perVector = sizeof( IVec ) / sizeof( int16_t );
+		int i = 0;
+		for( ; i + perVector <= samples; i += perVector )
+		{
+			V::storeInt( buf + i, V::swap16( V::loadInt( buf + i ) ) );
+		}
+		for( ; i < samples; ++i )
+		{
+			buf[i] = conversionSwap16( buf[i] );
+		}
+	}
+
+
+	static void swap32( int32_t * buf, int samples )
+	{
+		int i = 0;
+		for( ; i + Width <= samples; i += Width )
+		{
+			V::storeInt( buf + i, V::swap32( V::loadInt( buf + i ) ) );
+		}
+		for( ; i < samples; ++i )
+		{
+			buf[i] = conversionSwap32( buf[i] );
+		}
+	}
+
+} ;
+
+
+}
+
+
+// initializer for a SampleConversionKernels table - a constant expression,
+// so no code compiled for the instruction set runs before we know it's
+// supported
+#define SAMPLE_CONVERSION_KERNELS_TABLE( name, Impl )		\
+	{							\
+		name,						\
+		&Impl::toS16,					\
+		&Impl::toS32,					\
+		&Impl::toFloat,					\
+		&Impl::swap16,					\
+		&Impl::swap32					\
+	}
+
+
+#endif
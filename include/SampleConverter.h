@@ -0,0 +1,167 @@
+/*
+ * SampleConverter.h - convert mixer output to the sample formats of audio
+ *                     devices and files
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef SAMPLE_CONVERTER_H
+#define SAMPLE_CONVERTER_H
+
+#include "export.h"
+#include "lmms_basics.h"
+
+
+// number of independent random generators TPDF dither is drawn from -
+// sample i of a conversion uses generator i % SAMPLE_CONVERSION_RNG_LANES
+const int SAMPLE_CONVERSION_RNG_LANES = 8;
+
+
+/*! Table of sample conversions for one instruction set, working on plain
+ * arrays of interleaved samples. All kernels return exactly the same
+ * results as the scalar reference, including the dither noise. */
+struct SampleConversionKernels
+{
+	const char * name;
+
+	// each sample is multiplied by gain, clipped to -1..1 and multiplied
+	// by scale, then TPDF dither of +-1 is added if rng isn't NULL - the
+	// result is clamped to low..high and rounded to nearest
+	void (*toS16)( const float * src, int samples, float gain, uint32_t * rng, int16_t * dst );
+	void (*toS32)( const float * src, int samples, float gain, float scale, float low, float high, uint32_t * rng, int32_t * dst );
+	// multiplied by gain and optionally clipped to -1..1
+	void (*toFloat)( const float * src, int samples, float gain, bool clip, float * dst );
+
+	void (*swap16)( int16_t * buf, int samples );
+	void (*swap32)( int32_t * buf, int samples );
+
+} ;
+
+
+/*! Converts mixer output to interleaved samples for audio devices and
+ * files. Holds the dither state, so every output stream needs its own
+ * converter.
+ *
+ * Integer samples are rounded to nearest, also without dither. The former
+ * AudioDevice::convertToS16() truncated towards zero, which biased quiet
+ * signals towards 0 and doubled the quantization error - undithered 16 bit
+ * output therefore differs from older versions by at most 1 LSB. */
+class EXPORT SampleConverter
+{
+public:
+	enum Formats
+	{
+		Format_S16,
+		Format_S24,		// in lower 3 bytes of 32 bit samples
+		Format_S32,
+		Format_Float,		// clipped to -1..1
+		Format_FloatUnclipped,	// e.g. for exporting with headroom
+		NumFormats
+	} ;
+	typedef Formats Format;
+
+	enum DitherModes
+	{
+		Dither_None,
+		Dither_TPDF,
+		Dither_NoiseShaped,	// TPDF with 2nd order error feedback
+		NumDitherModes
+	} ;
+	typedef DitherModes DitherMode;
+
+	SampleConverter( Format _format = Format_S16,
+					DitherMode _dither = Dither_None );
+
+	Format format() const
+	{
+		return m_format;
+	}
+
+	void setFormat( Format _format )
+	{
+		m_format = _format;
+	}
+
+	// only applied to Format_S16 and Format_S24, 32 bit samples are too
+	// fine-grained for dither to matter
+	DitherMode dither() const
+	{
+		return m_dither;
+	}
+
+	void setDither( DitherMode _dither );
+
+	static int bytesPerSample( Format _format );
+
+	// converts first _channels channels of _src multiplied by _gain,
+	// swapping byte order of samples if _swap_endian is set - returns
+	// number of bytes written to _dst
+	int convert( const surroundSampleFrame * _src, const fpp_t _frames,
+				const ch_cnt_t _channels, const float _gain,
+				void * _dst, const bool _swap_endian = false );
+
+	// restarts dither noise and forgets noise shaping history
+	void reset();
+
+
+private:
+	void convertSamples( const float * _src, int _samples, float _gain,
+								void * _dst );
+	void convertNoiseShaped( const surroundSampleFrame * _src,
+				const fpp_t _frames, const ch_cnt_t _channels,
+					const float _gain, void * _dst );
+
+	Format m_format;
+	DitherMode m_dither;
+
+	uint32_t m_rng[SAMPLE_CONVERSION_RNG_LANES];
+	// last two quantization errors of each channel
+	float m_error[SURROUND_CHANNELS][2];
+
+} ;
+
+
+namespace SampleConversion
+{
+
+/*! \brief Select the fastest kernels supported by the CPU - until called,
+ * the scalar reference implementation is used */
+void init();
+
+/*! \brief Name of the instruction set currently used */
+const char * instructionSet();
+
+// kernel tables compiled into this build - functions return NULL if the
+// instruction set isn't supported by the target architecture
+const SampleConversionKernels * scalarKernels();
+const SampleConversionKernels * sse2Kernels();
+const SampleConversionKernels * avx2Kernels();
+
+/*! \brief Kernel tables usable on this CPU, scalar reference first and
+ * the one selected by init() last */
+int numKernels();
+const SampleConversionKernels * kernels( int index );
+
+const SampleConversionKernels * currentKernels();
+
+void setCurrentKernels( const SampleConversionKernels * kernels );
+
+}
+
+#endif
@@ -0,0 +1,167 @@
+/*
+ * SampleStream.h - disk streaming of large samples
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef SAMPLE_STREAM_H
+#define SAMPLE_STREAM_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QSemaphore>
+#include <QtCore/QString>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
+
+#include <samplerate.h>
+
+#include "lmms_basics.h"
+
+class SampleDecoder;
+
+const f_cnt_t STREAM_BLOCK_FRAMES = 16384; // frames decoded at a time
+const int STREAM_BLOCKS = 32; // blocks kept around the current play position
+const f_cnt_t STREAM_HEAD_FRAMES = 4 * STREAM_BLOCK_FRAMES; // preloaded when opening
+const f_cnt_t STREAM_OVERVIEW_FRAMES = 1024; // frames per peak in waveform overview
+
+
+/*! Plays a sample file from disk instead of decoding it into memory at
+ * once. The frames where playback starts are decoded right away, the
+ * rest is decoded by a background thread into a ring of blocks ahead of
+ * the position last read. Frames are delivered at the given target rate,
+ * so a stream can stand in for the decoded and resampled data of a
+ * SampleBuffer. Meant for linear playback - readers jumping around will
+ * hear silence until the blocks they need are decoded. */
+class SampleStream
+{
+public:
+	SampleStream( const QString & file, sample_rate_t targetRate, bool reversed );
+	~SampleStream();
+
+	bool isValid() const
+	{
+		return m_frames > 0;
+	}
+
+	f_cnt_t frames() const
+	{
+		return m_frames;
+	}
+
+	// copy frames starting at given index to dst - meant to be called from
+	// audio threads; frames not decoded yet are silenced
+	bool read( sampleFrame * dst, f_cnt_t index, f_cnt_t frames );
+
+	// number of reads which had to be silenced (partly)
+	int underruns() const
+	{
+		return m_underruns;
+	}
+
+	// minimum and maximum value of each STREAM_OVERVIEW_FRAMES frames in
+	// playback order, filled in by background thread - returns whether
+	// peak for given index is available yet
+	bool overviewPeak( int index, sampleFrame & min, sampleFrame & max ) const;
+
+	int overviewSize() const
+	{
+		return m_overviewMin.size() / DEFAULT_CHANNELS;
+	}
+
+
+private:
+	struct Block
+	{
+		QAtomicInt start; // first frame (file order) or -1 if invalid
+		sampleFrame frames[STREAM_BLOCK_FRAMES];
+	} ;
+
+	struct DecodeState
+	{
+		SampleDecoder * decoder;
+		SRC_STATE * resampler;
+		f_cnt_t nextFrame; // frame (file order) decoded next if not seeking
+		sampleFrame * input;
+		long inputFrames;
+		long inputOffset;
+	} ;
+
+	// called by SampleStreamThread, returns whether there was work to do
+	bool fill();
+
+	bool openState( DecodeState & state, const QString & file );
+	void closeState( DecodeState & state );
+	void decode( DecodeState & state, sampleFrame * dst, f_cnt_t start, f_cnt_t frames );
+
+	bool wanted( f_cnt_t blockStart, f_cnt_t position ) const;
+	const sampleFrame * lookup( f_cnt_t blockStart, Block * * block, int * stamp ) const;
+
+	f_cnt_t m_frames;
+	double m_ratio; // target rate / file rate
+	bool m_reversed;
+
+	sampleFrame * m_head;
+	f_cnt_t m_headFrames;
+	f_cnt_t m_headStart; // first frame of head (file order)
+
+	Block * m_blocks;
+	QAtomicInt m_position; // frame (file order) last read
+	QAtomicInt m_underruns;
+
+	DecodeState m_stream;
+	DecodeState m_scan;
+
+	QVector<sample_t> m_overviewMin; // one value per channel and peak
+	QVector<sample_t> m_overviewMax;
+	QAtomicInt m_overviewDone; // number of peaks calculated (file order)
+
+	friend class SampleStreamThread;
+
+} ;
+
+
+
+// background thread decoding blocks for all streams
+class SampleStreamThread : public QThread
+{
+public:
+	static void addStream( SampleStream * stream );
+	static void removeStream( SampleStream * stream );
+	static void wakeUp();
+
+private:
+	SampleStreamThread();
+	virtual ~SampleStreamThread();
+
+	virtual void run();
+
+	QList<SampleStream *> m_streams;
+	QMutex m_streamsMutex;
+	QSemaphore m_wakeUp;
+	volatile bool m_quit;
+
+	static SampleStreamThread * s_instance;
+	static QMutex s_instanceMutex;
+
+} ;
+
+
+#endif
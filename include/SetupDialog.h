@@ -93,6 +93,10 @@ private slots:
 	void toggleMMPZ( bool _enabled );
 	void toggleDisableBackup( bool _enabled );
 	void toggleHQAudioDev( bool _enabled );
+	void toggleAdaptiveBufferSize( bool _enabled );
+	void toggleSampleExactAutomation( bool _enabled );
+	void togglePipelinedRemotePlugins( bool _enabled );
+	void toggleDither( bool _enabled );
 
 	void openWorkingDir();
 	void openVSTDir();
@@ -129,6 +133,10 @@ private:
 	bool m_MMPZ;
 	bool m_disableBackup;
 	bool m_hqAudioDev;
+	bool m_adaptiveBufferSize;
+	bool m_sampleExactAutomation;
+	bool m_pipelinedRemotePlugins;
+	int m_dither;
 	QString m_lang;
 	QStringList m_languages;
 
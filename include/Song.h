@@ -321,6 +321,11 @@ private:
 	
 	void setPlayPos( tick_t _ticks, PlayModes _play_mode );
 
+	// write sample-exact automation for a part of the current period
+	void processAutomationBuffers( const TrackList & _tracks, int _tco_num,
+					float _current_frame, f_cnt_t _frames,
+					f_cnt_t _frame_base );
+
 	void saveControllerStates( QDomDocument & _doc, QDomElement & _this );
 	void restoreControllerStates( const QDomElement & _this );
 
@@ -365,6 +370,9 @@ private:
 
 	VstSyncController m_vstSyncController;
 
+	// render automation into ValueBuffers of automated models
+	bool m_sampleExactAutomation;
+
 
 	friend class Engine;
 	friend class SongEditor;
@@ -28,6 +28,7 @@
 #include <QtCore/QAtomicInt>
 
 #include "lmms_basics.h"
+#include "RenderTrace.h"
 
 
 class ThreadableJob
@@ -71,13 +72,22 @@ public:
 	{
 		if( m_state.testAndSetOrdered( Queued, InProgress ) )
 		{
+			const qint64 traceStart = RenderTrace::start();
 			doProcessing();
+			RenderTrace::finish( RenderTrace::CategoryJob, jobName(),
+							traceStart, this );
 			m_state = Done;
 		}
 	}
 
 	virtual bool requiresProcessing() const = 0;
 
+	// static string shown for this job in render traces
+	virtual const char * jobName() const
+	{
+		return "ThreadableJob";
+	}
+
 
 protected:
 	virtual void doProcessing() = 0;
@@ -28,6 +28,7 @@
 
 #include <QtCore/QVector>
 #include <QtCore/QList>
+#include <QtCore/QAtomicInt>
 #include <QWidget>
 #include <QSignalMapper>
 #include <QColor>
@@ -533,6 +534,13 @@ public:
 		return m_processingLock.tryLock();
 	}
 
+	// set while ~Track() deletes our TCOs - members of derived classes
+	// are gone then
+	bool isBeingDestroyed() const
+	{
+		return m_beingDestroyed;
+	}
+
 public slots:
 	virtual void setName( const QString & _new_name )
 	{
@@ -543,7 +551,28 @@ public slots:
 	void toggleSolo();
 
 
+private slots:
+	void invalidateTCOIndex();
+
+
 private:
+	// entry of m_tcoIndex - positions are cached so a consistent index
+	// is searched even if TCOs are moved meanwhile
+	struct TCOIndexEntry
+	{
+		tick_t start;
+		tick_t end;
+		tick_t maxEnd; // max. end of all entries up to this one
+		TrackContentObject * tco;
+
+		bool operator<( const TCOIndexEntry & other ) const
+		{
+			return start < other.start;
+		}
+	} ;
+
+	void updateTCOIndex();
+
 	TrackContainer* m_trackContainer;
 	TrackTypes m_type;
 	QString m_name;
@@ -559,7 +588,16 @@ private:
 
 	tcoVector m_trackContentObjects;
 
+	// m_trackContentObjects sorted by start position for range queries,
+	// built again in getTCOsInRange() after TCOs were added, removed,
+	// moved or resized
+	QVector<TCOIndexEntry> m_tcoIndex;
+	QAtomicInt m_tcoIndexValid;
+
+	// recursive, as TCOs lock their track when being deleted, which might
+	// happen with the track locked already (e.g. in ~Track())
 	QMutex m_processingLock;
+	bool m_beingDestroyed;
 
 	friend class TrackView;
 
@@ -0,0 +1,65 @@
+/*
+ * ValueBufferArena.h - per-period storage for sample-exact model values
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef VALUE_BUFFER_ARENA_H
+#define VALUE_BUFFER_ARENA_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QAtomicPointer>
+
+#include "export.h"
+
+const int VBA_BLOCK_FLOATS = 65536; // floats per block
+const int VBA_MAX_BLOCKS = 256;
+const int VBA_ALIGN_FLOATS = 4; // keep buffers aligned for SIMD loads
+
+
+/*! Storage for the ValueBuffers of all AutomatableModels. Instead of every
+ * model owning a period-sized buffer, buffers are handed out from a shared
+ * bump allocator while rendering a period and all of them are given back at
+ * once by reset() at the end of the period. Memory is organized in fixed-size
+ * blocks which are never moved or freed and only added by reset(), so
+ * handing out a buffer is a single compare-and-swap and never allocates. */
+class EXPORT ValueBufferArena
+{
+public:
+	// returns buffer valid until next reset() or NULL if arena is exhausted
+	static float * alloc( int length );
+
+	// release all buffers - called by the mixer before the first and after
+	// each period, makes sure there are enough blocks for the next period
+	static void reset();
+
+	// floats handed out in current period
+	static int used()
+	{
+		return s_used;
+	}
+
+private:
+	static QAtomicPointer<float> s_blocks[VBA_MAX_BLOCKS];
+	static QAtomicInt s_used;
+	static int s_highWaterMark;
+
+} ;
+
+#endif
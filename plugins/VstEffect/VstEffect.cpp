@@ -58,8 +58,12 @@ VstEffect::VstEffect( Model * _parent,
 	m_plugin( NULL ),
 	m_pluginMutex(),
 	m_key( *_key ),
+	m_delayedDry( new sampleFrame[Engine::mixer()->framesPerPeriod()] ),
+	m_delayedDryFrames( Engine::mixer()->framesPerPeriod() ),
 	m_vstControls( this )
 {
+	Engine::mixer()->clearAudioBuffer( m_delayedDry, m_delayedDryFrames );
+
 	if( !m_key.attributes["file"].isEmpty() )
 	{
 		openPlugin( m_key.attributes["file"] );
@@ -74,6 +78,8 @@ VstEffect::VstEffect( Model * _parent,
 VstEffect::~VstEffect()
 {
 	closePlugin();
+
+	delete[] m_delayedDry;
 }
 
 
@@ -97,8 +103,19 @@ bool VstEffect::processAudioBuffer( sampleFrame * _buf, const fpp_t _frames )
 		memcpy( buf, _buf, sizeof( sampleFrame ) * _frames );
 		m_pluginMutex.lock();
 		m_plugin->process( buf, buf );
+		const f_cnt_t latency = m_plugin->latency();
 		m_pluginMutex.unlock();
 
+		if( latency == _frames && _frames == m_delayedDryFrames )
+		{
+			// mix with the dry signal the output belongs to
+			for( fpp_t f = 0; f < _frames; ++f )
+			{
+				qSwap( _buf[f][0], m_delayedDry[f][0] );
+				qSwap( _buf[f][1], m_delayedDry[f][1] );
+			}
+		}
+
 		double out_sum = 0.0;
 		const float w = wetLevel();
 		for( fpp_t f = 0; f < _frames; ++f )
@@ -62,6 +62,11 @@ private:
 	QMutex m_pluginMutex;
 	EffectKey m_key;
 
+	// dry signal of the previous period - a pipelined plugin returns its
+	// output one period late, so the dry signal has to be as well
+	sampleFrame * m_delayedDry;
+	fpp_t m_delayedDryFrames;
+
 	VstEffectControls m_vstControls;
 
 
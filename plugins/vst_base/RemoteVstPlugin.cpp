@@ -134,6 +134,8 @@ public:
 
 	virtual void processMidiEvent( const MidiEvent& event, const f_cnt_t offset );
 
+	virtual void processParameterChange( int _index, float _value );
+
 	// set given sample-rate for plugin
 	virtual void updateSampleRate()
 	{
@@ -865,6 +867,16 @@ void RemoteVstPlugin::processMidiEvent( const MidiEvent& event, const f_cnt_t of
 
 
 
+void RemoteVstPlugin::processParameterChange( int _index, float _value )
+{
+	lock();
+	m_plugin->setParameter( m_plugin, _index, _value );
+	unlock();
+}
+
+
+
+
 const char * RemoteVstPlugin::pluginName()
 {
 	static char buf[32];
@@ -1766,7 +1778,8 @@ DWORD WINAPI RemoteVstPlugin::processingThread( LPVOID _param )
 	RemotePluginClient::message m;
 	while( ( m = _this->receiveMessage() ).id != IdQuit )
         {
-		if( m.id == IdStartProcessing || m.id == IdMidiEvent )
+		if( m.id == IdStartProcessing || m.id == IdMidiEvent ||
+						m.id == IdProcessEvents )
 		{
 			_this->processMessage( m );
 		}
@@ -610,7 +610,10 @@ void VstPlugin::savePreset( )
 void VstPlugin::setParam( int i, float f )
 {
 	lock();
-	sendMessage( message( IdVstSetParameter ).addInt( i ).addFloat( f ) );
+	if( !processParameterChange( i, f ) )
+	{
+		sendMessage( message( IdVstSetParameter ).addInt( i ).addFloat( f ) );
+	}
 	//waitForMessage( IdVstSetParameter );
 	unlock();
 }
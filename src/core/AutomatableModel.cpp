@@ -27,6 +27,7 @@
 #include "AutomationPattern.h"
 #include "ControllerConnection.h"
 #include "lmms_math.h"
+#include "ValueBufferArena.h"
 
 float AutomatableModel::s_copiedValue = 0;
 long AutomatableModel::s_periodCounter = 0;
@@ -51,8 +52,9 @@ AutomatableModel::AutomatableModel( DataType type,
 	m_hasStrictStepSize( false ),
 	m_hasLinkedModels( false ),
 	m_controllerConnection( NULL ),
-	m_valueBuffer( static_cast<int>( Engine::mixer()->framesPerPeriod() ) ),
+	m_valueBuffer(),
 	m_lastUpdatedPeriod( -1 ),
+	m_lastAutomatedPeriod( -1 ),
 	m_hasSampleExactData( false )
 
 {
@@ -75,7 +77,8 @@ AutomatableModel::~AutomatableModel()
 		delete m_controllerConnection;
 	}
 
-	m_valueBuffer.clear();
+	// not owned by us
+	m_valueBuffer.setValues( NULL );
 
 	emit destroyed( id() );
 }
@@ -333,6 +336,50 @@ void AutomatableModel::setAutomatedValue( const float value )
 
 
 
+void AutomatableModel::setAutomatedValues( const float * values, int offset,
+								int frames )
+{
+	QMutexLocker m( &m_valueBufferMutex );
+
+	if( m_lastAutomatedPeriod != s_periodCounter )
+	{
+		// first automation written this period - frames not covered
+		// by automation keep the value we had before
+		if( !allocValueBuffer() )
+		{
+			return;
+		}
+		m_valueBuffer.fill( m_value );
+		m_lastAutomatedPeriod = s_periodCounter;
+	}
+
+	offset = qMax( offset, 0 );
+	frames = qMin( frames, m_valueBuffer.length() - offset );
+
+	float * nvalues = m_valueBuffer.values() + offset;
+	if( m_scaleType == Linear && !( m_step != 0 && m_hasStrictStepSize ) )
+	{
+		// nothing but limiting needed for the common case
+		for( int i = 0; i < frames; ++i )
+		{
+			nvalues[i] = tLimit<float>( values[i], m_minValue, m_maxValue );
+		}
+	}
+	else
+	{
+		for( int i = 0; i < frames; ++i )
+		{
+			nvalues[i] = fittedValue( scaledValue( values[i] ) );
+		}
+	}
+
+	m_lastUpdatedPeriod = s_periodCounter;
+	m_hasSampleExactData = true;
+}
+
+
+
+
 void AutomatableModel::setRange( const float min, const float max,
 							const float step )
 {
@@ -536,7 +583,7 @@ ValueBuffer * AutomatableModel::valueBuffer()
 	if( m_controllerConnection && m_controllerConnection->getController()->isSampleExact() )
 	{
 		vb = m_controllerConnection->valueBuffer();
-		if( vb )
+		if( vb && allocValueBuffer() )
 		{
 			float * values = vb->values();
 			float * nvalues = m_valueBuffer.values();
@@ -572,18 +619,21 @@ ValueBuffer * AutomatableModel::valueBuffer()
 	if( lm && lm->controllerConnection() && lm->controllerConnection()->getController()->isSampleExact() )
 	{
 		vb = lm->valueBuffer();
-		float * values = vb->values();
-		float * nvalues = m_valueBuffer.values();
-		for( int i = 0; i < vb->length(); i++ )
+		if( vb && allocValueBuffer() )
 		{
-			nvalues[i] = fittedValue( values[i], false );
+			float * values = vb->values();
+			float * nvalues = m_valueBuffer.values();
+			for( int i = 0; i < vb->length(); i++ )
+			{
+				nvalues[i] = fittedValue( values[i], false );
+			}
+			m_lastUpdatedPeriod = s_periodCounter;
+			m_hasSampleExactData = true;
+			return &m_valueBuffer;
 		}
-		m_lastUpdatedPeriod = s_periodCounter;
-		m_hasSampleExactData = true;
-		return &m_valueBuffer;
 	}
 
-	if( m_oldValue != val )
+	if( m_oldValue != val && allocValueBuffer() )
 	{
 		m_valueBuffer.interpolate( m_oldValue, val );
 		m_oldValue = val;
@@ -600,6 +650,15 @@ ValueBuffer * AutomatableModel::valueBuffer()
 }
 
 
+bool AutomatableModel::allocValueBuffer()
+{
+	const int frames = Engine::mixer()->framesPerPeriod();
+	m_valueBuffer.setValues( ValueBufferArena::alloc( frames ) );
+	m_valueBuffer.setLength( frames );
+	return m_valueBuffer.values() != NULL;
+}
+
+
 void AutomatableModel::unlinkControllerConnection()
 {
 	if( m_controllerConnection )
@@ -0,0 +1,226 @@
+/*
+ * AutomationCurve.cpp - precompiled form of an automation pattern
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "AutomationCurve.h"
+
+#include <cmath>
+
+#include "AutomationPattern.h"
+
+
+AutomationCurve::AutomationCurve( const AutomationPattern & pattern ) :
+	m_refCount( 1 )
+{
+	build( pattern.getTimeMap(), pattern.getTangents(),
+			pattern.progressionType(), pattern.getTension() );
+}
+
+
+
+
+AutomationCurve::AutomationCurve( const AutomationPattern::timeMap & values,
+			const AutomationPattern::timeMap & tangents,
+			AutomationPattern::ProgressionTypes progression,
+							float tension ) :
+	m_refCount( 1 )
+{
+	build( values, tangents, progression, tension );
+}
+
+
+
+
+void AutomationCurve::build( const AutomationPattern::timeMap & values,
+			const AutomationPattern::timeMap & tangents,
+			AutomationPattern::ProgressionTypes progression,
+							float tension )
+{
+	typedef AutomationPattern::timeMap timeMap;
+
+	m_segments.reserve( values.size() );
+
+	for( timeMap::const_iterator it = values.begin(); it != values.end(); ++it )
+	{
+		Segment s;
+		s.start = it.key();
+		s.invLength = 0;
+		s.c0 = it.value();
+		s.c1 = s.c2 = s.c3 = 0;
+
+		timeMap::const_iterator next = it + 1;
+		if( next != values.end() )
+		{
+			const int length = next.key() - it.key();
+			s.invLength = 1.0f / length;
+
+			const float p0 = it.value();
+			const float p1 = next.value();
+			switch( progression )
+			{
+				case AutomationPattern::LinearProgression:
+					s.c1 = p1 - p0;
+					break;
+
+				case AutomationPattern::CubicHermiteProgression:
+				{
+					// Cubic Hermite spline as explained at
+					// http://en.wikipedia.org/wiki/Cubic_Hermite_spline#Unit_interval_.280.2C_1.29
+					// with tangents scaled to the unit
+					// interval, expanded into powers of t
+					const float m1 = tangents.value( it.key() ) *
+						length * tension;
+					const float m2 = tangents.value( next.key() ) *
+						length * tension;
+					s.c1 = m1;
+					s.c2 = -3 * p0 - 2 * m1 + 3 * p1 - m2;
+					s.c3 = 2 * p0 + m1 - 2 * p1 + m2;
+					break;
+				}
+
+				case AutomationPattern::DiscreteProgression:
+				default:
+					break;
+			}
+		}
+
+		m_segments.push_back( s );
+	}
+}
+
+
+
+
+float AutomationCurve::valueAt( float tick ) const
+{
+	const int s = find( tick, 0 );
+	return s < 0 ? 0 : evaluate( m_segments[s], tick );
+}
+
+
+
+
+float AutomationCurve::valueAt( float tick, int & cursor ) const
+{
+	cursor = seek( tick, cursor );
+	return cursor < 0 ? 0 : evaluate( m_segments[cursor], tick );
+}
+
+
+
+
+void AutomationCurve::fill( float * values, int frames, float tick,
+					float ticksPerFrame, int & cursor ) const
+{
+	const int numSegments = m_segments.size();
+
+	int f = 0;
+	while( f < frames )
+	{
+		const float pos = tick + f * ticksPerFrame;
+		cursor = seek( pos, cursor );
+
+		// frames until next segment starts
+		int end = frames;
+		if( cursor + 1 < numSegments )
+		{
+			const float next = m_segments[cursor + 1].start;
+			const float remaining = ceilf( ( next - pos ) / ticksPerFrame );
+			if( remaining < frames - f )
+			{
+				end = f + qMax( (int) remaining, 1 );
+			}
+			// correct rounding errors of estimation above, so
+			// positions are compared exactly like in seek()
+			while( end - 1 > f && tick + ( end - 1 ) * ticksPerFrame >= next )
+			{
+				--end;
+			}
+			while( end < frames && tick + end * ticksPerFrame < next )
+			{
+				++end;
+			}
+		}
+
+		if( cursor < 0 )
+		{
+			for( ; f < end; ++f )
+			{
+				values[f] = 0;
+			}
+			continue;
+		}
+
+		const Segment & s = m_segments[cursor];
+		for( ; f < end; ++f )
+		{
+			values[f] = evaluate( s, tick + f * ticksPerFrame );
+		}
+	}
+}
+
+
+
+
+int AutomationCurve::find( float tick, int first ) const
+{
+	// last segment starting at or before tick
+	int lo = first;
+	int hi = m_segments.size();
+	while( lo < hi )
+	{
+		const int mid = ( lo + hi ) / 2;
+		if( m_segments[mid].start <= tick )
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	return lo - 1;
+}
+
+
+
+
+int AutomationCurve::seek( float tick, int cursor ) const
+{
+	const int numSegments = m_segments.size();
+	if( cursor < 0 || cursor >= numSegments ||
+					m_segments[cursor].start > tick )
+	{
+		return find( tick, 0 );
+	}
+
+	// while playing we mostly stay in the same segment or move to the
+	// next one
+	if( cursor + 1 >= numSegments || m_segments[cursor + 1].start > tick )
+	{
+		return cursor;
+	}
+	if( cursor + 2 >= numSegments || m_segments[cursor + 2].start > tick )
+	{
+		return cursor + 1;
+	}
+	return find( tick, cursor + 2 );
+}
@@ -26,12 +26,18 @@
 
 #include "AutomationPattern.h"
 
+#include <math.h>
+
+#include "AutomationCurve.h"
 #include "AutomationPatternView.h"
 #include "AutomationTrack.h"
+#include "Engine.h"
+#include "Mixer.h"
 #include "ProjectJournal.h"
 #include "BBTrackContainer.h"
 #include "Song.h"
 #include "TextFloat.h"
+#include "ValueBufferArena.h"
 #include "embed.h"
 
 int AutomationPattern::s_quantization = 1;
@@ -45,10 +51,13 @@ AutomationPattern::AutomationPattern( AutomationTrack * _auto_track ) :
 	m_objects(),
 	m_tension( 1.0 ),
 	m_progressionType( DiscreteProgression ),
+	m_curve( NULL ),
+	m_playCursor( -1 ),
 	m_dragging( false ),
 	m_isRecording( false ),
 	m_lastRecordedValue( 0 )
 {
+	updateCurve();
 	changeLength( MidiTime( 1, 0 ) );
 	if( getTrack() )
 	{
@@ -75,7 +84,9 @@ AutomationPattern::AutomationPattern( const AutomationPattern & _pat_to_copy ) :
 	m_autoTrack( _pat_to_copy.m_autoTrack ),
 	m_objects( _pat_to_copy.m_objects ),
 	m_tension( _pat_to_copy.m_tension ),
-	m_progressionType( _pat_to_copy.m_progressionType )
+	m_progressionType( _pat_to_copy.m_progressionType ),
+	m_curve( NULL ),
+	m_playCursor( -1 )
 {
 	for( timeMap::const_iterator it = _pat_to_copy.m_timeMap.begin();
 				it != _pat_to_copy.m_timeMap.end(); ++it )
@@ -83,6 +94,7 @@ AutomationPattern::AutomationPattern( const AutomationPattern & _pat_to_copy ) :
 		m_timeMap[it.key()] = it.value();
 		m_tangents[it.key()] = _pat_to_copy.m_tangents[it.key()];
 	}
+	updateCurve();
 	switch( getTrack()->trackContainer()->type() )
 	{
 		case TrackContainer::BBContainer:
@@ -102,6 +114,7 @@ AutomationPattern::AutomationPattern( const AutomationPattern & _pat_to_copy ) :
 
 AutomationPattern::~AutomationPattern()
 {
+	AutomationCurve::release( m_curve.fetchAndStoreOrdered( NULL ) );
 }
 
 
@@ -151,6 +164,7 @@ void AutomationPattern::setProgressionType(
 		_new_progression_type == CubicHermiteProgression )
 	{
 		m_progressionType = _new_progression_type;
+		updateCurve();
 		emit dataChanged();
 	}
 }
@@ -166,6 +180,7 @@ void AutomationPattern::setTension( QString _new_tension )
 	if( ok && nt > -0.01 && nt < 1.01 )
 	{
 		m_tension = _new_tension.toFloat();
+		updateCurve();
 	}
 }
 
@@ -215,6 +230,7 @@ MidiTime AutomationPattern::putValue( const MidiTime & _time,
 		--it;
 	}
 	generateTangents(it, 3);
+	updateCurve();
 
 	// we need to maximize our length in case we're part of a hidden
 	// automation track as the user can't resize this pattern
@@ -248,6 +264,7 @@ void AutomationPattern::removeValue( const MidiTime & _time,
 		--it;
 	}
 	generateTangents(it, 3);
+	updateCurve();
 
 	if( getTrack() &&
 		getTrack()->type() == Track::HiddenAutomationTrack )
@@ -311,89 +328,81 @@ void AutomationPattern::applyDragValue()
 
 float AutomationPattern::valueAt( const MidiTime & _time ) const
 {
-	if( m_timeMap.isEmpty() )
-	{
-		return 0;
-	}
+	const AutomationCurve * c = acquireCurve();
+	const float value = c->valueAt( _time.getTicks() );
+	AutomationCurve::release( c );
+	return value;
+}
 
-	if( m_timeMap.contains( _time ) )
-	{
-		return m_timeMap[_time];
-	}
 
-	// lowerBound returns next value with greater key, therefore we take
-	// the previous element to get the current value
-	timeMap::ConstIterator v = m_timeMap.lowerBound( _time );
 
-	if( v == m_timeMap.begin() )
-	{
-		return 0;
-	}
-	if( v == m_timeMap.end() )
+
+float *AutomationPattern::valuesAfter( const MidiTime & _time ) const
+{
+	timeMap::ConstIterator v = m_timeMap.lowerBound( _time );
+	if( v == m_timeMap.end() || (v+1) == m_timeMap.end() )
 	{
-		return (v-1).value();
+		return NULL;
 	}
 
-	return valueAt( v-1, _time - (v-1).key() );
+	int numValues = (v+1).key() - v.key();
+	float *ret = new float[numValues];
+
+	int cursor = -1;
+	const AutomationCurve * c = acquireCurve();
+	c->fill( ret, numValues, v.key(), 1, cursor );
+	AutomationCurve::release( c );
+
+	return ret;
 }
 
 
 
 
-float AutomationPattern::valueAt( timeMap::const_iterator v, int offset ) const
+const AutomationCurve * AutomationPattern::curve() const
 {
-	if( m_progressionType == DiscreteProgression || v == m_timeMap.end() )
-	{
-		return v.value();
-	}
-	else if( m_progressionType == LinearProgression )
-	{
-		float slope = ((v+1).value() - v.value()) /
-							((v+1).key() - v.key());
-		return v.value() + offset * slope;
-	}
-	else /* CubicHermiteProgression */
-	{
-		// Implements a Cubic Hermite spline as explained at:
-		// http://en.wikipedia.org/wiki/Cubic_Hermite_spline#Unit_interval_.280.2C_1.29
-		//
-		// Note that we are not interpolating a 2 dimensional point over
-		// time as the article describes.  We are interpolating a single
-		// value: y.  To make this work we map the values of x that this
-		// segment spans to values of t for t = 0.0 -> 1.0 and scale the
-		// tangents _m1 and _m2
-		int numValues = ((v+1).key() - v.key());
-		float t = (float) offset / (float) numValues;
-		float m1 = (m_tangents[v.key()]) * numValues * m_tension;
-		float m2 = (m_tangents[(v+1).key()]) * numValues * m_tension;
-
-		return ( 2*pow(t,3) - 3*pow(t,2) + 1 ) * v.value()
-				+ ( pow(t,3) - 2*pow(t,2) + t) * m1
-				+ ( -2*pow(t,3) + 3*pow(t,2) ) * (v+1).value()
-				+ ( pow(t,3) - pow(t,2) ) * m2;
-	}
+	return m_curve;
 }
 
 
 
 
-float *AutomationPattern::valuesAfter( const MidiTime & _time ) const
+const AutomationCurve * AutomationPattern::acquireCurve() const
 {
-	timeMap::ConstIterator v = m_timeMap.lowerBound( _time );
-	if( v == m_timeMap.end() || (v+1) == m_timeMap.end() )
-	{
-		return NULL;
-	}
+	QMutexLocker lock( &m_curveMutex );
+	const AutomationCurve * c = m_curve;
+	c->ref();
+	return c;
+}
 
-	int numValues = (v+1).key() - v.key();
-	float *ret = new float[numValues];
 
-	for( int i = 0; i < numValues; i++ )
+
+
+void AutomationPattern::updateCurve()
+{
+	// built by whoever edits the pattern, so threads playing it never
+	// allocate
+	AutomationCurve * curve = new AutomationCurve( *this );
+	m_curveMutex.lock();
+	AutomationCurve * previous = m_curve.fetchAndStoreOrdered( curve );
+	m_curveMutex.unlock();
+
+	if( previous )
 	{
-		ret[i] = valueAt( v, i );
+		// mixer and worker threads use curves without a reference while
+		// the mixer is locked, readers like the GUI hold references and
+		// release the curve when done
+		Mixer * mixer = Engine::mixer();
+		if( mixer )
+		{
+			mixer->lock();
+		}
+		AutomationCurve::release( previous );
+		if( mixer )
+		{
+			mixer->unlock();
+		}
 	}
-
-	return ret;
 }
 
 
@@ -417,17 +426,18 @@ void AutomationPattern::flipY( int min, int max )
 
 		if ( min < 0 )
 		{
-			tempValue = valueAt( ( iterate + i ).key() ) * -1;
+			tempValue = ( iterate + i ).value() * -1;
 			putValue( MidiTime( (iterate + i).key() ) , tempValue, false);
 		}
 		else
 		{
-			tempValue = max - valueAt( ( iterate + i ).key() );
+			tempValue = max - ( iterate + i ).value();
 			putValue( MidiTime( (iterate + i).key() ) , tempValue, false);
 		}
 	}
 
 	generateTangents();
+	updateCurve();
 	emit dataChanged();
 }
 
@@ -461,12 +471,12 @@ void AutomationPattern::flipX( int length )
 	{
 		if ( realLength < length )
 		{
-			tempValue = valueAt( ( iterate + numPoints ).key() );
+			tempValue = ( iterate + numPoints ).value();
 			putValue( MidiTime( length ) , tempValue, false);
 			numPoints++;
 			for( int i = 0; i <= numPoints; i++ )
 			{
-				tempValue = valueAt( ( iterate + i ).key() );
+				tempValue = ( iterate + i ).value();
 				MidiTime newTime = MidiTime( length - ( iterate + i ).key() );
 				tempMap[newTime] = tempValue;
 			}
@@ -475,7 +485,7 @@ void AutomationPattern::flipX( int length )
 		{
 			for( int i = 0; i <= numPoints; i++ )
 			{
-				tempValue = valueAt( ( iterate + i ).key() );
+				tempValue = ( iterate + i ).value();
 				MidiTime newTime;
 
 				if ( ( iterate + i ).key() <= length )
@@ -494,7 +504,7 @@ void AutomationPattern::flipX( int length )
 	{
 		for( int i = 0; i <= numPoints; i++ )
 		{
-			tempValue = valueAt( ( iterate + i ).key() );
+			tempValue = ( iterate + i ).value();
 			cleanObjects();
 			MidiTime newTime = MidiTime( realLength - ( iterate + i ).key() );
 			tempMap[newTime] = tempValue;
@@ -506,6 +516,7 @@ void AutomationPattern::flipX( int length )
 	m_timeMap = tempMap;
 
 	generateTangents();
+	updateCurve();
 	emit dataChanged();
 }
 
@@ -582,6 +593,7 @@ void AutomationPattern::loadSettings( const QDomElement & _this )
 	}
 	changeLength( len );
 	generateTangents();
+	updateCurve();
 }
 
 
@@ -609,7 +621,7 @@ void AutomationPattern::processMidiTime( const MidiTime & time )
 	{
 		if( time >= 0 && hasAutomation() )
 		{
-			const float val = valueAt( time );
+			const float val = curve()->valueAt( time.getTicks(), m_playCursor );
 			for( objectVector::iterator it = m_objects.begin();
 							it != m_objects.end(); ++it )
 			{
@@ -641,6 +653,52 @@ void AutomationPattern::processMidiTime( const MidiTime & time )
 
 
 
+void AutomationPattern::processValueBuffers( float _tick, const fpp_t _frames,
+						const f_cnt_t _frame_base )
+{
+	if( isRecording() || !hasAutomation() )
+	{
+		return;
+	}
+
+	const float framesPerTick = Engine::framesPerTick();
+	f_cnt_t frames = _frames;
+	f_cnt_t frameBase = _frame_base;
+	if( _tick < 0 )
+	{
+		// leave frames before start of pattern alone
+		const f_cnt_t skip = (f_cnt_t) ceilf( -_tick * framesPerTick );
+		if( skip >= frames )
+		{
+			return;
+		}
+		_tick += skip / framesPerTick;
+		frames -= skip;
+		frameBase += skip;
+	}
+
+	// scratch buffer for unscaled values, every model scales on its own
+	float * values = ValueBufferArena::alloc( frames );
+	if( values == NULL )
+	{
+		return;
+	}
+	curve()->fill( values, frames, _tick, 1.0f / framesPerTick,
+								m_playCursor );
+
+	for( objectVector::iterator it = m_objects.begin();
+					it != m_objects.end(); ++it )
+	{
+		if( *it )
+		{
+			( *it )->setAutomatedValues( values, frameBase, frames );
+		}
+	}
+}
+
+
+
+
 TrackContentObjectView * AutomationPattern::createView( TrackView * _tv )
 {
 	return new AutomationPatternView( this, _tv );
@@ -803,6 +861,7 @@ void AutomationPattern::clear()
 {
 	m_timeMap.clear();
 	m_tangents.clear();
+	updateCurve();
 
 	emit dataChanged();
 }
@@ -26,89 +26,286 @@
 #include "BufferManager.h"
 
 #include <QtCore/QtGlobal>
-#include <QtCore/QAtomicInt>
+#include <QtCore/QHash>
+#include <QtCore/QThread>
+#include <QtCore/QThreadStorage>
 
-#include "MemoryManager.h"
+#include "MemoryHelper.h"
 
-sampleFrame ** BufferManager::s_available;
-QAtomicInt BufferManager::s_availableIndex = 0;
-sampleFrame ** BufferManager::s_released;
-QAtomicInt BufferManager::s_releasedIndex = 0;
-//QReadWriteLock BufferManager::s_mutex;
-int BufferManager::s_size;
+
+// per-thread free list, linked through BufferInfo::next
+class BufferCache
+{
+public:
+	BufferCache() :
+		m_first( -1 ),
+		m_count( 0 )
+	{
+	}
+
+	~BufferCache()
+	{
+		if( m_count > 0 )
+		{
+			BufferManager::push( m_first, last( m_count ), m_count );
+		}
+	}
+
+	// returns index of n-th buffer (counting from 1) in list
+	int last( int n ) const
+	{
+		int i = m_first;
+		while( --n > 0 )
+		{
+			i = BufferManager::info( i ).next;
+		}
+		return i;
+	}
+
+	int m_first;
+	int m_count;
+} ;
+
+
+static QThreadStorage<BufferCache *> s_bufferCache;
+
+BufferBlock * BufferManager::s_blocks[BM_MAX_BLOCKS];
+QAtomicInt BufferManager::s_blockCount = 0;
+QAtomicInt BufferManager::s_blocksReserved = 0;
+QAtomicInt BufferManager::s_freeList = 0;
+QAtomicInt BufferManager::s_freeBuffers = 0;
+int BufferManager::s_stride = 0;
+fpp_t BufferManager::s_framesPerPeriod = 0;
 
 
 void BufferManager::init( fpp_t framesPerPeriod )
 {
-	s_available = MM_ALLOC( sampleFrame*, BM_INITIAL_BUFFERS );
-	s_released = MM_ALLOC( sampleFrame*, BM_INITIAL_BUFFERS );
-
-	int c = framesPerPeriod * BM_INITIAL_BUFFERS;
-	sampleFrame * b = MM_ALLOC( sampleFrame, c );
+	s_framesPerPeriod = framesPerPeriod;
+	// each buffer is preceded by its index, padded to keep buffers aligned
+	s_stride = ALIGN_SIZE + framesPerPeriod * sizeof( sampleFrame );
+	s_stride = ( s_stride + ALIGN_SIZE - 1 ) / ALIGN_SIZE * ALIGN_SIZE;
 
-	for( int i = 0; i < BM_INITIAL_BUFFERS; ++i )
+	while( size() < BM_INITIAL_BUFFERS )
 	{
-		s_available[ i ] = b;
-		b += framesPerPeriod;
+		grow();
 	}
-	s_availableIndex = BM_INITIAL_BUFFERS - 1;
-	s_size = BM_INITIAL_BUFFERS;
 }
 
 
-sampleFrame * BufferManager::acquire()
+sampleFrame * BufferManager::acquire( const void * owner )
 {
-	if( s_availableIndex < 0 )
+	BufferCache * c = cache();
+
+	if( c->m_count == 0 )
 	{
-		qFatal( "BufferManager: out of buffers" );
+		// refill our list with a batch from the global list
+		int i;
+		while( c->m_count < BM_BATCH_BUFFERS && ( i = pop() ) >= 0 )
+		{
+			info( i ).next = c->m_first;
+			c->m_first = i;
+			++c->m_count;
+		}
+
+		if( c->m_count == 0 )
+		{
+			// all buffers in use - refresh() should have prevented this
+			grow();
+			return acquire( owner );
+		}
 	}
 
-	int i = s_availableIndex.fetchAndAddOrdered( -1 );
-	sampleFrame * b = s_available[ i ];
+	const int i = c->m_first;
+	c->m_first = info( i ).next;
+	--c->m_count;
 
-	//qDebug( "acquired buffer: %p - index %d", b, i );
-	return b;
+#ifdef LMMS_DEBUG
+	info( i ).owner = owner;
+	info( i ).inUse = true;
+#else
+	Q_UNUSED( owner );
+#endif
+
+	//qDebug( "acquired buffer: %d", i );
+	return buffer( i );
 }
 
 
 void BufferManager::release( sampleFrame * buf )
 {
-	int i = s_releasedIndex.fetchAndAddOrdered( 1 );
-	s_released[ i ] = buf;
-	//qDebug( "released buffer: %p - index %d", buf, i );
+	const int i = index( buf );
+
+#ifdef LMMS_DEBUG
+	if( !info( i ).inUse )
+	{
+		qFatal( "BufferManager: buffer %p released twice", buf );
+	}
+	info( i ).inUse = false;
+	info( i ).owner = NULL;
+#endif
+
+	BufferCache * c = cache();
+	if( c->m_count == BM_CACHE_BUFFERS )
+	{
+		// hand a batch back to the global list
+		const int last = c->last( BM_BATCH_BUFFERS );
+		const int first = c->m_first;
+		c->m_first = info( last ).next;
+		c->m_count -= BM_BATCH_BUFFERS;
+		push( first, last, BM_BATCH_BUFFERS );
+	}
+
+	info( i ).next = c->m_first;
+	c->m_first = i;
+	++c->m_count;
+	//qDebug( "released buffer: %d", i );
+}
+
+
+void BufferManager::refresh() // called periodically from mixer at a time when no other threads can interfere
+{
+	// grow in advance rather than in the middle of the next period
+	if( s_freeBuffers < BM_BLOCK_BUFFERS / 4 )
+	{
+		grow();
+	}
+}
+
+
+#ifdef LMMS_DEBUG
+int BufferManager::outstandingBuffers( const void * owner )
+{
+	int n = 0;
+	for( int i = 0; i < size(); ++i )
+	{
+		if( info( i ).inUse && info( i ).owner == owner )
+		{
+			++n;
+		}
+	}
+	return n;
+}
+
+
+void BufferManager::dumpOutstandingBuffers()
+{
+	QHash<const void *, int> owners;
+	for( int i = 0; i < size(); ++i )
+	{
+		if( info( i ).inUse )
+		{
+			++owners[info( i ).owner];
+		}
+	}
+
+	for( QHash<const void *, int>::ConstIterator it = owners.begin(); it != owners.end(); ++it )
+	{
+		qWarning( "BufferManager: %d buffers not released by %p", it.value(), it.key() );
+	}
+}
+#endif
+
+
+BufferCache * BufferManager::cache()
+{
+	BufferCache * c = s_bufferCache.localData();
+	if( c == NULL )
+	{
+		c = new BufferCache;
+		s_bufferCache.setLocalData( c );
+	}
+	return c;
 }
 
 
-void BufferManager::refresh() // non-threadsafe, hence it's called periodically from mixer at a time when no other threads can interfere
+void BufferManager::grow()
 {
-	if( s_releasedIndex == 0 ) return;
-	//qDebug( "refresh: %d buffers", int( s_releasedIndex ) );
+	const int b = s_blocksReserved.fetchAndAddOrdered( 1 );
+	if( b >= BM_MAX_BLOCKS )
+	{
+		qFatal( "BufferManager: out of buffers" );
+	}
+
+	BufferBlock * block = new BufferBlock;
+	block->memory = (char *) MemoryHelper::alignedMalloc( BM_BLOCK_BUFFERS * s_stride );
+
+	const int first = b * BM_BLOCK_BUFFERS;
+	for( int i = 0; i < BM_BLOCK_BUFFERS; ++i )
+	{
+		*(int *)( block->memory + i * s_stride ) = first + i;
+		block->info[i].next = i < BM_BLOCK_BUFFERS - 1 ? first + i + 1 : -1;
+#ifdef LMMS_DEBUG
+		block->info[i].owner = NULL;
+		block->info[i].inUse = false;
+#endif
+	}
+	s_blocks[b] = block;
 
-	int j = s_availableIndex;
-	for( int i = 0; i < s_releasedIndex; ++i )
+	// count the block only once it's stored, so size() never covers
+	// missing blocks - in order, as another thread might still be
+	// setting up the block before ours
+	while( !s_blockCount.testAndSetRelease( b, b + 1 ) )
 	{
-		++j;
-		s_available[ j ] = s_released[ i ];
+		QThread::yieldCurrentThread();
 	}
-	s_availableIndex = j;
-	s_releasedIndex = 0;
+
+	// publishes the new buffers to other threads
+	push( first, first + BM_BLOCK_BUFFERS - 1, BM_BLOCK_BUFFERS );
+}
+
+
+sampleFrame * BufferManager::buffer( int index )
+{
+	return (sampleFrame *)( s_blocks[index / BM_BLOCK_BUFFERS]->memory +
+				( index % BM_BLOCK_BUFFERS ) * s_stride + ALIGN_SIZE );
+}
+
+
+int BufferManager::index( sampleFrame * buf )
+{
+	return *(int *)( (char *) buf - ALIGN_SIZE );
+}
+
+
+BufferInfo & BufferManager::info( int index )
+{
+	return s_blocks[index / BM_BLOCK_BUFFERS]->info[index % BM_BLOCK_BUFFERS];
 }
 
 
-/* // non-extensible for now
-void BufferManager::extend( int c )
+int BufferManager::pop()
 {
-	s_size += c;
-	sampleFrame ** tmp = MM_ALLOC( sampleFrame*, s_size );
-	MM_FREE( s_available );
-	s_available = tmp;
+	// the tag in the upper 16 bits changes with every update, so a
+	// concurrent pop and push of the same buffer can't go unnoticed
+	unsigned int head;
+	int i;
+	do
+	{
+		head = (int) s_freeList;
+		i = (int)( head & 0xffff ) - 1;
+		if( i < 0 )
+		{
+			return -1;
+		}
+	}
+	while( !s_freeList.testAndSetOrdered( head,
+			( ( ( head >> 16 ) + 1 ) << 16 ) | ( info( i ).next + 1 ) ) );
+
+	s_freeBuffers.fetchAndAddOrdered( -1 );
+	return i;
+}
 
-	int cc = c * Engine::mixer()->framesPerPeriod();
-	sampleFrame * b = MM_ALLOC( sampleFrame, cc );
 
-	for( int i = 0; i < c; ++i )
+void BufferManager::push( int first, int last, int count )
+{
+	unsigned int head;
+	do
 	{
-		s_available[ s_availableIndex.fetchAndAddOrdered( 1 ) + 1 ] = b;
-		b += Engine::mixer()->framesPerPeriod();
+		head = (int) s_freeList;
+		info( last ).next = (int)( head & 0xffff ) - 1;
 	}
-}*/
+	while( !s_freeList.testAndSetOrdered( head,
+			( ( ( head >> 16 ) + 1 ) << 16 ) | ( first + 1 ) ) );
+
+	s_freeBuffers.fetchAndAddOrdered( count );
+}
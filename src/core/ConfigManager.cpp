@@ -89,6 +89,14 @@ void ConfigManager::setWorkingDir( const QString & _wd )
 
 
 
+void ConfigManager::setPluginDir( const QString & _pd )
+{
+	m_pluginDir = ensureTrailingSlash( _pd );
+}
+
+
+
+
 void ConfigManager::setVSTDir( const QString & _vd )
 {
 	m_vstDir = ensureTrailingSlash( _vd );
@@ -49,7 +49,10 @@ Effect::Effect( const Plugin::Descriptor * _desc,
 	m_wetDryModel( 1.0f, -1.0f, 1.0f, 0.01f, this, tr( "Wet/Dry mix" ) ),
 	m_gateModel( 0.0f, 0.0f, 1.0f, 0.01f, this, tr( "Gate" ) ),
 	m_autoQuitModel( 1.0f, 1.0f, 8000.0f, 100.0f, 1.0f, this, tr( "Decay" ) ),
-	m_autoQuitDisabled( false )
+	m_autoQuitDisabled( false ),
+	m_profilerNode( Engine::mixer()->profiler().registerNode(
+				MixerProfiler::NodeEffect, m_key.isValid() ?
+					m_key.name : QString( _desc->displayName ) ) )
 {
 	m_srcState[0] = m_srcState[1] = NULL;
 	reinitSRC();
@@ -65,6 +68,11 @@ Effect::Effect( const Plugin::Descriptor * _desc,
 
 Effect::~Effect()
 {
+	if( Engine::mixer() )
+	{
+		Engine::mixer()->profiler().unregisterNode( m_profilerNode );
+	}
+
 	for( int i = 0; i < 2; ++i )
 	{
 		if( m_srcState[i] != NULL )
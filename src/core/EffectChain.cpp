@@ -203,14 +203,20 @@ bool EffectChain::processAudioBuffer( sampleFrame * _buf, const fpp_t _frames, b
 	bool moreEffects = false;
 	for( EffectList::Iterator it = m_effects.begin(); it != m_effects.end(); ++it )
 	{
-		if( hasInputNoise || ( *it )->isRunning() )
+		const bool process = hasInputNoise || ( *it )->isRunning();
+		if( process )
 		{
+			MixerProfilerNodeTimer timer( Engine::mixer()->profiler(),
+							( *it )->m_profilerNode );
 			moreEffects |= ( *it )->processAudioBuffer( _buf, _frames );
+			timer.stop();
 			if( exporting ) // strip infs/nans if exporting
 			{
 				MixHelpers::sanitize( _buf, _frames );
 			}
 		}
+		Engine::mixer()->profiler().countNode( MixerProfiler::NodeEffect,
+						!process || !( *it )->isEnabled() );
 
 #ifdef LMMS_DEBUG
 		for( int f = 0; f < _frames; ++f )
@@ -250,6 +256,27 @@ void EffectChain::startRunning()
 
 
 
+bool EffectChain::isRunning() const
+{
+	if( m_enabledModel.value() == false )
+	{
+		return false;
+	}
+
+	for( EffectList::ConstIterator it = m_effects.begin();
+						it != m_effects.end(); ++it )
+	{
+		if( ( *it )->isEnabled() && ( *it )->isRunning() )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+
+
 void EffectChain::clear()
 {
 	emit aboutToClear();
@@ -90,8 +90,9 @@ void Engine::destroy()
 	deleteHelper( &s_bbTrackContainer );
 	deleteHelper( &s_dummyTC );
 
-	deleteHelper( &s_mixer );
+	// FX channels and their effects unregister from the mixer's profiler
 	deleteHelper( &s_fxMixer );
+	deleteHelper( &s_mixer );
 
 	deleteHelper( &s_ladspaManager );
 
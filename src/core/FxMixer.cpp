@@ -60,6 +60,7 @@ FxChannel::FxChannel( int idx, Model * _parent ) :
 	m_fxChain( NULL ),
 	m_hasInput( false ),
 	m_stillRunning( false ),
+	m_bufferUsed( false ),
 	m_peakLeft( 0.0f ),
 	m_peakRight( 0.0f ),
 	m_buffer( new sampleFrame[Engine::mixer()->framesPerPeriod()] ),
@@ -70,7 +71,9 @@ FxChannel::FxChannel( int idx, Model * _parent ) :
 	m_lock(),
 	m_channelIndex( idx ),
 	m_queued( false ),
-	m_dependenciesMet( 0 )
+	m_pendingInputs( 0 ),
+	m_profilerNode( Engine::mixer()->profiler().registerNode(
+					MixerProfiler::NodeFxChannel, QString() ) )
 {
 	Engine::mixer()->clearAudioBuffer( m_buffer,
 					Engine::mixer()->framesPerPeriod() );
@@ -82,6 +85,11 @@ FxChannel::FxChannel( int idx, Model * _parent ) :
 FxChannel::~FxChannel()
 {
 	delete[] m_buffer;
+
+	if( Engine::mixer() )
+	{
+		Engine::mixer()->profiler().unregisterNode( m_profilerNode );
+	}
 }
 
 
@@ -91,15 +99,15 @@ inline void FxChannel::processed()
 	{
 		if( receiverRoute->receiver()->m_muted == false )
 		{
-			receiverRoute->receiver()->incrementDeps();
+			receiverRoute->receiver()->inputDone();
 		}
 	}
 }
 
-void FxChannel::incrementDeps()
+void FxChannel::inputDone()
 {
-	m_dependenciesMet.ref();
-	if( m_dependenciesMet >= m_receives.size() && ! m_queued )
+	// deref() returns false once counter reaches zero
+	if( !m_pendingInputs.deref() && ! m_queued )
 	{
 		m_queued = true;
 		MixerWorkerThread::addJob( this );
@@ -119,6 +127,9 @@ void FxChannel::doProcessing()
 	const fpp_t fpp = Engine::mixer()->framesPerPeriod();
 	const bool exporting = Engine::getSong()->isExporting();
 
+	// effects are timed on their own
+	MixerProfilerNodeTimer timer( Engine::mixer()->profiler(), m_profilerNode );
+
 	if( m_muted == false )
 	{
 		foreach( FxRoute * senderRoute, m_receives )
@@ -129,37 +140,12 @@ void FxChannel::doProcessing()
 
 			if( sender->m_hasInput || sender->m_stillRunning )
 			{
-				// figure out if we're getting sample-exact input
-				ValueBuffer * sendBuf = sendModel->valueBuffer();
-				ValueBuffer * volBuf = sender->m_volumeModel.valueBuffer();
-
-				// mix it's output with this one's output
-				sampleFrame * ch_buf = sender->m_buffer;
-
-				// use sample-exact mixing if sample-exact values are available
-				if( ! volBuf && ! sendBuf ) // neither volume nor send has sample-exact data...
-				{
-					const float v = sender->m_volumeModel.value() * sendModel->value();
-					if( exporting ) { MixHelpers::addSanitizedMultiplied( m_buffer, ch_buf, v, fpp ); }
-					else { MixHelpers::addMultiplied( m_buffer, ch_buf, v, fpp ); }
-				}
-				else if( volBuf && sendBuf ) // both volume and send have sample-exact data
-				{
-					if( exporting ) { MixHelpers::addSanitizedMultipliedByBuffers( m_buffer, ch_buf, volBuf, sendBuf, fpp ); }
-					else { MixHelpers::addMultipliedByBuffers( m_buffer, ch_buf, volBuf, sendBuf, fpp ); }
-				}
-				else if( volBuf ) // volume has sample-exact data but send does not
-				{
-					const float v = sendModel->value();
-					if( exporting ) { MixHelpers::addSanitizedMultipliedByBuffer( m_buffer, ch_buf, v, volBuf, fpp ); }
-					else { MixHelpers::addMultipliedByBuffer( m_buffer, ch_buf, v, volBuf, fpp ); }
-				}
-				else // vice versa
-				{
-					const float v = sender->m_volumeModel.value();
-					if( exporting ) { MixHelpers::addSanitizedMultipliedByBuffer( m_buffer, ch_buf, v, sendBuf, fpp ); }
-					else { MixHelpers::addMultipliedByBuffer( m_buffer, ch_buf, v, sendBuf, fpp ); }
-				}
+				// mix it's output with this one's output, sample-exact if
+				// volume or send provide sample-exact data
+				MixHelpers::addMultipliedByGains( m_buffer, sender->m_buffer,
+						sender->m_volumeModel.value(), sender->m_volumeModel.valueBuffer(),
+						sendModel->value(), sendModel->valueBuffer(),
+						exporting, fpp );
 				m_hasInput = true;
 			}
 		}
@@ -173,16 +159,33 @@ void FxChannel::doProcessing()
 			m_fxChain.startRunning();
 		}
 
-		m_stillRunning = m_fxChain.processAudioBuffer( m_buffer, fpp, m_hasInput );
-
-		m_peakLeft = qMax( m_peakLeft, Engine::mixer()->peakValueLeft( m_buffer, fpp ) * v );
-		m_peakRight = qMax( m_peakRight, Engine::mixer()->peakValueRight( m_buffer, fpp ) * v );
+		if( m_hasInput || m_fxChain.isRunning() )
+		{
+			timer.stop();
+			m_stillRunning = m_fxChain.processAudioBuffer( m_buffer, fpp, m_hasInput );
+			timer.start();
+			m_bufferUsed = true;
+
+			float peakLeft, peakRight;
+			Mixer::peakValues( m_buffer, fpp, peakLeft, peakRight );
+			m_peakLeft = qMax( m_peakLeft, peakLeft * v );
+			m_peakRight = qMax( m_peakRight, peakRight * v );
+		}
+		else
+		{
+			// buffer is still silent from last period, so neither
+			// effects nor peak meters have anything to do
+			m_stillRunning = false;
+		}
 	}
 	else
 	{
 		m_peakLeft = m_peakRight = 0.0f;
 	}
 
+	Engine::mixer()->profiler().countNode( MixerProfiler::NodeFxChannel,
+						!m_hasInput && !m_stillRunning );
+
 	// increment dependency counter of all receivers
 	processed();
 }
@@ -192,7 +195,8 @@ void FxChannel::doProcessing()
 FxMixer::FxMixer() :
 	Model( NULL ),
 	JournallingObject(),
-	m_fxChannels()
+	m_fxChannels(),
+	m_channelGraphActive( false )
 {
 	// create master channel
 	createChannel();
@@ -460,7 +464,7 @@ void FxMixer::deleteChannelSend( FxRoute * route )
 	// remove us from to's receives
 	route->receiver()->m_receives.remove( route->receiver()->m_receives.indexOf( route ) );
 	// remove us from fxmixer's list
-	Engine::fxMixer()->m_fxRoutes.remove( Engine::fxMixer()->m_fxRoutes.indexOf( route ) );
+	m_fxRoutes.remove( m_fxRoutes.indexOf( route ) );
 	delete route;
 	m_sendsMutex.unlock();
 }
@@ -552,36 +556,91 @@ void FxMixer::prepareMasterMix()
 
 
 
-void FxMixer::masterMix( sampleFrame * _buf )
+void FxMixer::prepareChannelGraph()
 {
-	const int fpp = Engine::mixer()->framesPerPeriod();
+	// don't process channels if routing is being changed right now
+	m_channelGraphActive = m_sendsMutex.tryLock();
+	if( !m_channelGraphActive )
+	{
+		return;
+	}
 
-	if( m_sendsMutex.tryLock() )
+	foreach( FxChannel * ch, m_fxChannels )
 	{
-		// add the channels that have no dependencies (no incoming senders, ie. no receives)
-		// to the jobqueue. The channels that have receives get added when their senders get processed, which
-		// is detected by dependency counting.
-		// also instantly add all muted channels as they don't need to care about their senders, and can just increment the deps of
-		// their recipients right away.
-		MixerWorkerThread::resetJobQueue( MixerWorkerThread::JobQueue::Dynamic );
-		foreach( FxChannel * ch, m_fxChannels )
+		ch->m_muted = ch->m_muteModel.value();
+		// one extra input keeps the channel from being queued before all
+		// inputs are registered
+		ch->m_pendingInputs = ch->m_receives.size() + 1;
+	}
+}
+
+
+
+
+void FxMixer::addChannelInput( fx_ch_t _ch )
+{
+	if( m_channelGraphActive && _ch < m_fxChannels.size() &&
+					m_fxChannels[_ch]->m_muted == false )
+	{
+		m_fxChannels[_ch]->m_pendingInputs.ref();
+	}
+}
+
+
+
+
+void FxMixer::startChannelGraph()
+{
+	if( !m_channelGraphActive )
+	{
+		return;
+	}
+
+	// instantly "process" muted channels as they don't need to care about
+	// their inputs, so their receivers don't have to wait for them
+	foreach( FxChannel * ch, m_fxChannels )
+	{
+		if( ch->m_muted )
 		{
-			ch->m_muted = ch->m_muteModel.value();
-			if( ch->m_muted ) // instantly "process" muted channels
-			{
-				ch->processed();
-				ch->done();
-			}
-			else if( ch->m_receives.size() == 0 )
-			{
-				ch->m_queued = true;
-				MixerWorkerThread::addJob( ch );
-			}
+			ch->processed();
+			ch->done();
 		}
-		while( m_fxChannels[0]->state() != ThreadableJob::Done )
+	}
+
+	// drop the extra input - this queues all channels without any
+	// pending inputs (i.e. no incoming sends and no audio ports)
+	foreach( FxChannel * ch, m_fxChannels )
+	{
+		if( ch->m_muted == false )
 		{
-			MixerWorkerThread::startAndWaitForJobs();
+			ch->inputDone();
 		}
+	}
+}
+
+
+
+
+void FxMixer::channelInputDone( fx_ch_t _ch )
+{
+	if( m_channelGraphActive && _ch < m_fxChannels.size() &&
+					m_fxChannels[_ch]->m_muted == false )
+	{
+		m_fxChannels[_ch]->inputDone();
+	}
+}
+
+
+
+
+void FxMixer::masterMix( sampleFrame * _buf )
+{
+	const int fpp = Engine::mixer()->framesPerPeriod();
+
+	// all channels have been processed as part of the render graph
+	if( m_channelGraphActive )
+	{
+		m_channelGraphActive = false;
 		m_sendsMutex.unlock();
 	}
 
@@ -590,11 +649,7 @@ void FxMixer::masterMix( sampleFrame * _buf )
 
 	if( volBuf )
 	{
-		for( int f = 0; f < fpp; f++ )
-		{
-			m_fxChannels[0]->m_buffer[f][0] *= volBuf->values()[f];
-			m_fxChannels[0]->m_buffer[f][1] *= volBuf->values()[f];
-		}
+		MixHelpers::multiplyByBuffer( m_fxChannels[0]->m_buffer, volBuf, fpp );
 	}
 
 	const float v = volBuf
@@ -602,16 +657,20 @@ void FxMixer::masterMix( sampleFrame * _buf )
 		: m_fxChannels[0]->m_volumeModel.value();
 	MixHelpers::addSanitizedMultiplied( _buf, m_fxChannels[0]->m_buffer, v, fpp );
 
-	// clear all channel buffers and
+	// clear all channel buffers which were written to and
 	// reset channel process state
 	for( int i = 0; i < numChannels(); ++i)
 	{
-		Engine::mixer()->clearAudioBuffer( m_fxChannels[i]->m_buffer, Engine::mixer()->framesPerPeriod() );
+		if( m_fxChannels[i]->m_hasInput || m_fxChannels[i]->m_bufferUsed )
+		{
+			Engine::mixer()->clearAudioBuffer( m_fxChannels[i]->m_buffer, Engine::mixer()->framesPerPeriod() );
+		}
 		m_fxChannels[i]->reset();
 		m_fxChannels[i]->m_queued = false;
 		// also reset hasInput
 		m_fxChannels[i]->m_hasInput = false;
-		m_fxChannels[i]->m_dependenciesMet = 0;
+		m_fxChannels[i]->m_bufferUsed = false;
+		m_fxChannels[i]->m_pendingInputs = 0;
 	}
 }
 
@@ -639,6 +698,7 @@ void FxMixer::clearChannel(fx_ch_t index)
 	ch->m_soloModel.setValue( false );
 	ch->m_name = ( index == 0 ) ? tr( "Master" ) : tr( "FX %1" ).arg( index );
 	ch->m_volumeModel.setDisplayName( ch->m_name );
+	Engine::mixer()->profiler().setNodeName( ch->m_profilerNode, ch->m_name );
 
 	// send only to master
 	if( index > 0)
@@ -722,6 +782,8 @@ void FxMixer::loadSettings( const QDomElement & _this )
 		m_fxChannels[num]->m_muteModel.loadSettings( fxch, "muted" );
 		m_fxChannels[num]->m_soloModel.loadSettings( fxch, "soloed" );
 		m_fxChannels[num]->m_name = fxch.attribute( "name" );
+		Engine::mixer()->profiler().setNodeName( m_fxChannels[num]->m_profilerNode,
+							m_fxChannels[num]->m_name );
 
 		m_fxChannels[num]->m_fxChain.restoreState( fxch.firstChildElement(
 			m_fxChannels[num]->m_fxChain.nodeName() ) );
@@ -765,6 +827,7 @@ void FxMixer::validateChannelName( int index, int oldIndex )
 	if( fxc->m_name == tr( "FX %1" ).arg( oldIndex ) )
 	{
 		fxc->m_name = tr( "FX %1" ).arg( index );
+		Engine::mixer()->profiler().setNodeName( fxc->m_profilerNode, fxc->m_name );
 	}
 	// set correct channel index
 	fxc->m_channelIndex = index;
@@ -25,84 +25,133 @@
 
 
 #include "MemoryManager.h"
+#include "RealtimeGuard.h"
 #include <QtGlobal>
-#include <QReadWriteLock>
-#include <stdint.h>
+#include <QtCore/QThread>
+#include <QtCore/QThreadStorage>
+#include <string.h>
 
 
-MemoryPoolVector MemoryManager::s_memoryPools;
-QReadWriteLock MemoryManager::s_poolMutex;
-PointerInfoMap MemoryManager::s_pointerInfo;
-QMutex MemoryManager::s_pointerMutex;
+const int MM_MAGIC_USED = 0x4d4d5553;
+const int MM_MAGIC_FREE = 0x4d4d4652;
+
+
+class MemoryCache
+{
+public:
+	MemoryCache() :
+		m_allocations( 0 ),
+		m_prev( NULL ),
+		m_next( NULL )
+	{
+		memset( m_count, 0, sizeof( m_count ) );
+
+		QMutexLocker lock( &MemoryManager::s_cacheMutex );
+		m_next = MemoryManager::s_caches;
+		if( m_next )
+		{
+			m_next->m_prev = this;
+		}
+		MemoryManager::s_caches = this;
+	}
+
+	~MemoryCache()
+	{
+		if( !MemoryManager::s_cleanedUp )
+		{
+			for( int i = 0; i < MM_SIZE_CLASSES; ++i )
+			{
+				MemoryManager::flush( this, i, m_count[i] );
+			}
+		}
+
+		QMutexLocker lock( &MemoryManager::s_cacheMutex );
+		if( m_prev )
+		{
+			m_prev->m_next = m_next;
+		}
+		else
+		{
+			MemoryManager::s_caches = m_next;
+		}
+		if( m_next )
+		{
+			m_next->m_prev = m_prev;
+		}
+		MemoryManager::s_retiredAllocations.fetchAndAddOrdered( m_allocations );
+	}
+
+	MemoryBlock * m_blocks[MM_SIZE_CLASSES][MM_CACHE_BLOCKS];
+	int m_count[MM_SIZE_CLASSES];
+
+	// only written by owning thread, read by allocations()
+	volatile int m_allocations;
+
+	MemoryCache * m_prev;
+	MemoryCache * m_next;
+};
+
+
+static QThreadStorage<MemoryCache *> s_threadCache;
+
+MemorySizeClass MemoryManager::s_sizeClasses[MM_SIZE_CLASSES];
+QAtomicPointer<void> MemoryManager::s_slabs;
+QAtomicInt MemoryManager::s_retiredAllocations;
+QAtomicInt MemoryManager::s_lastAllocations;
+bool MemoryManager::s_cleanedUp = false;
+MemoryCache * MemoryManager::s_caches = NULL;
+QMutex MemoryManager::s_cacheMutex;
+
 
 
 bool MemoryManager::init()
 {
-	s_memoryPools.reserve( 64 );
-	s_pointerInfo.reserve( 4096 );
-	// construct first MemoryPool and allocate memory
-	MemoryPool m ( MM_INITIAL_CHUNKS );
-	m.m_pool = MemoryHelper::alignedMalloc( MM_INITIAL_CHUNKS * MM_CHUNK_SIZE );
-	s_memoryPools.append( m );
+	s_cleanedUp = false;
+	// set up cache of main thread right away
+	cache();
 	return true;
 }
 
 
+
+
 void * MemoryManager::alloc( size_t size )
 {
-	int requiredChunks = size / MM_CHUNK_SIZE + ( size % MM_CHUNK_SIZE > 0 ? 1 : 0 );
+	RealtimeGuard::check( RealtimeGuard::MemoryManagerAlloc, size );
 
-	MemoryPool * mp = NULL;
-	void * ptr = NULL;
+	MemoryCache * c = cache();
+	c->m_allocations = c->m_allocations + 1;
 
-	MemoryPoolVector::iterator it = s_memoryPools.begin();
+	const int sc = sizeClass( size );
+	MemoryBlock * block;
 
-	s_poolMutex.lockForRead();
-	while( it != s_memoryPools.end() && !ptr )
+	if( sc < 0 )
 	{
-		ptr = ( *it ).getChunks( requiredChunks );
-		if( ptr )
+		// too large for any size class
+		block = (MemoryBlock *) MemoryHelper::alignedMalloc( size + MM_HEADER_SIZE );
+		if( block == NULL )
 		{
-			mp = &( *it );
+			qFatal( "MemoryManager.cpp: Couldn't allocate memory: %d bytes asked", (int) size );
 		}
-		++it;
+		block->next = NULL;
+		block->sizeClass = -1;
 	}
-	s_poolMutex.unlock();
-
-	if( ptr )
+	else
 	{
-		s_pointerMutex.lock();
-		PtrInfo p;
-			p.chunks = requiredChunks;
-			p.memPool = mp;
-		s_pointerInfo[ptr] = p;
-		s_pointerMutex.unlock();
-		return ptr;
+		if( c->m_count[sc] == 0 )
+		{
+			refill( c, sc );
+		}
+		block = c->m_blocks[sc][--c->m_count[sc]];
 	}
 
-	// can't find enough chunks in existing pools, so
-	// create a new pool that is guaranteed to have enough chunks
-	int moreChunks = qMax( requiredChunks, MM_INCREMENT_CHUNKS );
-	int i = MemoryManager::extend( moreChunks );
-
-	mp = &s_memoryPools[i];
-	ptr = s_memoryPools[i].getChunks( requiredChunks );
-	if( ptr )
-	{
-		s_pointerMutex.lock();
-		PtrInfo p;
-			p.chunks = requiredChunks;
-			p.memPool = mp;
-		s_pointerInfo[ptr] = p;
-		s_pointerMutex.unlock();
-		return ptr;
-	}
-	// still no luck? something is horribly wrong
-	qFatal( "MemoryManager.cpp: Couldn't allocate memory: %d chunks asked", requiredChunks );
-	return NULL;
+	block->magic = MM_MAGIC_USED;
+	return (char *) block + MM_HEADER_SIZE;
 }
 
 
+
+
 void MemoryManager::free( void * ptr )
 {
 	if( ptr == NULL )
@@ -111,109 +160,261 @@ void MemoryManager::free( void * ptr )
 		return; // let's not try to deallocate null pointers, ok?
 	}
 
-	// fetch info on the ptr and remove
-	s_pointerMutex.lock();
-	if( ! s_pointerInfo.contains( ptr ) ) // if we have no info on ptr, fail loudly
+	if( s_cleanedUp )
 	{
-		qFatal( "MemoryManager: Couldn't find pointer info for pointer: %p", ptr );
+		// the memory backing this block is gone already
+		return;
 	}
-	PtrInfo p = s_pointerInfo[ptr];
-	s_pointerInfo.remove( ptr );
-	s_pointerMutex.unlock();
 
-	p.memPool->releaseChunks( ptr, p.chunks );
+	MemoryBlock * block = (MemoryBlock *)( (char *) ptr - MM_HEADER_SIZE );
+	if( block->magic != MM_MAGIC_USED ) // not ours or freed twice, fail loudly
+	{
+		qFatal( "MemoryManager: Invalid pointer deallocation attempted: %p", ptr );
+	}
+	block->magic = MM_MAGIC_FREE;
+
+	const int sc = block->sizeClass;
+	if( sc < 0 )
+	{
+		MemoryHelper::alignedFree( block );
+		return;
+	}
+
+	MemoryCache * c = cache();
+	if( c->m_count[sc] == MM_CACHE_BLOCKS )
+	{
+		flush( c, sc, MM_BATCH_BLOCKS );
+	}
+	c->m_blocks[sc][c->m_count[sc]++] = block;
 }
 
 
-int MemoryManager::extend( int chunks )
+
+
+void MemoryManager::cleanup()
 {
-	MemoryPool m ( chunks );
-	m.m_pool = MemoryHelper::alignedMalloc( chunks * MM_CHUNK_SIZE );
+	// return blocks of calling thread before memory goes away -
+	// QThreadStorage deletes the previous cache when replacing it
+	s_threadCache.setLocalData( NULL );
+
+	s_cleanedUp = true;
 
-	s_poolMutex.lockForWrite();
-	s_memoryPools.append( m );
-	int i = s_memoryPools.size() - 1;
-	s_poolMutex.unlock();
+	void * slab = s_slabs.fetchAndStoreOrdered( NULL );
+	while( slab )
+	{
+		void * next = *(void **) slab;
+		MemoryHelper::alignedFree( slab );
+		slab = next;
+	}
 
-	return i;
+	for( int i = 0; i < MM_SIZE_CLASSES; ++i )
+	{
+		s_sizeClasses[i].freeList = NULL;
+		s_sizeClasses[i].freeBlocks = 0;
+	}
 }
 
 
-void MemoryManager::cleanup()
+
+
+int MemoryManager::allocations()
+{
+	// called by the mixer every period, so never wait for threads
+	// setting up or tearing down their caches - report what we counted
+	// last time instead
+	if( !s_cacheMutex.tryLock() )
+	{
+		return s_lastAllocations;
+	}
+
+	int total = s_retiredAllocations;
+	for( MemoryCache * c = s_caches; c; c = c->m_next )
+	{
+		total += c->m_allocations;
+	}
+	s_lastAllocations = total;
+
+	s_cacheMutex.unlock();
+
+	return total;
+}
+
+
+
+
+int MemoryManager::sizeClass( size_t size )
 {
-	for( MemoryPoolVector::iterator it = s_memoryPools.begin(); it != s_memoryPools.end(); ++it )
+	size_t classSize = MM_MIN_BLOCK_SIZE;
+	for( int i = 0; i < MM_SIZE_CLASSES; ++i )
 	{
-		MemoryHelper::alignedFree( ( *it ).m_pool );
-		MemoryHelper::alignedFree( ( *it ).m_free );
+		if( size <= classSize )
+		{
+			return i;
+		}
+		classSize <<= 1;
 	}
+	return -1;
 }
 
 
-void * MemoryPool::getChunks( int chunksNeeded )
+
+
+int MemoryManager::blockSize( int sizeClass )
+{
+	return ( MM_MIN_BLOCK_SIZE << sizeClass ) + MM_HEADER_SIZE;
+}
+
+
+
+
+MemoryCache * MemoryManager::cache()
 {
-	if( chunksNeeded > m_chunks ) // not enough chunks in this pool?
+	MemoryCache * c = s_threadCache.localData();
+	if( c == NULL )
 	{
-		return NULL;
+		c = new MemoryCache;
+		s_threadCache.setLocalData( c );
 	}
+	return c;
+}
 
-	m_mutex.lock();
 
-	// now find out if we have a long enough sequence of chunks in this pool
-	char last = 0;
-	intptr_t n = 0;
-	intptr_t index = -1;
-	bool found = false;
 
-	for( int i = 0; i < m_chunks; ++i )
+
+void MemoryManager::refill( MemoryCache * cache, int sizeClass )
+{
+	MemorySizeClass & sc = s_sizeClasses[sizeClass];
+	MemoryBlock ** blocks = cache->m_blocks[sizeClass];
+	int n = 0;
+
+	lockClass( sizeClass );
+	while( n < MM_BATCH_BLOCKS && sc.freeList )
+	{
+		blocks[n++] = sc.freeList;
+		sc.freeList = sc.freeList->next;
+	}
+	sc.freeBlocks -= n;
+	unlockClass( sizeClass );
+
+	if( n == 0 )
 	{
-		if( m_free[i] )
+		// global list is empty too, so carve a new slab - keep a batch
+		// for ourselves and hand the rest to the global list
+		int carved = 0;
+		MemoryBlock * block = carve( sizeClass, &carved );
+		while( n < MM_BATCH_BLOCKS && block )
 		{
-			if( !last )
-			{
-				index = i;
-			}
+			blocks[n++] = block;
+			block = block->next;
+		}
 
-			++n;
-			if( n >= chunksNeeded )
+		if( block )
+		{
+			MemoryBlock * last = block;
+			while( last->next )
 			{
-				found = true;
-				break;
+				last = last->next;
 			}
+
+			lockClass( sizeClass );
+			last->next = sc.freeList;
+			sc.freeList = block;
+			sc.freeBlocks += carved - n;
+			unlockClass( sizeClass );
 		}
-		else
-		{
-			n = 0;
-		}
+	}
+
+	cache->m_count[sizeClass] = n;
+}
+
+
 
-		last = m_free[i];
+
+void MemoryManager::flush( MemoryCache * cache, int sizeClass, int blocks )
+{
+	if( blocks <= 0 )
+	{
+		return;
 	}
 
-	if( found ) // if enough chunks found, return pointer to chunks
+	// hand the topmost blocks of the cache back to the global list
+	int & count = cache->m_count[sizeClass];
+	MemoryBlock ** cached = cache->m_blocks[sizeClass];
+
+	MemoryBlock * first = cached[count - blocks];
+	for( int i = count - blocks; i < count - 1; ++i )
 	{
-		// set chunk flags to false so we know the chunks are in use
-		for( intptr_t i = 0; i < chunksNeeded; ++i )
-		{
-			m_free[ index + i ] = 0;
-		}
-		m_mutex.unlock();
-		return (char*)m_pool + ( index * MM_CHUNK_SIZE );
+		cached[i]->next = cached[i + 1];
 	}
-	m_mutex.unlock();
-	return NULL; // out of stock, come again tomorrow!
+	MemoryBlock * last = cached[count - 1];
+	count -= blocks;
+
+	MemorySizeClass & sc = s_sizeClasses[sizeClass];
+	lockClass( sizeClass );
+	last->next = sc.freeList;
+	sc.freeList = first;
+	sc.freeBlocks += blocks;
+	unlockClass( sizeClass );
 }
 
 
-void MemoryPool::releaseChunks( void * ptr, int chunks )
+
+
+MemoryBlock * MemoryManager::carve( int sizeClass, int * blocks )
 {
-	m_mutex.lock();
+	const int size = blockSize( sizeClass );
+	const int count = qMax( MM_BATCH_BLOCKS, ( MM_SLAB_SIZE - MM_HEADER_SIZE ) / size );
+
+	// first header-sized part of each slab links to the next slab
+	char * slab = (char *) MemoryHelper::alignedMalloc( MM_HEADER_SIZE + count * size );
+	if( slab == NULL )
+	{
+		qFatal( "MemoryManager.cpp: Couldn't allocate slab of %d blocks (%d bytes each)", count, size );
+	}
 
-	intptr_t start = ( (intptr_t)ptr - (intptr_t)m_pool ) / MM_CHUNK_SIZE;
-	if( start < 0 )
+	void * head;
+	do
 	{
-		qFatal( "MemoryManager: error at releaseChunks() - corrupt pointer info?" );
+		head = s_slabs;
+		*(void **) slab = head;
 	}
+	while( !s_slabs.testAndSetOrdered( head, slab ) );
 
-	memset( &m_free[ start ], 1, chunks );
+	MemoryBlock * first = (MemoryBlock *)( slab + MM_HEADER_SIZE );
+	MemoryBlock * block = first;
+	for( int i = 0; i < count; ++i )
+	{
+		block->sizeClass = sizeClass;
+		block->magic = MM_MAGIC_FREE;
+		block->next = i < count - 1 ? (MemoryBlock *)( (char *) block + size ) : NULL;
+		block = block->next;
+	}
 
-	m_mutex.unlock();
+	*blocks = count;
+	return first;
 }
+
+
+
+
+void MemoryManager::lockClass( int sizeClass )
+{
+	// held only for a few list operations, so spin instead of sleeping
+	int spins = 0;
+	while( !s_sizeClasses[sizeClass].lock.testAndSetAcquire( 0, 1 ) )
+	{
+		if( ++spins % 64 == 0 )
+		{
+			QThread::yieldCurrentThread();
+		}
+	}
+}
+
+
+
+
+void MemoryManager::unlockClass( int sizeClass )
+{
+	s_sizeClasses[sizeClass].lock.fetchAndStoreRelease( 0 );
+}
+
@@ -23,6 +23,7 @@
  */
 
 #include "MixHelpers.h"
+#include "MixKernels.h"
 #include "lmms_math.h"
 #include "ValueBuffer.h"
 
@@ -30,6 +31,9 @@
 namespace MixHelpers
 {
 
+// scalar reference implementation - also used on CPUs where none of the
+// vectorized kernels are supported
+
 /*! \brief Function for applying MIXOP on all sample frames */
 template<typename MIXOP>
 static inline void run( sampleFrame* dst, const sampleFrame* src, int frames, const MIXOP& OP )
@@ -53,7 +57,7 @@ static inline void run( sampleFrame* dst, const sample_t* srcLeft, const sample_
 
 
 
-bool isSilent( const sampleFrame* src, int frames )
+static bool scalarIsSilent( const sampleFrame* src, int frames )
 {
 	const float silenceThreshold = 0.0000001f;
 
@@ -70,7 +74,7 @@ bool isSilent( const sampleFrame* src, int frames )
 
 
 /*! \brief Function for sanitizing a buffer of infs/nans - returns true if those are found */
-bool sanitize( sampleFrame * src, int frames )
+static bool scalarSanitize( sampleFrame * src, int frames )
 {
 	bool found = false;
 	for( int f = 0; f < frames; ++f )
@@ -88,6 +92,34 @@ bool sanitize( sampleFrame * src, int frames )
 }
 
 
+static void scalarPeak( const sampleFrame* src, int frames, float* left, float* right )
+{
+	float l = 0.0f;
+	float r = 0.0f;
+	for( int f = 0; f < frames; ++f )
+	{
+		l = qMax( l, qAbs( src[f][0] ) );
+		r = qMax( r, qAbs( src[f][1] ) );
+	}
+	*left = l;
+	*right = r;
+}
+
+
+static void scalarSumOfSquares( const sampleFrame* src, int frames, float* left, float* right )
+{
+	float l = 0.0f;
+	float r = 0.0f;
+	for( int f = 0; f < frames; ++f )
+	{
+		l += src[f][0] * src[f][0];
+		r += src[f][1] * src[f][1];
+	}
+	*left = l;
+	*right = r;
+}
+
+
 struct AddOp
 {
 	void operator()( sampleFrame& dst, const sampleFrame& src ) const
@@ -97,7 +129,7 @@ struct AddOp
 	}
 } ;
 
-void add( sampleFrame* dst, const sampleFrame* src, int frames )
+static void scalarAdd( sampleFrame* dst, const sampleFrame* src, int frames )
 {
 	run<>( dst, src, frames, AddOp() );
 }
@@ -118,7 +150,7 @@ struct AddMultipliedOp
 } ;
 
 
-void addMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames )
+static void scalarAddMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames )
 {
 	run<>( dst, src, frames, AddMultipliedOp(coeffSrc) );
 }
@@ -137,50 +169,50 @@ struct AddSwappedMultipliedOp
 	const float m_coeff;
 };
 
-void addSwappedMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames )
+static void scalarAddSwappedMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames )
 {
 	run<>( dst, src, frames, AddSwappedMultipliedOp(coeffSrc) );
 }
 
 
-void addMultipliedByBuffer( sampleFrame* dst, const sampleFrame* src, float coeffSrc, ValueBuffer * coeffSrcBuf, int frames )
+static void scalarAddMultipliedByBuffer( sampleFrame* dst, const sampleFrame* src, float coeffSrc, const float * coeffSrcBuf, int frames )
 {
 	for( int f = 0; f < frames; ++f )
 	{
-		dst[f][0] += src[f][0] * coeffSrc * coeffSrcBuf->values()[f];
-		dst[f][1] += src[f][1] * coeffSrc * coeffSrcBuf->values()[f];
+		dst[f][0] += src[f][0] * coeffSrc * coeffSrcBuf[f];
+		dst[f][1] += src[f][1] * coeffSrc * coeffSrcBuf[f];
 	}
 }
 
-void addMultipliedByBuffers( sampleFrame* dst, const sampleFrame* src, ValueBuffer * coeffSrcBuf1, ValueBuffer * coeffSrcBuf2, int frames )
+static void scalarAddMultipliedByBuffers( sampleFrame* dst, const sampleFrame* src, const float * coeffSrcBuf1, const float * coeffSrcBuf2, int frames )
 {
 	for( int f = 0; f < frames; ++f )
 	{
-		dst[f][0] += src[f][0] * coeffSrcBuf1->values()[f] * coeffSrcBuf2->values()[f];
-		dst[f][1] += src[f][1] * coeffSrcBuf1->values()[f] * coeffSrcBuf2->values()[f];
+		dst[f][0] += src[f][0] * coeffSrcBuf1[f] * coeffSrcBuf2[f];
+		dst[f][1] += src[f][1] * coeffSrcBuf1[f] * coeffSrcBuf2[f];
 	}
 
 }
 
-void addSanitizedMultipliedByBuffer( sampleFrame* dst, const sampleFrame* src, float coeffSrc, ValueBuffer * coeffSrcBuf, int frames )
+static void scalarAddSanitizedMultipliedByBuffer( sampleFrame* dst, const sampleFrame* src, float coeffSrc, const float * coeffSrcBuf, int frames )
 {
 	for( int f = 0; f < frames; ++f )
 	{
-		dst[f][0] += ( isinff( src[f][0] ) || isnanf( src[f][0] ) ) ? 0.0f : src[f][0] * coeffSrc * coeffSrcBuf->values()[f];
-		dst[f][1] += ( isinff( src[f][1] ) || isnanf( src[f][1] ) ) ? 0.0f : src[f][1] * coeffSrc * coeffSrcBuf->values()[f];
+		dst[f][0] += ( isinff( src[f][0] ) || isnanf( src[f][0] ) ) ? 0.0f : src[f][0] * coeffSrc * coeffSrcBuf[f];
+		dst[f][1] += ( isinff( src[f][1] ) || isnanf( src[f][1] ) ) ? 0.0f : src[f][1] * coeffSrc * coeffSrcBuf[f];
 	}
 }
 
-void addSanitizedMultipliedByBuffers( sampleFrame* dst, const sampleFrame* src, ValueBuffer * coeffSrcBuf1, ValueBuffer * coeffSrcBuf2, int frames )
+static void scalarAddSanitizedMultipliedByBuffers( sampleFrame* dst, const sampleFrame* src, const float * coeffSrcBuf1, const float * coeffSrcBuf2, int frames )
 {
 	for( int f = 0; f < frames; ++f )
 	{
 		dst[f][0] += ( isinff( src[f][0] ) || isnanf( src[f][0] ) )
 			? 0.0f
-			: src[f][0] * coeffSrcBuf1->values()[f] * coeffSrcBuf2->values()[f];
+			: src[f][0] * coeffSrcBuf1[f] * coeffSrcBuf2[f];
 		dst[f][1] += ( isinff( src[f][1] ) || isnanf( src[f][1] ) )
 			? 0.0f
-			: src[f][1] * coeffSrcBuf1->values()[f] * coeffSrcBuf2->values()[f];
+			: src[f][1] * coeffSrcBuf1[f] * coeffSrcBuf2[f];
 	}
 
 }
@@ -199,7 +231,7 @@ struct AddSanitizedMultipliedOp
 	const float m_coeff;
 };
 
-void addSanitizedMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames )
+static void scalarAddSanitizedMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames )
 {
 	run<>( dst, src, frames, AddSanitizedMultipliedOp(coeffSrc) );
 }
@@ -224,7 +256,7 @@ struct AddMultipliedStereoOp
 } ;
 
 
-void addMultipliedStereo( sampleFrame* dst, const sampleFrame* src, float coeffSrcLeft, float coeffSrcRight, int frames )
+static void scalarAddMultipliedStereo( sampleFrame* dst, const sampleFrame* src, float coeffSrcLeft, float coeffSrcRight, int frames )
 {
 
 	run<>( dst, src, frames, AddMultipliedStereoOp(coeffSrcLeft, coeffSrcRight) );
@@ -252,14 +284,14 @@ struct MultiplyAndAddMultipliedOp
 } ;
 
 
-void multiplyAndAddMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffDst, float coeffSrc, int frames )
+static void scalarMultiplyAndAddMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffDst, float coeffSrc, int frames )
 {
 	run<>( dst, src, frames, MultiplyAndAddMultipliedOp(coeffDst, coeffSrc) );
 }
 
 
 
-void multiplyAndAddMultipliedJoined( sampleFrame* dst,
+static void scalarMultiplyAndAddMultipliedJoined( sampleFrame* dst,
 										const sample_t* srcLeft,
 										const sample_t* srcRight,
 										float coeffDst, float coeffSrc, int frames )
@@ -267,5 +299,285 @@ void multiplyAndAddMultipliedJoined( sampleFrame* dst,
 	run<>( dst, srcLeft, srcRight, frames, MultiplyAndAddMultipliedOp(coeffDst, coeffSrc) );
 }
 
+
+
+static void scalarMultiplyByBuffer( sampleFrame* dst, const float * coeffBuf, int frames )
+{
+	for( int f = 0; f < frames; ++f )
+	{
+		dst[f][0] *= coeffBuf[f];
+		dst[f][1] *= coeffBuf[f];
+	}
+}
+
+
+
+static void scalarMultiplyByVolumeAndPanning( sampleFrame* dst, const float * volBuf, float vol, const float * panBuf, float pan, int frames )
+{
+	for( int f = 0; f < frames; ++f )
+	{
+		const float v = ( volBuf ? volBuf[f] : vol ) * 0.01f;
+		const float p = ( panBuf ? panBuf[f] : pan ) * 0.01f;
+		dst[f][0] *= ( p <= 0 ? 1.0f : 1.0f - p ) * v;
+		dst[f][1] *= ( p >= 0 ? 1.0f : 1.0f + p ) * v;
+	}
+}
+
+
+
+
+static const MixKernels s_scalarKernels =
+{
+	"scalar",
+	&scalarIsSilent,
+	&scalarSanitize,
+	&scalarPeak,
+	&scalarSumOfSquares,
+	&scalarAdd,
+	&scalarAddMultiplied,
+	&scalarAddSwappedMultiplied,
+	&scalarAddMultipliedByBuffer,
+	&scalarAddMultipliedByBuffers,
+	&scalarAddSanitizedMultiplied,
+	&scalarAddSanitizedMultipliedByBuffer,
+	&scalarAddSanitizedMultipliedByBuffers,
+	&scalarAddMultipliedStereo,
+	&scalarMultiplyAndAddMultiplied,
+	&scalarMultiplyAndAddMultipliedJoined,
+	&scalarMultiplyByBuffer,
+	&scalarMultiplyByVolumeAndPanning
+} ;
+
+// constant initialized, so MixHelpers can be used before init() as well
+static const MixKernels * s_kernels = &s_scalarKernels;
+
+
+
+const MixKernels * scalarKernels()
+{
+	return &s_scalarKernels;
+}
+
+
+
+static bool cpuSupports( const MixKernels * k )
+{
+	if( k == NULL )
+	{
+		return false;
+	}
+#if defined( __GNUC__ ) && ( defined( __i386__ ) || defined( __x86_64__ ) )
+	if( k == avx2Kernels() )
+	{
+		return __builtin_cpu_supports( "avx2" );
+	}
+	if( k == sse2Kernels() )
+	{
+		return __builtin_cpu_supports( "sse2" );
+	}
+#endif
+	return true;
+}
+
+
+
+int numKernels()
+{
+	int n = 0;
+	for( int i = 0; kernels( i ) != NULL; ++i )
+	{
+		++n;
+	}
+	return n;
+}
+
+
+
+const MixKernels * kernels( int index )
+{
+	// ordered by preference, least preferred first
+	const MixKernels * all[] =
+	{
+		scalarKernels(), sse2Kernels(), neonKernels(), avx2Kernels()
+	} ;
+
+	for( unsigned int i = 0; i < sizeof( all ) / sizeof( all[0] ); ++i )
+	{
+		if( cpuSupports( all[i] ) && index-- == 0 )
+		{
+			return all[i];
+		}
+	}
+	return NULL;
+}
+
+
+
+const MixKernels * currentKernels()
+{
+	return s_kernels;
+}
+
+
+
+void setCurrentKernels( const MixKernels * kernels )
+{
+	s_kernels = kernels ? kernels : &s_scalarKernels;
+}
+
+
+
+void init()
+{
+	setCurrentKernels( kernels( numKernels() - 1 ) );
+}
+
+
+
+const char * instructionSet()
+{
+	return s_kernels->name;
+}
+
+
+
+
+bool isSilent( const sampleFrame* src, int frames )
+{
+	return s_kernels->isSilent( src, frames );
+}
+
+
+bool sanitize( sampleFrame * src, int frames )
+{
+	return s_kernels->sanitize( src, frames );
+}
+
+
+void peak( const sampleFrame* src, int frames, float& left, float& right )
+{
+	s_kernels->peak( src, frames, &left, &right );
+}
+
+
+void rms( const sampleFrame* src, int frames, float& left, float& right )
+{
+	if( frames <= 0 )
+	{
+		left = right = 0.0f;
+		return;
+	}
+	s_kernels->sumOfSquares( src, frames, &left, &right );
+	left = sqrtf( left / frames );
+	right = sqrtf( right / frames );
+}
+
+
+void add( sampleFrame* dst, const sampleFrame* src, int frames )
+{
+	s_kernels->add( dst, src, frames );
+}
+
+
+void addMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames )
+{
+	s_kernels->addMultiplied( dst, src, coeffSrc, frames );
+}
+
+
+void addSwappedMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames )
+{
+	s_kernels->addSwappedMultiplied( dst, src, coeffSrc, frames );
+}
+
+
+void addMultipliedByBuffer( sampleFrame* dst, const sampleFrame* src, float coeffSrc, ValueBuffer * coeffSrcBuf, int frames )
+{
+	s_kernels->addMultipliedByBuffer( dst, src, coeffSrc, coeffSrcBuf->values(), frames );
+}
+
+
+void addMultipliedByBuffers( sampleFrame* dst, const sampleFrame* src, ValueBuffer * coeffSrcBuf1, ValueBuffer * coeffSrcBuf2, int frames )
+{
+	s_kernels->addMultipliedByBuffers( dst, src, coeffSrcBuf1->values(), coeffSrcBuf2->values(), frames );
+}
+
+
+void addSanitizedMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames )
+{
+	s_kernels->addSanitizedMultiplied( dst, src, coeffSrc, frames );
+}
+
+
+void addSanitizedMultipliedByBuffer( sampleFrame* dst, const sampleFrame* src, float coeffSrc, ValueBuffer * coeffSrcBuf, int frames )
+{
+	s_kernels->addSanitizedMultipliedByBuffer( dst, src, coeffSrc, coeffSrcBuf->values(), frames );
+}
+
+
+void addSanitizedMultipliedByBuffers( sampleFrame* dst, const sampleFrame* src, ValueBuffer * coeffSrcBuf1, ValueBuffer * coeffSrcBuf2, int frames )
+{
+	s_kernels->addSanitizedMultipliedByBuffers( dst, src, coeffSrcBuf1->values(), coeffSrcBuf2->values(), frames );
+}
+
+
+void addMultipliedStereo( sampleFrame* dst, const sampleFrame* src, float coeffSrcLeft, float coeffSrcRight, int frames )
+{
+	s_kernels->addMultipliedStereo( dst, src, coeffSrcLeft, coeffSrcRight, frames );
+}
+
+
+void multiplyAndAddMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffDst, float coeffSrc, int frames )
+{
+	s_kernels->multiplyAndAddMultiplied( dst, src, coeffDst, coeffSrc, frames );
+}
+
+
+void multiplyAndAddMultipliedJoined( sampleFrame* dst, const sample_t* srcLeft, const sample_t* srcRight, float coeffDst, float coeffSrc, int frames )
+{
+	s_kernels->multiplyAndAddMultipliedJoined( dst, srcLeft, srcRight, coeffDst, coeffSrc, frames );
+}
+
+
+void multiplyByBuffer( sampleFrame* dst, ValueBuffer * coeffBuf, int frames )
+{
+	s_kernels->multiplyByBuffer( dst, coeffBuf->values(), frames );
+}
+
+
+void multiplyByVolumeAndPanning( sampleFrame* dst, ValueBuffer * volBuf, float vol, ValueBuffer * panBuf, float pan, int frames )
+{
+	s_kernels->multiplyByVolumeAndPanning( dst, volBuf ? volBuf->values() : NULL, vol,
+						panBuf ? panBuf->values() : NULL, pan, frames );
+}
+
+
+void addMultipliedByGains( sampleFrame* dst, const sampleFrame* src,
+				float gain1, ValueBuffer * gainBuf1,
+				float gain2, ValueBuffer * gainBuf2,
+				bool sanitized, int frames )
+{
+	if( gainBuf1 && gainBuf2 )
+	{
+		if( sanitized ) { addSanitizedMultipliedByBuffers( dst, src, gainBuf1, gainBuf2, frames ); }
+		else { addMultipliedByBuffers( dst, src, gainBuf1, gainBuf2, frames ); }
+	}
+	else if( gainBuf1 )
+	{
+		if( sanitized ) { addSanitizedMultipliedByBuffer( dst, src, gain2, gainBuf1, frames ); }
+		else { addMultipliedByBuffer( dst, src, gain2, gainBuf1, frames ); }
+	}
+	else if( gainBuf2 )
+	{
+		if( sanitized ) { addSanitizedMultipliedByBuffer( dst, src, gain1, gainBuf2, frames ); }
+		else { addMultipliedByBuffer( dst, src, gain1, gainBuf2, frames ); }
+	}
+	else
+	{
+		if( sanitized ) { addSanitizedMultiplied( dst, src, gain1 * gain2, frames ); }
+		else { addMultiplied( dst, src, gain1 * gain2, frames ); }
+	}
+}
+
 }
 
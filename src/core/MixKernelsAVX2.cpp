@@ -0,0 +1,122 @@
+/*
+ * MixKernelsAVX2.cpp - AVX2 implementation of MixHelpers
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "MixKernels.h"
+
+// compiled with -mavx2 but without -mfma - fused multiply-adds would give
+// results different from the scalar reference
+#ifdef __AVX2__
+
+#include <immintrin.h>
+
+#include "MixKernelsImpl.h"
+
+
+namespace
+{
+
+struct AVX2Vector
+{
+	typedef __m256 Vec;
+	enum { Width = 8 };
+
+	static Vec load( const float * p ) { return _mm256_loadu_ps( p ); }
+	static void store( float * p, Vec a ) { _mm256_storeu_ps( p, a ); }
+	static Vec set1( float x ) { return _mm256_set1_ps( x ); }
+	static Vec setPair( float l, float r ) { return _mm256_setr_ps( l, r, l, r, l, r, l, r ); }
+
+	static Vec add( Vec a, Vec b ) { return _mm256_add_ps( a, b ); }
+	static Vec sub( Vec a, Vec b ) { return _mm256_sub_ps( a, b ); }
+	static Vec mul( Vec a, Vec b ) { return _mm256_mul_ps( a, b ); }
+	// vmaxps returns its second operand if any of them is NaN
+	static Vec maxOf( Vec a, Vec acc ) { return _mm256_max_ps( a, acc ); }
+	static Vec abs( Vec a ) { return _mm256_andnot_ps( _mm256_set1_ps( -0.0f ), a ); }
+
+	static Vec notAbove( Vec a, Vec b, Vec x, Vec y )
+	{
+		return _mm256_blendv_ps( y, x, _mm256_cmp_ps( a, b, _CMP_LE_OQ ) );
+	}
+
+	static Vec finiteMask( Vec a )
+	{
+		return _mm256_cmp_ps( abs( a ), _mm256_set1_ps( FLT_MAX ), _CMP_LE_OQ );
+	}
+
+	static Vec finite( Vec a, Vec ref ) { return _mm256_and_ps( finiteMask( ref ), a ); }
+
+	static bool anyNonFinite( Vec a )
+	{
+		return _mm256_movemask_ps( finiteMask( a ) ) != 0xff;
+	}
+
+	static bool anyNotBelow( Vec a, Vec t )
+	{
+		return _mm256_movemask_ps( _mm256_cmp_ps( abs( a ), t, _CMP_GE_OQ ) ) != 0;
+	}
+
+	static Vec dupPairs( const float * p )
+	{
+		return _mm256_permutevar8x32_ps(
+				_mm256_castps128_ps256( _mm_loadu_ps( p ) ),
+				_mm256_setr_epi32( 0, 0, 1, 1, 2, 2, 3, 3 ) );
+	}
+
+	static Vec swapPairs( Vec a )
+	{
+		return _mm256_permute_ps( a, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+	}
+
+	static void interleave( const float * l, const float * r, Vec & lo, Vec & hi )
+	{
+		// unpack works within 128 bit lanes, so put lanes in order
+		// afterwards
+		const Vec vl = load( l );
+		const Vec vr = load( r );
+		const Vec a = _mm256_unpacklo_ps( vl, vr );
+		const Vec b = _mm256_unpackhi_ps( vl, vr );
+		lo = _mm256_permute2f128_ps( a, b, 0x20 );
+		hi = _mm256_permute2f128_ps( a, b, 0x31 );
+	}
+} ;
+
+
+const MixKernels s_avx2Kernels = MIX_KERNELS_TABLE( "AVX2", MixKernelsImpl<AVX2Vector> );
+
+}
+
+
+const MixKernels * MixHelpers::avx2Kernels()
+{
+	return &s_avx2Kernels;
+}
+
+
+#else
+
+
+const MixKernels * MixHelpers::avx2Kernels()
+{
+	return NULL;
+}
+
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ * MixKernelsNEON.cpp - NEON implementation of MixHelpers
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "MixKernels.h"
+
+// NEON is always available on AArch64 - 32 bit ARM lacks some of the
+// instructions used (and IEEE compliant NEON arithmetic), so it keeps using
+// the scalar reference
+#ifdef __aarch64__
+
+#include <arm_neon.h>
+
+#include "MixKernelsImpl.h"
+
+
+namespace
+{
+
+struct NEONVector
+{
+	typedef float32x4_t Vec;
+	enum { Width = 4 };
+
+	static Vec load( const float * p ) { return vld1q_f32( p ); }
+	static void store( float * p, Vec a ) { vst1q_f32( p, a ); }
+	static Vec set1( float x ) { return vdupq_n_f32( x ); }
+
+	static Vec setPair( float l, float r )
+	{
+		const float pair[4] = { l, r, l, r };
+		return vld1q_f32( pair );
+	}
+
+	static Vec add( Vec a, Vec b ) { return vaddq_f32( a, b ); }
+	static Vec sub( Vec a, Vec b ) { return vsubq_f32( a, b ); }
+	static Vec mul( Vec a, Vec b ) { return vmulq_f32( a, b ); }
+	// fmaxnm ignores NaNs
+	static Vec maxOf( Vec a, Vec acc ) { return vmaxnmq_f32( a, acc ); }
+	static Vec abs( Vec a ) { return vabsq_f32( a ); }
+
+	static Vec notAbove( Vec a, Vec b, Vec x, Vec y )
+	{
+		return vbslq_f32( vcleq_f32( a, b ), x, y );
+	}
+
+	static uint32x4_t finiteMask( Vec a )
+	{
+		return vcleq_f32( vabsq_f32( a ), vdupq_n_f32( FLT_MAX ) );
+	}
+
+	static Vec finite( Vec a, Vec ref )
+	{
+		return vreinterpretq_f32_u32( vandq_u32( finiteMask( ref ),
+						vreinterpretq_u32_f32( a ) ) );
+	}
+
+	static bool anyNonFinite( Vec a )
+	{
+		return vminvq_u32( finiteMask( a ) ) == 0;
+	}
+
+	static bool anyNotBelow( Vec a, Vec t )
+	{
+		return vmaxvq_u32( vcgeq_f32( vabsq_f32( a ), t ) ) != 0;
+	}
+
+	static Vec dupPairs( const float * p )
+	{
+		const float32x2_t x = vld1_f32( p );
+		const Vec xx = vcombine_f32( x, x );
+		return vzip1q_f32( xx, xx );
+	}
+
+	static Vec swapPairs( Vec a ) { return vrev64q_f32( a ); }
+
+	static void interleave( const float * l, const float * r, Vec & lo, Vec & hi )
+	{
+		const Vec vl = load( l );
+		const Vec vr = load( r );
+		lo = vzip1q_f32( vl, vr );
+		hi = vzip2q_f32( vl, vr );
+	}
+} ;
+
+
+const MixKernels s_neonKernels = MIX_KERNELS_TABLE( "NEON", MixKernelsImpl<NEONVector> );
+
+}
+
+
+const MixKernels * MixHelpers::neonKernels()
+{
+	return &s_neonKernels;
+}
+
+
+#else
+
+
+const MixKernels * MixHelpers::neonKernels()
+{
+	return NULL;
+}
+
+
+#endif
@@ -0,0 +1,116 @@
+/*
+ * MixKernelsSSE2.cpp - SSE2 implementation of MixHelpers
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "MixKernels.h"
+
+#ifdef __SSE2__
+
+#include <emmintrin.h>
+
+#include "MixKernelsImpl.h"
+
+
+namespace
+{
+
+struct SSE2Vector
+{
+	typedef __m128 Vec;
+	enum { Width = 4 };
+
+	static Vec load( const float * p ) { return _mm_loadu_ps( p ); }
+	static void store( float * p, Vec a ) { _mm_storeu_ps( p, a ); }
+	static Vec set1( float x ) { return _mm_set1_ps( x ); }
+	static Vec setPair( float l, float r ) { return _mm_setr_ps( l, r, l, r ); }
+
+	static Vec add( Vec a, Vec b ) { return _mm_add_ps( a, b ); }
+	static Vec sub( Vec a, Vec b ) { return _mm_sub_ps( a, b ); }
+	static Vec mul( Vec a, Vec b ) { return _mm_mul_ps( a, b ); }
+	// maxps returns its second operand if any of them is NaN
+	static Vec maxOf( Vec a, Vec acc ) { return _mm_max_ps( a, acc ); }
+	static Vec abs( Vec a ) { return _mm_andnot_ps( _mm_set1_ps( -0.0f ), a ); }
+
+	static Vec notAbove( Vec a, Vec b, Vec x, Vec y )
+	{
+		const Vec m = _mm_cmple_ps( a, b );
+		return _mm_or_ps( _mm_and_ps( m, x ), _mm_andnot_ps( m, y ) );
+	}
+
+	static Vec finiteMask( Vec a )
+	{
+		return _mm_cmple_ps( abs( a ), _mm_set1_ps( FLT_MAX ) );
+	}
+
+	static Vec finite( Vec a, Vec ref ) { return _mm_and_ps( finiteMask( ref ), a ); }
+
+	static bool anyNonFinite( Vec a )
+	{
+		return _mm_movemask_ps( finiteMask( a ) ) != 0xf;
+	}
+
+	static bool anyNotBelow( Vec a, Vec t )
+	{
+		return _mm_movemask_ps( _mm_cmpge_ps( abs( a ), t ) ) != 0;
+	}
+
+	static Vec dupPairs( const float * p )
+	{
+		const Vec x = _mm_loadl_pi( _mm_setzero_ps(), (const __m64 *) p );
+		return _mm_unpacklo_ps( x, x );
+	}
+
+	static Vec swapPairs( Vec a )
+	{
+		return _mm_shuffle_ps( a, a, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+	}
+
+	static void interleave( const float * l, const float * r, Vec & lo, Vec & hi )
+	{
+		const Vec vl = load( l );
+		const Vec vr = load( r );
+		lo = _mm_unpacklo_ps( vl, vr );
+		hi = _mm_unpackhi_ps( vl, vr );
+	}
+} ;
+
+
+const MixKernels s_sse2Kernels = MIX_KERNELS_TABLE( "SSE2", MixKernelsImpl<SSE2Vector> );
+
+}
+
+
+const MixKernels * MixHelpers::sse2Kernels()
+{
+	return &s_sse2Kernels;
+}
+
+
+#else
+
+
+const MixKernels * MixHelpers::sse2Kernels()
+{
+	return NULL;
+}
+
+
+#endif
@@ -27,6 +27,7 @@
 #include "AudioPort.h"
 #include "FxMixer.h"
 #include "MixerWorkerThread.h"
+#include "MixHelpers.h"
 #include "Song.h"
 #include "EnvelopeAndLfoParameters.h"
 #include "NotePlayHandle.h"
@@ -54,6 +55,9 @@
 
 #include "MemoryHelper.h"
 #include "BufferManager.h"
+#include "RealtimeGuard.h"
+#include "RenderTrace.h"
+#include "ValueBufferArena.h"
 
 
 
@@ -67,12 +71,18 @@ Mixer::Mixer() :
 	m_workers(),
 	m_numWorkers( QThread::idealThreadCount()-1 ),
 	m_queueReadyWaitCond(),
+	m_playHandles(),
+	m_newPlayHandles( 0 ),
+	m_playHandlesToRemove( 1 ),
+	m_clearPlayHandles( 0 ),
 	m_qualitySettings( qualitySettings::Mode_Draft ),
 	m_masterGain( 1.0f ),
 	m_audioDev( NULL ),
 	m_oldAudioDev( NULL ),
 	m_globalMutex( QMutex::Recursive ),
-	m_profiler()
+	m_profiler(),
+	m_pluginLatencyMutex(),
+	m_pluginLatencies()
 {
 	for( int i = 0; i < 2; ++i )
 	{
@@ -82,11 +92,13 @@ Mixer::Mixer() :
 		clearAudioBuffer( m_inputBuffer[i], m_inputBufferSize[i] );
 	}
 
+	// number of periods the fifo holds
+	int fifoSize = 1;
+
 	// just rendering?
 	if( !Engine::hasGUI() )
 	{
 		m_framesPerPeriod = DEFAULT_BUFFER_SIZE;
-		m_fifo = new fifo( 1 );
 	}
 	else if( ConfigManager::inst()->value( "mixer", "framesperaudiobuffer"
 						).toInt() >= 32 )
@@ -97,25 +109,39 @@ Mixer::Mixer() :
 
 		if( m_framesPerPeriod > DEFAULT_BUFFER_SIZE )
 		{
-			m_fifo = new fifo( m_framesPerPeriod
-							/ DEFAULT_BUFFER_SIZE );
+			fifoSize = m_framesPerPeriod / DEFAULT_BUFFER_SIZE;
 			m_framesPerPeriod = DEFAULT_BUFFER_SIZE;
 		}
-		else
-		{
-			m_fifo = new fifo( 1 );
-		}
 	}
 	else
 	{
 		ConfigManager::inst()->setValue( "mixer",
 							"framesperaudiobuffer",
 				QString::number( m_framesPerPeriod ) );
-		m_fifo = new fifo( 1 );
 	}
 
+	// the fifo is allocated for the largest render-ahead allowed and
+	// only filled up to the current depth
+	int maxFifoSize = fifoSize;
+	if( Engine::hasGUI() && ConfigManager::inst()->value( "mixer",
+					"adaptivebuffersize" ).toInt() )
+	{
+		int maxFrames = ConfigManager::inst()->value( "mixer",
+					"maxframesperaudiobuffer" ).toInt();
+		if( maxFrames <= 0 )
+		{
+			maxFrames = DEFAULT_MAX_ADAPTIVE_BUFFER_SIZE;
+		}
+		maxFifoSize = qMax( fifoSize, maxFrames / m_framesPerPeriod );
+	}
+
+	m_fifo = new fifo( maxFifoSize, m_framesPerPeriod );
+	m_renderAhead = new RenderAheadController( fifoSize, maxFifoSize );
+	m_fifo->setDepth( m_renderAhead->depth() );
+
 	// now that framesPerPeriod is fixed initialize global BufferManager
 	BufferManager::init( m_framesPerPeriod );
+	ValueBufferArena::reset();
 
 	m_workingBuf = (sampleFrame*) MemoryHelper::alignedMalloc( m_framesPerPeriod *
 							sizeof( sampleFrame ) );
@@ -161,11 +187,8 @@ Mixer::~Mixer()
 		m_workers[w]->wait( 500 );
 	}
 
-	while( m_fifo->available() )
-	{
-		delete[] m_fifo->read();
-	}
 	delete m_fifo;
+	delete m_renderAhead;
 
 	delete m_audioDev;
 	delete m_midiClient;
@@ -181,6 +204,10 @@ Mixer::~Mixer()
 	{
 		delete[] m_inputBuffer[i];
 	}
+
+#ifdef LMMS_DEBUG
+	BufferManager::dumpOutstandingBuffers();
+#endif
 }
 
 
@@ -273,6 +300,42 @@ sample_rate_t Mixer::processingSampleRate() const
 
 
 
+void Mixer::addPluginLatency( f_cnt_t _frames )
+{
+	QMutexLocker lock( &m_pluginLatencyMutex );
+	m_pluginLatencies.push_back( _frames );
+}
+
+
+
+
+void Mixer::removePluginLatency( f_cnt_t _frames )
+{
+	QMutexLocker lock( &m_pluginLatencyMutex );
+	const int i = m_pluginLatencies.indexOf( _frames );
+	if( i >= 0 )
+	{
+		m_pluginLatencies.remove( i );
+	}
+}
+
+
+
+
+f_cnt_t Mixer::pluginLatency() const
+{
+	QMutexLocker lock( &m_pluginLatencyMutex );
+	f_cnt_t latency = 0;
+	for( int i = 0; i < m_pluginLatencies.size(); ++i )
+	{
+		latency = qMax( latency, m_pluginLatencies[i] );
+	}
+	return latency;
+}
+
+
+
+
 bool Mixer::criticalXRuns() const
 {
 	return cpuLoad() >= 99 && Engine::getSong()->isExporting() == false;
@@ -314,6 +377,8 @@ void Mixer::pushInputFrames( sampleFrame * _ab, const f_cnt_t _frames )
 const surroundSampleFrame * Mixer::renderNextBuffer()
 {
 	m_profiler.startPeriod();
+	RealtimeGuard::startPeriod();
+	qint64 traceStart = RenderTrace::start();
 
 	static Song::playPos last_metro_pos = -1;
 
@@ -343,28 +408,9 @@ const surroundSampleFrame * Mixer::renderNextBuffer()
 	m_inputBufferFrames[ m_inputBufferWrite ] = 0;
 	unlockInputFrames();
 
-	// remove all play-handles that have to be deleted and delete
-	// them if they still exist...
-	// maybe this algorithm could be optimized...
+	// remove all play-handles that have to be deleted
 	lockPlayHandleRemoval();
-	ConstPlayHandleList::Iterator it_rem = m_playHandlesToRemove.begin();
-	while( it_rem != m_playHandlesToRemove.end() )
-	{
-		PlayHandleList::Iterator it = qFind( m_playHandles.begin(), m_playHandles.end(), *it_rem );
-
-		if( it != m_playHandles.end() )
-		{
-			( *it )->audioPort()->removePlayHandle( ( *it ) );
-			if( ( *it )->type() == PlayHandle::TypeNotePlayHandle )
-			{
-				NotePlayHandleManager::release( (NotePlayHandle*) *it );
-			}
-			else delete *it;
-			m_playHandles.erase( it );
-		}
-
-		it_rem = m_playHandlesToRemove.erase( it_rem );
-	}
+	removeRequestedPlayHandles();
 	unlockPlayHandleRemoval();
 
 	// now we have to make sure no other thread does anything bad
@@ -388,18 +434,60 @@ const surroundSampleFrame * Mixer::renderNextBuffer()
 	Engine::getSong()->processNextBuffer();
 
 	// add all play-handles that have to be added
-	m_playHandleMutex.lock();
-	m_playHandles += m_newPlayHandles;
-	m_newPlayHandles.clear();
-	m_playHandleMutex.unlock();
-
-	// STAGE 1: run and render all play handles
 	lockPlayHandleRemoval();
-	MixerWorkerThread::fillJobQueue<PlayHandleList>( m_playHandles );
+	adoptNewPlayHandles();
+
+	m_profiler.finishStage( MixerProfiler::StagePrepare );
+	RenderTrace::finish( RenderTrace::CategoryStage, "prepare", traceStart );
+	traceStart = RenderTrace::start();
+
+	// build and run the render graph for this period: play handles feed
+	// their audio ports, audio ports feed their FX channel and FX channels
+	// feed the channels they send to. Every node is queued as soon as all
+	// of its inputs are done, so e.g. effects of a track can be processed
+	// while notes of other tracks are still being rendered
+	MixerWorkerThread::resetJobQueue( MixerWorkerThread::JobQueue::Dynamic );
+
+	FxMixer * fxMixer = Engine::fxMixer();
+	fxMixer->prepareChannelGraph();
+	for( QVector<AudioPort *>::ConstIterator it = m_audioPorts.begin();
+						it != m_audioPorts.end(); ++it )
+	{
+		( *it )->prepareGraph();
+		fxMixer->addChannelInput( ( *it )->graphFxChannel() );
+	}
+	fxMixer->startChannelGraph();
+
+	for( LinkedPlayHandleList::ConstIterator it = m_playHandles.begin();
+						it != m_playHandles.end(); ++it )
+	{
+		AudioPort * port = ( *it )->audioPort();
+		port->addGraphInput();
+		// handles to be removed with next period aren't played anymore
+		if( ( *it )->isRemovalRequested() ||
+				!MixerWorkerThread::addJob( *it ) )
+		{
+			// nothing to do for this play handle
+			port->graphInputDone();
+		}
+	}
+
+	// now that all play handles are registered, queue audio ports which
+	// do not wait for any play handle
+	for( QVector<AudioPort *>::ConstIterator it = m_audioPorts.begin();
+						it != m_audioPorts.end(); ++it )
+	{
+		( *it )->graphInputDone();
+	}
+
 	MixerWorkerThread::startAndWaitForJobs();
 
+	m_profiler.finishStage( MixerProfiler::StageRender );
+	RenderTrace::finish( RenderTrace::CategoryStage, "render", traceStart );
+	traceStart = RenderTrace::start();
+
 	// removed all play handles which are done
-	for( PlayHandleList::Iterator it = m_playHandles.begin();
+	for( LinkedPlayHandleList::Iterator it = m_playHandles.begin();
 						it != m_playHandles.end(); )
 	{
 		if( ( *it )->affinityMatters() &&
@@ -408,15 +496,13 @@ const surroundSampleFrame * Mixer::renderNextBuffer()
 			++it;
 			continue;
 		}
-		if( ( *it )->isFinished() )
+		// handles queued for removal are deleted when processing
+		// m_playHandlesToRemove, as they're still linked there
+		if( ( *it )->isFinished() && !( *it )->isRemovalRequested() )
 		{
-			( *it )->audioPort()->removePlayHandle( ( *it ) );
-			if( ( *it )->type() == PlayHandle::TypeNotePlayHandle )
-			{
-				NotePlayHandleManager::release( (NotePlayHandle*) *it );
-			}
-			else delete *it;
+			PlayHandle * handle = *it;
 			it = m_playHandles.erase( it );
+			deletePlayHandle( handle );
 		}
 		else
 		{
@@ -425,16 +511,15 @@ const surroundSampleFrame * Mixer::renderNextBuffer()
 	}
 	unlockPlayHandleRemoval();
 
-	// STAGE 2: process effects of all instrument- and sampletracks
-	MixerWorkerThread::fillJobQueue<QVector<AudioPort *> >( m_audioPorts );
-	MixerWorkerThread::startAndWaitForJobs();
-
-
-	// STAGE 3: do master mix in FX mixer
-	Engine::fxMixer()->masterMix( m_writeBuf );
+	// do master mix in FX mixer
+	fxMixer->masterMix( m_writeBuf );
 
 	unlock();
 
+	m_profiler.finishStage( MixerProfiler::StageMasterMix );
+	RenderTrace::finish( RenderTrace::CategoryStage, "master mix", traceStart );
+	traceStart = RenderTrace::start();
+
 
 	emit nextAudioBuffer();
 
@@ -442,11 +527,16 @@ const surroundSampleFrame * Mixer::renderNextBuffer()
 	EnvelopeAndLfoParameters::instances()->trigger();
 	Controller::triggerFrameCounter();
 	AutomatableModel::incrementPeriodCounter();
+	ValueBufferArena::reset();
 
 	// refresh buffer pool
 	BufferManager::refresh();
 
+	m_profiler.finishStage( MixerProfiler::StageFinish );
+	RenderTrace::finish( RenderTrace::CategoryStage, "finish", traceStart );
+	m_profiler.setPeriodJobs( MixerWorkerThread::finishPeriod() );
 	m_profiler.finishPeriod( processingSampleRate(), m_framesPerPeriod );
+	RealtimeGuard::finishPeriod();
 
 	return m_readBuf;
 }
@@ -459,17 +549,8 @@ const surroundSampleFrame * Mixer::renderNextBuffer()
 void Mixer::clear()
 {
 	// TODO: m_midiClient->noteOffAll();
-	lock();
-	for( PlayHandleList::Iterator it = m_playHandles.begin(); it != m_playHandles.end(); ++it )
-	{
-		// we must not delete instrument-play-handles as they exist
-		// during the whole lifetime of an instrument
-		if( ( *it )->type() != PlayHandle::TypeInstrumentPlayHandle )
-		{
-			m_playHandlesToRemove.push_back( *it );
-		}
-	}
-	unlock();
+	// done by mixer with next period, see removeRequestedPlayHandles()
+	m_clearPlayHandles.fetchAndStoreOrdered( 1 );
 }
 
 
@@ -494,27 +575,10 @@ void Mixer::clearAudioBuffer( surroundSampleFrame * _ab, const f_cnt_t _frames,
 
 
 
-float Mixer::peakValueLeft( sampleFrame * _ab, const f_cnt_t _frames )
-{
-	float p = 0.0f;
-	for( f_cnt_t f = 0; f < _frames; ++f )
-	{
-		p = qMax( p, qAbs( _ab[f][0] ) );
-	}
-	return p;
-}
-
-
-
-
-float Mixer::peakValueRight( sampleFrame * _ab, const f_cnt_t _frames )
+void Mixer::peakValues( const sampleFrame * _ab, const f_cnt_t _frames,
+						float & _left, float & _right )
 {
-	float p = 0.0f;
-	for( f_cnt_t f = 0; f < _frames; ++f )
-	{
-		p = qMax( p, qAbs( _ab[f][1] ) );
-	}
-	return p;
+	MixHelpers::peak( _ab, _frames, _left, _right );
 }
 
 
@@ -628,10 +692,7 @@ bool Mixer::addPlayHandle( PlayHandle* handle )
 {
 	if( criticalXRuns() == false )
 	{
-		m_playHandleMutex.lock();
-			m_newPlayHandles.append( handle );
-			handle->audioPort()->addPlayHandle( handle );
-		m_playHandleMutex.unlock();
+		m_newPlayHandles.push( handle );
 		return true;
 	}
 
@@ -653,24 +714,17 @@ void Mixer::removePlayHandle( PlayHandle * _ph )
 				_ph->affinity() == QThread::currentThread() )
 	{
 		lockPlayHandleRemoval();
-		_ph->audioPort()->removePlayHandle( _ph );
-		PlayHandleList::Iterator it =
-				qFind( m_playHandles.begin(),
-						m_playHandles.end(), _ph );
-		if( it != m_playHandles.end() )
+		// also adopts the handle if it's still waiting for being added
+		removeRequestedPlayHandles();
+		if( m_playHandles.remove( _ph ) )
 		{
-			m_playHandles.erase( it );
-			if( _ph->type() == PlayHandle::TypeNotePlayHandle )
-			{
-				NotePlayHandleManager::release( (NotePlayHandle*) _ph );
-			}
-			else delete _ph;
+			deletePlayHandle( _ph );
 		}
 		unlockPlayHandleRemoval();
 	}
-	else
+	else if( _ph->requestRemoval() )
 	{
-		m_playHandlesToRemove.push_back( _ph );
+		m_playHandlesToRemove.push( _ph );
 	}
 }
 
@@ -680,18 +734,17 @@ void Mixer::removePlayHandle( PlayHandle * _ph )
 void Mixer::removePlayHandles( Track * _track, bool removeIPHs )
 {
 	lockPlayHandleRemoval();
-	PlayHandleList::Iterator it = m_playHandles.begin();
+	// also catch handles of the track which are still waiting for being
+	// added or removed
+	removeRequestedPlayHandles();
+	LinkedPlayHandleList::Iterator it = m_playHandles.begin();
 	while( it != m_playHandles.end() )
 	{
 		if( ( *it )->isFromTrack( _track ) && ( removeIPHs || ( *it )->type() != PlayHandle::TypeInstrumentPlayHandle ) )
 		{
-			( *it )->audioPort()->removePlayHandle( ( *it ) );
-			if( ( *it )->type() == PlayHandle::TypeNotePlayHandle )
-			{
-				NotePlayHandleManager::release( (NotePlayHandle*) *it );
-			}
-			else delete *it;
+			PlayHandle * handle = *it;
 			it = m_playHandles.erase( it );
+			deletePlayHandle( handle );
 		}
 		else
 		{
@@ -704,11 +757,85 @@ void Mixer::removePlayHandles( Track * _track, bool removeIPHs )
 
 
 
+void Mixer::adoptNewPlayHandles()
+{
+	for( PlayHandle * handle = m_newPlayHandles.takeAll(); handle != NULL; )
+	{
+		PlayHandle * next = m_newPlayHandles.next( handle );
+		// also add handles whose removal has been requested already -
+		// they're not played but deleted when processing
+		// m_playHandlesToRemove
+		m_playHandles.append( handle );
+		handle->audioPort()->addPlayHandle( handle );
+		handle = next;
+	}
+}
+
+
+
+
+void Mixer::removeRequestedPlayHandles()
+{
+	// take the requests before adopting new handles - a handle is queued
+	// for being added before its removal can be requested, so every
+	// requested handle that has been added at all is in m_playHandles
+	// then. Anything else never got added (e.g. it has been rejected by
+	// addPlayHandle() and deleted already) and must not be touched again
+	PlayHandle * handle = m_playHandlesToRemove.takeAll();
+	adoptNewPlayHandles();
+	while( handle != NULL )
+	{
+		PlayHandle * next = m_playHandlesToRemove.next( handle );
+		if( m_playHandles.remove( handle ) )
+		{
+			deletePlayHandle( handle );
+		}
+		handle = next;
+	}
+
+	if( m_clearPlayHandles.fetchAndStoreOrdered( 0 ) )
+	{
+		for( LinkedPlayHandleList::Iterator it = m_playHandles.begin();
+							it != m_playHandles.end(); )
+		{
+			// we must not delete instrument-play-handles as they
+			// exist during the whole lifetime of an instrument
+			if( ( *it )->type() != PlayHandle::TypeInstrumentPlayHandle &&
+					!( *it )->isRemovalRequested() )
+			{
+				PlayHandle * handle = *it;
+				it = m_playHandles.erase( it );
+				deletePlayHandle( handle );
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+}
+
+
+
+
+void Mixer::deletePlayHandle( PlayHandle * handle )
+{
+	handle->audioPort()->removePlayHandle( handle );
+	if( handle->type() == PlayHandle::TypeNotePlayHandle )
+	{
+		NotePlayHandleManager::release( (NotePlayHandle*) handle );
+	}
+	else delete handle;
+}
+
+
+
+
 bool Mixer::hasNotePlayHandles()
 {
 	lock();
 
-	for( PlayHandleList::Iterator it = m_playHandles.begin(); it != m_playHandles.end(); ++it )
+	for( LinkedPlayHandleList::Iterator it = m_playHandles.begin(); it != m_playHandles.end(); ++it )
 	{
 		if( (*it)->type() == PlayHandle::TypeNotePlayHandle )
 		{
@@ -951,16 +1078,35 @@ void Mixer::fifoWriter::run()
 #endif
 #endif
 
+	RenderTrace::setThreadName( "fifoWriter" );
+
 	const fpp_t frames = m_mixer->framesPerPeriod();
+	RenderAheadController * renderAhead = m_mixer->m_renderAhead;
 	while( m_writing )
 	{
-		surroundSampleFrame * buffer = new surroundSampleFrame[frames];
 		const surroundSampleFrame * b = m_mixer->renderNextBuffer();
+
+		const MixerProfiler & profiler = m_mixer->profiler();
+		const int depth = renderAhead->update( profiler.periodTime(),
+						profiler.deadline(),
+						m_fifo->underruns() );
+		if( depth != m_fifo->depth() )
+		{
+			m_fifo->setDepth( depth );
+		}
+
+		// blocks while the fifo is full
+		const qint64 traceStart = RenderTrace::start();
+		surroundSampleFrame * buffer = m_fifo->waitForWriteBuffer();
+		RenderTrace::finish( RenderTrace::CategoryFifo, "push", traceStart );
+
 		memcpy( buffer, b, frames * sizeof( surroundSampleFrame ) );
-		m_fifo->write( buffer );
+		m_fifo->push();
 	}
 
-	m_fifo->write( NULL );
+	// let the audio device know we're done
+	m_fifo->waitForWriteBuffer();
+	m_fifo->push( true );
 }
 
 
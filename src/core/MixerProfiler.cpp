@@ -24,12 +24,50 @@
 
 #include "MixerProfiler.h"
 
+#include <QtCore/QMutexLocker>
+#include <cstring>
+
+
+static const char * nodeTypeNames[MixerProfiler::NumNodeTypes] =
+{
+	"playhandles", "port", "effect", "fxchannel"
+} ;
+
 
 MixerProfiler::MixerProfiler() :
 	m_periodTimer(),
+	m_stageTimer(),
+	m_periodTime( 0 ),
+	m_deadline( 0 ),
 	m_cpuLoad( 0 ),
-	m_outputFile()
+	m_periodJobs( 0 ),
+	m_jobsHighWaterMark( 0 ),
+	m_periodStartAllocations( 0 ),
+	m_periodAllocations( 0 ),
+	m_outputFile(),
+	m_nodeProfiling( false ),
+	m_periodStartTicks( 0 ),
+	m_period( 0 ),
+	m_nodeMutex(),
+	m_nodeCount( 0 ),
+	m_historyWritten( 0 ),
+	m_nodeOutputFile(),
+	m_nodeOutputTrace( false )
 {
+	for( int i = 0; i < NumStages; ++i )
+	{
+		m_stageTimes[i] = 0;
+	}
+	for( int i = 0; i < NumNodeTypes; ++i )
+	{
+		m_activeNodes[i] = m_silentNodes[i] = 0;
+	}
+	for( int i = 0; i < MaxNodes; ++i )
+	{
+		m_nodeUsed[i] = false;
+	}
+	resetNodeStats();
+	memset( m_history, 0, sizeof( m_history ) );
 }
 
 
@@ -42,6 +80,15 @@ MixerProfiler::~MixerProfiler()
 void MixerProfiler::finishPeriod( sample_rate_t sampleRate, fpp_t framesPerPeriod )
 {
 	int periodElapsed = m_periodTimer.elapsed();
+	m_periodTime = periodElapsed;
+	m_deadline = (int)( framesPerPeriod * 1000000LL / sampleRate );
+	m_periodAllocations = MemoryManager::allocations() - m_periodStartAllocations;
+
+	for( int i = 0; i < NumNodeTypes; ++i )
+	{
+		m_activeNodes[i] = m_activeNodeCounters[i].fetchAndStoreOrdered( 0 );
+		m_silentNodes[i] = m_silentNodeCounters[i].fetchAndStoreOrdered( 0 );
+	}
 
 	const float newCpuLoad = periodElapsed / 10000.0f * sampleRate / framesPerPeriod;
     m_cpuLoad = qBound<int>( 0, ( newCpuLoad * 0.1f + m_cpuLoad * 0.9f ), 100 );
@@ -50,6 +97,85 @@ void MixerProfiler::finishPeriod( sample_rate_t sampleRate, fpp_t framesPerPerio
 	{
 		m_outputFile.write( QString( "%1\n" ).arg( periodElapsed ).toLatin1() );
 	}
+
+	// skip the period node profiling was enabled in
+	if( m_nodeProfiling && m_periodStartTicks != 0 )
+	{
+		finishNodePeriod( periodElapsed, m_deadline );
+	}
+	++m_period;
+}
+
+
+
+
+void MixerProfiler::finishNodePeriod( int periodTime, int deadline )
+{
+	// only taken while node profiling is enabled, the GUI holds it just
+	// for copying statistics
+	QMutexLocker lock( &m_nodeMutex );
+
+	const qint64 periodTicks = ticks() - m_periodStartTicks;
+	const double usPerTick = periodTicks > 0 ?
+					(double) periodTime / periodTicks : 0;
+
+	const int index = m_historyWritten.fetchAndAddOrdered( 0 );
+	PeriodRecord & record = m_history[index % HistoryLength];
+	record.period = m_period;
+	record.periodTime = periodTime;
+	record.deadline = deadline;
+	for( int i = 0; i < TopNodes; ++i )
+	{
+		record.nodes[i] = -1;
+		record.nodeTimes[i] = 0;
+	}
+
+	for( int node = 0; node < m_nodeCount; ++node )
+	{
+		const int nodeTicks = m_nodeTicks[node].fetchAndStoreOrdered( 0 );
+		NodeStats & s = m_nodeStats[node];
+		if( nodeTicks == 0 || !m_nodeUsed[node] )
+		{
+			s.lastTime = 0;
+			continue;
+		}
+
+		const int t = (int)( nodeTicks * usPerTick );
+		s.lastTime = t;
+		s.minTime = s.periods ? qMin( s.minTime, t ) : t;
+		s.maxTime = qMax( s.maxTime, t );
+		s.totalTime += t;
+		++s.periods;
+
+		// keep most expensive nodes sorted in record
+		for( int i = 0; i < TopNodes; ++i )
+		{
+			if( record.nodes[i] < 0 || t > record.nodeTimes[i] )
+			{
+				for( int j = TopNodes - 1; j > i; --j )
+				{
+					record.nodes[j] = record.nodes[j-1];
+					record.nodeTimes[j] = record.nodeTimes[j-1];
+				}
+				record.nodes[i] = node;
+				record.nodeTimes[i] = t;
+				break;
+			}
+		}
+	}
+
+	if( periodTime > deadline && record.nodes[0] >= 0 )
+	{
+		++m_nodeStats[record.nodes[0]].xruns;
+	}
+
+	// publish record
+	m_historyWritten.fetchAndAddOrdered( 1 );
+
+	if( m_nodeOutputFile.isOpen() && m_nodeOutputTrace )
+	{
+		writeTraceRecord( record );
+	}
 }
 
 
@@ -61,3 +187,245 @@ void MixerProfiler::setOutputFile( const QString& outputFile )
 	m_outputFile.open( QFile::WriteOnly | QFile::Truncate );
 }
 
+
+
+
+
+int MixerProfiler::registerNode( NodeType type, const QString & name )
+{
+	QMutexLocker lock( &m_nodeMutex );
+
+	for( int node = 0; node < MaxNodes; ++node )
+	{
+		if( m_nodeUsed[node] == false )
+		{
+			NodeStats & s = m_nodeStats[node];
+			s.name = name;
+			s.type = type;
+			s.periods = s.lastTime = s.minTime = s.maxTime = s.xruns = 0;
+			s.totalTime = 0;
+			m_nodeTicks[node].fetchAndStoreOrdered( 0 );
+			m_nodeUsed[node] = true;
+			m_nodeCount = qMax( m_nodeCount, node + 1 );
+			return node;
+		}
+	}
+
+	// too many nodes - don't time this one
+	return -1;
+}
+
+
+
+
+void MixerProfiler::unregisterNode( int node )
+{
+	if( node < 0 )
+	{
+		return;
+	}
+
+	QMutexLocker lock( &m_nodeMutex );
+	m_nodeUsed[node] = false;
+	m_nodeStats[node].name = QString();
+}
+
+
+
+
+void MixerProfiler::setNodeName( int node, const QString & name )
+{
+	if( node < 0 )
+	{
+		return;
+	}
+
+	QMutexLocker lock( &m_nodeMutex );
+	m_nodeStats[node].name = name;
+}
+
+
+
+
+void MixerProfiler::setNodeProfiling( bool enabled )
+{
+	if( enabled && !m_nodeProfiling )
+	{
+		// period currently running isn't timed completely
+		m_periodStartTicks = 0;
+		for( int node = 0; node < MaxNodes; ++node )
+		{
+			m_nodeTicks[node].fetchAndStoreOrdered( 0 );
+		}
+	}
+	m_nodeProfiling = enabled;
+}
+
+
+
+
+void MixerProfiler::resetNodeStats()
+{
+	QMutexLocker lock( &m_nodeMutex );
+
+	for( int node = 0; node < MaxNodes; ++node )
+	{
+		NodeStats & s = m_nodeStats[node];
+		s.periods = s.lastTime = s.minTime = s.maxTime = s.xruns = 0;
+		s.totalTime = 0;
+	}
+}
+
+
+
+
+MixerProfiler::NodeStats MixerProfiler::nodeStats( int node ) const
+{
+	QMutexLocker lock( &m_nodeMutex );
+	return m_nodeStats[node];
+}
+
+
+
+
+QList<int> MixerProfiler::nodes() const
+{
+	QMutexLocker lock( &m_nodeMutex );
+
+	QList<int> n;
+	for( int node = 0; node < m_nodeCount; ++node )
+	{
+		if( m_nodeUsed[node] )
+		{
+			n << node;
+		}
+	}
+	return n;
+}
+
+
+
+
+int MixerProfiler::readHistory( int & cursor, PeriodRecord * records, int maxRecords ) const
+{
+	// the writer might be filling the record after the last one written,
+	// so only HistoryLength - 1 records are valid at once
+	const int valid = HistoryLength - 1;
+
+	const int written = m_historyWritten.fetchAndAddOrdered( 0 );
+	if( written - cursor > valid )
+	{
+		cursor = written - valid;
+	}
+
+	int n = 0;
+	for( ; cursor < written && n < maxRecords; ++cursor, ++n )
+	{
+		records[n] = m_history[cursor % HistoryLength];
+	}
+
+	// drop records which were overwritten while copying them
+	const int firstCopied = cursor - n;
+	const int oldestValid = m_historyWritten.fetchAndAddOrdered( 0 ) - valid;
+	if( firstCopied < oldestValid )
+	{
+		const int dropped = qMin( oldestValid - firstCopied, n );
+		memmove( records, records + dropped, ( n - dropped ) * sizeof( PeriodRecord ) );
+		n -= dropped;
+	}
+
+	return n;
+}
+
+
+
+
+void MixerProfiler::setNodeOutputFile( const QString & outputFile )
+{
+	finishNodeOutput();
+
+	m_nodeOutputFile.setFileName( outputFile );
+	if( m_nodeOutputFile.open( QFile::WriteOnly | QFile::Truncate ) )
+	{
+		m_nodeOutputTrace = outputFile.endsWith( ".json" );
+		if( m_nodeOutputTrace )
+		{
+			m_nodeOutputFile.write( "[\n" );
+		}
+		setNodeProfiling( true );
+	}
+}
+
+
+
+
+static QString jsonString( QString s )
+{
+	return "\"" + s.replace( "\\", "\\\\" ).replace( "\"", "\\\"" ) + "\"";
+}
+
+
+
+
+static QString csvString( QString s )
+{
+	return "\"" + s.replace( "\"", "\"\"" ) + "\"";
+}
+
+
+
+
+void MixerProfiler::writeTraceRecord( const PeriodRecord & record )
+{
+	// one counter event per period with the times of the most expensive
+	// nodes, stamped with the audio time of the period
+	QString args = "\"period\":" + QString::number( record.periodTime );
+	for( int i = 0; i < TopNodes && record.nodes[i] >= 0; ++i )
+	{
+		const NodeStats & s = m_nodeStats[record.nodes[i]];
+		args += "," + jsonString( QString( nodeTypeNames[s.type] ) + " " +
+				s.name + " #" + QString::number( record.nodes[i] ) ) +
+			":" + QString::number( record.nodeTimes[i] );
+	}
+
+	const QString event = "{\"name\":\"nodes (us)\",\"ph\":\"C\",\"pid\":1,"
+				"\"ts\":" + QString::number( (qint64) record.period * record.deadline ) +
+				",\"args\":{" + args + "}}\n";
+
+	// no comma before the first event
+	m_nodeOutputFile.write( ( m_nodeOutputFile.pos() > 2 ? "," : "" ) + event.toUtf8() );
+}
+
+
+
+
+void MixerProfiler::finishNodeOutput()
+{
+	if( !m_nodeOutputFile.isOpen() )
+	{
+		return;
+	}
+
+	if( m_nodeOutputTrace )
+	{
+		m_nodeOutputFile.write( "]\n" );
+	}
+	else
+	{
+		m_nodeOutputFile.write( "type,name,periods,min_us,avg_us,max_us,total_us,xruns\n" );
+		foreach( int node, nodes() )
+		{
+			const NodeStats s = nodeStats( node );
+			m_nodeOutputFile.write( ( QString( nodeTypeNames[s.type] ) + "," +
+				csvString( s.name ) + "," +
+				QString::number( s.periods ) + "," +
+				QString::number( s.minTime ) + "," +
+				QString::number( s.periods ? s.totalTime / s.periods : 0 ) + "," +
+				QString::number( s.maxTime ) + "," +
+				QString::number( s.totalTime ) + "," +
+				QString::number( s.xruns ) + "\n" ).toUtf8() );
+		}
+	}
+
+	m_nodeOutputFile.close();
+}
@@ -28,6 +28,9 @@
 #include <QWaitCondition>
 #include "ThreadableJob.h"
 #include "Mixer.h"
+#include "ConfigManager.h"
+#include "RealtimeGuard.h"
+#include "RenderTrace.h"
 
 #ifdef __SSE__
 #include <xmmintrin.h>
@@ -39,6 +42,102 @@
 MixerWorkerThread::JobQueue MixerWorkerThread::globalJobQueue;
 QWaitCondition * MixerWorkerThread::queueReadyWaitCond = NULL;
 QList<MixerWorkerThread *> MixerWorkerThread::workerThreads;
+bool MixerWorkerThread::s_workStealing = true;
+MixerWorkerThread::JobQueue::OperationMode MixerWorkerThread::s_opMode =
+							MixerWorkerThread::JobQueue::Static;
+QAtomicInt MixerWorkerThread::s_pendingJobs = 0;
+QAtomicInt MixerWorkerThread::s_jobsHighWaterMark = 0;
+int MixerWorkerThread::s_lastPeriodJobs = 0;
+
+
+
+static inline void relaxCpu()
+{
+#if defined(LMMS_HOST_X86) || defined(LMMS_HOST_X86_64)
+	asm( "pause" );
+#endif
+}
+
+
+
+// deque indices are allowed to wrap around so do all index arithmetic unsigned
+static inline int indexDistance( int _from, int _to )
+{
+	return (int)( (unsigned int) _to - (unsigned int) _from );
+}
+
+
+
+static inline int nextIndex( int _index, int _delta )
+{
+	return (int)( (unsigned int) _index + (unsigned int) _delta );
+}
+
+
+
+// implementation of segmented job storage
+MixerWorkerThread::JobSegments::JobSegments()
+{
+	// always have the first segment so the common case never allocates
+	reserve( JOB_SEGMENT_SIZE );
+}
+
+
+
+
+MixerWorkerThread::JobSegments::~JobSegments()
+{
+	for( int i = 0; i < JOB_MAX_SEGMENTS; ++i )
+	{
+		delete[] m_segments[i].fetchAndStoreOrdered( NULL );
+	}
+}
+
+
+
+
+MixerWorkerThread::JobSlot * MixerWorkerThread::JobSegments::slot( int _index,
+							bool _allocate )
+{
+	const int s = _index / JOB_SEGMENT_SIZE;
+	if( _index < 0 || s >= JOB_MAX_SEGMENTS )
+	{
+		return NULL;
+	}
+
+	JobSlot * segment = m_segments[s];
+	if( segment == NULL && _allocate )
+	{
+		// several threads might try to add the same segment - the one
+		// losing the race simply discards its allocation
+		JobSlot * newSegment = new JobSlot[JOB_SEGMENT_SIZE];
+		if( m_segments[s].testAndSetOrdered( NULL, newSegment ) )
+		{
+			segment = newSegment;
+		}
+		else
+		{
+			delete[] newSegment;
+			segment = m_segments[s];
+		}
+	}
+
+	return segment ? segment + _index % JOB_SEGMENT_SIZE : NULL;
+}
+
+
+
+
+void MixerWorkerThread::JobSegments::reserve( int _jobs )
+{
+	const int segments = qMin( ( _jobs + JOB_SEGMENT_SIZE - 1 ) /
+						JOB_SEGMENT_SIZE, JOB_MAX_SEGMENTS );
+	for( int s = 0; s < segments; ++s )
+	{
+		slot( s * JOB_SEGMENT_SIZE, true );
+	}
+}
+
 
 
 
@@ -53,15 +152,30 @@ void MixerWorkerThread::JobQueue::reset( OperationMode _opMode )
 
 
 
-void MixerWorkerThread::JobQueue::addJob( ThreadableJob * _job )
+bool MixerWorkerThread::JobQueue::addJob( ThreadableJob * _job )
 {
 	if( _job->requiresProcessing() )
 	{
 		// update job state
 		_job->queue();
-		// actually queue the job via atomic operations
-		m_items[m_queueSize.fetchAndAddOrdered(1)] = _job;
+		// actually queue the job via atomic operations - storage is
+		// grown in between periods only
+		JobSlot * slot = m_items.slot( m_queueSize.fetchAndAddOrdered( 1 ),
+									false );
+		if( slot )
+		{
+			*slot = _job;
+		}
+		else
+		{
+			// maximum queue size exceeded - rather than dropping the
+			// job process it right away
+			_job->process();
+			m_itemsDone.fetchAndAddOrdered( 1 );
+		}
+		return true;
 	}
+	return false;
 }
 
 
@@ -74,7 +188,9 @@ void MixerWorkerThread::JobQueue::run()
 		processedJob = false;
 		for( int i = 0; i < m_queueSize; ++i )
 		{
-			ThreadableJob * job = m_items[i].fetchAndStoreOrdered( NULL );
+			JobSlot * slot = m_items.slot( i, false );
+			ThreadableJob * job = slot ?
+					slot->fetchAndStoreOrdered( NULL ) : NULL;
 			if( job )
 			{
 				job->process();
@@ -92,11 +208,119 @@ void MixerWorkerThread::JobQueue::run()
 
 void MixerWorkerThread::JobQueue::wait()
 {
+	RenderTraceScope trace( RenderTrace::CategoryWait, "barrier" );
 	while( (int) m_itemsDone < (int) m_queueSize )
 	{
-#if defined(LMMS_HOST_X86) || defined(LMMS_HOST_X86_64)
-		asm( "pause" );
-#endif
+		relaxCpu();
+	}
+}
+
+
+
+
+// implementation of work-stealing deque (Chase-Lev)
+MixerWorkerThread::JobDeque::JobDeque() :
+	m_items(),
+	m_capacity( JOB_SEGMENT_SIZE ),
+	m_top( 0 ),
+	m_bottom( 0 )
+{
+}
+
+
+
+
+bool MixerWorkerThread::JobDeque::push( ThreadableJob * _job )
+{
+	const int b = m_bottom;
+	const int t = m_top;
+	const int capacity = m_capacity;
+	if( indexDistance( t, b ) >= capacity )
+	{
+		return false;
+	}
+	m_items.slot( b & ( capacity - 1 ), false )->fetchAndStoreRelease( _job );
+	m_bottom.fetchAndStoreRelease( nextIndex( b, 1 ) );
+	return true;
+}
+
+
+
+
+void MixerWorkerThread::JobDeque::reserve( int _jobs )
+{
+	int capacity = m_capacity;
+	// thieves might still be looking at the old index mapping but as long
+	// as we're empty, m_top has moved past what they've read and their
+	// attempt will fail anyway
+	if( capacity >= _jobs ||
+		indexDistance( m_top.fetchAndAddOrdered( 0 ), m_bottom ) > 0 )
+	{
+		return;
+	}
+
+	while( capacity < _jobs &&
+			capacity < JOB_SEGMENT_SIZE * JOB_MAX_SEGMENTS )
+	{
+		capacity *= 2;
+	}
+
+	m_items.reserve( capacity );
+	m_capacity.fetchAndStoreOrdered( capacity );
+}
+
+
+
+
+ThreadableJob * MixerWorkerThread::JobDeque::pop()
+{
+	const int b = nextIndex( m_bottom, -1 );
+	// full barrier required so that thieves see the reservation before we
+	// read m_top
+	m_bottom.fetchAndStoreOrdered( b );
+	const int t = m_top.fetchAndAddOrdered( 0 );
+
+	if( indexDistance( t, b ) < 0 )
+	{
+		// deque was empty
+		m_bottom.fetchAndStoreOrdered( nextIndex( b, 1 ) );
+		return NULL;
+	}
+
+	ThreadableJob * job = *m_items.slot( b & ( m_capacity - 1 ), false );
+	if( t == b )
+	{
+		// last item - compete with thieves for it
+		if( !m_top.testAndSetOrdered( t, nextIndex( t, 1 ) ) )
+		{
+			job = NULL;
+		}
+		m_bottom.fetchAndStoreOrdered( nextIndex( t, 1 ) );
+	}
+	return job;
+}
+
+
+
+
+ThreadableJob * MixerWorkerThread::JobDeque::steal()
+{
+	while( true )
+	{
+		const int t = m_top.fetchAndAddOrdered( 0 );
+		const int b = m_bottom.fetchAndAddOrdered( 0 );
+		if( indexDistance( t, b ) <= 0 )
+		{
+			return NULL;
+		}
+
+		JobSlot * slot = m_items.slot( t & ( m_capacity - 1 ), false );
+		ThreadableJob * job = slot ? (ThreadableJob *) *slot : NULL;
+		if( m_top.testAndSetOrdered( t, nextIndex( t, 1 ) ) )
+		{
+			return job;
+		}
+		// lost race against owner or another thief - try again
 	}
 }
 
@@ -108,14 +332,20 @@ void MixerWorkerThread::JobQueue::wait()
 
 MixerWorkerThread::MixerWorkerThread( Mixer* mixer ) :
 	QThread( mixer ),
+	m_jobDeque(),
+	m_index( 0 ),
 	m_quit( false )
 {
 	// initialize global static data
 	if( queueReadyWaitCond == NULL )
 	{
 		queueReadyWaitCond = new QWaitCondition;
+		s_workStealing = !ConfigManager::inst()->value( "mixer",
+						"globaljobqueue" ).toInt();
 	}
 
+	m_index = workerThreads.size();
+
 	// keep track of all instantiated worker threads - this is used for
 	// processing the last worker thread "inline", see comments in
 	// MixerWorkerThread::startAndWaitForJobs() for details
@@ -144,12 +374,61 @@ void MixerWorkerThread::quit()
 
 
 
+void MixerWorkerThread::resetJobQueue( JobQueue::OperationMode _opMode )
+{
+	globalJobQueue.reset( _opMode );
+	s_opMode = _opMode;
+}
+
+
+
+
+bool MixerWorkerThread::addJob( ThreadableJob * _job )
+{
+	if( !s_workStealing )
+	{
+		if( globalJobQueue.addJob( _job ) )
+		{
+			updateJobsHighWaterMark( globalJobQueue.queued() );
+			return true;
+		}
+		return false;
+	}
+
+	if( _job->requiresProcessing() )
+	{
+		// update job state
+		_job->queue();
+		updateJobsHighWaterMark(
+				s_pendingJobs.fetchAndAddOrdered( 1 ) + 1 );
+
+		JobDeque & deque = currentWorker()->m_jobDeque;
+		if( !deque.push( _job ) )
+		{
+			// own deque is full - rather than dropping the job
+			// process it right away
+			_job->process();
+			s_pendingJobs.fetchAndAddOrdered( -1 );
+		}
+		return true;
+	}
+	return false;
+}
+
+
+
+
 void MixerWorkerThread::startAndWaitForJobs()
 {
 	queueReadyWaitCond->wakeAll();
 	// The last worker-thread is never started. Instead it's processed "inline"
 	// i.e. within the global Mixer thread. This way we can reduce latencies
 	// that otherwise would be caused by synchronizing with another thread.
+	if( s_workStealing )
+	{
+		workerThreads.last()->processJobs( true );
+		return;
+	}
 	globalJobQueue.run();
 	globalJobQueue.wait();
 }
@@ -157,6 +436,123 @@ void MixerWorkerThread::startAndWaitForJobs()
 
 
 
+int MixerWorkerThread::finishPeriod()
+{
+	s_lastPeriodJobs = s_jobsHighWaterMark.fetchAndStoreOrdered( 0 );
+
+	// all jobs are done, so deques can be grown by us - with some
+	// headroom, so the next period usually fits without processing jobs
+	// right away because storage is full
+	const int jobs = s_lastPeriodJobs + s_lastPeriodJobs / 2;
+	if( s_workStealing )
+	{
+		foreach( MixerWorkerThread * wt, workerThreads )
+		{
+			if( wt->m_jobDeque.capacity() < jobs )
+			{
+				wt->m_jobDeque.reserve( jobs );
+			}
+		}
+	}
+	else
+	{
+		globalJobQueue.reserve( jobs );
+	}
+
+	return s_lastPeriodJobs;
+}
+
+
+
+
+void MixerWorkerThread::updateJobsHighWaterMark( int _jobs )
+{
+	int mark = s_jobsHighWaterMark;
+	while( _jobs > mark &&
+			!s_jobsHighWaterMark.testAndSetOrdered( mark, _jobs ) )
+	{
+		mark = s_jobsHighWaterMark;
+	}
+}
+
+
+
+
+MixerWorkerThread * MixerWorkerThread::currentWorker()
+{
+	QThread * thread = QThread::currentThread();
+	foreach( MixerWorkerThread * wt, workerThreads )
+	{
+		if( wt == thread )
+		{
+			return wt;
+		}
+	}
+	// jobs not added by a worker thread are added by the mixer thread which
+	// processes the last worker's deque inline
+	return workerThreads.last();
+}
+
+
+
+
+void MixerWorkerThread::processJobs( bool _untilDone )
+{
+	const int count = workerThreads.size();
+	int idleRounds = 0;
+	// the mixer thread waiting for the last jobs of the period is the
+	// barrier between rendering and master mix
+	const char * waitName = _untilDone ? "barrier" : "wait for jobs";
+	qint64 waitStart = 0;
+
+	while( (int) s_pendingJobs > 0 )
+	{
+		ThreadableJob * job = m_jobDeque.pop();
+		for( int i = 1; job == NULL && i < count; ++i )
+		{
+			job = workerThreads[( m_index + i ) % count]->m_jobDeque.steal();
+		}
+
+		if( job )
+		{
+			RenderTrace::finish( RenderTrace::CategoryWait, waitName,
+								waitStart );
+			waitStart = 0;
+			job->process();
+			s_pendingJobs.fetchAndAddOrdered( -1 );
+			idleRounds = 0;
+		}
+		// in static mode no more jobs can show up once all deques are
+		// empty so there's no need for helper threads to keep spinning
+		else if( !_untilDone && s_opMode == JobQueue::Static )
+		{
+			break;
+		}
+		else
+		{
+			if( waitStart == 0 )
+			{
+				waitStart = RenderTrace::start();
+			}
+			if( ++idleRounds < 64 )
+			{
+				relaxCpu();
+			}
+			else
+			{
+				// the remaining jobs are long-running ones -
+				// don't burn a core while waiting for them
+				yieldCurrentThread();
+			}
+		}
+	}
+
+	RenderTrace::finish( RenderTrace::CategoryWait, waitName, waitStart );
+}
+
+
+
+
 void MixerWorkerThread::run()
 {
 // set denormal protection for this thread
@@ -168,12 +564,24 @@ void MixerWorkerThread::run()
 /* FTZ flag */
 	_MM_SET_FLUSH_ZERO_MODE( _MM_FLUSH_ZERO_ON );
 #endif
+	RealtimeGuard::setRealtimeThread( true );
+	RenderTrace::setThreadName( "MixerWorkerThread", m_index );
+
 	QMutex m;
 	while( m_quit == false )
 	{
 		m.lock();
+		const qint64 traceStart = RenderTrace::start();
 		queueReadyWaitCond->wait( &m );
-		globalJobQueue.run();
+		RenderTrace::finish( RenderTrace::CategoryWait, "sleep", traceStart );
+		if( s_workStealing )
+		{
+			processJobs( false );
+		}
+		else
+		{
+			globalJobQueue.run();
+		}
 		m.unlock();
 	}
 }
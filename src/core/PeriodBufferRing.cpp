@@ -0,0 +1,177 @@
+/*
+ * PeriodBufferRing.cpp - preallocated SPSC ring of period buffers between
+ *                        Mixer::fifoWriter and the audio device
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "PeriodBufferRing.h"
+
+#include <QtCore/QThread>
+#include <cstring>
+
+#include "MemoryHelper.h"
+
+
+// rounds of spinning before going to sleep - the other side usually
+// needs much longer than this, but it keeps short stalls out of the kernel
+static const int SpinRounds = 100;
+
+
+
+PeriodBufferRing::PeriodBufferRing( int size, fpp_t frames ) :
+	m_size( qMax( size, 1 ) ),
+	m_frames( frames ),
+	m_buffers( NULL ),
+	m_endOfStream( NULL ),
+	m_writeSlot( 0 ),
+	m_readSlot( 0 ),
+	m_filled( 0 ),
+	m_depth( m_size ),
+	m_underruns( 0 ),
+	m_waitMutex(),
+	m_writable(),
+	m_readable(),
+	m_writerWaiting( 0 ),
+	m_readerWaiting( 0 )
+{
+	m_buffers = (surroundSampleFrame *) MemoryHelper::alignedMalloc(
+			m_size * m_frames * sizeof( surroundSampleFrame ) );
+	memset( m_buffers, 0, m_size * m_frames * sizeof( surroundSampleFrame ) );
+
+	m_endOfStream = new bool[m_size];
+	for( int i = 0; i < m_size; ++i )
+	{
+		m_endOfStream[i] = false;
+	}
+}
+
+
+
+
+PeriodBufferRing::~PeriodBufferRing()
+{
+	MemoryHelper::alignedFree( m_buffers );
+	delete[] m_endOfStream;
+}
+
+
+
+
+void PeriodBufferRing::setDepth( int depth )
+{
+	m_depth.fetchAndStoreOrdered( qBound( 1, depth, m_size ) );
+
+	// producer might be waiting for the ring to become writable
+	wake( m_writerWaiting, m_writable );
+}
+
+
+
+
+surroundSampleFrame * PeriodBufferRing::waitForWriteBuffer()
+{
+	for( int i = 0; i < SpinRounds; ++i )
+	{
+		if( surroundSampleFrame * b = writeBuffer() )
+		{
+			return b;
+		}
+		QThread::yieldCurrentThread();
+	}
+
+	m_waitMutex.lock();
+	// announce that we're going to sleep before checking the last time -
+	// both are ordered, so push() either sees us waiting or we see its
+	// buffer
+	m_writerWaiting.fetchAndStoreOrdered( 1 );
+	surroundSampleFrame * b;
+	while( ( b = writeBuffer() ) == NULL )
+	{
+		m_writable.wait( &m_waitMutex );
+	}
+	m_writerWaiting.fetchAndStoreOrdered( 0 );
+	m_waitMutex.unlock();
+
+	return b;
+}
+
+
+
+
+void PeriodBufferRing::push( bool endOfStream )
+{
+	m_endOfStream[m_writeSlot] = endOfStream;
+	m_writeSlot = ( m_writeSlot + 1 ) % m_size;
+	m_filled.fetchAndAddOrdered( 1 );
+
+	wake( m_readerWaiting, m_readable );
+}
+
+
+
+
+const surroundSampleFrame * PeriodBufferRing::waitForReadBuffer()
+{
+	for( int i = 0; i < SpinRounds && available() == 0; ++i )
+	{
+		QThread::yieldCurrentThread();
+	}
+
+	if( available() == 0 )
+	{
+		m_underruns.fetchAndAddOrdered( 1 );
+
+		m_waitMutex.lock();
+		m_readerWaiting.fetchAndStoreOrdered( 1 );
+		while( available() == 0 )
+		{
+			m_readable.wait( &m_waitMutex );
+		}
+		m_readerWaiting.fetchAndStoreOrdered( 0 );
+		m_waitMutex.unlock();
+	}
+
+	return readBuffer();
+}
+
+
+
+
+void PeriodBufferRing::pop()
+{
+	m_readSlot = ( m_readSlot + 1 ) % m_size;
+	m_filled.fetchAndAddOrdered( -1 );
+
+	wake( m_writerWaiting, m_writable );
+}
+
+
+
+
+void PeriodBufferRing::wake( QAtomicInt & waiting, QWaitCondition & cond )
+{
+	// only enter the kernel if the other side is actually sleeping
+	if( waiting.fetchAndAddOrdered( 0 ) )
+	{
+		m_waitMutex.lock();
+		cond.wakeAll();
+		m_waitMutex.unlock();
+	}
+}
@@ -23,7 +23,10 @@
  */
  
 #include "PlayHandle.h"
+#include "AudioPort.h"
 #include "BufferManager.h"
+#include "Engine.h"
+#include "Mixer.h"
 
 
 PlayHandle::PlayHandle( const Type type, f_cnt_t offset ) :
@@ -31,27 +34,62 @@ PlayHandle::PlayHandle( const Type type, f_cnt_t offset ) :
 		m_offset( offset ),
 		m_affinity( QThread::currentThread() ),
 		m_playHandleBuffer( NULL ),
-		m_usesBuffer( true )
+		m_usesBuffer( true ),
+		m_silent( false ),
+		m_audioPort( NULL ),
+		m_prevLinked( NULL ),
+		m_nextLinked( NULL ),
+		m_linkedList( NULL ),
+		m_removalRequested( 0 )
 {
+	m_nextInInbox[0] = m_nextInInbox[1] = NULL;
 }
 
 
 PlayHandle::~PlayHandle()
 {
+	releaseBuffer();
 }
 
 
 void PlayHandle::doProcessing()
 {
+	m_silent = false;
+	MixerProfilerNodeTimer timer( Engine::mixer()->profiler(),
+			m_audioPort ? m_audioPort->playHandleProfilerNode() : -1 );
 	if( m_usesBuffer )
 	{
-		if( ! m_playHandleBuffer ) m_playHandleBuffer = BufferManager::acquire();
+		if( ! m_playHandleBuffer ) m_playHandleBuffer = BufferManager::acquire( this );
 		play( m_playHandleBuffer );
 	}
 	else
 	{
 		play( NULL );
 	}
+	timer.stop();
+
+	Engine::mixer()->profiler().countNode( MixerProfiler::NodePlayHandle,
+								m_silent );
+
+	// our buffer is ready for being mixed by the audio port
+	if( m_audioPort )
+	{
+		m_audioPort->graphInputDone();
+	}
+}
+
+
+const char * PlayHandle::jobName() const
+{
+	switch( m_type )
+	{
+		case TypeNotePlayHandle: return "NotePlayHandle";
+		case TypeInstrumentPlayHandle: return "InstrumentPlayHandle";
+		case TypeSamplePlayHandle: return "SamplePlayHandle";
+		case TypePresetPreviewHandle: return "PresetPreviewPlayHandle";
+		default: break;
+	}
+	return "PlayHandle";
 }
 
 
@@ -162,6 +162,7 @@ void ProjectRenderer::run()
 	Engine::getSong()->startExport();
     //skip first empty buffer
     Engine::mixer()->nextBuffer();
+    Engine::mixer()->releaseNextBuffer();
 
 	Song::playPos & pp = Engine::getSong()->getPlayPos(
 							Song::Mode_PlaySong );
@@ -0,0 +1,465 @@
+/*
+ * RealtimeGuard.cpp - detect real-time unsafe operations in audio threads
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "RealtimeGuard.h"
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <stdlib.h>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#include "lmmsconfig.h"
+
+#ifdef LMMS_HAVE_EXECINFO_H
+#include <execinfo.h>
+#endif
+
+
+struct ViolationRecord
+{
+	RealtimeGuard::Violation type;
+	size_t size;
+	int period;
+	int depth;
+	void * frames[RT_GUARD_STACK_DEPTH];
+} ;
+
+enum ThreadStates
+{
+	RealtimeThread = 1,
+	Reporting = 2	// set while recording, avoids recursion via allocations
+} ;
+
+// plain thread-local flags - QThreadStorage would allocate by itself
+#if defined( _MSC_VER )
+#define RT_GUARD_THREAD_LOCAL __declspec( thread )
+#elif __cplusplus >= 201103L
+#define RT_GUARD_THREAD_LOCAL thread_local
+#else
+#define RT_GUARD_THREAD_LOCAL __thread
+#endif
+
+static RT_GUARD_THREAD_LOCAL int s_threadState = 0;
+
+static ViolationRecord s_violations[RT_GUARD_MAX_VIOLATIONS];
+static QAtomicInt s_violationCount;
+static QAtomicInt s_violationTotals[RealtimeGuard::NumViolations];
+static QAtomicInt s_period;
+static QAtomicInt s_inPeriod;
+
+static const char * s_violationNames[RealtimeGuard::NumViolations] =
+{
+	"MemoryManager::alloc()", "operator new", "mutex lock"
+} ;
+
+bool RealtimeGuard::s_enabled = false;
+QString RealtimeGuard::s_outputFile;
+
+
+// report() and the function calling it are not interesting
+static const int FirstCallSiteFrame = 2;
+
+
+
+static QByteArray callSiteKey( const ViolationRecord & record )
+{
+	QByteArray key( (const char *) &record.type, sizeof( record.type ) );
+	for( int f = FirstCallSiteFrame; f < record.depth; ++f )
+	{
+		key.append( (const char *) &record.frames[f], sizeof( void * ) );
+	}
+	return key;
+}
+
+
+
+
+void RealtimeGuard::enable( const QString & outputFile )
+{
+	s_outputFile = outputFile;
+
+#ifdef LMMS_HAVE_EXECINFO_H
+	// the first backtrace() call loads libgcc and thereby allocates -
+	// get that over with before anything is recorded
+	void * frame;
+	backtrace( &frame, 1 );
+#endif
+
+	s_enabled = true;
+}
+
+
+
+
+void RealtimeGuard::setRealtimeThread( bool realtime )
+{
+	if( realtime )
+	{
+		s_threadState |= RealtimeThread;
+	}
+	else
+	{
+		s_threadState &= ~RealtimeThread;
+	}
+}
+
+
+
+
+void RealtimeGuard::startPeriod()
+{
+	if( s_enabled )
+	{
+		setRealtimeThread( true );
+		s_period.fetchAndAddOrdered( 1 );
+		s_inPeriod = 1;
+	}
+}
+
+
+
+
+void RealtimeGuard::finishPeriod()
+{
+	s_inPeriod = 0;
+}
+
+
+
+
+void RealtimeGuard::report( Violation type, size_t size )
+{
+	if( !s_inPeriod || ( s_threadState & ( RealtimeThread | Reporting ) ) != RealtimeThread )
+	{
+		return;
+	}
+
+	s_threadState |= Reporting;
+
+	s_violationTotals[type].fetchAndAddOrdered( 1 );
+
+	const int index = s_violationCount.fetchAndAddOrdered( 1 );
+	if( index < RT_GUARD_MAX_VIOLATIONS )
+	{
+		ViolationRecord & record = s_violations[index];
+		record.type = type;
+		record.size = size;
+		record.period = s_period;
+#ifdef LMMS_HAVE_EXECINFO_H
+		record.depth = backtrace( record.frames, RT_GUARD_STACK_DEPTH );
+#else
+		record.depth = 0;
+#endif
+	}
+
+	s_threadState &= ~Reporting;
+}
+
+
+
+
+void RealtimeGuard::dump()
+{
+	if( !s_enabled )
+	{
+		return;
+	}
+	// stop recording, we're going to allocate a lot from now on
+	s_enabled = false;
+
+	QFile out;
+	if( s_outputFile == "-" )
+	{
+		out.open( stderr, QFile::WriteOnly );
+	}
+	else
+	{
+		out.setFileName( s_outputFile );
+		if( !out.open( QFile::WriteOnly | QFile::Truncate ) )
+		{
+			qWarning( "RealtimeGuard: could not open %s for writing",
+						qPrintable( s_outputFile ) );
+			return;
+		}
+	}
+
+	const int recorded = qMin<int>( s_violationCount, RT_GUARD_MAX_VIOLATIONS );
+
+	out.write( QString( "Real-time violations in %1 periods:\n" ).
+					arg( (int) s_period ).toLatin1() );
+	for( int i = 0; i < NumViolations; ++i )
+	{
+		out.write( QString( "  %1: %2\n" ).arg( s_violationNames[i] ).
+					arg( (int) s_violationTotals[i] ).toLatin1() );
+	}
+	if( recorded < s_violationCount )
+	{
+		out.write( QString( "Only the first %1 violations were recorded.\n" ).
+					arg( recorded ).toLatin1() );
+	}
+
+	// group recorded violations by type and call site
+	QHash<QByteArray, int> counts;
+	QList<int> firstRecords;
+	for( int i = 0; i < recorded; ++i )
+	{
+		const QByteArray key = callSiteKey( s_violations[i] );
+		if( !counts.contains( key ) )
+		{
+			firstRecords << i;
+		}
+		++counts[key];
+	}
+
+	foreach( int i, firstRecords )
+	{
+		const ViolationRecord & record = s_violations[i];
+
+		out.write( QString( "\n%1x %2 (%3 bytes), first in period %4\n" ).
+					arg( counts[callSiteKey( record )] ).
+					arg( s_violationNames[record.type] ).
+					arg( (qulonglong) record.size ).
+					arg( record.period ).toLatin1() );
+
+#ifdef LMMS_HAVE_EXECINFO_H
+		char * * symbols = backtrace_symbols( record.frames, record.depth );
+		for( int f = FirstCallSiteFrame; symbols && f < record.depth; ++f )
+		{
+			out.write( QString( "    %1\n" ).arg( symbols[f] ).toLatin1() );
+		}
+		::free( symbols );
+#else
+		out.write( "    (no call site information available on this platform)\n" );
+#endif
+	}
+}
+
+
+
+
+// report heap allocations done via operator new as well - these replace
+// the default operators for the whole process, so all variants have to be
+// replaced together with their matching operator delete
+
+// dynamic exception specifications are deprecated since C++11 and gone in
+// C++17, while older standards don't know noexcept
+#if __cplusplus >= 201103L
+#define RT_GUARD_THROWS_BAD_ALLOC
+#define RT_GUARD_NOTHROW noexcept
+#else
+#define RT_GUARD_THROWS_BAD_ALLOC throw( std::bad_alloc )
+#define RT_GUARD_NOTHROW throw()
+#endif
+
+
+static inline void * guardedMalloc( size_t size )
+{
+	RealtimeGuard::check( RealtimeGuard::OperatorNew, size );
+	return malloc( size ? size : 1 );
+}
+
+
+
+
+void * operator new( size_t size ) RT_GUARD_THROWS_BAD_ALLOC
+{
+	void * ptr = guardedMalloc( size );
+	if( ptr == NULL )
+	{
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+
+
+
+void * operator new[]( size_t size ) RT_GUARD_THROWS_BAD_ALLOC
+{
+	return operator new( size );
+}
+
+
+
+
+void * operator new( size_t size, const std::nothrow_t & ) RT_GUARD_NOTHROW
+{
+	return guardedMalloc( size );
+}
+
+
+
+
+void * operator new[]( size_t size, const std::nothrow_t & ) RT_GUARD_NOTHROW
+{
+	return guardedMalloc( size );
+}
+
+
+
+
+void operator delete( void * ptr ) RT_GUARD_NOTHROW
+{
+	free( ptr );
+}
+
+
+
+
+void operator delete[]( void * ptr ) RT_GUARD_NOTHROW
+{
+	free( ptr );
+}
+
+
+
+
+void operator delete( void * ptr, const std::nothrow_t & ) RT_GUARD_NOTHROW
+{
+	free( ptr );
+}
+
+
+
+
+void operator delete[]( void * ptr, const std::nothrow_t & ) RT_GUARD_NOTHROW
+{
+	free( ptr );
+}
+
+
+
+
+#ifdef __cpp_aligned_new
+
+// for types with extended alignment (C++17)
+
+static void * guardedAlignedMalloc( size_t size, std::align_val_t align )
+{
+	RealtimeGuard::check( RealtimeGuard::OperatorNew, size );
+
+	size_t alignment = static_cast<size_t>( align );
+	if( alignment < sizeof( void * ) )
+	{
+		alignment = sizeof( void * );
+	}
+#ifdef _WIN32
+	return _aligned_malloc( size ? size : 1, alignment );
+#else
+	void * ptr = NULL;
+	return posix_memalign( &ptr, alignment, size ? size : 1 ) == 0 ?
+								ptr : NULL;
+#endif
+}
+
+
+
+
+static void guardedAlignedFree( void * ptr )
+{
+#ifdef _WIN32
+	_aligned_free( ptr );
+#else
+	free( ptr );
+#endif
+}
+
+
+
+
+void * operator new( size_t size, std::align_val_t align )
+{
+	void * ptr = guardedAlignedMalloc( size, align );
+	if( ptr == NULL )
+	{
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+
+
+
+void * operator new[]( size_t size, std::align_val_t align )
+{
+	return operator new( size, align );
+}
+
+
+
+
+void * operator new( size_t size, std::align_val_t align,
+					const std::nothrow_t & ) noexcept
+{
+	return guardedAlignedMalloc( size, align );
+}
+
+
+
+
+void * operator new[]( size_t size, std::align_val_t align,
+					const std::nothrow_t & ) noexcept
+{
+	return guardedAlignedMalloc( size, align );
+}
+
+
+
+
+void operator delete( void * ptr, std::align_val_t ) noexcept
+{
+	guardedAlignedFree( ptr );
+}
+
+
+
+
+void operator delete[]( void * ptr, std::align_val_t ) noexcept
+{
+	guardedAlignedFree( ptr );
+}
+
+
+
+
+void operator delete( void * ptr, std::align_val_t,
+					const std::nothrow_t & ) noexcept
+{
+	guardedAlignedFree( ptr );
+}
+
+
+
+
+void operator delete[]( void * ptr, std::align_val_t,
+					const std::nothrow_t & ) noexcept
+{
+	guardedAlignedFree( ptr );
+}
+
+#endif
@@ -81,10 +81,20 @@ RemotePlugin::RemotePlugin() :
 	m_shmID( 0 ),
 #endif
 	m_shmSize( 0 ),
+	m_shmHeader( NULL ),
 	m_shm( NULL ),
+	m_processTimer(),
+	m_pipelined( ConfigManager::inst()->value( "mixer",
+				"pipelinedremoteplugins" ).toInt() ),
+	m_periodsSubmitted( 0 ),
+	m_periodsDone( 0 ),
 	m_inputCount( DEFAULT_CHANNELS ),
 	m_outputCount( DEFAULT_CHANNELS )
 {
+	if( m_pipelined )
+	{
+		Engine::mixer()->addPluginLatency( latency() );
+	}
 }
 
 
@@ -95,6 +105,12 @@ RemotePlugin::~RemotePlugin()
 	m_watcher.quit();
 	m_watcher.wait();
 
+	// nothing to remove from if the mixer is gone already
+	if( m_pipelined && Engine::mixer() )
+	{
+		Engine::mixer()->removePluginLatency( latency() );
+	}
+
 	if( m_failed == false )
 	{
 		if( isRunning() )
@@ -112,7 +128,7 @@ RemotePlugin::~RemotePlugin()
 		}
 
 #ifndef USE_QT_SHMEM
-		shmdt( m_shm );
+		shmdt( m_shmHeader );
 		shmctl( m_shmID, IPC_RMID, NULL );
 #endif
 	}
@@ -195,10 +211,91 @@ bool RemotePlugin::process( const sampleFrame * _in_buf,
 		return false;
 	}
 
-	memset( m_shm, 0, m_shmSize );
+	// output collected now belongs to a period submitted in an earlier
+	// call - if that was long ago (e.g. a sleeping effect), it's stale
+	const bool stale = m_pipelined && m_processTimer.elapsed() >
+				2 * 1000000LL * frames /
+				Engine::mixer()->processingSampleRate();
+	m_processTimer.reset();
+
+	lock();
+	// the slot to fill might still be in use if periods weren't collected
+	// (no output buffer given)
+	while( m_periodsDone < m_periodsSubmitted - REMOTE_AUDIO_SLOTS + 1 &&
+								!isInvalid() )
+	{
+		fetchAndProcessNextMessage();
+	}
+
+	writeInputs( _in_buf,
+			slotBuffer( m_periodsSubmitted % REMOTE_AUDIO_SLOTS ) );
+	sendMessage( message( IdStartProcessing ).addInt(
+				m_periodsSubmitted % REMOTE_AUDIO_SLOTS ) );
+	++m_periodsSubmitted;
+
+	if( m_failed || _out_buf == NULL || m_outputCount == 0 )
+	{
+		unlock();
+		return false;
+	}
+
+	// in pipelined mode the period just submitted is left to the remote
+	// process, we only collect the one before - IdProcessingDone might
+	// also be picked up by another thread waiting for a reply, so wait
+	// for the counter rather than for the message itself
+	const int collect = m_pipelined ? m_periodsSubmitted - 1 :
+							m_periodsSubmitted;
+	while( m_periodsDone < collect && !isInvalid() )
+	{
+		fetchAndProcessNextMessage();
+	}
+	unlock();
 
+	if( collect == 0 || stale )
+	{
+		// nothing rendered for the current input yet
+		Engine::mixer()->clearAudioBuffer( _out_buf, frames );
+		return true;
+	}
+
+	readOutputs( slotBuffer( ( collect - 1 ) % REMOTE_AUDIO_SLOTS ),
+								_out_buf );
+
+	return true;
+}
+
+
+
+
+f_cnt_t RemotePlugin::latency() const
+{
+	return m_pipelined ? Engine::mixer()->framesPerPeriod() : 0;
+}
+
+
+
+
+float * RemotePlugin::slotBuffer( int _slot ) const
+{
+	return m_shm + _slot * ( m_inputCount + m_outputCount ) *
+					Engine::mixer()->framesPerPeriod();
+}
+
+
+
+
+void RemotePlugin::writeInputs( const sampleFrame * _in_buf, float * _buf )
+{
+	const fpp_t frames = Engine::mixer()->framesPerPeriod();
 	ch_cnt_t inputs = qMin<ch_cnt_t>( m_inputCount, DEFAULT_CHANNELS );
 
+	// the remote process writes all of its outputs, so only clear input
+	// channels we don't fill
+	if( _in_buf == NULL || inputs < m_inputCount )
+	{
+		memset( _buf, 0, m_inputCount * frames * sizeof( float ) );
+	}
+
 	if( _in_buf != NULL && inputs > 0 )
 	{
 		if( m_splitChannels )
@@ -207,18 +304,18 @@ bool RemotePlugin::process( const sampleFrame * _in_buf,
 			{
 				for( fpp_t frame = 0; frame < frames; ++frame )
 				{
-					m_shm[ch * frames + frame] =
+					_buf[ch * frames + frame] =
 							_in_buf[frame][ch];
 				}
 			}
 		}
 		else if( inputs == DEFAULT_CHANNELS )
 		{
-			memcpy( m_shm, _in_buf, frames * BYTES_PER_FRAME );
+			memcpy( _buf, _in_buf, frames * BYTES_PER_FRAME );
 		}
 		else
 		{
-			sampleFrame * o = (sampleFrame *) m_shm;
+			sampleFrame * o = (sampleFrame *) _buf;
 			for( ch_cnt_t ch = 0; ch < inputs; ++ch )
 			{
 				for( fpp_t frame = 0; frame < frames; ++frame )
@@ -228,19 +325,14 @@ bool RemotePlugin::process( const sampleFrame * _in_buf,
 			}
 		}
 	}
+}
 
-	lock();
-	sendMessage( IdStartProcessing );
 
-	if( m_failed || _out_buf == NULL || m_outputCount == 0 )
-	{
-		unlock();
-		return false;
-	}
 
-	waitForMessage( IdProcessingDone );
-	unlock();
 
+void RemotePlugin::readOutputs( const float * _buf, sampleFrame * _out_buf )
+{
+	const fpp_t frames = Engine::mixer()->framesPerPeriod();
 	const ch_cnt_t outputs = qMin<ch_cnt_t>( m_outputCount,
 							DEFAULT_CHANNELS );
 	if( m_splitChannels )
@@ -249,19 +341,19 @@ bool RemotePlugin::process( const sampleFrame * _in_buf,
 		{
 			for( fpp_t frame = 0; frame < frames; ++frame )
 			{
-				_out_buf[frame][ch] = m_shm[( m_inputCount+ch )*
+				_out_buf[frame][ch] = _buf[( m_inputCount+ch )*
 								frames + frame];
 			}
 		}
 	}
 	else if( outputs == DEFAULT_CHANNELS )
 	{
-		memcpy( _out_buf, m_shm + m_inputCount * frames,
+		memcpy( _out_buf, _buf + m_inputCount * frames,
 						frames * BYTES_PER_FRAME );
 	}
 	else
 	{
-		sampleFrame * o = (sampleFrame *) ( m_shm +
+		const sampleFrame * o = (const sampleFrame *) ( _buf +
 							m_inputCount*frames );
 		// clear buffer, if plugin didn't fill up both channels
 		Engine::mixer()->clearAudioBuffer( _out_buf, frames );
@@ -275,8 +367,6 @@ bool RemotePlugin::process( const sampleFrame * _in_buf,
 			}
 		}
 	}
-
-	return true;
 }
 
 
@@ -285,31 +375,72 @@ bool RemotePlugin::process( const sampleFrame * _in_buf,
 void RemotePlugin::processMidiEvent( const MidiEvent & _e,
 							const f_cnt_t _offset )
 {
-	message m( IdMidiEvent );
-	m.addInt( _e.type() );
-	m.addInt( _e.channel() );
-	m.addInt( _e.param( 0 ) );
-	m.addInt( _e.param( 1 ) );
-	m.addInt( _offset );
+	RemoteEvent e;
+	e.type = RemoteEventMidi;
+	e.offset = _offset;
+	e.data[0] = _e.type();
+	e.data[1] = _e.channel();
+	e.data[2] = _e.param( 0 );
+	e.data[3] = _e.param( 1 );
+	e.value = 0;
+
 	lock();
-	sendMessage( m );
+	// the remote process picks up queued events with the next period
+	if( !pushEvent( e ) )
+	{
+		message m( IdMidiEvent );
+		m.addInt( _e.type() );
+		m.addInt( _e.channel() );
+		m.addInt( _e.param( 0 ) );
+		m.addInt( _e.param( 1 ) );
+		m.addInt( _offset );
+		sendMessage( m );
+	}
 	unlock();
 }
 
 
 
 
+bool RemotePlugin::processParameterChange( int _index, float _value )
+{
+	RemoteEvent e;
+	e.type = RemoteEventParameter;
+	e.offset = 0;
+	e.data[0] = _index;
+	e.data[1] = e.data[2] = e.data[3] = 0;
+	e.value = _value;
+
+	lock();
+	const bool queued = pushEvent( e );
+	// not being processed at the moment (e.g. a sleeping effect), so
+	// make remote process apply it right away
+	if( queued && m_processTimer.elapsed() > 2 * 1000000LL *
+				Engine::mixer()->framesPerPeriod() /
+				Engine::mixer()->processingSampleRate() )
+	{
+		sendMessage( IdProcessEvents );
+	}
+	unlock();
+
+	return queued;
+}
+
+
+
+
 void RemotePlugin::resizeSharedProcessingMemory()
 {
-	const size_t s = ( m_inputCount+m_outputCount ) *
+	const size_t s = REMOTE_SHM_HEADER_SIZE + REMOTE_AUDIO_SLOTS *
+				( m_inputCount+m_outputCount ) *
 				Engine::mixer()->framesPerPeriod() *
 							sizeof( float );
-	if( m_shm != NULL )
+	if( m_shmHeader != NULL )
 	{
 #ifdef USE_QT_SHMEM
 		m_shmObj.detach();
 #else
-		shmdt( m_shm );
+		shmdt( m_shmHeader );
 		shmctl( m_shmID, IPC_RMID, NULL );
 #endif
 	}
@@ -322,15 +453,18 @@ void RemotePlugin::resizeSharedProcessingMemory()
 		m_shmObj.create( s );
 	} while( m_shmObj.error() != QSharedMemory::NoError );
 
-	m_shm = (float *) m_shmObj.data();
+	m_shmHeader = (RemoteShmHeader *) m_shmObj.data();
 #else
 	while( ( m_shmID = shmget( ++shm_key, s, IPC_CREAT | IPC_EXCL |
 								0600 ) ) == -1 )
 	{
 	}
 
-	m_shm = (float *) shmat( m_shmID, 0, 0 );
+	m_shmHeader = (RemoteShmHeader *) shmat( m_shmID, 0, 0 );
 #endif
+	// events queued for the old memory are lost
+	m_shmHeader->init();
+	m_shm = (float *)( (char *) m_shmHeader + REMOTE_SHM_HEADER_SIZE );
 	m_shmSize = s;
 	sendMessage( message( IdChangeSharedMemoryKey ).
 				addInt( shm_key ).addInt( m_shmSize ) );
@@ -379,6 +513,9 @@ bool RemotePlugin::processMessage( const message & _m )
 			break;
 
 		case IdProcessingDone:
+			++m_periodsDone;
+			break;
+
 		case IdQuit:
 		default:
 			break;
@@ -0,0 +1,114 @@
+/*
+ * RenderAheadController.cpp - adapts number of periods rendered ahead of the
+ *                             audio device to the current render load
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "RenderAheadController.h"
+
+#include <QtCore/QtGlobal>
+
+
+
+RenderAheadController::RenderAheadController( int minDepth, int maxDepth ) :
+	m_lastUnderruns( 0 ),
+	m_holdOff( 0 ),
+	m_quietTime( 0 )
+{
+	m_stats.minDepth = qMax( minDepth, 1 );
+	m_stats.maxDepth = qMax( maxDepth, m_stats.minDepth );
+	m_stats.depth = m_stats.minDepth;
+	m_stats.peakDepth = m_stats.minDepth;
+	m_stats.grows = 0;
+	m_stats.shrinks = 0;
+	m_stats.underruns = 0;
+	m_stats.lateRenders = 0;
+
+	// the device usually has to wait for the very first periods, which
+	// doesn't tell anything about the load
+	m_holdOff = m_stats.maxDepth;
+}
+
+
+
+
+int RenderAheadController::update( int periodTime, int deadline,
+								int underruns )
+{
+	const int newUnderruns = underruns - m_lastUnderruns;
+	m_lastUnderruns = underruns;
+	m_stats.underruns += newUnderruns;
+
+	const bool late = periodTime * 100LL > deadline * (qint64) GrowLoad;
+	if( late )
+	{
+		++m_stats.lateRenders;
+	}
+
+	if( !isAdaptive() )
+	{
+		return m_stats.depth;
+	}
+
+	if( m_holdOff > 0 )
+	{
+		--m_holdOff;
+	}
+
+	if( late || newUnderruns > 0 )
+	{
+		m_quietTime = 0;
+		if( m_holdOff == 0 && m_stats.depth < m_stats.maxDepth )
+		{
+			setDepth( m_stats.depth + 1 );
+			++m_stats.grows;
+			// let the fifo fill up to the new depth before
+			// reacting again
+			m_holdOff = m_stats.depth;
+		}
+	}
+	else if( periodTime * 100LL < deadline * (qint64) ShrinkLoad )
+	{
+		m_quietTime += deadline;
+		if( m_quietTime >= ShrinkTime * 1000 &&
+					m_stats.depth > m_stats.minDepth )
+		{
+			setDepth( m_stats.depth - 1 );
+			++m_stats.shrinks;
+			m_quietTime = 0;
+		}
+	}
+	else
+	{
+		// neither close to the deadline nor far away from it
+		m_quietTime = 0;
+	}
+
+	return m_stats.depth;
+}
+
+
+
+
+void RenderAheadController::setDepth( int depth )
+{
+	m_stats.depth = qBound( m_stats.minDepth, depth, m_stats.maxDepth );
+	m_stats.peakDepth = qMax( m_stats.peakDepth, m_stats.depth );
+}
@@ -0,0 +1,273 @@
+/*
+ * RenderTrace.cpp - record a timeline of render threads in Chrome trace format
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "RenderTrace.h"
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QAtomicPointer>
+#include <QtCore/QFile>
+#include <stdlib.h>
+#include <new>
+
+#include "lmmsconfig.h"
+
+#ifdef LMMS_BUILD_LINUX
+#include <time.h>
+#else
+#include <sys/time.h>
+#endif
+
+
+struct TraceEvent
+{
+	qint64 start;
+	qint64 duration;
+	const char * name;
+	const void * id;
+	RenderTrace::Category category;
+} ;
+
+struct ThreadBuffer
+{
+	const char * name;
+	int index;
+	QAtomicInt count;	// published events
+	int dropped;
+	TraceEvent * events;
+} ;
+
+static const char * s_categoryNames[RenderTrace::NumCategories] =
+{
+	"stage", "job", "wait", "fifo", "device"
+} ;
+
+// buffers are claimed by threads when recording their first event and
+// never freed, as threads might still be recording while dumping
+static QAtomicPointer<ThreadBuffer> s_buffers[RENDER_TRACE_MAX_THREADS];
+static QAtomicInt s_threadCount;
+static qint64 s_epoch = 0;
+
+// plain thread-local pointer - QThreadStorage would allocate by itself
+static __thread ThreadBuffer * s_threadBuffer = NULL;
+static __thread bool s_threadClaimed = false;
+
+bool RenderTrace::s_enabled = false;
+QString RenderTrace::s_outputFile;
+
+
+
+// returns buffer of calling thread or NULL if there are too many threads
+static ThreadBuffer * threadBuffer()
+{
+	if( s_threadClaimed )
+	{
+		return s_threadBuffer;
+	}
+	s_threadClaimed = true;
+
+	const int index = s_threadCount.fetchAndAddOrdered( 1 );
+	if( index >= RENDER_TRACE_MAX_THREADS )
+	{
+		return NULL;
+	}
+
+	// use malloc() so a thread claiming its buffer during a period isn't
+	// reported by RealtimeGuard - pages are only touched when recording
+	ThreadBuffer * buffer = (ThreadBuffer *) malloc( sizeof( ThreadBuffer ) );
+	TraceEvent * events = (TraceEvent *) malloc( sizeof( TraceEvent ) *
+						RENDER_TRACE_THREAD_EVENTS );
+	if( buffer == NULL || events == NULL )
+	{
+		free( buffer );
+		free( events );
+		return NULL;
+	}
+
+	new( &buffer->count ) QAtomicInt( 0 );
+	buffer->name = NULL;
+	buffer->index = -1;
+	buffer->dropped = 0;
+	buffer->events = events;
+
+	s_buffers[index].fetchAndStoreOrdered( buffer );
+	s_threadBuffer = buffer;
+
+	return buffer;
+}
+
+
+
+
+void RenderTrace::enable( const QString & outputFile )
+{
+	s_outputFile = outputFile;
+	s_epoch = now();
+	s_enabled = true;
+}
+
+
+
+
+void RenderTrace::setThreadName( const char * name, int index )
+{
+	if( !s_enabled )
+	{
+		return;
+	}
+
+	ThreadBuffer * buffer = threadBuffer();
+	if( buffer )
+	{
+		buffer->name = name;
+		buffer->index = index;
+	}
+}
+
+
+
+
+qint64 RenderTrace::now()
+{
+#ifdef LMMS_BUILD_LINUX
+	struct timespec t;
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return t.tv_sec * 1000000000LL + t.tv_nsec;
+#else
+	struct timeval t;
+	gettimeofday( &t, NULL );
+	return t.tv_sec * 1000000000LL + t.tv_usec * 1000LL;
+#endif
+}
+
+
+
+
+void RenderTrace::record( Category category, const char * name,
+					qint64 start, const void * id )
+{
+	ThreadBuffer * buffer = threadBuffer();
+	if( buffer == NULL )
+	{
+		return;
+	}
+
+	// only this thread writes to its buffer
+	const int count = buffer->count;
+	if( count >= RENDER_TRACE_THREAD_EVENTS )
+	{
+		++buffer->dropped;
+		return;
+	}
+
+	TraceEvent & event = buffer->events[count];
+	event.start = start;
+	event.duration = now() - start;
+	event.name = name;
+	event.id = id;
+	event.category = category;
+
+	buffer->count.fetchAndStoreRelease( count + 1 );
+}
+
+
+
+
+// microseconds since enable() with nanosecond resolution
+static QByteArray timestamp( qint64 ns )
+{
+	return QByteArray::number( ns / 1000.0, 'f', 3 );
+}
+
+
+
+
+void RenderTrace::dump()
+{
+	if( !s_enabled )
+	{
+		return;
+	}
+	// stop recording - threads still recording only add events we don't
+	// look at anymore
+	s_enabled = false;
+
+	QFile out( s_outputFile );
+	if( !out.open( QFile::WriteOnly | QFile::Truncate ) )
+	{
+		qWarning( "RenderTrace: could not open %s for writing",
+					qPrintable( s_outputFile ) );
+		return;
+	}
+
+	out.write( "{\"traceEvents\":[\n" );
+
+	int dropped = 0;
+	const int threads = qMin<int>( s_threadCount, RENDER_TRACE_MAX_THREADS );
+	for( int t = 0; t < threads; ++t )
+	{
+		ThreadBuffer * buffer = s_buffers[t];
+		if( buffer == NULL )
+		{
+			continue;
+		}
+
+		const QByteArray tid = QByteArray::number( t );
+		QByteArray name = buffer->name ? QByteArray( buffer->name ) :
+							"thread " + tid;
+		if( buffer->name && buffer->index >= 0 )
+		{
+			name += " " + QByteArray::number( buffer->index );
+		}
+		out.write( "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" +
+				tid + ",\"args\":{\"name\":\"" + name + "\"}},\n" );
+
+		const int count = buffer->count.fetchAndAddAcquire( 0 );
+		for( int i = 0; i < count; ++i )
+		{
+			const TraceEvent & event = buffer->events[i];
+			QByteArray e = "{\"name\":\"" + QByteArray( event.name ) +
+				"\",\"cat\":\"" + s_categoryNames[event.category] +
+				"\",\"ph\":\"X\",\"pid\":1,\"tid\":" + tid +
+				",\"ts\":" + timestamp( event.start - s_epoch ) +
+				",\"dur\":" + timestamp( event.duration );
+			if( event.id )
+			{
+				e += ",\"args\":{\"id\":\"0x" +
+					QByteArray::number( (qulonglong) (quintptr) event.id, 16 ) + "\"}";
+			}
+			out.write( e + "},\n" );
+		}
+		dropped += buffer->dropped;
+	}
+
+	// metadata record last so there's no trailing comma to care about
+	out.write( "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+				"\"args\":{\"name\":\"LMMS\"}}\n],\n" );
+	out.write( "\"displayTimeUnit\":\"ns\",\"otherData\":{\"droppedEvents\":" +
+				QByteArray::number( dropped ) + "}}\n" );
+
+	if( dropped )
+	{
+		qWarning( "RenderTrace: %d events were dropped as buffers were full",
+								dropped );
+	}
+}
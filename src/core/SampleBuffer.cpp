@@ -31,6 +31,7 @@
 #include <QFileInfo>
 #include <QMessageBox>
 #include <QPainter>
+#include <QThreadStorage>
 
 
 #include <cstring>
@@ -62,6 +63,60 @@
 
 #include "FileDialog.h"
 #include "MemoryManager.h"
+#include "SampleCache.h"
+#include "SampleStream.h"
+
+
+// fragments crossing loop points are assembled in a buffer per thread -
+// it's only needed until the fragment has been resampled or copied, and
+// sharing it between all voices keeps it in cache and play() free of
+// memory allocations
+class FragmentBuffer
+{
+public:
+	FragmentBuffer() :
+		m_data( NULL ),
+		m_frames( 0 )
+	{
+	}
+
+	~FragmentBuffer()
+	{
+		if( m_data )
+		{
+			MM_FREE( m_data );
+		}
+	}
+
+	sampleFrame * m_data;
+	f_cnt_t m_frames;
+} ;
+
+static QThreadStorage<FragmentBuffer *> s_fragmentBuffer;
+
+
+static sampleFrame * fragmentBuffer( f_cnt_t _frames )
+{
+	FragmentBuffer * buf = s_fragmentBuffer.localData();
+	if( buf == NULL )
+	{
+		buf = new FragmentBuffer;
+		s_fragmentBuffer.setLocalData( buf );
+	}
+
+	// fragment size only grows with pitch, so this rarely allocates
+	// after the first periods
+	if( _frames > buf->m_frames )
+	{
+		if( buf->m_data )
+		{
+			MM_FREE( buf->m_data );
+		}
+		buf->m_frames = qMax( _frames, 2 * buf->m_frames );
+		buf->m_data = MM_ALLOC( sampleFrame, buf->m_frames );
+	}
+	return buf->m_data;
+}
 
 
 SampleBuffer::SampleBuffer( const QString & _audio_file,
@@ -78,7 +133,10 @@ SampleBuffer::SampleBuffer( const QString & _audio_file,
 	m_amplification( 1.0f ),
 	m_reversed( false ),
 	m_frequency( BaseFreq ),
-	m_sampleRate( Engine::mixer()->baseSampleRate() )
+	m_sampleRate( Engine::mixer()->baseSampleRate() ),
+	m_stream( NULL ),
+	m_streamingAllowed( false ),
+	m_cachedSample( NULL )
 {
 	if( _is_base64_data == true )
 	{
@@ -104,7 +162,10 @@ SampleBuffer::SampleBuffer( const sampleFrame * _data, const f_cnt_t _frames ) :
 	m_amplification( 1.0f ),
 	m_reversed( false ),
 	m_frequency( BaseFreq ),
-	m_sampleRate( Engine::mixer()->baseSampleRate() )
+	m_sampleRate( Engine::mixer()->baseSampleRate() ),
+	m_stream( NULL ),
+	m_streamingAllowed( false ),
+	m_cachedSample( NULL )
 {
 	if( _frames > 0 )
 	{
@@ -132,7 +193,10 @@ SampleBuffer::SampleBuffer( const f_cnt_t _frames ) :
 	m_amplification( 1.0f ),
 	m_reversed( false ),
 	m_frequency( BaseFreq ),
-	m_sampleRate( Engine::mixer()->baseSampleRate() )
+	m_sampleRate( Engine::mixer()->baseSampleRate() ),
+	m_stream( NULL ),
+	m_streamingAllowed( false ),
+	m_cachedSample( NULL )
 {
 	if( _frames > 0 )
 	{
@@ -152,7 +216,7 @@ SampleBuffer::~SampleBuffer()
 	if( m_origData != NULL )
 		MM_FREE( m_origData );
 
-	MM_FREE( m_data );
+	freeData();
 }
 
 
@@ -169,7 +233,7 @@ void SampleBuffer::update( bool _keep_settings )
 	if( lock )
 	{
 		m_varLock.lockForWrite();
-		MM_FREE( m_data );
+		freeData();
 	}
 
 	if( m_audioFile.isEmpty() && m_origData != NULL && m_origFrames > 0 )
@@ -200,10 +264,44 @@ void SampleBuffer::update( bool _keep_settings )
 		m_frames = 0;
 
 		const QFileInfo fileInfo( file );
-		if( fileInfo.size() > 100*1024*1024 )
+
+		// size in MB above which samples are streamed from disk
+		int streamThreshold = ConfigManager::inst()->value( "mixer",
+						"samplestreamthreshold" ).toInt();
+		if( streamThreshold <= 0 )
+		{
+			streamThreshold = 100;
+		}
+
+		// files bigger than this are never decoded into memory, so
+		// they're streamed even if the threshold is set higher
+		const qint64 maxDecodedSize = 100*1024*1024;
+		const qint64 streamSize = qMin( (qint64) streamThreshold *
+						1024 * 1024, maxDecodedSize );
+
+		if( m_streamingAllowed && fileInfo.size() > streamSize &&
+					loadStream( file, _keep_settings ) )
+		{
+			// frames are decoded in background while playing
+		}
+		else if( fileInfo.size() > maxDecodedSize )
 		{
 			qWarning( "refusing to load sample files bigger "
-								"than 100 MB" );
+					"than 100 MB which can't be streamed" );
+		}
+		else if( ( m_cachedSample = SampleCache::acquire( file,
+					Engine::mixer()->baseSampleRate(),
+							m_reversed ) ) != NULL )
+		{
+			// same file has been decoded already - data is shared
+			// and must not be modified
+			m_data = const_cast<sampleFrame *>( m_cachedSample->data() );
+			m_frames = m_cachedSample->frames();
+			if( _keep_settings == false )
+			{
+				m_loopStartFrame = m_startFrame = 0;
+				m_loopEndFrame = m_endFrame = m_frames;
+			}
 		}
 		else
 		{
@@ -235,8 +333,6 @@ void SampleBuffer::update( bool _keep_settings )
 								samplerate );
 		}
 
-		delete[] f;
-
 			if ( m_frames == 0 )  // if still no frames, bail
 			{
 				// sample couldn't be decoded, create buffer containing
@@ -250,11 +346,15 @@ void SampleBuffer::update( bool _keep_settings )
 			else // otherwise normalize sample rate
 			{
 				normalizeSampleRate( samplerate, _keep_settings );
+				m_cachedSample = SampleCache::insert( file,
+					Engine::mixer()->baseSampleRate(),
+					m_reversed, m_data, m_frames,
+					samplerate != Engine::mixer()->baseSampleRate() );
 			}
 
 		}
 
-
+		delete[] f;
 
 	}
 	else
@@ -277,6 +377,51 @@ void SampleBuffer::update( bool _keep_settings )
 }
 
 
+void SampleBuffer::freeData()
+{
+	if( m_cachedSample )
+	{
+		SampleCache::release( m_cachedSample );
+		m_cachedSample = NULL;
+	}
+	else if( m_data )
+	{
+		MM_FREE( m_data );
+	}
+	m_data = NULL;
+
+	delete m_stream;
+	m_stream = NULL;
+}
+
+
+bool SampleBuffer::loadStream( const QString & _file, bool _keep_settings )
+{
+	m_stream = new SampleStream( _file, Engine::mixer()->baseSampleRate(),
+								m_reversed );
+	if( !m_stream->isValid() )
+	{
+		delete m_stream;
+		m_stream = NULL;
+		return false;
+	}
+
+	// stream already delivers frames at our sample rate - m_data only
+	// holds a silent frame so it's never left dangling
+	m_frames = m_stream->frames();
+	m_data = MM_ALLOC( sampleFrame, 1 );
+	memset( m_data, 0, sizeof( *m_data ) );
+
+	if( _keep_settings == false )
+	{
+		m_loopStartFrame = m_startFrame = 0;
+		m_loopEndFrame = m_endFrame = m_frames;
+	}
+
+	return true;
+}
+
+
 void SampleBuffer::convertIntToFloat ( int_sample_t * & _ibuf, f_cnt_t _frames, int _channels)
 {
 			// following code transforms int-samples into
@@ -668,15 +813,13 @@ bool SampleBuffer::play( sampleFrame * _ab, handleState * _state,
 
 	f_cnt_t fragment_size = (f_cnt_t)( _frames * freq_factor ) + MARGIN[ _state->interpolationMode() ];
 
-	sampleFrame * tmp = NULL;
-
 	// check whether we have to change pitch...
 	if( freq_factor != 1.0 || _state->m_varyingPitch )
 	{
 		SRC_DATA src_data;
 		// Generate output
 		src_data.data_in =
-			getSampleFragment( play_frame, fragment_size, _loopmode, &tmp, &is_backwards,
+			getSampleFragment( play_frame, fragment_size, _loopmode, &is_backwards,
 			loopStartFrame, loopEndFrame, endFrame )[0];
 		src_data.data_out = _ab[0];
 		src_data.input_frames = fragment_size;
@@ -731,7 +874,7 @@ bool SampleBuffer::play( sampleFrame * _ab, handleState * _state,
 
 		// Generate output
 		memcpy( _ab,
-			getSampleFragment( play_frame, _frames, _loopmode, &tmp, &is_backwards,
+			getSampleFragment( play_frame, _frames, _loopmode, &is_backwards,
 						loopStartFrame, loopEndFrame, endFrame ),
 						_frames * BYTES_PER_FRAME );
 		// Advance
@@ -764,11 +907,6 @@ bool SampleBuffer::play( sampleFrame * _ab, handleState * _state,
 		}
 	}
 
-	if( tmp != NULL ) 
-	{
-		MM_FREE( tmp );
-	}
-
 	_state->setBackwards( is_backwards );
 	_state->setFrameIndex( play_frame );
 
@@ -786,10 +924,14 @@ bool SampleBuffer::play( sampleFrame * _ab, handleState * _state,
 
 
 sampleFrame * SampleBuffer::getSampleFragment( f_cnt_t _index,
-		f_cnt_t _frames, LoopMode _loopmode, sampleFrame * * _tmp, bool * _backwards,
+		f_cnt_t _frames, LoopMode _loopmode, bool * _backwards,
 		f_cnt_t _loopstart, f_cnt_t _loopend, f_cnt_t _end ) const
 {
-	if( _loopmode == LoopOff )
+	if( m_stream )
+	{
+		// no data to point into, always fetch from stream
+	}
+	else if( _loopmode == LoopOff )
 	{
 		if( _index + _frames <= _end )
 		{
@@ -809,24 +951,24 @@ sampleFrame * SampleBuffer::getSampleFragment( f_cnt_t _index,
 		return m_data + _index;
 	}
 
-	*_tmp = MM_ALLOC( sampleFrame, _frames );
+	sampleFrame * tmp = fragmentBuffer( _frames );
 
 	if( _loopmode == LoopOff )
 	{
 		f_cnt_t available = _end - _index;
-		memcpy( *_tmp, m_data + _index, available * BYTES_PER_FRAME );
-		memset( *_tmp + available, 0, ( _frames - available ) *
+		fetchFrames( tmp, _index, available );
+		memset( tmp + available, 0, ( _frames - available ) *
 							BYTES_PER_FRAME );
 	}
 	else if( _loopmode == LoopOn )
 	{
 		f_cnt_t copied = qMin( _frames, _loopend - _index );
-		memcpy( *_tmp, m_data + _index, copied * BYTES_PER_FRAME );
+		fetchFrames( tmp, _index, copied );
 		f_cnt_t loop_frames = _loopend - _loopstart;
 		while( copied < _frames )
 		{
 			f_cnt_t todo = qMin( _frames - copied, loop_frames );
-			memcpy( *_tmp + copied, m_data + _loopstart, todo * BYTES_PER_FRAME );
+			fetchFrames( tmp + copied, _loopstart, todo );
 			copied += todo;
 		}
 	}
@@ -842,18 +984,14 @@ sampleFrame * SampleBuffer::getSampleFragment( f_cnt_t _index,
 		if( backwards )
 		{
 			copied = qMin( _frames, pos - _loopstart );
-			for( int i=0; i < copied; i++ )
-			{
-				(*_tmp)[i][0] = m_data[ pos - i ][0];
-				(*_tmp)[i][1] = m_data[ pos - i ][1];
-			}
+			fetchFramesBackwards( tmp, pos, copied );
 			pos -= copied;
 			if( pos == _loopstart ) backwards = false;
 		}
 		else
 		{
 			copied = qMin( _frames, _loopend - pos );
-			memcpy( *_tmp, m_data + pos, copied * BYTES_PER_FRAME );
+			fetchFrames( tmp, pos, copied );
 			pos += copied;
 			if( pos == _loopend ) backwards = true;
 		}
@@ -863,11 +1001,7 @@ sampleFrame * SampleBuffer::getSampleFragment( f_cnt_t _index,
 			if( backwards )
 			{
 				f_cnt_t todo = qMin( _frames - copied, pos - _loopstart );
-				for ( int i=0; i < todo; i++ )
-				{
-					(*_tmp)[ copied + i ][0] = m_data[ pos - i ][0];
-					(*_tmp)[ copied + i ][1] = m_data[ pos - i ][1];
-				}
+				fetchFramesBackwards( tmp + copied, pos, todo );
 				pos -= todo;
 				copied += todo;
 				if( pos <= _loopstart ) backwards = false;
@@ -875,7 +1009,7 @@ sampleFrame * SampleBuffer::getSampleFragment( f_cnt_t _index,
 			else
 			{
 				f_cnt_t todo = qMin( _frames - copied, _loopend - pos );
-				memcpy( *_tmp + copied, m_data + pos, todo * BYTES_PER_FRAME );
+				fetchFrames( tmp + copied, pos, todo );
 				pos += todo;
 				copied += todo;
 				if( pos >= _loopend ) backwards = true;
@@ -884,7 +1018,49 @@ sampleFrame * SampleBuffer::getSampleFragment( f_cnt_t _index,
 		*_backwards = backwards;
 	}
 
-	return *_tmp;
+	return tmp;
+}
+
+
+
+
+void SampleBuffer::fetchFrames( sampleFrame * _dst, f_cnt_t _index,
+						f_cnt_t _frames ) const
+{
+	if( m_stream )
+	{
+		m_stream->read( _dst, _index, _frames );
+	}
+	else
+	{
+		memcpy( _dst, m_data + _index, _frames * BYTES_PER_FRAME );
+	}
+}
+
+
+
+
+// fetches frames _index, _index - 1, ..., _index - _frames + 1
+void SampleBuffer::fetchFramesBackwards( sampleFrame * _dst, f_cnt_t _index,
+						f_cnt_t _frames ) const
+{
+	if( m_stream )
+	{
+		m_stream->read( _dst, _index - _frames + 1, _frames );
+		for( f_cnt_t i = 0; i < _frames / 2; ++i )
+		{
+			qSwap( _dst[i][0], _dst[_frames - 1 - i][0] );
+			qSwap( _dst[i][1], _dst[_frames - 1 - i][1] );
+		}
+	}
+	else
+	{
+		for( f_cnt_t i = 0; i < _frames; ++i )
+		{
+			_dst[i][0] = m_data[_index - i][0];
+			_dst[i][1] = m_data[_index - i][1];
+		}
+	}
 }
 
 
@@ -933,6 +1109,28 @@ void SampleBuffer::visualize( QPainter & _p, const QRect & _dr,
 	const float y_space = h*0.5f;
 	const int nb_frames = focus_on_range ? _to_frame - _from_frame : m_frames;
 
+	if( m_stream )
+	{
+		// no data in memory, so draw peaks calculated while streaming
+		const int xb = _dr.x();
+		const int first = focus_on_range ? _from_frame : 0;
+		for( int x = 0; x < w; ++x )
+		{
+			const f_cnt_t frame = first + (f_cnt_t)( x * double( nb_frames ) / w );
+			sampleFrame min, max;
+			if( !m_stream->overviewPeak( frame / STREAM_OVERVIEW_FRAMES, min, max ) )
+			{
+				continue;
+			}
+			for( ch_cnt_t ch = 0; ch < DEFAULT_CHANNELS; ++ch )
+			{
+				_p.drawLine( xb + x, (int)( yb - max[ch] * y_space * m_amplification ),
+						xb + x, (int)( yb - min[ch] * y_space * m_amplification ) );
+			}
+		}
+		return;
+	}
+
 	if( nb_frames < 60000 )
 	{
 		_p.setRenderHint( QPainter::Antialiasing );
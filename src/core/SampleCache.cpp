@@ -0,0 +1,268 @@
+/*
+ * SampleCache.cpp - process-wide cache of decoded samples
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "SampleCache.h"
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMutexLocker>
+
+#include <cstring>
+
+#include "ConfigManager.h"
+#include "MemoryManager.h"
+
+
+// header of files in disk cache, followed by frames in native byte order
+struct SampleCacheHeader
+{
+	char magic[8];
+	quint32 version;
+	quint32 frames;
+} ;
+
+static const char SampleCacheMagic[8] = { 'L', 'M', 'M', 'S', 'S', 'M', 'P', 'L' };
+static const quint32 SampleCacheVersion = 1;
+
+
+QHash<QString, CachedSample *> SampleCache::s_samples;
+QMutex SampleCache::s_mutex( QMutex::Recursive );
+
+
+
+
+CachedSample::CachedSample( const QString & key, sampleFrame * data, f_cnt_t frames ) :
+	sharedObject(),
+	m_key( key ),
+	m_data( data ),
+	m_frames( frames )
+{
+}
+
+
+
+
+CachedSample::~CachedSample()
+{
+	// only deleted from within SampleCache::release(), so s_mutex is
+	// already held (recursive)
+	QMutexLocker lock( &SampleCache::s_mutex );
+	if( SampleCache::s_samples.value( m_key ) == this )
+	{
+		SampleCache::s_samples.remove( m_key );
+	}
+
+	MM_FREE( m_data );
+}
+
+
+
+
+CachedSample * SampleCache::acquire( const QString & file,
+					sample_rate_t sampleRate, bool reversed )
+{
+	const QString k = key( file, sampleRate, reversed );
+	if( k.isEmpty() )
+	{
+		return NULL;
+	}
+
+	QMutexLocker lock( &s_mutex );
+
+	CachedSample * sample = s_samples.value( k );
+	if( sample )
+	{
+		return sharedObject::ref( sample );
+	}
+
+	if( diskCacheEnabled() )
+	{
+		sample = loadFromDisk( k );
+		if( sample )
+		{
+			s_samples[k] = sample;
+		}
+	}
+
+	return sample;
+}
+
+
+
+
+CachedSample * SampleCache::insert( const QString & file,
+					sample_rate_t sampleRate, bool reversed,
+					sampleFrame * data, f_cnt_t frames,
+					bool resampled )
+{
+	const QString k = key( file, sampleRate, reversed );
+	CachedSample * sample = new CachedSample( k, data, frames );
+	if( k.isEmpty() )
+	{
+		// file vanished meanwhile - don't share but still hand out
+		// an entry so the caller has a single way of releasing data
+		return sample;
+	}
+
+	QMutexLocker lock( &s_mutex );
+
+	// someone else might have loaded the same file in between - keep
+	// the existing entry, ours goes away with its buffer
+	if( !s_samples.contains( k ) )
+	{
+		s_samples[k] = sample;
+	}
+
+	if( resampled && diskCacheEnabled() )
+	{
+		saveToDisk( sample );
+	}
+
+	return sample;
+}
+
+
+
+
+void SampleCache::release( CachedSample * sample )
+{
+	QMutexLocker lock( &s_mutex );
+	sharedObject::unref( sample );
+}
+
+
+
+
+int SampleCache::size()
+{
+	QMutexLocker lock( &s_mutex );
+	return s_samples.size();
+}
+
+
+
+
+QString SampleCache::key( const QString & file, sample_rate_t sampleRate,
+								bool reversed )
+{
+	const QFileInfo fileInfo( file );
+	if( !fileInfo.exists() )
+	{
+		return QString();
+	}
+
+	return QString( "%1|%2|%3|%4|%5" ).
+			arg( fileInfo.canonicalFilePath() ).
+			arg( fileInfo.lastModified().toTime_t() ).
+			arg( fileInfo.size() ).
+			arg( sampleRate ).
+			arg( reversed ? 1 : 0 );
+}
+
+
+
+
+QString SampleCache::diskCacheFile( const QString & key )
+{
+	return ConfigManager::inst()->sampleCacheDir() +
+		QCryptographicHash::hash( key.toUtf8(),
+				QCryptographicHash::Md5 ).toHex() + ".raw";
+}
+
+
+
+
+bool SampleCache::diskCacheEnabled()
+{
+	return ConfigManager::inst()->value( "mixer",
+					"samplediskcache" ).toInt() != 0;
+}
+
+
+
+
+CachedSample * SampleCache::loadFromDisk( const QString & key )
+{
+	QFile f( diskCacheFile( key ) );
+	if( !f.open( QFile::ReadOnly ) )
+	{
+		return NULL;
+	}
+
+	SampleCacheHeader header;
+	if( f.read( (char *) &header, sizeof( header ) ) != sizeof( header ) ||
+		memcmp( header.magic, SampleCacheMagic, sizeof( SampleCacheMagic ) ) ||
+		header.version != SampleCacheVersion || header.frames == 0 ||
+		f.size() != (qint64)( sizeof( header ) + header.frames * sizeof( sampleFrame ) ) )
+	{
+		return NULL;
+	}
+
+	const qint64 bytes = header.frames * sizeof( sampleFrame );
+	sampleFrame * data = MM_ALLOC( sampleFrame, header.frames );
+	if( f.read( (char *) data, bytes ) != bytes )
+	{
+		MM_FREE( data );
+		return NULL;
+	}
+
+	return new CachedSample( key, data, header.frames );
+}
+
+
+
+
+void SampleCache::saveToDisk( const CachedSample * sample )
+{
+	const QString fileName = diskCacheFile( sample->m_key );
+	if( QFile::exists( fileName ) )
+	{
+		return;
+	}
+	QDir().mkpath( ConfigManager::inst()->sampleCacheDir() );
+
+	// write to temporary file first so other instances never pick up
+	// incomplete data
+	QFile f( fileName + ".tmp" );
+	if( !f.open( QFile::WriteOnly | QFile::Truncate ) )
+	{
+		return;
+	}
+
+	SampleCacheHeader header;
+	memcpy( header.magic, SampleCacheMagic, sizeof( SampleCacheMagic ) );
+	header.version = SampleCacheVersion;
+	header.frames = sample->m_frames;
+
+	const qint64 bytes = sample->m_frames * sizeof( sampleFrame );
+	const bool ok = f.write( (const char *) &header, sizeof( header ) ) == sizeof( header ) &&
+			f.write( (const char *) sample->m_data, bytes ) == bytes;
+	f.close();
+
+	if( !ok || !f.rename( fileName ) )
+	{
+		f.remove();
+	}
+}
@@ -0,0 +1,115 @@
+/*
+ * SampleConversionAVX2.cpp - AVX2 implementation of sample conversions
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "SampleConverter.h"
+
+// compiled with -mavx2 but without -mfma - fused multiply-adds would give
+// results different from the scalar reference
+#ifdef __AVX2__
+
+#include <immintrin.h>
+
+#include "SampleConversionImpl.h"
+
+
+namespace
+{
+
+struct AVX2ConversionVector
+{
+	typedef __m256 Vec;
+	typedef __m256i IVec;
+	enum { Width = 8 };
+
+	static Vec load( const float * p ) { return _mm256_loadu_ps( p ); }
+	static void store( float * p, Vec a ) { _mm256_storeu_ps( p, a ); }
+	static IVec loadInt( const void * p ) { return _mm256_loadu_si256( (const __m256i *) p ); }
+	static void storeInt( void * p, IVec a ) { _mm256_storeu_si256( (__m256i *) p, a ); }
+	static Vec set1( float x ) { return _mm256_set1_ps( x ); }
+
+	static Vec add( Vec a, Vec b ) { return _mm256_add_ps( a, b ); }
+	static Vec sub( Vec a, Vec b ) { return _mm256_sub_ps( a, b ); }
+	static Vec mul( Vec a, Vec b ) { return _mm256_mul_ps( a, b ); }
+	// both return their second operand if any of them is NaN
+	static Vec maxOf( Vec a, Vec b ) { return _mm256_max_ps( a, b ); }
+	static Vec minOf( Vec a, Vec b ) { return _mm256_min_ps( a, b ); }
+
+	static IVec round( Vec a ) { return _mm256_cvtps_epi32( a ); }
+	static Vec toFloat( IVec a ) { return _mm256_cvtepi32_ps( a ); }
+
+	static IVec xorshift( IVec x )
+	{
+		x = _mm256_xor_si256( x, _mm256_slli_epi32( x, 13 ) );
+		x = _mm256_xor_si256( x, _mm256_srli_epi32( x, 17 ) );
+		return _mm256_xor_si256( x, _mm256_slli_epi32( x, 5 ) );
+	}
+
+	static IVec shiftRight8( IVec a ) { return _mm256_srli_epi32( a, 8 ); }
+
+	static void storeS16( int16_t * p, IVec a )
+	{
+		// packs of 256 bit vectors works per 128 bit lane
+		_mm_storeu_si128( (__m128i *) p, _mm_packs_epi32(
+					_mm256_castsi256_si128( a ),
+					_mm256_extracti128_si256( a, 1 ) ) );
+	}
+
+	static IVec swap16( IVec a )
+	{
+		const IVec m = _mm256_setr_epi8(
+			1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+			1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14 );
+		return _mm256_shuffle_epi8( a, m );
+	}
+
+	static IVec swap32( IVec a )
+	{
+		const IVec m = _mm256_setr_epi8(
+			3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+			3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12 );
+		return _mm256_shuffle_epi8( a, m );
+	}
+} ;
+
+
+const SampleConversionKernels s_avx2Kernels = SAMPLE_CONVERSION_KERNELS_TABLE( "AVX2",
+					SampleConversionImpl<AVX2ConversionVector> );
+
+}
+
+
+const SampleConversionKernels * SampleConversion::avx2Kernels()
+{
+	return &s_avx2Kernels;
+}
+
+
+#else
+
+
+const SampleConversionKernels * SampleConversion::avx2Kernels()
+{
+	return NULL;
+}
+
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ * SampleConversionSSE2.cpp - SSE2 implementation of sample conversions
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "SampleConverter.h"
+
+#ifdef __SSE2__
+
+#include <emmintrin.h>
+
+#include "SampleConversionImpl.h"
+
+
+namespace
+{
+
+struct SSE2ConversionVector
+{
+	typedef __m128 Vec;
+	typedef __m128i IVec;
+	enum { Width = 4 };
+
+	static Vec load( const float * p ) { return _mm_loadu_ps( p ); }
+	static void store( float * p, Vec a ) { _mm_storeu_ps( p, a ); }
+	static IVec loadInt( const void * p ) { return _mm_loadu_si128( (const __m128i *) p ); }
+	static void storeInt( void * p, IVec a ) { _mm_storeu_si128( (__m128i *) p, a ); }
+	static Vec set1( float x ) { return _mm_set1_ps( x ); }
+
+	static Vec add( Vec a, Vec b ) { return _mm_add_ps( a, b ); }
+	static Vec sub( Vec a, Vec b ) { return _mm_sub_ps( a, b ); }
+	static Vec mul( Vec a, Vec b ) { return _mm_mul_ps( a, b ); }
+	// both return their second operand if any of them is NaN
+	static Vec maxOf( Vec a, Vec b ) { return _mm_max_ps( a, b ); }
+	static Vec minOf( Vec a, Vec b ) { return _mm_min_ps( a, b ); }
+
+	static IVec round( Vec a ) { return _mm_cvtps_epi32( a ); }
+	static Vec toFloat( IVec a ) { return _mm_cvtepi32_ps( a ); }
+
+	static IVec xorshift( IVec x )
+	{
+		x = _mm_xor_si128( x, _mm_slli_epi32( x, 13 ) );
+		x = _mm_xor_si128( x, _mm_srli_epi32( x, 17 ) );
+		return _mm_xor_si128( x, _mm_slli_epi32( x, 5 ) );
+	}
+
+	static IVec shiftRight8( IVec a ) { return _mm_srli_epi32( a, 8 ); }
+
+	static void storeS16( int16_t * p, IVec a )
+	{
+		_mm_storel_epi64( (__m128i *) p, _mm_packs_epi32( a, a ) );
+	}
+
+	static IVec swap16( IVec a )
+	{
+		return _mm_or_si128( _mm_slli_epi16( a, 8 ), _mm_srli_epi16( a, 8 ) );
+	}
+
+	static IVec swap32( IVec a )
+	{
+		// swap bytes of each half, then the halves
+		a = swap16( a );
+		return _mm_or_si128( _mm_slli_epi32( a, 16 ), _mm_srli_epi32( a, 16 ) );
+	}
+} ;
+
+
+const SampleConversionKernels s_sse2Kernels = SAMPLE_CONVERSION_KERNELS_TABLE( "SSE2",
+					SampleConversionImpl<SSE2ConversionVector> );
+
+}
+
+
+const SampleConversionKernels * SampleConversion::sse2Kernels()
+{
+	return &s_sse2Kernels;
+}
+
+
+#else
+
+
+const SampleConversionKernels * SampleConversion::sse2Kernels()
+{
+	return NULL;
+}
+
+
+#endif
@@ -0,0 +1,387 @@
+/*
+ * SampleConverter.cpp - convert mixer output to the sample formats of audio
+ *                       devices and files
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "SampleConverter.h"
+
+#include <QtCore/QtGlobal>
+
+#include "SampleConversionImpl.h"
+
+
+// scale and range of the integer formats - 2^31 - 1 isn't representable as
+// float, so S32 is scaled by 2^31 and clamped to the largest float below
+static const float S16Scale = 32767.0f;
+static const float S16Low = -32768.0f;
+static const float S16High = 32767.0f;
+static const float S24Scale = 8388607.0f;
+static const float S24Low = -8388608.0f;
+static const float S24High = 8388607.0f;
+static const float S32Scale = 2147483648.0f;
+static const float S32Low = -2147483648.0f;
+static const float S32High = 2147483520.0f;
+
+// limit of the quantization error fed back when noise shaping - it only
+// exceeds 1.5 while clipping, which must not make the filter run away
+static const float MaxShapingError = 2.0f;
+
+// frames gathered at once when converting fewer channels than the mixer has
+static const int GatherFrames = 64;
+
+
+
+// scalar reference implementation - also used on CPUs where none of the
+// vectorized kernels are supported
+
+static void scalarToS16( const float * src, int samples, float gain,
+					uint32_t * rng, int16_t * dst )
+{
+	for( int i = 0; i < samples; ++i )
+	{
+		dst[i] = conversionSample( src[i], gain, S16Scale, S16Low,
+				S16High, rng ?
+				&rng[i % SAMPLE_CONVERSION_RNG_LANES] : NULL );
+	}
+}
+
+
+static void scalarToS32( const float * src, int samples, float gain,
+				float scale, float low, float high,
+					uint32_t * rng, int32_t * dst )
+{
+	for( int i = 0; i < samples; ++i )
+	{
+		dst[i] = conversionSample( src[i], gain, scale, low, high,
+				rng ? &rng[i % SAMPLE_CONVERSION_RNG_LANES] : NULL );
+	}
+}
+
+
+static void scalarToFloat( const float * src, int samples, float gain,
+						bool clip, float * dst )
+{
+	for( int i = 0; i < samples; ++i )
+	{
+		dst[i] = clip ? conversionClip( src[i], gain ) : src[i] * gain;
+	}
+}
+
+
+static void scalarSwap16( int16_t * buf, int samples )
+{
+	for( int i = 0; i < samples; ++i )
+	{
+		buf[i] = conversionSwap16( buf[i] );
+	}
+}
+
+
+static void scalarSwap32( int32_t * buf, int samples )
+{
+	for( int i = 0; i < samples; ++i )
+	{
+		buf[i] = conversionSwap32( buf[i] );
+	}
+}
+
+
+
+
+static const SampleConversionKernels s_scalarKernels =
+{
+	"scalar",
+	&scalarToS16,
+	&scalarToS32,
+	&scalarToFloat,
+	&scalarSwap16,
+	&scalarSwap32
+} ;
+
+// constant initialized, so converters can be used before init() as well
+static const SampleConversionKernels * s_kernels = &s_scalarKernels;
+
+
+
+namespace SampleConversion
+{
+
+const SampleConversionKernels * scalarKernels()
+{
+	return &s_scalarKernels;
+}
+
+
+
+static bool cpuSupports( const SampleConversionKernels * k )
+{
+	if( k == NULL )
+	{
+		return false;
+	}
+#if defined( __GNUC__ ) && ( defined( __i386__ ) || defined( __x86_64__ ) )
+	if( k == avx2Kernels() )
+	{
+		return __builtin_cpu_supports( "avx2" );
+	}
+	if( k == sse2Kernels() )
+	{
+		return __builtin_cpu_supports( "sse2" );
+	}
+#endif
+	return true;
+}
+
+
+
+int numKernels()
+{
+	int n = 0;
+	for( int i = 0; kernels( i ) != NULL; ++i )
+	{
+		++n;
+	}
+	return n;
+}
+
+
+
+const SampleConversionKernels * kernels( int index )
+{
+	// ordered by preference, least preferred first
+	const SampleConversionKernels * all[] =
+	{
+		scalarKernels(), sse2Kernels(), avx2Kernels()
+	} ;
+
+	for( unsigned int i = 0; i < sizeof( all ) / sizeof( all[0] ); ++i )
+	{
+		if( cpuSupports( all[i] ) && index-- == 0 )
+		{
+			return all[i];
+		}
+	}
+	return NULL;
+}
+
+
+
+const SampleConversionKernels * currentKernels()
+{
+	return s_kernels;
+}
+
+
+
+void setCurrentKernels( const SampleConversionKernels * kernels )
+{
+	s_kernels = kernels ? kernels : &s_scalarKernels;
+}
+
+
+
+void init()
+{
+	setCurrentKernels( kernels( numKernels() - 1 ) );
+}
+
+
+
+const char * instructionSet()
+{
+	return s_kernels->name;
+}
+
+}
+
+
+
+
+SampleConverter::SampleConverter( Format _format, DitherMode _dither ) :
+	m_format( _format ),
+	m_dither( Dither_None )
+{
+	setDither( _dither );
+	reset();
+}
+
+
+
+
+void SampleConverter::setDither( DitherMode _dither )
+{
+	m_dither = _dither >= Dither_None && _dither < NumDitherModes ?
+							_dither : Dither_None;
+}
+
+
+
+
+int SampleConverter::bytesPerSample( Format _format )
+{
+	return _format == Format_S16 ? sizeof( int16_t ) : sizeof( int32_t );
+}
+
+
+
+
+int SampleConverter::convert( const surroundSampleFrame * _src,
+				const fpp_t _frames, const ch_cnt_t _channels,
+				const float _gain, void * _dst,
+				const bool _swap_endian )
+{
+	const int samples = _frames * _channels;
+	const int bytes = bytesPerSample( m_format );
+
+	if( m_dither == Dither_NoiseShaped &&
+		( m_format == Format_S16 || m_format == Format_S24 ) )
+	{
+		convertNoiseShaped( _src, _frames, _channels, _gain, _dst );
+	}
+	else if( _channels == SURROUND_CHANNELS )
+	{
+		convertSamples( &_src[0][0], samples, _gain, _dst );
+	}
+	else
+	{
+		// gather the channels wanted, so the kernels can run over
+		// contiguous samples
+		float block[GatherFrames * SURROUND_CHANNELS];
+		for( fpp_t f = 0; f < _frames; f += GatherFrames )
+		{
+			const int frames = qMin<int>( GatherFrames, _frames - f );
+			for( int i = 0; i < frames; ++i )
+			{
+				for( ch_cnt_t ch = 0; ch < _channels; ++ch )
+				{
+					block[i * _channels + ch] = _src[f + i][ch];
+				}
+			}
+			convertSamples( block, frames * _channels, _gain,
+				(char *) _dst + f * _channels * bytes );
+		}
+	}
+
+	if( _swap_endian )
+	{
+		if( bytes == sizeof( int16_t ) )
+		{
+			s_kernels->swap16( (int16_t *) _dst, samples );
+		}
+		else
+		{
+			s_kernels->swap32( (int32_t *) _dst, samples );
+		}
+	}
+
+	return samples * bytes;
+}
+
+
+
+
+void SampleConverter::reset()
+{
+	for( int i = 0; i < SAMPLE_CONVERSION_RNG_LANES; ++i )
+	{
+		// any non-zero seed will do for xorshift
+		m_rng[i] = 0x9e3779b9u * ( i + 1 );
+	}
+	for( int ch = 0; ch < SURROUND_CHANNELS; ++ch )
+	{
+		m_error[ch][0] = m_error[ch][1] = 0.0f;
+	}
+}
+
+
+
+
+void SampleConverter::convertSamples( const float * _src, int _samples,
+						float _gain, void * _dst )
+{
+	uint32_t * rng = m_dither != Dither_None ? m_rng : NULL;
+
+	switch( m_format )
+	{
+		case Format_S16:
+			s_kernels->toS16( _src, _samples, _gain, rng,
+							(int16_t *) _dst );
+			break;
+		case Format_S24:
+			s_kernels->toS32( _src, _samples, _gain, S24Scale,
+					S24Low, S24High, rng, (int32_t *) _dst );
+			break;
+		case Format_S32:
+			s_kernels->toS32( _src, _samples, _gain, S32Scale,
+					S32Low, S32High, NULL, (int32_t *) _dst );
+			break;
+		case Format_Float:
+		case Format_FloatUnclipped:
+			s_kernels->toFloat( _src, _samples, _gain,
+					m_format == Format_Float, (float *) _dst );
+			break;
+		default:
+			break;
+	}
+}
+
+
+
+
+// quantization error is fed back through 2 z^-1 - z^-2, so it's shaped by
+// ( 1 - z^-1 )^2 and mostly moved above the frequencies we hear best -
+// this is sequential per channel and therefore not vectorized
+void SampleConverter::convertNoiseShaped( const surroundSampleFrame * _src,
+				const fpp_t _frames, const ch_cnt_t _channels,
+					const float _gain, void * _dst )
+{
+	const bool s16 = m_format == Format_S16;
+	const float scale = s16 ? S16Scale : S24Scale;
+	const float low = s16 ? S16Low : S24Low;
+	const float high = s16 ? S16High : S24High;
+
+	for( fpp_t f = 0; f < _frames; ++f )
+	{
+		for( ch_cnt_t ch = 0; ch < _channels; ++ch )
+		{
+			float * e = m_error[ch];
+			const float v = conversionClip( _src[f][ch], _gain ) *
+								scale -
+					( 2.0f * e[0] - e[1] );
+			const int32_t q = conversionQuantize( v +
+				conversionDither( m_rng[ch %
+					SAMPLE_CONVERSION_RNG_LANES] ),
+								low, high );
+			const float error = q - v;
+			e[1] = e[0];
+			e[0] = qBound( -MaxShapingError, error, MaxShapingError );
+
+			if( s16 )
+			{
+				( (int16_t *) _dst )[f * _channels + ch] = q;
+			}
+			else
+			{
+				( (int32_t *) _dst )[f * _channels + ch] = q;
+			}
+		}
+	}
+}
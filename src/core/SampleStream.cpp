@@ -0,0 +1,783 @@
+/*
+ * SampleStream.cpp - disk streaming of large samples
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "SampleStream.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMutexLocker>
+
+#include <cstring>
+
+#include <sndfile.h>
+
+#define OV_EXCLUDE_STATIC_CALLBACKS
+#ifdef LMMS_HAVE_OGGVORBIS
+#include <vorbis/vorbisfile.h>
+#endif
+
+#include "MemoryManager.h"
+
+
+// decodes a file into stereo frames at its own sample rate
+class SampleDecoder
+{
+public:
+	virtual ~SampleDecoder()
+	{
+	}
+
+	virtual bool seek( f_cnt_t frame ) = 0;
+	// returns number of frames read, 0 at end of file
+	virtual f_cnt_t read( sampleFrame * dst, f_cnt_t frames ) = 0;
+
+	f_cnt_t frames() const
+	{
+		return m_frames;
+	}
+
+	sample_rate_t sampleRate() const
+	{
+		return m_sampleRate;
+	}
+
+	static SampleDecoder * open( const QString & file );
+
+protected:
+	f_cnt_t m_frames;
+	sample_rate_t m_sampleRate;
+	int m_channels;
+
+} ;
+
+
+
+
+class SndfileDecoder : public SampleDecoder
+{
+public:
+	SndfileDecoder( SNDFILE * file, const SF_INFO & info ) :
+		m_file( file )
+	{
+		m_frames = info.frames;
+		m_sampleRate = info.samplerate;
+		m_channels = info.channels;
+	}
+
+	virtual ~SndfileDecoder()
+	{
+		sf_close( m_file );
+	}
+
+	virtual bool seek( f_cnt_t frame )
+	{
+		return sf_seek( m_file, frame, SEEK_SET ) >= 0;
+	}
+
+	virtual f_cnt_t read( sampleFrame * dst, f_cnt_t frames )
+	{
+		m_buffer.resize( frames * m_channels );
+		const f_cnt_t n = sf_readf_float( m_file, m_buffer.data(), frames );
+
+		const int ch = ( m_channels > 1 ) ? 1 : 0;
+		const float * src = m_buffer.constData();
+		for( f_cnt_t f = 0; f < n; ++f )
+		{
+			dst[f][0] = src[0];
+			dst[f][1] = src[ch];
+			src += m_channels;
+		}
+		return n;
+	}
+
+private:
+	SNDFILE * m_file;
+	QVector<float> m_buffer;
+
+} ;
+
+
+
+
+#ifdef LMMS_HAVE_OGGVORBIS
+
+// QFile based callbacks for libvorbisfile, defined in SampleBuffer.cpp
+size_t qfileReadCallback( void * _ptr, size_t _size, size_t _n, void * _udata );
+int qfileSeekCallback( void * _udata, ogg_int64_t _offset, int _whence );
+int qfileCloseCallback( void * _udata );
+long qfileTellCallback( void * _udata );
+
+
+class VorbisDecoder : public SampleDecoder
+{
+public:
+	VorbisDecoder() :
+		m_open( false )
+	{
+		m_frames = 0;
+		m_sampleRate = 0;
+		m_channels = 0;
+	}
+
+	virtual ~VorbisDecoder()
+	{
+		if( m_open )
+		{
+			ov_clear( &m_file );
+		}
+	}
+
+	bool open( const QString & file )
+	{
+		static ov_callbacks callbacks =
+		{
+			qfileReadCallback,
+			qfileSeekCallback,
+			qfileCloseCallback,
+			qfileTellCallback
+		} ;
+
+		QFile * f = new QFile( file );
+		if( f->open( QFile::ReadOnly ) == false ||
+			ov_open_callbacks( f, &m_file, NULL, 0, callbacks ) < 0 )
+		{
+			delete f;
+			return false;
+		}
+		m_open = true;
+
+		m_frames = ov_pcm_total( &m_file, -1 );
+		m_sampleRate = ov_info( &m_file, -1 )->rate;
+		m_channels = ov_info( &m_file, -1 )->channels;
+		return m_frames > 0;
+	}
+
+	virtual bool seek( f_cnt_t frame )
+	{
+		return ov_pcm_seek( &m_file, frame ) == 0;
+	}
+
+	virtual f_cnt_t read( sampleFrame * dst, f_cnt_t frames )
+	{
+		const int ch = ( m_channels > 1 ) ? 1 : 0;
+		f_cnt_t done = 0;
+		while( done < frames )
+		{
+			float * * pcm;
+			int bitstream;
+			const long n = ov_read_float( &m_file, &pcm, frames - done, &bitstream );
+			if( n <= 0 )
+			{
+				break;
+			}
+			for( long f = 0; f < n; ++f )
+			{
+				dst[done + f][0] = pcm[0][f];
+				dst[done + f][1] = pcm[ch][f];
+			}
+			done += n;
+		}
+		return done;
+	}
+
+private:
+	OggVorbis_File m_file;
+	bool m_open;
+
+} ;
+
+#endif
+
+
+
+
+SampleDecoder * SampleDecoder::open( const QString & file )
+{
+#ifdef LMMS_HAVE_OGGVORBIS
+	// same order of decoders as in SampleBuffer::update()
+	if( QFileInfo( file ).suffix() == "ogg" )
+	{
+		VorbisDecoder * decoder = new VorbisDecoder;
+		if( decoder->open( file ) )
+		{
+			return decoder;
+		}
+		delete decoder;
+	}
+#endif
+
+#ifdef LMMS_BUILD_WIN32
+	const QByteArray f = file.toLocal8Bit();
+#else
+	const QByteArray f = file.toUtf8();
+#endif
+	SF_INFO info;
+	memset( &info, 0, sizeof( info ) );
+	SNDFILE * sndFile = sf_open( f.constData(), SFM_READ, &info );
+	if( sndFile != NULL )
+	{
+		if( info.frames > 0 && info.channels > 0 && info.seekable )
+		{
+			return new SndfileDecoder( sndFile, info );
+		}
+		sf_close( sndFile );
+	}
+
+#ifdef LMMS_HAVE_OGGVORBIS
+	VorbisDecoder * decoder = new VorbisDecoder;
+	if( decoder->open( file ) )
+	{
+		return decoder;
+	}
+	delete decoder;
+#endif
+
+	return NULL;
+}
+
+
+
+
+
+
+SampleStream::SampleStream( const QString & file, sample_rate_t targetRate, bool reversed ) :
+	m_frames( 0 ),
+	m_ratio( 1.0 ),
+	m_reversed( reversed ),
+	m_head( NULL ),
+	m_headFrames( 0 ),
+	m_headStart( 0 ),
+	m_blocks( NULL ),
+	m_position( 0 ),
+	m_underruns( 0 ),
+	m_overviewDone( 0 )
+{
+	memset( &m_stream, 0, sizeof( m_stream ) );
+	memset( &m_scan, 0, sizeof( m_scan ) );
+
+	if( !openState( m_stream, file ) )
+	{
+		return;
+	}
+
+	// deliver frames at target rate so we can stand in for resampled data
+	const sample_rate_t fileRate = m_stream.decoder->sampleRate();
+	if( fileRate != targetRate )
+	{
+		m_ratio = (double) targetRate / fileRate;
+		int error;
+		m_stream.resampler = src_new( SRC_SINC_MEDIUM_QUALITY, DEFAULT_CHANNELS, &error );
+	}
+	m_frames = static_cast<f_cnt_t>( m_stream.decoder->frames() * m_ratio );
+	if( m_frames <= 0 )
+	{
+		m_frames = 0;
+		return;
+	}
+
+	// decode the frames played first - for reversed playback these are
+	// the last ones, aligned to a block boundary
+	if( m_reversed )
+	{
+		m_headStart = qMax<f_cnt_t>( 0, ( m_frames - 1 ) / STREAM_BLOCK_FRAMES * STREAM_BLOCK_FRAMES -
+						STREAM_HEAD_FRAMES + STREAM_BLOCK_FRAMES );
+		m_headFrames = m_frames - m_headStart;
+	}
+	else
+	{
+		m_headStart = 0;
+		m_headFrames = qMin( m_frames, STREAM_HEAD_FRAMES );
+	}
+	m_head = MM_ALLOC( sampleFrame, m_headFrames );
+	decode( m_stream, m_head, m_headStart, m_headFrames );
+	m_position = m_reversed ? m_frames - 1 : 0;
+
+	m_blocks = new Block[STREAM_BLOCKS];
+	for( int b = 0; b < STREAM_BLOCKS; ++b )
+	{
+		m_blocks[b].start = -1;
+	}
+
+	// separate decoder for calculating waveform overview
+	if( openState( m_scan, file ) )
+	{
+		if( m_stream.resampler )
+		{
+			int error;
+			m_scan.resampler = src_new( SRC_SINC_FASTEST, DEFAULT_CHANNELS, &error );
+		}
+		const int peaks = ( m_frames + STREAM_OVERVIEW_FRAMES - 1 ) / STREAM_OVERVIEW_FRAMES;
+		m_overviewMin.resize( peaks * DEFAULT_CHANNELS );
+		m_overviewMax.resize( peaks * DEFAULT_CHANNELS );
+	}
+
+	SampleStreamThread::addStream( this );
+}
+
+
+
+
+SampleStream::~SampleStream()
+{
+	if( m_blocks )
+	{
+		SampleStreamThread::removeStream( this );
+	}
+
+	closeState( m_stream );
+	closeState( m_scan );
+
+	delete[] m_blocks;
+	if( m_head )
+	{
+		MM_FREE( m_head );
+	}
+}
+
+
+
+
+bool SampleStream::read( sampleFrame * dst, f_cnt_t index, f_cnt_t frames )
+{
+	bool complete = true;
+	f_cnt_t frame = m_position;
+
+	f_cnt_t done = 0;
+	while( done < frames )
+	{
+		const f_cnt_t i = index + done;
+		if( i < 0 || i >= m_frames )
+		{
+			// outside of sample - silence, but not an underrun
+			memset( dst + done, 0, ( frames - done ) * sizeof( sampleFrame ) );
+			break;
+		}
+
+		frame = m_reversed ? m_frames - 1 - i : i;
+		const f_cnt_t blockStart = frame / STREAM_BLOCK_FRAMES * STREAM_BLOCK_FRAMES;
+		const f_cnt_t offset = frame - blockStart;
+		const f_cnt_t n = qMin( frames - done, m_reversed ?
+							offset + 1 : STREAM_BLOCK_FRAMES - offset );
+
+		Block * block;
+		int stamp;
+		const sampleFrame * src = lookup( blockStart, &block, &stamp );
+		if( src )
+		{
+			if( m_reversed )
+			{
+				for( f_cnt_t f = 0; f < n; ++f )
+				{
+					dst[done + f][0] = src[offset - f][0];
+					dst[done + f][1] = src[offset - f][1];
+				}
+			}
+			else
+			{
+				memcpy( dst + done, src + offset, n * sizeof( sampleFrame ) );
+			}
+
+			// block might have been recycled while we were copying
+			if( block && block->start != stamp )
+			{
+				src = NULL;
+			}
+		}
+
+		if( src == NULL )
+		{
+			memset( dst + done, 0, n * sizeof( sampleFrame ) );
+			complete = false;
+		}
+
+		done += n;
+	}
+
+	const f_cnt_t previous = m_position.fetchAndStoreOrdered( frame );
+	if( !complete )
+	{
+		m_underruns.ref();
+	}
+	if( !complete || previous / STREAM_BLOCK_FRAMES != frame / STREAM_BLOCK_FRAMES )
+	{
+		SampleStreamThread::wakeUp();
+	}
+
+	return complete;
+}
+
+
+
+
+bool SampleStream::overviewPeak( int index, sampleFrame & min, sampleFrame & max ) const
+{
+	const int peaks = overviewSize();
+	if( index < 0 || index >= peaks )
+	{
+		return false;
+	}
+
+	if( m_reversed )
+	{
+		index = peaks - 1 - index;
+	}
+	if( index >= m_overviewDone )
+	{
+		return false;
+	}
+
+	for( ch_cnt_t ch = 0; ch < DEFAULT_CHANNELS; ++ch )
+	{
+		min[ch] = m_overviewMin[index * DEFAULT_CHANNELS + ch];
+		max[ch] = m_overviewMax[index * DEFAULT_CHANNELS + ch];
+	}
+	return true;
+}
+
+
+
+
+bool SampleStream::fill()
+{
+	const f_cnt_t position = m_position;
+	const f_cnt_t current = position / STREAM_BLOCK_FRAMES * STREAM_BLOCK_FRAMES;
+
+	// decode the first missing block in playback direction
+	for( int k = 0; k < STREAM_BLOCKS; ++k )
+	{
+		const f_cnt_t start = current + ( m_reversed ? -k : k ) * STREAM_BLOCK_FRAMES;
+		if( start < 0 || start >= m_frames )
+		{
+			break;
+		}
+
+		Block * block;
+		int stamp;
+		if( lookup( start, &block, &stamp ) )
+		{
+			continue;
+		}
+
+		for( int b = 0; b < STREAM_BLOCKS; ++b )
+		{
+			const f_cnt_t s = m_blocks[b].start;
+			if( s < 0 || !wanted( s, position ) )
+			{
+				m_blocks[b].start.fetchAndStoreOrdered( -1 );
+				decode( m_stream, m_blocks[b].frames, start, STREAM_BLOCK_FRAMES );
+				m_blocks[b].start.fetchAndStoreOrdered( start );
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// everything around play position is there, continue with overview
+	const int peaks = m_overviewMin.size() / DEFAULT_CHANNELS;
+	const int done = m_overviewDone;
+	if( done < peaks )
+	{
+		const int n = qMin<int>( peaks - done, STREAM_BLOCK_FRAMES / STREAM_OVERVIEW_FRAMES );
+		sampleFrame * buf = MM_ALLOC( sampleFrame, n * STREAM_OVERVIEW_FRAMES );
+		decode( m_scan, buf, done * STREAM_OVERVIEW_FRAMES, n * STREAM_OVERVIEW_FRAMES );
+
+		for( int p = 0; p < n; ++p )
+		{
+			const sampleFrame * src = buf + p * STREAM_OVERVIEW_FRAMES;
+			for( ch_cnt_t ch = 0; ch < DEFAULT_CHANNELS; ++ch )
+			{
+				sample_t min = src[0][ch];
+				sample_t max = src[0][ch];
+				for( f_cnt_t f = 1; f < STREAM_OVERVIEW_FRAMES; ++f )
+				{
+					min = qMin( min, src[f][ch] );
+					max = qMax( max, src[f][ch] );
+				}
+				m_overviewMin[( done + p ) * DEFAULT_CHANNELS + ch] = min;
+				m_overviewMax[( done + p ) * DEFAULT_CHANNELS + ch] = max;
+			}
+		}
+		MM_FREE( buf );
+
+		m_overviewDone.fetchAndStoreOrdered( done + n );
+		return true;
+	}
+
+	return false;
+}
+
+
+
+
+bool SampleStream::openState( DecodeState & state, const QString & file )
+{
+	state.decoder = SampleDecoder::open( file );
+	if( state.decoder == NULL )
+	{
+		return false;
+	}
+
+	state.resampler = NULL;
+	state.nextFrame = -1;
+	state.input = MM_ALLOC( sampleFrame, STREAM_BLOCK_FRAMES );
+	state.inputFrames = 0;
+	state.inputOffset = 0;
+
+	return true;
+}
+
+
+
+
+void SampleStream::closeState( DecodeState & state )
+{
+	delete state.decoder;
+	if( state.resampler )
+	{
+		src_delete( state.resampler );
+	}
+	if( state.input )
+	{
+		MM_FREE( state.input );
+	}
+	memset( &state, 0, sizeof( state ) );
+}
+
+
+
+
+void SampleStream::decode( DecodeState & state, sampleFrame * dst, f_cnt_t start, f_cnt_t frames )
+{
+	f_cnt_t done = 0;
+
+	if( state.resampler == NULL )
+	{
+		if( start != state.nextFrame )
+		{
+			state.decoder->seek( start );
+		}
+		while( done < frames )
+		{
+			const f_cnt_t n = state.decoder->read( dst + done, frames - done );
+			if( n <= 0 )
+			{
+				break;
+			}
+			done += n;
+		}
+	}
+	else
+	{
+		if( start != state.nextFrame )
+		{
+			state.decoder->seek( static_cast<f_cnt_t>( start / m_ratio ) );
+			src_reset( state.resampler );
+			state.inputFrames = 0;
+			state.inputOffset = 0;
+		}
+
+		bool endOfInput = false;
+		while( done < frames )
+		{
+			if( state.inputOffset == state.inputFrames && !endOfInput )
+			{
+				state.inputFrames = state.decoder->read( state.input, STREAM_BLOCK_FRAMES );
+				state.inputOffset = 0;
+				endOfInput = state.inputFrames <= 0;
+				state.inputFrames = qMax<long>( state.inputFrames, 0 );
+			}
+
+			SRC_DATA src_data;
+			src_data.data_in = state.input[state.inputOffset];
+			src_data.input_frames = state.inputFrames - state.inputOffset;
+			src_data.data_out = dst[done];
+			src_data.output_frames = frames - done;
+			src_data.src_ratio = m_ratio;
+			src_data.end_of_input = endOfInput ? 1 : 0;
+			if( src_process( state.resampler, &src_data ) )
+			{
+				break;
+			}
+			state.inputOffset += src_data.input_frames_used;
+			done += src_data.output_frames_gen;
+
+			if( endOfInput && src_data.output_frames_gen == 0 )
+			{
+				break;
+			}
+		}
+	}
+
+	memset( dst + done, 0, ( frames - done ) * sizeof( sampleFrame ) );
+	state.nextFrame = start + frames;
+}
+
+
+
+
+bool SampleStream::wanted( f_cnt_t blockStart, f_cnt_t position ) const
+{
+	const f_cnt_t current = position / STREAM_BLOCK_FRAMES * STREAM_BLOCK_FRAMES;
+	const f_cnt_t distance = m_reversed ? current - blockStart : blockStart - current;
+	return distance >= 0 && distance < STREAM_BLOCKS * STREAM_BLOCK_FRAMES;
+}
+
+
+
+
+const sampleFrame * SampleStream::lookup( f_cnt_t blockStart, Block * * block, int * stamp ) const
+{
+	*block = NULL;
+	*stamp = -1;
+
+	if( blockStart >= m_headStart && blockStart < m_headStart + m_headFrames )
+	{
+		return m_head + ( blockStart - m_headStart );
+	}
+
+	for( int b = 0; b < STREAM_BLOCKS; ++b )
+	{
+		if( m_blocks[b].start == blockStart )
+		{
+			*block = &m_blocks[b];
+			*stamp = blockStart;
+			return m_blocks[b].frames;
+		}
+	}
+
+	return NULL;
+}
+
+
+
+
+
+
+SampleStreamThread * SampleStreamThread::s_instance = NULL;
+QMutex SampleStreamThread::s_instanceMutex;
+
+
+SampleStreamThread::SampleStreamThread() :
+	QThread(),
+	m_streams(),
+	m_streamsMutex(),
+	m_wakeUp(),
+	m_quit( false )
+{
+}
+
+
+
+
+SampleStreamThread::~SampleStreamThread()
+{
+	m_quit = true;
+	m_wakeUp.release();
+	wait();
+}
+
+
+
+
+void SampleStreamThread::addStream( SampleStream * stream )
+{
+	QMutexLocker lock( &s_instanceMutex );
+
+	if( s_instance == NULL )
+	{
+		s_instance = new SampleStreamThread;
+		s_instance->start();
+	}
+
+	s_instance->m_streamsMutex.lock();
+	s_instance->m_streams << stream;
+	s_instance->m_streamsMutex.unlock();
+
+	s_instance->m_wakeUp.release();
+}
+
+
+
+
+void SampleStreamThread::removeStream( SampleStream * stream )
+{
+	QMutexLocker lock( &s_instanceMutex );
+
+	if( s_instance == NULL )
+	{
+		return;
+	}
+
+	s_instance->m_streamsMutex.lock();
+	s_instance->m_streams.removeAll( stream );
+	const bool empty = s_instance->m_streams.isEmpty();
+	s_instance->m_streamsMutex.unlock();
+
+	// no need to keep the thread around without any streams
+	if( empty )
+	{
+		delete s_instance;
+		s_instance = NULL;
+	}
+}
+
+
+
+
+void SampleStreamThread::wakeUp()
+{
+	// called from audio threads, so don't wait for addStream() or
+	// removeStream() - the thread polls its streams regularly anyway
+	if( s_instanceMutex.tryLock() )
+	{
+		if( s_instance )
+		{
+			s_instance->m_wakeUp.release();
+		}
+		s_instanceMutex.unlock();
+	}
+}
+
+
+
+
+void SampleStreamThread::run()
+{
+	while( !m_quit )
+	{
+		bool busy = false;
+
+		m_streamsMutex.lock();
+		foreach( SampleStream * stream, m_streams )
+		{
+			busy |= stream->fill();
+		}
+		m_streamsMutex.unlock();
+
+		if( !busy )
+		{
+			// sleep until a reader moves on to the next block
+			m_wakeUp.tryAcquire( 1, 100 );
+			m_wakeUp.tryAcquire( m_wakeUp.available() );
+		}
+	}
+}
@@ -99,7 +99,9 @@ Song::Song() :
 	m_loopPattern( false ),
 	m_elapsedMilliSeconds( 0 ),
 	m_elapsedTicks( 0 ),
-	m_elapsedTacts( 0 )
+	m_elapsedTacts( 0 ),
+	m_sampleExactAutomation( ConfigManager::inst()->value( "mixer",
+					"sampleexactautomation" ).toInt() )
 {
 	connect( &m_tempoModel, SIGNAL( dataChanged() ),
 						this, SLOT( setTempo() ) );
@@ -146,8 +148,8 @@ void Song::setTempo()
 {
 	Engine::mixer()->lockPlayHandleRemoval();
 	const bpm_t tempo = (bpm_t) m_tempoModel.value();
-	PlayHandleList & playHandles = Engine::mixer()->playHandles();
-	for( PlayHandleList::Iterator it = playHandles.begin();
+	LinkedPlayHandleList & playHandles = Engine::mixer()->playHandles();
+	for( LinkedPlayHandleList::Iterator it = playHandles.begin();
 						it != playHandles.end(); ++it )
 	{
 		NotePlayHandle * nph = dynamic_cast<NotePlayHandle *>( *it );
@@ -349,6 +351,12 @@ void Song::processNextBuffer()
 		// skip last frame fraction
 		if( last_frames == 0 )
 		{
+			if( m_sampleExactAutomation )
+			{
+				processAutomationBuffers( track_list, tco_num,
+							current_frame, 1,
+							total_frames_played );
+			}
 			++total_frames_played;
 			m_playPos[m_playMode].setCurrentFrame( current_frame
 								+ 1.0f );
@@ -363,6 +371,14 @@ void Song::processNextBuffer()
 			played_frames = last_frames;
 		}
 
+		// before playing tracks, so models still have their previous
+		// value for frames in front of automation starting here
+		if( m_sampleExactAutomation )
+		{
+			processAutomationBuffers( track_list, tco_num, current_frame,
+						played_frames, total_frames_played );
+		}
+
 		if( (f_cnt_t) current_frame == 0 )
 		{
 			if( m_playMode == Mode_PlaySong )
@@ -392,6 +408,36 @@ void Song::processNextBuffer()
 	}
 }
 
+
+
+
+void Song::processAutomationBuffers( const TrackList & _tracks, int _tco_num,
+					float _current_frame, f_cnt_t _frames,
+					f_cnt_t _frame_base )
+{
+	const float tick = m_playPos[m_playMode].getTicks() +
+				_current_frame / Engine::framesPerTick();
+
+	if( m_playMode == Mode_PlaySong )
+	{
+		m_globalAutomationTrack->processValueBuffers( tick, _frames,
+							_frame_base, _tco_num );
+	}
+
+	for( int i = 0; i < _tracks.size(); ++i )
+	{
+		if( _tracks[i]->type() == Track::AutomationTrack )
+		{
+			static_cast<AutomationTrack *>( _tracks[i] )->
+				processValueBuffers( tick, _frames,
+							_frame_base, _tco_num );
+		}
+	}
+}
+
+
+
+
 bool Song::isExportDone() const
 {
 	if ( m_renderBetweenMarkers )
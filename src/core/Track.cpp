@@ -1817,7 +1817,11 @@ Track::Track( TrackTypes _type, TrackContainer * _tc ) :
 	m_soloModel( false, this, tr( "Solo" ) ),
 					/*!< For controlling track soloing */
 	m_simpleSerializingMode( false ),
-	m_trackContentObjects()         /*!< The track content objects (segments) */
+	m_trackContentObjects(),        /*!< The track content objects (segments) */
+	m_tcoIndex(),
+	m_tcoIndexValid( 0 ),
+	m_processingLock( QMutex::Recursive ),
+	m_beingDestroyed( false )
 {
 	m_trackContainer->addTrack( this );
 	m_height = -1;
@@ -1839,6 +1843,7 @@ Track::Track( TrackTypes _type, TrackContainer * _tc ) :
 Track::~Track()
 {
 	lock();
+	m_beingDestroyed = true;
 	emit destroyedTrack();
 
 	while( !m_trackContentObjects.isEmpty() )
@@ -2054,7 +2059,15 @@ void Track::loadSettings( const QDomElement & _this )
  */
 TrackContentObject * Track::addTCO( TrackContentObject * _tco )
 {
+	lock();
 	m_trackContentObjects.push_back( _tco );
+	invalidateTCOIndex();
+	unlock();
+
+	connect( _tco, SIGNAL( positionChanged() ),
+			this, SLOT( invalidateTCOIndex() ), Qt::DirectConnection );
+	connect( _tco, SIGNAL( lengthChanged() ),
+			this, SLOT( invalidateTCOIndex() ), Qt::DirectConnection );
 
 	emit trackContentObjectAdded( _tco );
 
@@ -2070,17 +2083,23 @@ TrackContentObject * Track::addTCO( TrackContentObject * _tco )
  */
 void Track::removeTCO( TrackContentObject * _tco )
 {
+	// play() iterates our TCOs with us locked
+	lock();
 	tcoVector::iterator it = qFind( m_trackContentObjects.begin(),
 					m_trackContentObjects.end(),
 					_tco );
-	if( it != m_trackContentObjects.end() )
+	const bool found = it != m_trackContentObjects.end();
+	if( found )
 	{
 		m_trackContentObjects.erase( it );
-		if( Engine::getSong() )
-		{
-			Engine::getSong()->updateLength();
-			Engine::getSong()->setModified();
-		}
+		invalidateTCOIndex();
+	}
+	unlock();
+
+	if( found && Engine::getSong() )
+	{
+		Engine::getSong()->updateLength();
+		Engine::getSong()->setModified();
 	}
 }
 
@@ -2088,10 +2107,12 @@ void Track::removeTCO( TrackContentObject * _tco )
 /*! \brief Remove all TCOs from this track */
 void Track::deleteTCOs()
 {
+	lock();
 	while( ! m_trackContentObjects.isEmpty() )
 	{
 		delete m_trackContentObjects.first();
 	}
+	unlock();
 }
 
 
@@ -2162,12 +2183,13 @@ int Track::getTCONum( const TrackContentObject * _tco )
 
 /*! \brief Retrieve a list of trackContentObjects that fall within a period.
  *
- *  Here we're interested in a range of trackContentObjects that fall
- *  completely within a given time period - their start must be no earlier
- *  than the given start time and their end must be no later than the given
- *  end time.
+ *  Here we're interested in all trackContentObjects that overlap a given
+ *  time period - their start must be no later than the given end time and
+ *  their end must be no earlier than the given start time.
  *
- *  We return the TCOs we find in order by time, earliest TCOs first.
+ *  Found TCOs are appended in order by time, earliest TCOs first. The
+ *  search uses an index sorted by start position, so it takes logarithmic
+ *  time plus time for TCOs actually overlapping the period.
  *
  *  \param _tco_c The list to contain the found trackContentObjects.
  *  \param _start The MIDI start time of the range.
@@ -2176,35 +2198,77 @@ int Track::getTCONum( const TrackContentObject * _tco )
 void Track::getTCOsInRange( tcoVector & _tco_v, const MidiTime & _start,
 							const MidiTime & _end )
 {
-	for( tcoVector::iterator it_o = m_trackContentObjects.begin();
-				it_o != m_trackContentObjects.end(); ++it_o )
+	// mark as valid before building, so changes made meanwhile
+	// invalidate again
+	if( m_tcoIndexValid.fetchAndStoreOrdered( 1 ) == 0 )
 	{
-		TrackContentObject * tco = ( *it_o );
-		int s = tco->startPosition();
-		int e = tco->endPosition();
-		if( ( s <= _end ) && ( e >= _start ) )
+		updateTCOIndex();
+	}
+
+	const TCOIndexEntry * index = m_tcoIndex.constData();
+	const int count = m_tcoIndex.size();
+	const tick_t start = _start;
+	const tick_t end = _end;
+
+	// maxEnd is ascending - search first entry which is (or follows) a
+	// TCO ending at or behind start, all TCOs in front of it end earlier
+	int first = 0;
+	int last = count;
+	while( first < last )
+	{
+		const int mid = ( first + last ) / 2;
+		if( index[mid].maxEnd < start )
 		{
-			// ok, TCO is posated within given range
-			// now let's search according position for TCO in list
-			// 	-> list is ordered by TCO's position afterwards
-			bool inserted = false;
-			for( tcoVector::iterator it = _tco_v.begin();
-						it != _tco_v.end(); ++it )
-			{
-				if( ( *it )->startPosition() >= s )
-				{
-					_tco_v.insert( it, tco );
-					inserted = true;
-					break;
-				}
-			}
-			if( inserted == false )
-			{
-				// no TCOs found posated behind current TCO...
-				_tco_v.push_back( tco );
-			}
+			first = mid + 1;
+		}
+		else
+		{
+			last = mid;
 		}
 	}
+
+	for( int i = first; i < count && index[i].start <= end; ++i )
+	{
+		if( index[i].end >= start )
+		{
+			_tco_v.push_back( index[i].tco );
+		}
+	}
+}
+
+
+
+
+void Track::invalidateTCOIndex()
+{
+	m_tcoIndexValid = 0;
+}
+
+
+
+
+void Track::updateTCOIndex()
+{
+	// keep allocated memory, we're usually called by the mixer thread
+	m_tcoIndex.resize( 0 );
+
+	for( tcoVector::const_iterator it = m_trackContentObjects.begin();
+				it != m_trackContentObjects.end(); ++it )
+	{
+		TCOIndexEntry e = { ( *it )->startPosition(),
+					( *it )->endPosition(), 0, *it };
+		m_tcoIndex.push_back( e );
+	}
+
+	qStableSort( m_tcoIndex.begin(), m_tcoIndex.end() );
+
+	tick_t maxEnd = 0;
+	for( int i = 0; i < m_tcoIndex.size(); ++i )
+	{
+		maxEnd = i > 0 ? qMax( maxEnd, m_tcoIndex[i].end ) :
+							m_tcoIndex[i].end;
+		m_tcoIndex[i].maxEnd = maxEnd;
+	}
 }
 
 
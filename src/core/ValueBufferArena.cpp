@@ -0,0 +1,89 @@
+/*
+ * ValueBufferArena.cpp - per-period storage for sample-exact model values
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "ValueBufferArena.h"
+
+#include <QtCore/QtGlobal>
+
+
+QAtomicPointer<float> ValueBufferArena::s_blocks[VBA_MAX_BLOCKS];
+QAtomicInt ValueBufferArena::s_used = 0;
+int ValueBufferArena::s_highWaterMark = 0;
+
+
+
+
+float * ValueBufferArena::alloc( int length )
+{
+	length = ( length + VBA_ALIGN_FLOATS - 1 ) / VBA_ALIGN_FLOATS *
+							VBA_ALIGN_FLOATS;
+	if( length <= 0 || length > VBA_BLOCK_FLOATS )
+	{
+		return NULL;
+	}
+
+	int used;
+	int offset;
+	do
+	{
+		used = s_used;
+		offset = used;
+		// buffers never span two blocks - start at the next one if
+		// the rest of the current block is too small
+		if( offset % VBA_BLOCK_FLOATS + length > VBA_BLOCK_FLOATS )
+		{
+			offset = ( offset / VBA_BLOCK_FLOATS + 1 ) *
+							VBA_BLOCK_FLOATS;
+		}
+		if( offset + length > VBA_BLOCK_FLOATS * VBA_MAX_BLOCKS )
+		{
+			return NULL;
+		}
+	} while( !s_used.testAndSetOrdered( used, offset + length ) );
+
+	// blocks are only added by reset(), so rendering never allocates -
+	// what we used counts for the high water mark nevertheless, so the
+	// next period gets the block
+	float * b = s_blocks[offset / VBA_BLOCK_FLOATS];
+	return b ? b + offset % VBA_BLOCK_FLOATS : NULL;
+}
+
+
+
+
+void ValueBufferArena::reset()
+{
+	s_highWaterMark = qMax<int>( s_highWaterMark, s_used );
+	s_used = 0;
+
+	// allocate blocks needed for the next period now, in between periods
+	const int blocks = qMin( s_highWaterMark / VBA_BLOCK_FLOATS + 1,
+							VBA_MAX_BLOCKS );
+	for( int i = 0; i < blocks; ++i )
+	{
+		if( s_blocks[i] == NULL )
+		{
+			s_blocks[i].fetchAndStoreOrdered( new float[VBA_BLOCK_FLOATS] );
+		}
+	}
+}
@@ -27,6 +27,7 @@
 #include "AudioDevice.h"
 #include "ConfigManager.h"
 #include "debug.h"
+#include "RenderTrace.h"
 
 
 
@@ -35,7 +36,10 @@ AudioDevice::AudioDevice( const ch_cnt_t _channels, Mixer*  _mixer ) :
 	m_sampleRate( _mixer->processingSampleRate() ),
 	m_channels( _channels ),
 	m_mixer( _mixer ),
-	m_buffer( new surroundSampleFrame[mixer()->framesPerPeriod()] )
+	m_buffer( new surroundSampleFrame[mixer()->framesPerPeriod()] ),
+	m_converter( SampleConverter::Format_S16,
+		(SampleConverter::DitherMode) ConfigManager::inst()->value(
+					"mixer", "dither" ).toInt() )
 {
 	int error;
 	if( ( m_srcState = src_new(
@@ -66,6 +70,7 @@ void AudioDevice::processNextBuffer()
 	const fpp_t frames = getNextBuffer( m_buffer );
 	if( frames )
 	{
+		RenderTraceScope trace( RenderTrace::CategoryDevice, "writeBuffer", this );
 		writeBuffer( m_buffer, frames, mixer()->masterGain() );
 	}
 	else
@@ -79,10 +84,14 @@ void AudioDevice::processNextBuffer()
 
 fpp_t AudioDevice::getNextBuffer( surroundSampleFrame * _ab )
 {
+	// called from the callbacks of the drivers
+	RenderTraceScope trace( RenderTrace::CategoryDevice, "getNextBuffer", this );
+
 	fpp_t frames = mixer()->framesPerPeriod();
 	const surroundSampleFrame * b = mixer()->nextBuffer();
 	if( !b )
 	{
+		mixer()->releaseNextBuffer();
 		return 0;
 	}
 
@@ -105,10 +114,8 @@ fpp_t AudioDevice::getNextBuffer( surroundSampleFrame * _ab )
 	// release lock
 	unlock();
 
-	if( mixer()->hasFifoWriter() )
-	{
-		delete[] b;
-	}
+	// hand buffer back to fifoWriter
+	mixer()->releaseNextBuffer();
 
 	return frames;
 }
@@ -199,37 +206,23 @@ int AudioDevice::convertToS16( const surroundSampleFrame * _ab,
 								int_sample_t * _output_buffer,
 								const bool _convert_endian )
 {
-	if( _convert_endian )
-	{
-		int_sample_t temp;
-		for( fpp_t frame = 0; frame < _frames; ++frame )
-		{
-			for( ch_cnt_t chnl = 0; chnl < channels(); ++chnl )
-			{
-				temp = static_cast<int_sample_t>( Mixer::clip( _ab[frame][chnl] * _master_gain ) * OUTPUT_SAMPLE_MULTIPLIER );
-				
-				( _output_buffer + frame * channels() )[chnl] =
-						( temp & 0x00ff ) << 8 |
-						( temp & 0xff00 ) >> 8;
-			}
-		}
-	}
-	else
-	{
-		for( fpp_t frame = 0; frame < _frames; ++frame )
-		{
-			for( ch_cnt_t chnl = 0; chnl < channels(); ++chnl )
-			{
-				( _output_buffer + frame * channels() )[chnl] =
-						static_cast<int_sample_t>(
-						Mixer::clip( _ab[frame][chnl] *
-						_master_gain ) *
-						OUTPUT_SAMPLE_MULTIPLIER );
-			}
-		}
-	}
+	return convertBuffer( _ab, _frames, _master_gain, _output_buffer,
+				SampleConverter::Format_S16, _convert_endian );
+}
+
 
-	return _frames * channels() * BYTES_PER_INT_SAMPLE;
+
+
+int AudioDevice::convertBuffer( const surroundSampleFrame * _ab,
+						const fpp_t _frames,
+						const float _master_gain,
+						void * _output_buffer,
+						SampleConverter::Format _format,
+						const bool _convert_endian )
+{
+	m_converter.setFormat( _format );
+	return m_converter.convert( _ab, _frames, channels(), _master_gain,
+					_output_buffer, _convert_endian );
 }
 
 
@@ -24,7 +24,6 @@
  */
 
 #include "AudioFileWave.h"
-#include "endian_handling.h"
 
 
 AudioFileWave::AudioFileWave( const sample_rate_t _sample_rate,
@@ -90,22 +89,16 @@ void AudioFileWave::writeBuffer( const surroundSampleFrame * _ab,
 	if( depth() == 32 )
 	{
 		float *  buf = new float[_frames*channels()];
-		for( fpp_t frame = 0; frame < _frames; ++frame )
-		{
-			for( ch_cnt_t chnl = 0; chnl < channels(); ++chnl )
-			{
-				buf[frame*channels()+chnl] = _ab[frame][chnl] *
-								_master_gain;
-			}
-		}
+		convertBuffer( _ab, _frames, _master_gain, buf,
+					SampleConverter::Format_FloatUnclipped );
 		sf_writef_float( m_sf, buf, _frames );
 		delete[] buf;
 	}
 	else
 	{
+		// libsndfile takes samples in host byte order
 		int_sample_t * buf = new int_sample_t[_frames * channels()];
-		convertToS16( _ab, _frames, _master_gain, buf,
-							!isLittleEndian() );
+		convertToS16( _ab, _frames, _master_gain, buf );
 
 		sf_writef_short( m_sf, buf, _frames );
 		delete[] buf;
@@ -28,6 +28,7 @@
 #include "FxMixer.h"
 #include "Engine.h"
 #include "MixHelpers.h"
+#include "MixerWorkerThread.h"
 #include "BufferManager.h"
 #include "ValueBuffer.h"
 #include "panning.h"
@@ -40,11 +41,17 @@ AudioPort::AudioPort( const QString & _name, bool _has_effect_chain,
 	m_portBuffer( NULL ),
 	m_extOutputEnabled( false ),
 	m_nextFxChannel( 0 ),
+	m_pendingInputs( 0 ),
+	m_graphFxChannel( 0 ),
 	m_name( "unnamed port" ),
 	m_effects( _has_effect_chain ? new EffectChain( NULL ) : NULL ),
 	m_volumeModel( volumeModel ),
 	m_panningModel( panningModel ),
-	m_mutedModel( mutedModel )
+	m_mutedModel( mutedModel ),
+	m_profilerNode( Engine::mixer()->profiler().registerNode(
+					MixerProfiler::NodeAudioPort, _name ) ),
+	m_playHandleProfilerNode( Engine::mixer()->profiler().registerNode(
+					MixerProfiler::NodePlayHandle, _name ) )
 {
 	Engine::mixer()->addAudioPort( this );
 	setExtOutputEnabled( true );
@@ -55,9 +62,20 @@ AudioPort::AudioPort( const QString & _name, bool _has_effect_chain,
 
 AudioPort::~AudioPort()
 {
-	setExtOutputEnabled( false );
-	Engine::mixer()->removeAudioPort( this );
+	// ports of objects outliving the mixer have nothing to unregister from
+	Mixer * mixer = Engine::mixer();
+	if( mixer )
+	{
+		setExtOutputEnabled( false );
+		mixer->removeAudioPort( this );
+	}
 	delete m_effects;
+
+	if( mixer )
+	{
+		mixer->profiler().unregisterNode( m_profilerNode );
+		mixer->profiler().unregisterNode( m_playHandleProfilerNode );
+	}
 }
 
 
@@ -86,6 +104,8 @@ void AudioPort::setName( const QString & _name )
 {
 	m_name = _name;
 	Engine::mixer()->audioDev()->renamePort( this );
+	Engine::mixer()->profiler().setNodeName( m_profilerNode, _name );
+	Engine::mixer()->profiler().setNodeName( m_playHandleProfilerNode, _name );
 }
 
 
@@ -106,22 +126,43 @@ void AudioPort::doProcessing()
 {
 	if( m_mutedModel && m_mutedModel->value() )
 	{
+		// play handles were processed nevertheless, so give back their buffers
+		m_playHandleLock.lock();
+		foreach( PlayHandle * ph, m_playHandles )
+		{
+			ph->releaseBuffer();
+		}
+		m_playHandleLock.unlock();
+
+		Engine::fxMixer()->channelInputDone( m_graphFxChannel );
 		return;
 	}
 
 	const fpp_t fpp = Engine::mixer()->framesPerPeriod();
 
-	m_portBuffer = BufferManager::acquire(); // get buffer for processing
+	// effects are timed on their own
+	MixerProfilerNodeTimer timer( Engine::mixer()->profiler(), m_profilerNode );
 
-	Engine::mixer()->clearAudioBuffer( m_portBuffer, fpp ); // clear the audioport buffer so we can use it
+	// play handles might be added from other threads at any time
+	m_playHandleLock.lock();
+	const PlayHandleList playHandles = m_playHandles;
+	m_playHandleLock.unlock();
+
+	// only get a buffer once a play handle actually delivers a signal
+	m_portBuffer = NULL;
 
 	//qDebug( "Playhandles: %d", m_playHandles.size() );
-	foreach( PlayHandle * ph, m_playHandles ) // now we mix all playhandle buffers into the audioport buffer
+	foreach( PlayHandle * ph, playHandles ) // now we mix all playhandle buffers into the audioport buffer
 	{
 		if( ph->buffer() )
 		{
-			if( ph->usesBuffer() )
+			if( ph->usesBuffer() && !ph->isSilent() )
 			{
+				if( m_portBuffer == NULL )
+				{
+					m_portBuffer = BufferManager::acquire( this ); // get buffer for processing
+					Engine::mixer()->clearAudioBuffer( m_portBuffer, fpp ); // clear the audioport buffer so we can use it
+				}
 				m_bufferUsage = true;
 				MixHelpers::add( m_portBuffer, ph->buffer(), fpp );
 			}
@@ -130,104 +171,74 @@ void AudioPort::doProcessing()
 		}
 	}
 
-	if( m_bufferUsage )
+	// without input and without effects having a tail to play there's
+	// nothing to send to the FX channel
+	if( !m_bufferUsage && !( m_effects && m_effects->isRunning() ) )
 	{
-		// handle volume and panning
-		// has both vol and pan models
-		if( m_volumeModel && m_panningModel )
-		{
-			ValueBuffer * volBuf = m_volumeModel->valueBuffer();
-			ValueBuffer * panBuf = m_panningModel->valueBuffer();
-
-			// both vol and pan have s.ex.data:
-			if( volBuf && panBuf )
-			{
-				for( f_cnt_t f = 0; f < fpp; ++f )
-				{
-					float v = volBuf->values()[ f ] * 0.01f;
-					float p = panBuf->values()[ f ] * 0.01f;
-					m_portBuffer[f][0] *= ( p <= 0 ? 1.0f : 1.0f - p ) * v;
-					m_portBuffer[f][1] *= ( p >= 0 ? 1.0f : 1.0f + p ) * v;
-				}
-			}
-
-			// only vol has s.ex.data:
-			else if( volBuf )
-			{
-				float p = m_panningModel->value() * 0.01f;
-				float l = ( p <= 0 ? 1.0f : 1.0f - p );
-				float r = ( p >= 0 ? 1.0f : 1.0f + p );
-				for( f_cnt_t f = 0; f < fpp; ++f )
-				{
-					float v = volBuf->values()[ f ] * 0.01f;
-					m_portBuffer[f][0] *= v * l;
-					m_portBuffer[f][1] *= v * r;
-				}
-			}
-
-			// only pan has s.ex.data:
-			else if( panBuf )
-			{
-				float v = m_volumeModel->value() * 0.01f;
-				for( f_cnt_t f = 0; f < fpp; ++f )
-				{
-					float p = panBuf->values()[ f ] * 0.01f;
-					m_portBuffer[f][0] *= ( p <= 0 ? 1.0f : 1.0f - p ) * v;
-					m_portBuffer[f][1] *= ( p >= 0 ? 1.0f : 1.0f + p ) * v;
-				}
-			}
-
-			// neither has s.ex.data:
-			else
-			{
-				float p = m_panningModel->value() * 0.01f;
-				float v = m_volumeModel->value() * 0.01f;
-				for( f_cnt_t f = 0; f < fpp; ++f )
-				{
-					m_portBuffer[f][0] *= ( p <= 0 ? 1.0f : 1.0f - p ) * v;
-					m_portBuffer[f][1] *= ( p >= 0 ? 1.0f : 1.0f + p ) * v;
-				}
-			}
-		}
+		Engine::mixer()->profiler().countNode( MixerProfiler::NodeAudioPort, true );
+		Engine::fxMixer()->channelInputDone( m_graphFxChannel );
+		return;
+	}
+	Engine::mixer()->profiler().countNode( MixerProfiler::NodeAudioPort, false );
 
-		// has vol model only
-		else if( m_volumeModel )
-		{
-			ValueBuffer * volBuf = m_volumeModel->valueBuffer();
+	if( m_portBuffer == NULL )
+	{
+		m_portBuffer = BufferManager::acquire( this );
+		Engine::mixer()->clearAudioBuffer( m_portBuffer, fpp );
+	}
 
-			if( volBuf )
-			{
-				for( f_cnt_t f = 0; f < fpp; ++f )
-				{
-					float v = volBuf->values()[ f ] * 0.01f;
-					m_portBuffer[f][0] *= v;
-					m_portBuffer[f][1] *= v;
-				}
-			}
-			else
-			{
-				float v = m_volumeModel->value() * 0.01f;
-				for( f_cnt_t f = 0; f < fpp; ++f )
-				{
-					m_portBuffer[f][0] *= v;
-					m_portBuffer[f][1] *= v;
-				}
-			}
-		}
+	if( m_bufferUsage && m_volumeModel )
+	{
+		// handle volume and panning - as of now there's no situation
+		// where we only have panning model but no volume model
+		MixHelpers::multiplyByVolumeAndPanning( m_portBuffer,
+				m_volumeModel->valueBuffer(), m_volumeModel->value(),
+				m_panningModel ? m_panningModel->valueBuffer() : NULL,
+				m_panningModel ? m_panningModel->value() : 0.0f, fpp );
 	}
-	// as of now there's no situation where we only have panning model but no volume model
 	// if we have neither, we don't have to do anything here - just pass the audio as is
 
 	// handle effects
+	timer.stop();
 	const bool me = processEffects();
+	timer.start();
 	if( me || m_bufferUsage )
 	{
-		Engine::fxMixer()->mixToChannel( m_portBuffer, m_nextFxChannel ); 	// send output to fx mixer
+		Engine::fxMixer()->mixToChannel( m_portBuffer, m_graphFxChannel ); 	// send output to fx mixer
 																			// TODO: improve the flow here - convert to pull model
 		m_bufferUsage = false;
 	}
 
 	BufferManager::release( m_portBuffer ); // release buffer, we don't need it anymore
+	m_portBuffer = NULL;
+
+	// let the FX channel know we're done with it
+	Engine::fxMixer()->channelInputDone( m_graphFxChannel );
+}
+
+
+
+
+void AudioPort::prepareGraph()
+{
+	// stick to the FX channel we registered with for the whole period, even
+	// if the user changes it in the meantime
+	m_graphFxChannel = m_nextFxChannel;
+	// one extra input keeps the port from being queued before all play
+	// handles are registered
+	m_pendingInputs = 1;
+}
+
+
+
+
+void AudioPort::graphInputDone()
+{
+	// deref() returns false once counter reaches zero
+	if( !m_pendingInputs.deref() )
+	{
+		MixerWorkerThread::addJob( this );
+	}
 }
 
 
@@ -294,17 +294,9 @@ int AudioPortAudio::process_callback(
 		const int min_len = qMin( (int)_framesPerBuffer,
 			m_outBufSize - m_outBufPos );
 
-		float master_gain = mixer()->masterGain();
-
-		for( fpp_t frame = 0; frame < min_len; ++frame )
-		{
-			for( ch_cnt_t chnl = 0; chnl < channels(); ++chnl )
-			{
-				( _outputBuffer + frame * channels() )[chnl] =
-						Mixer::clip( m_outBuf[frame][chnl] *
-						master_gain );
-			}
-		}
+		convertBuffer( m_outBuf + m_outBufPos, min_len,
+					mixer()->masterGain(), _outputBuffer,
+					SampleConverter::Format_Float );
 
 		_outputBuffer += min_len * channels();
 		_framesPerBuffer -= min_len;
@@ -64,6 +64,8 @@
 #endif
 
 #include "MemoryManager.h"
+#include "MixHelpers.h"
+#include "SampleConverter.h"
 #include "ConfigManager.h"
 #include "NotePlayHandle.h"
 #include "Engine.h"
@@ -71,6 +73,8 @@
 #include "ImportFilter.h"
 #include "MainWindow.h"
 #include "ProjectRenderer.h"
+#include "RealtimeGuard.h"
+#include "RenderTrace.h"
 #include "DataFile.h"
 #include "Song.h"
 
@@ -99,6 +103,8 @@ int main( int argc, char * * argv )
 	// initialize memory managers
 	MemoryManager::init();
 	NotePlayHandleManager::init();
+	MixHelpers::init();
+	SampleConversion::init();
 
 	// intialize RNG
 	srand( getpid() + time( 0 ) );
@@ -116,7 +122,8 @@ int main( int argc, char * * argv )
 	bool core_only = false;
 	bool fullscreen = true;
 	bool exit_after_import = false;
-	QString file_to_load, file_to_save, file_to_import, render_out, profilerOutputFile;
+	QString file_to_load, file_to_save, file_to_import, render_out, profilerOutputFile,
+		nodeProfilerOutputFile;
 
 	for( int i = 1; i < argc; ++i )
 	{
@@ -195,6 +202,15 @@ int main( int argc, char * * argv )
 	"-u, --upgrade <in> [out]	upgrade file <in> and save as <out>\n"
 	"       standard out is used if no output file is specifed\n"
 	"-d, --dump <in>			dump XML of compressed file <in>\n"
+	"    --profile-nodes <file>	when rendering, time tracks, effects and\n"
+	"				FX channels and write statistics to <file>\n"
+	"				(CSV, or Chrome trace if it ends in .json)\n"
+	"    --rtcheck <file>		report heap allocations and mutex locks\n"
+	"				in audio threads to <file> on exit\n"
+	"				('-' for standard error)\n"
+	"    --trace <file>		record a timeline of jobs, waits and audio\n"
+	"				buffer transfers of render threads and\n"
+	"				write it to <file> (Chrome JSON trace) on exit\n"
 	"-v, --version			show version information and exit.\n"
 	"-h, --help			show this usage information and exit.\n\n",
 							LMMS_VERSION );
@@ -374,6 +390,21 @@ int main( int argc, char * * argv )
 			profilerOutputFile = argv[i+1];
 			++i;
 		}
+		else if( argc > i + 1 && QString( argv[i] ) == "--profile-nodes" )
+		{
+			nodeProfilerOutputFile = argv[i+1];
+			++i;
+		}
+		else if( argc > i + 1 && QString( argv[i] ) == "--rtcheck" )
+		{
+			RealtimeGuard::enable( argv[i+1] );
+			++i;
+		}
+		else if( argc > i + 1 && QString( argv[i] ) == "--trace" )
+		{
+			RenderTrace::enable( argv[i+1] );
+			++i;
+		}
 		else
 		{
 			if( argv[i][0] == '-' )
@@ -525,14 +556,27 @@ int main( int argc, char * * argv )
 		{
 			Engine::mixer()->profiler().setOutputFile( profilerOutputFile );
 		}
+		if( nodeProfilerOutputFile.isEmpty() == false )
+		{
+			Engine::mixer()->profiler().setNodeOutputFile( nodeProfilerOutputFile );
+		}
 
 		// start now!
 		r->startProcessing();
 	}
 
 	const int ret = app->exec();
+
+	if( nodeProfilerOutputFile.isEmpty() == false )
+	{
+		Engine::mixer()->profiler().finishNodeOutput();
+	}
+
 	delete app;
 
+	RealtimeGuard::dump();
+	RenderTrace::dump();
+
 	// cleanup memory managers
 	MemoryManager::cleanup();
 
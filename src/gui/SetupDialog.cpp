@@ -46,6 +46,7 @@
 #include "LedCheckbox.h"
 #include "LcdSpinBox.h"
 #include "FileDialog.h"
+#include "SampleConverter.h"
 
 
 // platform-specific audio-interface-classes
@@ -98,6 +99,14 @@ SetupDialog::SetupDialog( ConfigTabs _tab_to_open ) :
 							"disablebackup" ).toInt() ),
 	m_hqAudioDev( ConfigManager::inst()->value( "mixer",
 							"hqaudio" ).toInt() ),
+	m_adaptiveBufferSize( ConfigManager::inst()->value( "mixer",
+					"adaptivebuffersize" ).toInt() ),
+	m_sampleExactAutomation( ConfigManager::inst()->value( "mixer",
+					"sampleexactautomation" ).toInt() ),
+	m_pipelinedRemotePlugins( ConfigManager::inst()->value( "mixer",
+					"pipelinedremoteplugins" ).toInt() ),
+	m_dither( ConfigManager::inst()->value( "mixer",
+					"dither" ).toInt() ),
 	m_lang( ConfigManager::inst()->value( "app",
 							"language" ) ),
 	m_workingDir( QDir::toNativeSeparators( ConfigManager::inst()->workingDir() ) ),
@@ -258,6 +267,41 @@ SetupDialog::SetupDialog( ConfigTabs _tab_to_open ) :
 	connect( hqaudio, SIGNAL( toggled( bool ) ),
 				this, SLOT( toggleHQAudioDev( bool ) ) );
 
+	LedCheckBox * adaptiveBufferSize = new LedCheckBox(
+			tr( "Enlarge buffer on high load (needs restart)" ),
+								misc_tw );
+	labelNumber++;
+	adaptiveBufferSize->move( XDelta, YDelta*labelNumber );
+	adaptiveBufferSize->setChecked( m_adaptiveBufferSize );
+	connect( adaptiveBufferSize, SIGNAL( toggled( bool ) ),
+			this, SLOT( toggleAdaptiveBufferSize( bool ) ) );
+
+	LedCheckBox * sampleExactAutomation = new LedCheckBox(
+				tr( "Sample-exact automation (needs restart)" ),
+								misc_tw );
+	labelNumber++;
+	sampleExactAutomation->move( XDelta, YDelta*labelNumber );
+	sampleExactAutomation->setChecked( m_sampleExactAutomation );
+	connect( sampleExactAutomation, SIGNAL( toggled( bool ) ),
+			this, SLOT( toggleSampleExactAutomation( bool ) ) );
+
+	LedCheckBox * pipelinedRemotePlugins = new LedCheckBox(
+			tr( "Parallel VST/ZynAddSubFX (adds latency)" ),
+								misc_tw );
+	labelNumber++;
+	pipelinedRemotePlugins->move( XDelta, YDelta*labelNumber );
+	pipelinedRemotePlugins->setChecked( m_pipelinedRemotePlugins );
+	connect( pipelinedRemotePlugins, SIGNAL( toggled( bool ) ),
+			this, SLOT( togglePipelinedRemotePlugins( bool ) ) );
+
+	LedCheckBox * dither = new LedCheckBox(
+			tr( "Dither 16 bit output and exports" ), misc_tw );
+	labelNumber++;
+	dither->move( XDelta, YDelta*labelNumber );
+	dither->setChecked( m_dither != SampleConverter::Dither_None );
+	connect( dither, SIGNAL( toggled( bool ) ),
+				this, SLOT( toggleDither( bool ) ) );
+
 	LedCheckBox * compacttracks = new LedCheckBox(
 				tr( "Compact track buttons" ),
 								misc_tw );
@@ -865,6 +909,14 @@ void SetupDialog::accept()
 					QString::number( !m_disableBackup ) );
 	ConfigManager::inst()->setValue( "mixer", "hqaudio",
 					QString::number( m_hqAudioDev ) );
+	ConfigManager::inst()->setValue( "mixer", "adaptivebuffersize",
+				QString::number( m_adaptiveBufferSize ) );
+	ConfigManager::inst()->setValue( "mixer", "sampleexactautomation",
+				QString::number( m_sampleExactAutomation ) );
+	ConfigManager::inst()->setValue( "mixer", "pipelinedremoteplugins",
+				QString::number( m_pipelinedRemotePlugins ) );
+	ConfigManager::inst()->setValue( "mixer", "dither",
+					QString::number( m_dither ) );
 	ConfigManager::inst()->setValue( "ui", "smoothscroll",
 					QString::number( m_smoothScroll ) );
 	ConfigManager::inst()->setValue( "ui", "enableautosave",
@@ -978,7 +1030,9 @@ void SetupDialog::displayBufSizeHelp()
 					"unusable sound or bad performance, "
 					"especially on older computers or "
 					"systems with a non-realtime "
-					"kernel." ) );
+					"kernel. If the buffer is enlarged "
+					"on high load, this is the smallest "
+					"size used." ) );
 }
 
 
@@ -1032,6 +1086,40 @@ void SetupDialog::toggleHQAudioDev( bool _enabled )
 
 
 
+void SetupDialog::toggleAdaptiveBufferSize( bool _enabled )
+{
+	m_adaptiveBufferSize = _enabled;
+}
+
+
+
+
+void SetupDialog::toggleSampleExactAutomation( bool _enabled )
+{
+	m_sampleExactAutomation = _enabled;
+}
+
+
+
+
+void SetupDialog::togglePipelinedRemotePlugins( bool _enabled )
+{
+	m_pipelinedRemotePlugins = _enabled;
+}
+
+
+
+
+void SetupDialog::toggleDither( bool _enabled )
+{
+	// noise shaped dither can only be selected in the config file so far
+	m_dither = _enabled ? SampleConverter::Dither_TPDF :
+						SampleConverter::Dither_None;
+}
+
+
+
+
 void SetupDialog::toggleSmoothScroll( bool _enabled )
 {
 	m_smoothScroll = _enabled;
@@ -24,6 +24,8 @@
  */
 
 
+#include <QMap>
+#include <QMouseEvent>
 #include <QPainter>
 
 #include "CPULoadWidget.h"
@@ -35,6 +37,7 @@
 CPULoadWidget::CPULoadWidget( QWidget * _parent ) :
 	QWidget( _parent ),
 	m_currentLoad( 0 ),
+	m_historyCursor( 0 ),
 	m_temp(),
 	m_background( embed::getIconPixmap( "cpuload_bg" ) ),
 	m_leds( embed::getIconPixmap( "cpuload_leds" ) ),
@@ -46,6 +49,7 @@ CPULoadWidget::CPULoadWidget( QWidget * _parent ) :
 
 	m_temp = QPixmap( width(), height() );
 	
+	updateToolTip();
 
 	connect( &m_updateTimer, SIGNAL( timeout() ),
 					this, SLOT( updateCpuLoad() ) );
@@ -89,8 +93,150 @@ void CPULoadWidget::paintEvent( QPaintEvent *  )
 
 
 
+void CPULoadWidget::mousePressEvent( QMouseEvent * _me )
+{
+	if( _me->button() != Qt::LeftButton )
+	{
+		return;
+	}
+
+	MixerProfiler & profiler = Engine::mixer()->profiler();
+	profiler.setNodeProfiling( !profiler.nodeProfiling() );
+	if( profiler.nodeProfiling() )
+	{
+		profiler.resetNodeStats();
+		setToolTip( tr( "Collecting..." ) );
+	}
+	else
+	{
+		updateToolTip();
+	}
+}
+
+
+
+
+void CPULoadWidget::updateNodeToolTip()
+{
+	MixerProfiler & profiler = Engine::mixer()->profiler();
+
+	// most expensive nodes of periods since last update
+	MixerProfiler::PeriodRecord records[MixerProfiler::HistoryLength];
+	const int count = profiler.readHistory( m_historyCursor, records,
+						MixerProfiler::HistoryLength );
+	if( count == 0 )
+	{
+		return;
+	}
+
+	QMap<int, int> maxTimes;
+	int maxPeriodTime = 0;
+	for( int r = 0; r < count; ++r )
+	{
+		maxPeriodTime = qMax( maxPeriodTime, records[r].periodTime );
+		for( int i = 0; i < MixerProfiler::TopNodes &&
+						records[r].nodes[i] >= 0; ++i )
+		{
+			const int node = records[r].nodes[i];
+			maxTimes[node] = qMax( maxTimes.value( node ),
+						records[r].nodeTimes[i] );
+		}
+	}
+
+	// sort by time
+	QMap<int, int> nodesByTime;
+	for( QMap<int, int>::ConstIterator it = maxTimes.begin();
+						it != maxTimes.end(); ++it )
+	{
+		nodesByTime.insertMulti( it.value(), it.key() );
+	}
+
+	QString text = tr( "Slowest period: %1 of %2 us" ).
+				arg( maxPeriodTime ).arg( records[count-1].deadline );
+	int shown = 0;
+	QMapIterator<int, int> it( nodesByTime );
+	it.toBack();
+	while( it.hasPrevious() && shown++ < 5 )
+	{
+		it.previous();
+		const MixerProfiler::NodeStats s = profiler.nodeStats( it.value() );
+		QString type;
+		switch( s.type )
+		{
+			case MixerProfiler::NodePlayHandle: type = tr( "Sound" ); break;
+			case MixerProfiler::NodeAudioPort: type = tr( "Track" ); break;
+			case MixerProfiler::NodeEffect: type = tr( "Effect" ); break;
+			default: type = tr( "FX channel" ); break;
+		}
+		// name last, so it isn't searched for placeholders
+		text += "\n" + tr( "%1 us: %2 %5 (avg %3 us, %4 xruns)" ).
+				arg( it.key() ).
+				arg( type ).
+				arg( s.periods ? s.totalTime / s.periods : 0 ).
+				arg( s.xruns ).
+				arg( s.name );
+	}
+	setToolTip( text );
+}
+
+
+
+
+void CPULoadWidget::updateToolTip()
+{
+	QString text = tr( "Click to show which tracks, effects and FX "
+					"channels take most of the time" );
+
+	const RenderAheadController::Stats s =
+					Engine::mixer()->renderAheadStats();
+	if( s.minDepth < s.maxDepth )
+	{
+		const fpp_t frames = Engine::mixer()->framesPerPeriod();
+		const sample_rate_t sr =
+				Engine::mixer()->processingSampleRate();
+		text += "\n" + tr( "Buffer: %1 frames (%2 ms), "
+						"peak %3 frames" ).
+				arg( s.depth * frames ).
+				arg( 1000.0f * s.depth * frames / sr, 0, 'f', 1 ).
+				arg( s.peakDepth * frames );
+		text += "\n" + tr( "%1 underruns, %2 slow periods, "
+					"grown %3 times, shrunk %4 times" ).
+				arg( s.underruns ).
+				arg( s.lateRenders ).
+				arg( s.grows ).
+				arg( s.shrinks );
+	}
+
+	const f_cnt_t latency = Engine::mixer()->pluginLatency();
+	if( latency > 0 )
+	{
+		text += "\n" + tr( "Plugins add %1 frames (%2 ms) of latency" ).
+				arg( latency ).
+				arg( 1000.0f * latency /
+					Engine::mixer()->processingSampleRate(),
+								0, 'f', 1 );
+	}
+
+	if( text != toolTip() )
+	{
+		setToolTip( text );
+	}
+}
+
+
+
+
 void CPULoadWidget::updateCpuLoad()
 {
+	if( Engine::mixer()->profiler().nodeProfiling() )
+	{
+		updateNodeToolTip();
+	}
+	else
+	{
+		updateToolTip();
+	}
+
 	// smooth load-values a bit
 	int new_load = ( m_currentLoad + Engine::mixer()->cpuLoad() ) / 2;
 	if( new_load != m_currentLoad )
@@ -36,6 +36,7 @@
 #include "embed.h"
 #include "Engine.h"
 #include "GuiApplication.h"
+#include "Mixer.h"
 #include "SendButtonIndicator.h"
 #include "gui_templates.h"
 #include "CaptionMenu.h"
@@ -223,6 +224,8 @@ void FxLine::renameChannel()
 	if( ok && !new_name.isEmpty() )
 	{
 		mix->effectChannel( m_channelIndex )->m_name = new_name;
+		Engine::mixer()->profiler().setNodeName(
+			mix->effectChannel( m_channelIndex )->m_profilerNode, new_name );
 		update();
 	}
 }
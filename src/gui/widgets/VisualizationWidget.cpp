@@ -134,9 +134,9 @@ void VisualizationWidget::paintEvent( QPaintEvent * )
 
 		const fpp_t frames =
 				Engine::mixer()->framesPerPeriod();
-		const float max_level = qMax<float>(
-				Mixer::peakValueLeft( m_buffer, frames ),
-				Mixer::peakValueRight( m_buffer, frames ) );
+		float peakLeft, peakRight;
+		Mixer::peakValues( m_buffer, frames, peakLeft, peakRight );
+		const float max_level = qMax<float>( peakLeft, peakRight );
 
 		// and set color according to that...
 		if( max_level * master_output < 0.9 )
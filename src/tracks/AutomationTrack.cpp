@@ -90,6 +90,46 @@ bool AutomationTrack::play( const MidiTime & _start, const fpp_t _frames,
 
 
 
+void AutomationTrack::processValueBuffers( float _tick, const fpp_t _frames,
+						const f_cnt_t _frame_base, int _tco_num )
+{
+	if( isMuted() )
+	{
+		return;
+	}
+
+	// same patterns as selected by play()
+	tcoVector tcos;
+	if( _tco_num >= 0 )
+	{
+		tcos.push_back( getTCO( _tco_num ) );
+	}
+	else
+	{
+		getTCOsInRange( tcos, MidiTime( (tick_t) _tick ),
+				MidiTime( (tick_t)( _tick +
+					_frames / Engine::framesPerTick() ) ) );
+	}
+
+	for( tcoVector::iterator it = tcos.begin(); it != tcos.end(); ++it )
+	{
+		AutomationPattern * p = dynamic_cast<AutomationPattern *>( *it );
+		if( p == NULL || ( *it )->isMuted() )
+		{
+			continue;
+		}
+		float cur_start = _tick;
+		if( _tco_num < 0 )
+		{
+			cur_start -= p->startPosition();
+		}
+		p->processValueBuffers( cur_start, _frames, _frame_base );
+	}
+}
+
+
+
+
 TrackView * AutomationTrack::createView( TrackContainerView* tcv )
 {
 	return new AutomationTrackView( this, tcv );
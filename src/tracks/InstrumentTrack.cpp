@@ -23,6 +23,8 @@
  *
  */
 
+#include <algorithm>
+
 #include <QDir>
 #include <QFile>
 #include <QQueue>
@@ -104,8 +106,12 @@ InstrumentTrack::InstrumentTrack( TrackContainer* tc ) :
 	m_notes(),
 	m_sustainPedalPressed( false ),
 	m_silentBuffersProcessed( false ),
+	m_silentOutput( false ),
 	m_baseNoteModel( 0, 0, KeysPerOctave * NumOctaves - 1, this,
 							tr( "Base note" ) ),
+	m_noteEvents(),
+	m_noteEventCursor( 0 ),
+	m_noteEventsValid( 0 ),
 	m_volumeModel( DefaultVolume, MinVolume, MaxVolume, 0.1f, this, tr( "Volume" ) ),
 	m_panningModel( DefaultPanning, PanningLeft, PanningRight, 0.1f, this, tr( "Panning" ) ),
 	m_audioPort( tr( "unnamed_track" ), true, &m_volumeModel, &m_panningModel, &m_mutedModel ),
@@ -180,14 +186,18 @@ void InstrumentTrack::processAudioBuffer( sampleFrame* buf, const fpp_t frames,
 		// at least pass one silent buffer to allow
 		if( m_silentBuffersProcessed )
 		{
-			// skip further processing
+			// skip further processing and let the audio port skip
+			// the buffer as well
+			m_silentOutput = true;
 			return;
 		}
 		m_silentBuffersProcessed = true;
+		m_silentOutput = false;
 	}
 	else
 	{
 		m_silentBuffersProcessed = false;
+		m_silentOutput = false;
 	}
 
 	// if effects "went to sleep" because there was no input, wake them up
@@ -588,20 +598,6 @@ bool InstrumentTrack::play( const MidiTime & _start, const fpp_t _frames,
 	}
 	const float frames_per_tick = Engine::framesPerTick();
 
-	tcoVector tcos;
-	::BBTrack * bb_track = NULL;
-	if( _tco_num >= 0 )
-	{
-		TrackContentObject * tco = getTCO( _tco_num );
-		tcos.push_back( tco );
-		bb_track = BBTrack::findBBTrack( _tco_num );
-	}
-	else
-	{
-		getTCOsInRange( tcos, _start, _start + static_cast<int>(
-					_frames / frames_per_tick ) );
-	}
-
 	// Handle automation: detuning
 	for( NotePlayHandleList::Iterator it = m_processHandles.begin();
 					it != m_processHandles.end(); ++it )
@@ -609,73 +605,151 @@ bool InstrumentTrack::play( const MidiTime & _start, const fpp_t _frames,
 		( *it )->processMidiTime( _start );
 	}
 
-	if ( tcos.size() == 0 )
+	// playing global song?
+	if( _tco_num < 0 )
+	{
+		const bool played_a_note = playNoteEvents( _start, _offset );
+		unlock();
+		return played_a_note;
+	}
+
+	Pattern* p = dynamic_cast<Pattern*>( getTCO( _tco_num ) );
+	// everything which is not a pattern or muted won't be played
+	if( p == NULL || p->isMuted() )
 	{
 		unlock();
 		return false;
 	}
+	::BBTrack * bb_track = BBTrack::findBBTrack( _tco_num );
 
 	bool played_a_note = false;	// will be return variable
 
-	for( tcoVector::Iterator it = tcos.begin(); it != tcos.end(); ++it )
+	// notes are sorted by position, so search the first one which is
+	// posated at or behind start-tact
+	const NoteVector & notes = p->notes();
+	NoteVector::ConstIterator nit = std::lower_bound( notes.begin(),
+					notes.end(), _start, Note::posLessThan );
+
+	Note * cur_note;
+	while( nit != notes.end() &&
+				( cur_note = *nit )->pos() == _start )
 	{
-		Pattern* p = dynamic_cast<Pattern*>( *it );
-		// everything which is not a pattern or muted won't be played
-		if( p == NULL || ( *it )->isMuted() )
-		{
-			continue;
-		}
-		MidiTime cur_start = _start;
-		if( _tco_num < 0 )
+		if( cur_note->length() != 0 )
 		{
-			cur_start -= p->startPosition();
+			const f_cnt_t note_frames =
+				cur_note->length().frames( frames_per_tick );
+
+			NotePlayHandle* notePlayHandle = NotePlayHandleManager::acquire( this, _offset, note_frames, *cur_note );
+			notePlayHandle->setBBTrack( bb_track );
+
+			Engine::mixer()->addPlayHandle( notePlayHandle );
+			played_a_note = true;
 		}
+		++nit;
+	}
+	unlock();
+	return played_a_note;
+}
+
+
+
+
+void InstrumentTrack::invalidateNoteEvents()
+{
+	m_noteEventsValid = 0;
+}
+
 
-		// get all notes from the given pattern...
-		const NoteVector & notes = p->notes();
-		// ...and set our index to zero
-		NoteVector::ConstIterator nit = notes.begin();
 
-		// very effective algorithm for playing notes that are
-		// posated within the current sample-frame
 
+void InstrumentTrack::updateNoteEvents()
+{
+	// keep allocated memory, this runs in the mixer thread
+	m_noteEvents.resize( 0 );
 
-		if( cur_start > 0 )
+	for( int i = 0; i < numOfTCOs(); ++i )
+	{
+		Pattern * p = dynamic_cast<Pattern *>( getTCO( i ) );
+		if( p == NULL )
 		{
-			// skip notes which are posated before start-tact
-			while( nit != notes.end() && ( *nit )->pos() < cur_start )
-			{
-				++nit;
-			}
+			continue;
 		}
 
-		Note * cur_note;
-		while( nit != notes.end() &&
-					( cur_note = *nit )->pos() == cur_start )
+		// same notes as found by searching patterns in the current
+		// tick before: everything from start up to the end of the
+		// pattern (inclusive)
+		const tick_t start = p->startPosition();
+		const tick_t length = p->TrackContentObject::length();
+		const NoteVector & notes = p->notes();
+		for( NoteVector::ConstIterator it = notes.begin();
+						it != notes.end(); ++it )
 		{
-			if( cur_note->length() != 0 )
+			const tick_t pos = ( *it )->pos();
+			if( ( *it )->length() != 0 && pos >= 0 && pos <= length )
 			{
-				const f_cnt_t note_frames =
-					cur_note->length().frames(
-							frames_per_tick );
-
-				NotePlayHandle* notePlayHandle = NotePlayHandleManager::acquire( this, _offset, note_frames, *cur_note );
-				notePlayHandle->setBBTrack( bb_track );
-				// are we playing global song?
-				if( _tco_num < 0 )
-				{
-					// then set song-global offset of pattern in order to
-					// properly perform the note detuning
-					notePlayHandle->setSongGlobalParentOffset( p->startPosition() );
-				}
-
-				Engine::mixer()->addPlayHandle( notePlayHandle );
-				played_a_note = true;
+				NoteEvent e = { start + pos, *it, p };
+				m_noteEvents.push_back( e );
 			}
-			++nit;
 		}
 	}
-	unlock();
+
+	// stable, so notes at the same position are played in the order
+	// of their patterns
+	qStableSort( m_noteEvents.begin(), m_noteEvents.end() );
+	m_noteEventCursor = 0;
+}
+
+
+
+
+bool InstrumentTrack::playNoteEvents( const MidiTime & _start,
+							const f_cnt_t _offset )
+{
+	// mark as valid before collecting, so changes made meanwhile
+	// invalidate again
+	if( m_noteEventsValid.fetchAndStoreOrdered( 1 ) == 0 )
+	{
+		updateNoteEvents();
+	}
+
+	const NoteEvent * events = m_noteEvents.constData();
+	const int count = m_noteEvents.size();
+	const tick_t start = _start;
+
+	// we usually continue where we stopped in the previous tick, so only
+	// search when position jumped (loops, user interaction)
+	int & cursor = m_noteEventCursor;
+	if( cursor > count || ( cursor > 0 && events[cursor-1].pos >= start ) ||
+				( cursor < count && events[cursor].pos < start ) )
+	{
+		cursor = std::lower_bound( events, events + count, start ) -
+									events;
+	}
+
+	const float frames_per_tick = Engine::framesPerTick();
+	bool played_a_note = false;
+
+	for( ; cursor < count && events[cursor].pos == start; ++cursor )
+	{
+		const NoteEvent & e = events[cursor];
+		if( e.pattern->isMuted() || e.note->length() == 0 )
+		{
+			continue;
+		}
+
+		const f_cnt_t note_frames =
+				e.note->length().frames( frames_per_tick );
+
+		NotePlayHandle* notePlayHandle = NotePlayHandleManager::acquire( this, _offset, note_frames, *e.note );
+		notePlayHandle->setBBTrack( NULL );
+		// set song-global offset of pattern in order to properly
+		// perform the note detuning
+		notePlayHandle->setSongGlobalParentOffset( e.pattern->startPosition() );
+
+		Engine::mixer()->addPlayHandle( notePlayHandle );
+		played_a_note = true;
+	}
+
 	return played_a_note;
 }
 
@@ -103,6 +103,16 @@ Pattern::~Pattern()
 {
 	emit destroyedPattern( this );
 
+	// play() keeps pointers to our notes until it collects its note
+	// events again - while our track is being destroyed, it neither
+	// plays nor has note events anymore
+	Track * track = getTrack();
+	track->lock();
+	if( !track->isBeingDestroyed() )
+	{
+		instrumentTrack()->invalidateNoteEvents();
+	}
+
 	for( NoteVector::Iterator it = m_notes.begin();
 						it != m_notes.end(); ++it )
 	{
@@ -110,6 +120,7 @@ Pattern::~Pattern()
 	}
 
 	m_notes.clear();
+	track->unlock();
 }
 
 
@@ -119,6 +130,17 @@ void Pattern::init()
 {
 	connect( Engine::getSong(), SIGNAL( timeSignatureChanged( int, int ) ),
 				this, SLOT( changeTimeSignature() ) );
+
+	// note events of our track have to be collected again whenever
+	// something about us changes - direct connections as these signals
+	// might be emitted from other threads, e.g. while recording
+	connect( this, SIGNAL( dataChanged() ), m_instrumentTrack,
+			SLOT( invalidateNoteEvents() ), Qt::DirectConnection );
+	connect( this, SIGNAL( positionChanged() ), m_instrumentTrack,
+			SLOT( invalidateNoteEvents() ), Qt::DirectConnection );
+	connect( this, SIGNAL( lengthChanged() ), m_instrumentTrack,
+			SLOT( invalidateNoteEvents() ), Qt::DirectConnection );
+	m_instrumentTrack->invalidateNoteEvents();
 	saveJournallingState( false );
 
 	ensureBeatNotes();
@@ -211,6 +233,7 @@ Note * Pattern::addNote( const Note & _new_note, const bool _quant_pos )
 
 		m_notes.insert( it, new_note );
 	}
+	instrumentTrack()->invalidateNoteEvents();
 	instrumentTrack()->unlock();
 
 	checkType();
@@ -240,6 +263,7 @@ void Pattern::removeNote( const Note * _note_to_del )
 		}
 		++it;
 	}
+	instrumentTrack()->invalidateNoteEvents();
 	instrumentTrack()->unlock();
 
 	checkType();
@@ -283,7 +307,10 @@ Note * Pattern::rearrangeNote( const Note * _note_to_proc,
 void Pattern::rearrangeAllNotes()
 {
 	// sort notes by start time
+	instrumentTrack()->lock();
 	qSort(m_notes.begin(), m_notes.end(), Note::lessThan );
+	instrumentTrack()->invalidateNoteEvents();
+	instrumentTrack()->unlock();
 }
 
 
@@ -297,6 +324,7 @@ void Pattern::clearNotes()
 		delete *it;
 	}
 	m_notes.clear();
+	instrumentTrack()->invalidateNoteEvents();
 	instrumentTrack()->unlock();
 
 	checkType();
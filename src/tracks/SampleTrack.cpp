@@ -55,6 +55,10 @@ SampleTCO::SampleTCO( Track * _track ) :
 	TrackContentObject( _track ),
 	m_sampleBuffer( new SampleBuffer )
 {
+	// sample tracks only play linearly, so long recordings can be
+	// streamed from disk
+	m_sampleBuffer->setStreamingAllowed( true );
+
 	saveJournallingState( false );
 	setSampleFile( "" );
 	restoreJournallingState();
@@ -107,6 +111,8 @@ void SampleTCO::setSampleBuffer( SampleBuffer* sb )
 {
 	sharedObject::unref( m_sampleBuffer );
 	m_sampleBuffer = sb;
+	// same as for our own buffer, applies when a file is loaded into it
+	m_sampleBuffer->setStreamingAllowed( true );
 	updateLength();
 
 	emit sampleChanged();
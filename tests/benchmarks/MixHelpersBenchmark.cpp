@@ -0,0 +1,373 @@
+/*
+ * MixHelpersBenchmark.cpp - compare MixHelpers kernels against the scalar
+ *                           reference
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*
+ * Runs every operation of every kernel table usable on this CPU, reports
+ * time per call, speedup over the scalar reference and the largest
+ * deviation from the reference results:
+ *
+ *	mixbenchmark [--frames N] [--iterations I]
+ *
+ * Deviations are checked on buffers containing infs and NaNs and with an
+ * odd number of frames, so remainder loops are covered as well. Apart from
+ * sumofsquares (summed in a different order) all deviations have to be 0,
+ * otherwise the benchmark exits with 1.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <QtCore/QtGlobal>
+
+#include "MicroTimer.h"
+#include "MixKernels.h"
+
+
+enum Operations
+{
+	OpIsSilent,
+	OpSanitize,
+	OpPeak,
+	OpSumOfSquares,
+	OpAdd,
+	OpAddMultiplied,
+	OpAddSwappedMultiplied,
+	OpAddMultipliedByBuffer,
+	OpAddMultipliedByBuffers,
+	OpAddSanitizedMultiplied,
+	OpAddSanitizedMultipliedByBuffer,
+	OpAddSanitizedMultipliedByBuffers,
+	OpAddMultipliedStereo,
+	OpMultiplyAndAddMultiplied,
+	OpMultiplyAndAddMultipliedJoined,
+	OpMultiplyByBuffer,
+	NumOperations
+} ;
+typedef Operations Operation;
+
+
+static const char * operationNames[NumOperations] =
+{
+	"issilent", "sanitize", "peak", "sumofsquares", "add", "addmultiplied",
+	"addswappedmultiplied", "addmultipliedbybuffer",
+	"addmultipliedbybuffers", "addsanitizedmultiplied",
+	"addsanitizedmultipliedbybuffer", "addsanitizedmultipliedbybuffers",
+	"addmultipliedstereo", "multiplyandaddmultiplied",
+	"multiplyandaddmultipliedjoined", "multiplybybuffer"
+} ;
+
+
+struct Buffers
+{
+	sampleFrame * dst;
+	sampleFrame * src;
+	sample_t * left;
+	sample_t * right;
+	float * coeffs1;
+	float * coeffs2;
+	float result[2];
+} ;
+
+
+
+
+static float randomSample( unsigned int & seed )
+{
+	seed = seed * 1103515245 + 12345;
+	return ( ( seed >> 8 ) & 0xffff ) / 32768.0f - 1.0f;
+}
+
+
+
+
+static void allocBuffers( Buffers & b, int frames )
+{
+	b.dst = new sampleFrame[frames];
+	b.src = new sampleFrame[frames];
+	b.left = new sample_t[frames];
+	b.right = new sample_t[frames];
+	b.coeffs1 = new float[frames];
+	b.coeffs2 = new float[frames];
+}
+
+
+
+
+static void freeBuffers( Buffers & b )
+{
+	delete[] b.dst;
+	delete[] b.src;
+	delete[] b.left;
+	delete[] b.right;
+	delete[] b.coeffs1;
+	delete[] b.coeffs2;
+}
+
+
+
+
+// fill buffers with the same data for every kernel table - with special
+// values only if requested, as they slow down the scalar code
+static void fillBuffers( Buffers & b, int frames, bool specialValues )
+{
+	unsigned int seed = 1;
+	for( int f = 0; f < frames; ++f )
+	{
+		b.dst[f][0] = randomSample( seed );
+		b.dst[f][1] = randomSample( seed );
+		b.src[f][0] = randomSample( seed );
+		b.src[f][1] = randomSample( seed );
+		b.left[f] = randomSample( seed );
+		b.right[f] = randomSample( seed );
+		// coefficients around 1 keep repeatedly processed buffers
+		// away from denormals and overflows
+		b.coeffs1[f] = 1.0f + randomSample( seed ) * 0.001f;
+		b.coeffs2[f] = 1.0f + randomSample( seed ) * 0.001f;
+	}
+
+	if( specialValues )
+	{
+		for( int f = 3; f < frames; f += 7 )
+		{
+			b.src[f][f % 2] = ( f % 3 ) ? INFINITY : NAN;
+		}
+		if( frames > 1 )
+		{
+			b.src[frames-1][1] = -INFINITY;
+		}
+	}
+	b.result[0] = b.result[1] = 0.0f;
+}
+
+
+
+
+static void runOperation( const MixKernels * k, Operation op, Buffers & b, int frames )
+{
+	switch( op )
+	{
+		case OpIsSilent:
+			b.result[0] = k->isSilent( b.src, frames ) ? 1.0f : 0.0f;
+			break;
+		case OpSanitize:
+			b.result[0] = k->sanitize( b.src, frames ) ? 1.0f : 0.0f;
+			break;
+		case OpPeak:
+			k->peak( b.src, frames, &b.result[0], &b.result[1] );
+			break;
+		case OpSumOfSquares:
+			k->sumOfSquares( b.src, frames, &b.result[0], &b.result[1] );
+			break;
+		case OpAdd:
+			k->add( b.dst, b.src, frames );
+			break;
+		case OpAddMultiplied:
+			k->addMultiplied( b.dst, b.src, 0.5f, frames );
+			break;
+		case OpAddSwappedMultiplied:
+			k->addSwappedMultiplied( b.dst, b.src, 0.5f, frames );
+			break;
+		case OpAddMultipliedByBuffer:
+			k->addMultipliedByBuffer( b.dst, b.src, 0.5f, b.coeffs1, frames );
+			break;
+		case OpAddMultipliedByBuffers:
+			k->addMultipliedByBuffers( b.dst, b.src, b.coeffs1, b.coeffs2, frames );
+			break;
+		case OpAddSanitizedMultiplied:
+			k->addSanitizedMultiplied( b.dst, b.src, 0.5f, frames );
+			break;
+		case OpAddSanitizedMultipliedByBuffer:
+			k->addSanitizedMultipliedByBuffer( b.dst, b.src, 0.5f, b.coeffs1, frames );
+			break;
+		case OpAddSanitizedMultipliedByBuffers:
+			k->addSanitizedMultipliedByBuffers( b.dst, b.src, b.coeffs1, b.coeffs2, frames );
+			break;
+		case OpAddMultipliedStereo:
+			k->addMultipliedStereo( b.dst, b.src, 0.3f, 0.7f, frames );
+			break;
+		case OpMultiplyAndAddMultiplied:
+			k->multiplyAndAddMultiplied( b.dst, b.src, 0.5f, 0.5f, frames );
+			break;
+		case OpMultiplyAndAddMultipliedJoined:
+			k->multiplyAndAddMultipliedJoined( b.dst, b.left, b.right, 0.5f, 0.5f, frames );
+			break;
+		case OpMultiplyByBuffer:
+			k->multiplyByBuffer( b.dst, b.coeffs1, frames );
+			break;
+		default:
+			break;
+	}
+}
+
+
+
+
+static float deviation( float a, float b )
+{
+	if( a == b || ( std::isnan( a ) && std::isnan( b ) ) )
+	{
+		return 0.0f;
+	}
+	const float d = fabsf( a - b );
+	return std::isnan( d ) ? INFINITY : d;
+}
+
+
+
+
+// largest deviation of results of k from those of the scalar reference
+static float maxDeviation( const MixKernels * k, Operation op, int frames )
+{
+	Buffers ref, b;
+	allocBuffers( ref, frames );
+	allocBuffers( b, frames );
+
+	// infs and NaNs only for operations which are supposed to handle them
+	const bool specialValues = op == OpIsSilent || op == OpSanitize ||
+			op == OpPeak || op == OpAddSanitizedMultiplied ||
+			op == OpAddSanitizedMultipliedByBuffer ||
+			op == OpAddSanitizedMultipliedByBuffers;
+
+	fillBuffers( ref, frames, specialValues );
+	fillBuffers( b, frames, specialValues );
+	runOperation( MixHelpers::scalarKernels(), op, ref, frames );
+	runOperation( k, op, b, frames );
+
+	float d = qMax( deviation( ref.result[0], b.result[0] ),
+				deviation( ref.result[1], b.result[1] ) );
+	for( int f = 0; f < frames; ++f )
+	{
+		for( int c = 0; c < DEFAULT_CHANNELS; ++c )
+		{
+			d = qMax( d, deviation( ref.dst[f][c], b.dst[f][c] ) );
+			d = qMax( d, deviation( ref.src[f][c], b.src[f][c] ) );
+		}
+	}
+
+	// also check whether silence is detected
+	if( op == OpIsSilent )
+	{
+		memset( ref.src, 0, sizeof( sampleFrame ) * frames );
+		memset( b.src, 0, sizeof( sampleFrame ) * frames );
+		d = qMax( d, deviation( MixHelpers::scalarKernels()->isSilent( ref.src, frames ),
+						k->isSilent( b.src, frames ) ) );
+	}
+
+	freeBuffers( ref );
+	freeBuffers( b );
+
+	return d;
+}
+
+
+
+
+// time per call in ns
+static double timeOperation( const MixKernels * k, Operation op, int frames, int iterations )
+{
+	Buffers b;
+	allocBuffers( b, frames );
+	fillBuffers( b, frames, false );
+
+	MicroTimer timer;
+	for( int i = 0; i < iterations; ++i )
+	{
+		runOperation( k, op, b, frames );
+	}
+	const double ns = timer.elapsed() * 1000.0 / iterations;
+
+	freeBuffers( b );
+
+	return ns;
+}
+
+
+
+
+int main( int argc, char * * argv )
+{
+	int frames = 256;
+	int iterations = 100000;
+
+	for( int i = 1; i < argc; ++i )
+	{
+		const bool hasValue = i + 1 < argc;
+		if( !strcmp( argv[i], "--frames" ) && hasValue )
+		{
+			frames = qMax( atoi( argv[++i] ), 1 );
+		}
+		else if( !strcmp( argv[i], "--iterations" ) && hasValue )
+		{
+			iterations = qMax( atoi( argv[++i] ), 1 );
+		}
+		else
+		{
+			printf( "usage: %s [--frames N] [--iterations I]\n", argv[0] );
+			return 1;
+		}
+	}
+
+	printf( "%d frames per call, %d iterations\n", frames, iterations );
+	printf( "%-32s", "operation" );
+	for( int k = 0; k < MixHelpers::numKernels(); ++k )
+	{
+		printf( " %16s", MixHelpers::kernels( k )->name );
+	}
+	printf( "\n" );
+
+	int ret = 0;
+	for( int o = 0; o < NumOperations; ++o )
+	{
+		const Operation op = (Operation) o;
+		printf( "%-32s", operationNames[op] );
+
+		double scalarTime = 0;
+		for( int k = 0; k < MixHelpers::numKernels(); ++k )
+		{
+			const MixKernels * kernels = MixHelpers::kernels( k );
+			const double ns = timeOperation( kernels, op, frames, iterations );
+			if( k == 0 )
+			{
+				scalarTime = ns;
+				printf( " %13.0fns", ns );
+				continue;
+			}
+
+			const float d = maxDeviation( kernels, op, frames + 3 );
+			printf( " %6.0fns %5.2fx", ns, scalarTime / ns );
+			if( d != 0.0f )
+			{
+				printf( " (max deviation %g)", d );
+				if( op != OpSumOfSquares )
+				{
+					ret = 1;
+				}
+			}
+		}
+		printf( "\n" );
+	}
+
+	return ret;
+}
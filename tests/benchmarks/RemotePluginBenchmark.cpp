@@ -0,0 +1,373 @@
+/*
+ * RemotePluginBenchmark.cpp - time RemotePlugin IPC against a dummy remote
+ *                             process
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*
+ * Forks dummy remote processes which just halve their input and drives them
+ * the way RemotePlugin does, one after another per period like the render
+ * graph does with several VST instances:
+ *
+ *	remotepluginbenchmark [--instances N] [--periods P] [--events E]
+ *							[--load US]
+ *
+ * Reports the time per period for plain processing round trips, for
+ * passing E MIDI events per instance and period via the shared event ring
+ * and via separate messages and for pipelined processing, where all
+ * instances compute a period at the same time. The remote processes spin
+ * for US microseconds per period to simulate DSP load, pipelining only
+ * pays off with that and more than one core. Exits with 1 if output or
+ * number of events received by the remote processes is wrong.
+ */
+
+#include "lmmsconfig.h"
+
+#define BUILD_REMOTE_PLUGIN_CLIENT
+#include "RemotePlugin.h"
+
+#include <sys/wait.h>
+#include <algorithm>
+
+#include "MicroTimer.h"
+
+
+const int FRAMES = 256;
+const int CHANNELS = 2;
+
+enum BenchmarkMessageIDs
+{
+	IdQueryEvents = IdUserBase	// reply contains events received
+} ;
+
+
+// remote side, running in a forked process
+class DummyClient : public RemotePluginClient
+{
+public:
+	DummyClient( key_t _shm_in, key_t _shm_out, int _load ) :
+		RemotePluginClient( _shm_in, _shm_out ),
+		m_events( 0 ),
+		m_load( _load )
+	{
+		setInputCount( CHANNELS );
+		setOutputCount( CHANNELS );
+	}
+
+	void run()
+	{
+		message m;
+		while( ( m = receiveMessage() ).id != IdQuit )
+		{
+			processMessage( m );
+		}
+	}
+
+	virtual bool processMessage( const message & _m )
+	{
+		if( _m.id == IdQueryEvents )
+		{
+			sendMessage( message( IdQueryEvents ).addInt( m_events ) );
+			m_events = 0;
+			return true;
+		}
+		return RemotePluginClient::processMessage( _m );
+	}
+
+	virtual void processMidiEvent( const MidiEvent &, const f_cnt_t )
+	{
+		++m_events;
+	}
+
+	virtual void process( const sampleFrame * _in, sampleFrame * _out )
+	{
+		MicroTimer timer;
+		while( timer.elapsed() < m_load )
+		{
+		}
+		for( int f = 0; f < bufferSize(); ++f )
+		{
+			for( int ch = 0; ch < CHANNELS; ++ch )
+			{
+				_out[f][ch] = _in[f][ch] * 0.5f;
+			}
+		}
+	}
+
+
+private:
+	int m_events;
+	int m_load;
+
+} ;
+
+
+// master side, like RemotePlugin without QProcess and Mixer
+class BenchmarkHost : public RemotePluginBase
+{
+public:
+	BenchmarkHost( int _load ) :
+		RemotePluginBase( new shmFifo(), new shmFifo() ),
+		m_pid( -1 ),
+		m_shmID( -1 ),
+		m_header( NULL ),
+		m_audio( NULL ),
+		m_periodsSubmitted( 0 ),
+		m_periodsDone( 0 )
+	{
+		static int shm_key = 0;
+		const size_t size = REMOTE_SHM_HEADER_SIZE + REMOTE_AUDIO_SLOTS *
+				2 * CHANNELS * FRAMES * sizeof( float );
+		while( ( m_shmID = shmget( ++shm_key, size, IPC_CREAT |
+						IPC_EXCL | 0600 ) ) == -1 )
+		{
+		}
+		m_header = (RemoteShmHeader *) shmat( m_shmID, 0, 0 );
+		m_header->init();
+		m_audio = (float *)( (char *) m_header + REMOTE_SHM_HEADER_SIZE );
+
+		m_pid = fork();
+		if( m_pid == 0 )
+		{
+			// swap in and out for bidirectional communication
+			DummyClient * client = new DummyClient( out()->shmKey(),
+							in()->shmKey(), _load );
+			client->run();
+			delete client;
+			// leave master's shared memory alone
+			_exit( 0 );
+		}
+
+		sendMessage( message( IdSampleRateInformation ).addInt( 44100 ) );
+		sendMessage( message( IdBufferSizeInformation ).addInt( FRAMES ) );
+		sendMessage( message( IdChangeSharedMemoryKey ).
+					addInt( shm_key ).addInt( size ) );
+		while( !m_header->isAccepted() && !isInvalid() )
+		{
+			fetchAndProcessAllMessages();
+			usleep( 1000 );
+		}
+	}
+
+	virtual ~BenchmarkHost()
+	{
+		sendMessage( IdQuit );
+		waitpid( m_pid, NULL, 0 );
+		shmdt( m_header );
+		shmctl( m_shmID, IPC_RMID, NULL );
+	}
+
+	virtual bool processMessage( const message & _m )
+	{
+		if( _m.id == IdDebugMessage )
+		{
+			fprintf( stderr, "remote: %s", _m.getString( 0 ).c_str() );
+		}
+		else if( _m.id == IdProcessingDone )
+		{
+			++m_periodsDone;
+		}
+		return true;
+	}
+
+	void queueEvents( int _events, bool _viaRing )
+	{
+		for( int i = 0; i < _events; ++i )
+		{
+			RemoteEvent e;
+			e.type = RemoteEventMidi;
+			e.offset = i % FRAMES;
+			e.data[0] = MidiNoteOn;
+			e.data[1] = 0;
+			e.data[2] = i % 128;
+			e.data[3] = 100;
+			e.value = 0;
+			if( !_viaRing || !m_header->pushEvent( e ) )
+			{
+				sendMessage( message( IdMidiEvent ).
+					addInt( e.data[0] ).addInt( e.data[1] ).
+					addInt( e.data[2] ).addInt( e.data[3] ).
+					addInt( e.offset ) );
+			}
+		}
+	}
+
+	// returns whether output is correct - in pipelined mode the output
+	// checked is the one of the previous call
+	bool process( int _period, bool _pipelined )
+	{
+		const int slot = m_periodsSubmitted % REMOTE_AUDIO_SLOTS;
+		float * in = m_audio + slot * 2 * CHANNELS * FRAMES;
+		for( int i = 0; i < CHANNELS * FRAMES; ++i )
+		{
+			in[i] = _period + i;
+		}
+		m_slotPeriods[slot] = _period;
+		sendMessage( message( IdStartProcessing ).addInt( slot ) );
+		++m_periodsSubmitted;
+
+		const int collect = _pipelined ? m_periodsSubmitted - 1 :
+							m_periodsSubmitted;
+		while( m_periodsDone < collect && !isInvalid() )
+		{
+			fetchAndProcessNextMessage();
+		}
+		if( collect == 0 )
+		{
+			return true;
+		}
+
+		const int done = ( collect - 1 ) % REMOTE_AUDIO_SLOTS;
+		const float * out = m_audio + ( done * 2 + 1 ) *
+							CHANNELS * FRAMES;
+		return out[0] == m_slotPeriods[done] * 0.5f &&
+			out[CHANNELS * FRAMES - 1] == ( m_slotPeriods[done] +
+					CHANNELS * FRAMES - 1 ) * 0.5f;
+	}
+
+	int eventsReceived()
+	{
+		sendMessage( IdQueryEvents );
+		return waitForMessage( IdQueryEvents ).getInt( 0 );
+	}
+
+
+private:
+	pid_t m_pid;
+	int m_shmID;
+	RemoteShmHeader * m_header;
+	float * m_audio;
+	int m_periodsSubmitted;
+	int m_periodsDone;
+	int m_slotPeriods[REMOTE_AUDIO_SLOTS];
+
+} ;
+
+
+
+
+enum Modes
+{
+	ModeRoundTrip,
+	ModeEventRing,
+	ModeEventMessages,
+	ModePipelined,
+	NumModes
+} ;
+
+static const char * modeNames[NumModes] =
+{
+	"round trip", "events via ring", "events via messages", "pipelined"
+} ;
+
+
+
+
+int main( int argc, char * * argv )
+{
+	int instances = 8;
+	int periods = 5000;
+	int events = 16;
+	int load = 0;
+	for( int i = 1; i < argc; ++i )
+	{
+		if( strcmp( argv[i], "--instances" ) == 0 && i + 1 < argc )
+		{
+			instances = std::max( 1, atoi( argv[++i] ) );
+		}
+		else if( strcmp( argv[i], "--periods" ) == 0 && i + 1 < argc )
+		{
+			periods = std::max( 1, atoi( argv[++i] ) );
+		}
+		else if( strcmp( argv[i], "--events" ) == 0 && i + 1 < argc )
+		{
+			events = std::min( std::max( 0, atoi( argv[++i] ) ),
+						REMOTE_EVENT_RING_SIZE );
+		}
+		else if( strcmp( argv[i], "--load" ) == 0 && i + 1 < argc )
+		{
+			load = std::max( 0, atoi( argv[++i] ) );
+		}
+		else
+		{
+			printf( "usage: %s [--instances N] [--periods P] "
+					"[--events E] [--load US]\n", argv[0] );
+			return 1;
+		}
+	}
+
+	std::vector<BenchmarkHost *> hosts;
+	for( int i = 0; i < instances; ++i )
+	{
+		hosts.push_back( new BenchmarkHost( load ) );
+	}
+
+	printf( "%d instances, %d periods of %d frames, %d events per "
+			"instance and period, %dus load\n", instances, periods,
+							FRAMES, events, load );
+
+	bool failed = false;
+	for( int mode = 0; mode < NumModes; ++mode )
+	{
+		const int periodEvents = mode == ModeEventRing ||
+				mode == ModeEventMessages ? events : 0;
+		int badPeriods = 0;
+
+		MicroTimer timer;
+		for( int p = 0; p < periods; ++p )
+		{
+			for( int i = 0; i < instances; ++i )
+			{
+				hosts[i]->queueEvents( periodEvents,
+						mode == ModeEventRing );
+				if( !hosts[i]->process( p % 1024,
+						mode == ModePipelined ) )
+				{
+					++badPeriods;
+				}
+			}
+		}
+		const float us = (float) timer.elapsed() / periods;
+
+		int received = 0;
+		for( int i = 0; i < instances; ++i )
+		{
+			received += hosts[i]->eventsReceived();
+		}
+		const int expected = periodEvents * periods * instances;
+
+		printf( "%-20s %9.1fus per period %7.2fus per instance",
+					modeNames[mode], us, us / instances );
+		if( badPeriods || received != expected )
+		{
+			printf( " - %d bad periods, %d of %d events received",
+					badPeriods, received, expected );
+			failed = true;
+		}
+		printf( "\n" );
+	}
+
+	for( int i = 0; i < instances; ++i )
+	{
+		delete hosts[i];
+	}
+
+	return failed ? 1 : 0;
+}
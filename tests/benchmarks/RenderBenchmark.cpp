@@ -0,0 +1,484 @@
+/*
+ * RenderBenchmark.cpp - headless benchmark of the mixer pipeline
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*
+ * Builds synthetic projects (N tracks with M notes each) and renders them
+ * as fast as possible, reporting throughput, time spent in each stage of
+ * Mixer::renderNextBuffer(), MemoryManager allocations and render graph
+ * nodes skipped because of silence per period:
+ *
+ *	benchmarks [--scene <name>] [--tracks N] [--notes M] [--bars B]
+ *		[--periods P] [--plugin-dir <dir>] [--csv]
+ *
+ * Scenes: tripleosc, afp, effects, fxsends, all (default), longsong and
+ * idle. longsong isn't part of all - it spreads the notes of each track over
+ * one pattern per bar, so scheduling of long songs shows up in the prepare
+ * stage, e.g. a 10k note song:
+ *
+ *	benchmarks --scene longsong --tracks 8 --notes 1250 --bars 250
+ *
+ * idle isn't part of all either - it's the fxsends project with effects on
+ * every track but without any notes, i.e. a large template which should
+ * cost almost nothing once the effects went to sleep.
+ *
+ * Plugins are loaded from the plugin directory of an installed LMMS unless
+ * --plugin-dir is given.
+ */
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QStringList>
+
+#include <cstdio>
+#include <cstring>
+
+#include "AudioDevice.h"
+#include "AudioPort.h"
+#include "ConfigManager.h"
+#include "Effect.h"
+#include "EffectChain.h"
+#include "Engine.h"
+#include "FxMixer.h"
+#include "Instrument.h"
+#include "InstrumentTrack.h"
+#include "MemoryManager.h"
+#include "MicroTimer.h"
+#include "Mixer.h"
+#include "MixerProfiler.h"
+#include "MixHelpers.h"
+#include "NotePlayHandle.h"
+#include "Pattern.h"
+#include "Song.h"
+
+
+// device which just takes rendered buffers away, so the mixer is driven
+// by the benchmark instead of a (real time paced) audio driver
+class BenchmarkDevice : public AudioDevice
+{
+public:
+	BenchmarkDevice( Mixer * mixer ) :
+		AudioDevice( DEFAULT_CHANNELS, mixer )
+	{
+	}
+
+	virtual ~BenchmarkDevice()
+	{
+	}
+
+} ;
+
+
+
+
+struct BenchmarkOptions
+{
+	int tracks;
+	int notes;
+	int bars;
+	int periods;
+	bool csv;
+} ;
+
+
+struct BenchmarkResult
+{
+	int periods;
+	double seconds;
+	double audioSeconds;
+	double stageTimes[MixerProfiler::NumStages];
+	double maxPeriodTime;
+	double allocations;
+	int jobsHighWaterMark;
+	double activeNodes[MixerProfiler::NumNodeTypes];
+	double silentNodes[MixerProfiler::NumNodeTypes];
+} ;
+
+
+static const char * stageNames[MixerProfiler::NumStages] =
+{
+	"prepare", "render", "mastermix", "finish"
+} ;
+
+
+static const char * nodeTypeNames[MixerProfiler::NumNodeTypes] =
+{
+	"playhandles", "ports", "effects", "fxchannels"
+} ;
+
+
+
+
+static InstrumentTrack * addTrack( const QString & instrument,
+					const BenchmarkOptions & options, int index )
+{
+	InstrumentTrack * track = dynamic_cast<InstrumentTrack *>(
+		Track::create( Track::InstrumentTrack, Engine::getSong() ) );
+	track->loadInstrument( instrument );
+
+	Pattern * pattern = dynamic_cast<Pattern *>(
+					track->createTCO( MidiTime( 0 ) ) );
+
+	// spread notes over sixteenth steps, notes beyond the number of
+	// steps end up in chords
+	const tick_t step = MidiTime::ticksPerTact() / 16;
+	const int steps = options.bars * 16;
+	for( int n = 0; n < options.notes; ++n )
+	{
+		const int key = DefaultKey - 12 + ( n * 7 + index * 5 ) % 24;
+		pattern->addNote( Note( MidiTime( 4 * step ),
+					MidiTime( ( n % steps ) * step ), key ),
+								false );
+	}
+	pattern->changeLength( MidiTime( options.bars, 0 ) );
+
+	return track;
+}
+
+
+
+
+// one pattern per bar, notes of the track are distributed among them
+static void addLongSongTrack( const BenchmarkOptions & options, int index )
+{
+	InstrumentTrack * track = dynamic_cast<InstrumentTrack *>(
+		Track::create( Track::InstrumentTrack, Engine::getSong() ) );
+	track->loadInstrument( "tripleoscillator" );
+
+	const tick_t step = MidiTime::ticksPerTact() / 16;
+	for( int bar = 0; bar < options.bars; ++bar )
+	{
+		Pattern * pattern = dynamic_cast<Pattern *>(
+					track->createTCO( MidiTime( 0 ) ) );
+		pattern->movePosition( MidiTime( bar, 0 ) );
+		for( int n = bar; n < options.notes; n += options.bars )
+		{
+			const int key = DefaultKey - 12 + ( n * 7 + index * 5 ) % 24;
+			pattern->addNote( Note( MidiTime( step ),
+					MidiTime( ( n / options.bars % 16 ) * step ),
+								key ), false );
+		}
+		pattern->changeLength( MidiTime( 1, 0 ) );
+	}
+}
+
+
+
+
+static void addEffects( EffectChain * chain )
+{
+	const char * effects[] = { "bassbooster", "stereoenhancer", "amplifier" };
+	for( unsigned int i = 0; i < sizeof( effects ) / sizeof( effects[0] ); ++i )
+	{
+		Effect * e = Effect::instantiate( effects[i], chain, NULL );
+		if( e )
+		{
+			chain->appendEffect( e );
+		}
+	}
+	chain->setEnabled( true );
+}
+
+
+
+
+static bool buildScene( const QString & scene, const BenchmarkOptions & options )
+{
+	if( scene == "tripleosc" )
+	{
+		for( int t = 0; t < options.tracks; ++t )
+		{
+			addTrack( "tripleoscillator", options, t );
+		}
+	}
+	else if( scene == "afp" )
+	{
+		for( int t = 0; t < options.tracks; ++t )
+		{
+			InstrumentTrack * track = addTrack( "audiofileprocessor", options, t );
+			track->instrument()->loadFile( t % 2 ? "drums/snare01.ogg" :
+							"drums/bassdrum01.ogg" );
+		}
+	}
+	else if( scene == "effects" )
+	{
+		for( int t = 0; t < options.tracks; ++t )
+		{
+			InstrumentTrack * track = addTrack( "tripleoscillator", options, t );
+			addEffects( track->audioPort()->effects() );
+		}
+	}
+	else if( scene == "longsong" )
+	{
+		for( int t = 0; t < options.tracks; ++t )
+		{
+			addLongSongTrack( options, t );
+		}
+	}
+	else if( scene == "fxsends" || scene == "idle" )
+	{
+		BenchmarkOptions trackOptions = options;
+		if( scene == "idle" )
+		{
+			trackOptions.notes = 0;
+		}
+
+		// every track gets its own FX channel, all of them send to a
+		// bus with effects which sends to master
+		FxMixer * fxMixer = Engine::fxMixer();
+		const int bus = fxMixer->createChannel();
+		addEffects( &fxMixer->effectChannel( bus )->m_fxChain );
+
+		for( int t = 0; t < options.tracks; ++t )
+		{
+			InstrumentTrack * track = addTrack( "tripleoscillator", trackOptions, t );
+			if( scene == "idle" )
+			{
+				addEffects( track->audioPort()->effects() );
+			}
+			const int channel = fxMixer->createChannel();
+			fxMixer->createChannelSend( channel, bus, 0.5f );
+			addEffects( &fxMixer->effectChannel( channel )->m_fxChain );
+			track->effectChannelModel()->setValue( channel );
+		}
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
+
+
+static BenchmarkResult render( BenchmarkDevice * device, const BenchmarkOptions & options )
+{
+	Mixer * mixer = Engine::mixer();
+	MixerProfiler & profiler = mixer->profiler();
+
+	BenchmarkResult result;
+	memset( &result, 0, sizeof( result ) );
+
+	Engine::getSong()->startExport();
+
+	MicroTimer timer;
+	while( Engine::getSong()->isExportDone() == false &&
+			( options.periods <= 0 || result.periods < options.periods ) )
+	{
+		device->processNextBuffer();
+
+		for( int s = 0; s < MixerProfiler::NumStages; ++s )
+		{
+			result.stageTimes[s] += profiler.stageTime( (MixerProfiler::Stage) s );
+		}
+		result.maxPeriodTime = qMax<double>( result.maxPeriodTime, profiler.periodTime() );
+		result.allocations += profiler.periodAllocations();
+		result.jobsHighWaterMark = qMax( result.jobsHighWaterMark, profiler.periodJobs() );
+		for( int n = 0; n < MixerProfiler::NumNodeTypes; ++n )
+		{
+			result.activeNodes[n] += profiler.activeNodes( (MixerProfiler::NodeType) n );
+			result.silentNodes[n] += profiler.silentNodes( (MixerProfiler::NodeType) n );
+		}
+		++result.periods;
+	}
+	result.seconds = timer.elapsed() / 1000000.0;
+
+	Engine::getSong()->stopExport();
+
+	result.audioSeconds = (double) result.periods * mixer->framesPerPeriod() /
+						mixer->processingSampleRate();
+
+	return result;
+}
+
+
+
+
+static void printResult( const QString & scene, const BenchmarkOptions & options,
+						const BenchmarkResult & result )
+{
+	const int periods = qMax( result.periods, 1 );
+	const double seconds = qMax( result.seconds, 1e-6 );
+
+	if( options.csv )
+	{
+		printf( "%s,%d,%d,%d,%.1f,%.2f", qPrintable( scene ),
+			options.tracks, options.notes, result.periods,
+			result.periods / seconds, result.audioSeconds / seconds );
+		for( int s = 0; s < MixerProfiler::NumStages; ++s )
+		{
+			printf( ",%.1f", result.stageTimes[s] / periods );
+		}
+		printf( ",%.0f,%.1f,%d", result.maxPeriodTime,
+			result.allocations / periods, result.jobsHighWaterMark );
+		for( int n = 0; n < MixerProfiler::NumNodeTypes; ++n )
+		{
+			printf( ",%.1f,%.1f", result.activeNodes[n] / periods,
+						result.silentNodes[n] / periods );
+		}
+		printf( "\n" );
+		return;
+	}
+
+	printf( "%s: %d tracks x %d notes, %d periods\n", qPrintable( scene ),
+				options.tracks, options.notes, result.periods );
+	printf( "  %.1f periods/s, realtime factor %.2f\n",
+			result.periods / seconds, result.audioSeconds / seconds );
+	printf( "  stages (us/period):" );
+	for( int s = 0; s < MixerProfiler::NumStages; ++s )
+	{
+		printf( " %s %.1f", stageNames[s], result.stageTimes[s] / periods );
+	}
+	printf( "\n  slowest period %.0f us, %.1f allocations/period, "
+			"up to %d jobs queued\n", result.maxPeriodTime,
+			result.allocations / periods, result.jobsHighWaterMark );
+	printf( "  active/silent nodes per period:" );
+	for( int n = 0; n < MixerProfiler::NumNodeTypes; ++n )
+	{
+		printf( " %s %.1f/%.1f", nodeTypeNames[n],
+			result.activeNodes[n] / periods, result.silentNodes[n] / periods );
+	}
+	printf( "\n" );
+}
+
+
+
+
+int main( int argc, char * * argv )
+{
+	MemoryManager::init();
+	NotePlayHandleManager::init();
+	MixHelpers::init();
+
+	QCoreApplication app( argc, argv );
+
+	BenchmarkOptions options;
+	options.tracks = 16;
+	options.notes = 64;
+	options.bars = 8;
+	options.periods = 0;
+	options.csv = false;
+	QString sceneName = "all";
+	QString pluginDir;
+
+	const QStringList args = app.arguments();
+	for( int i = 1; i < args.size(); ++i )
+	{
+		const bool hasValue = i + 1 < args.size();
+		if( args[i] == "--scene" && hasValue )
+		{
+			sceneName = args[++i];
+		}
+		else if( args[i] == "--tracks" && hasValue )
+		{
+			options.tracks = args[++i].toInt();
+		}
+		else if( args[i] == "--notes" && hasValue )
+		{
+			options.notes = args[++i].toInt();
+		}
+		else if( args[i] == "--bars" && hasValue )
+		{
+			options.bars = qMax( args[++i].toInt(), 1 );
+		}
+		else if( args[i] == "--periods" && hasValue )
+		{
+			options.periods = args[++i].toInt();
+		}
+		else if( args[i] == "--plugin-dir" && hasValue )
+		{
+			pluginDir = args[++i];
+		}
+		else if( args[i] == "--csv" )
+		{
+			options.csv = true;
+		}
+		else
+		{
+			printf( "usage: %s [--scene tripleosc|afp|effects|fxsends|all|longsong|idle] "
+				"[--tracks N] [--notes M] [--bars B] [--periods P] "
+				"[--plugin-dir <dir>] [--csv]\n", argv[0] );
+			return 1;
+		}
+	}
+
+	if( !pluginDir.isEmpty() )
+	{
+		ConfigManager::inst()->setPluginDir( pluginDir );
+	}
+	ConfigManager::inst()->loadConfigFile();
+
+	// no device name matches, so the mixer starts up with AudioDummy and
+	// MidiDummy - the configuration file isn't saved by us
+	ConfigManager::inst()->setValue( "mixer", "audiodev", "benchmark" );
+	ConfigManager::inst()->setValue( "mixer", "mididev", "benchmark" );
+
+	Engine::init();
+
+	// render without fifo so every period is rendered by processNextBuffer()
+	BenchmarkDevice * device = new BenchmarkDevice( Engine::mixer() );
+	Engine::mixer()->setAudioDevice( device, Engine::mixer()->currentQualitySettings(), false );
+
+	QStringList scenes;
+	if( sceneName == "all" )
+	{
+		scenes << "tripleosc" << "afp" << "effects" << "fxsends";
+	}
+	else
+	{
+		scenes << sceneName;
+	}
+
+	if( options.csv )
+	{
+		printf( "scene,tracks,notes,periods,periods_per_sec,realtime_factor" );
+		for( int s = 0; s < MixerProfiler::NumStages; ++s )
+		{
+			printf( ",%s_us", stageNames[s] );
+		}
+		printf( ",max_period_us,allocations_per_period,max_jobs" );
+		for( int n = 0; n < MixerProfiler::NumNodeTypes; ++n )
+		{
+			printf( ",%s_active,%s_silent", nodeTypeNames[n], nodeTypeNames[n] );
+		}
+		printf( "\n" );
+	}
+
+	int ret = 0;
+	foreach( const QString & scene, scenes )
+	{
+		Engine::getSong()->clearProject();
+		if( !buildScene( scene, options ) )
+		{
+			fprintf( stderr, "unknown scene %s\n", qPrintable( scene ) );
+			ret = 1;
+			continue;
+		}
+		printResult( scene, options, render( device, options ) );
+	}
+
+	Engine::getSong()->clearProject();
+	// also deletes our device
+	Engine::mixer()->restoreAudioDevice();
+
+	return ret;
+}
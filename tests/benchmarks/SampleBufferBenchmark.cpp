@@ -0,0 +1,204 @@
+/*
+ * SampleBufferBenchmark.cpp - time SampleBuffer::play() of many looped
+ *                             voices
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*
+ * Plays 64 to 512 voices of one sample with a short loop, which is crossed
+ * by every voice in every period, so each period fetches a fragment around
+ * the loop points. Voices are pitched up by a fifth, so the fragment is
+ * resampled as well:
+ *
+ *	samplebenchmark [--periods P] [--runs R]
+ *
+ * Each loop mode and voice count is rendered R times. Timings of single
+ * runs vary a lot with CPU frequency and cache state, so the fastest, the
+ * median and the slowest run are reported in us per period, together with
+ * MemoryManager allocations per period, which should be 0.
+ */
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QStringList>
+#include <QtCore/QtAlgorithms>
+
+#include <cstdio>
+
+#include "ConfigManager.h"
+#include "Engine.h"
+#include "MemoryManager.h"
+#include "MicroTimer.h"
+#include "Mixer.h"
+#include "SampleBuffer.h"
+
+
+static const f_cnt_t SampleFrames = 44100;
+static const f_cnt_t LoopStart = 1000;
+static const f_cnt_t LoopEnd = 1300;
+static const fpp_t PeriodFrames = 256;
+
+
+struct RunResult
+{
+	double periodTime;
+	double allocations;
+} ;
+
+
+
+
+// renders given number of periods with all voices starting in the loop
+static RunResult render( SampleBuffer * sample,
+				SampleBuffer::LoopMode loopMode, int voices,
+								int periods )
+{
+	SampleBuffer::handleState * * states =
+				new SampleBuffer::handleState *[voices];
+	for( int v = 0; v < voices; ++v )
+	{
+		states[v] = new SampleBuffer::handleState( false, SRC_LINEAR );
+		states[v]->setFrameIndex( LoopStart +
+					v % ( LoopEnd - LoopStart ) );
+	}
+	sampleFrame * buf = new sampleFrame[PeriodFrames];
+
+	const float freq = BaseFreq * 1.5f;
+
+	// warm up, so buffers grown in the first periods aren't counted
+	for( int v = 0; v < voices; ++v )
+	{
+		sample->play( buf, states[v], PeriodFrames, freq, loopMode );
+	}
+
+	const int allocations = MemoryManager::allocations();
+	MicroTimer timer;
+	for( int p = 0; p < periods; ++p )
+	{
+		for( int v = 0; v < voices; ++v )
+		{
+			sample->play( buf, states[v], PeriodFrames, freq,
+								loopMode );
+		}
+	}
+
+	RunResult result;
+	result.periodTime = (double) timer.elapsed() / periods;
+	result.allocations = (double)( MemoryManager::allocations() -
+						allocations ) / periods;
+
+	delete[] buf;
+	for( int v = 0; v < voices; ++v )
+	{
+		delete states[v];
+	}
+	delete[] states;
+
+	return result;
+}
+
+
+
+
+int main( int argc, char * * argv )
+{
+	MemoryManager::init();
+
+	QCoreApplication app( argc, argv );
+
+	int periods = 2000;
+	int runs = 7;
+
+	const QStringList args = app.arguments();
+	for( int i = 1; i < args.size(); ++i )
+	{
+		const bool hasValue = i + 1 < args.size();
+		if( args[i] == "--periods" && hasValue )
+		{
+			periods = qMax( args[++i].toInt(), 1 );
+		}
+		else if( args[i] == "--runs" && hasValue )
+		{
+			runs = qMax( args[++i].toInt(), 1 );
+		}
+		else
+		{
+			printf( "usage: %s [--periods P] [--runs R]\n", argv[0] );
+			return 1;
+		}
+	}
+
+	ConfigManager::inst()->loadConfigFile();
+	// start up with AudioDummy and MidiDummy, see RenderBenchmark.cpp
+	ConfigManager::inst()->setValue( "mixer", "audiodev", "benchmark" );
+	ConfigManager::inst()->setValue( "mixer", "mididev", "benchmark" );
+
+	Engine::init();
+
+	sampleFrame * data = new sampleFrame[SampleFrames];
+	unsigned int seed = 1;
+	for( f_cnt_t f = 0; f < SampleFrames; ++f )
+	{
+		for( ch_cnt_t ch = 0; ch < DEFAULT_CHANNELS; ++ch )
+		{
+			seed = seed * 1103515245 + 12345;
+			data[f][ch] = ( ( seed >> 8 ) & 0xffff ) / 32768.0f - 1.0f;
+		}
+	}
+	SampleBuffer * sample = new SampleBuffer( data, SampleFrames );
+	sample->setAllPointFrames( 0, SampleFrames, LoopStart, LoopEnd );
+	delete[] data;
+
+	printf( "%d frames per period, %d periods, %d runs\n", PeriodFrames,
+							periods, runs );
+	printf( "%-10s %6s %10s %10s %10s %12s\n", "mode", "voices", "min_us",
+				"median_us", "max_us", "allocations" );
+
+	const SampleBuffer::LoopMode loopModes[] =
+	{
+		SampleBuffer::LoopOn, SampleBuffer::LoopPingPong
+	} ;
+	const char * loopModeNames[] = { "loop", "pingpong" };
+
+	for( int m = 0; m < 2; ++m )
+	{
+		for( int voices = 64; voices <= 512; voices *= 2 )
+		{
+			QList<double> times;
+			double allocations = 0;
+			for( int r = 0; r < runs; ++r )
+			{
+				const RunResult result = render( sample,
+						loopModes[m], voices, periods );
+				times << result.periodTime;
+				allocations = qMax( allocations,
+							result.allocations );
+			}
+			qSort( times );
+			printf( "%-10s %6d %10.1f %10.1f %10.1f %12.2f\n",
+					loopModeNames[m], voices, times.first(),
+					times[times.size() / 2], times.last(),
+								allocations );
+		}
+	}
+
+	delete sample;
+
+	return 0;
+}
@@ -0,0 +1,250 @@
+/*
+ * SampleConversionBenchmark.cpp - time sample conversion kernels against
+ *                                 scalar reference
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*
+ * Converts a period of mixer output with every kernel table usable on this
+ * CPU to every output format, with and without dither and byte swapping,
+ * and reports time per period and speedup over the scalar reference:
+ *
+ *	conversionbenchmark [--frames N] [--iterations I]
+ *
+ * The first row is the conversion to 16 bit AudioDevice::convertToS16()
+ * used to do frame by frame. Results of all kernels are compared to the
+ * scalar reference on a buffer containing infs and NaNs and with an odd
+ * number of frames - if any byte differs, the benchmark exits with 1.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <QtCore/QtGlobal>
+
+#include "MicroTimer.h"
+#include "SampleConverter.h"
+
+
+struct Case
+{
+	const char * name;
+	SampleConverter::Format format;
+	SampleConverter::DitherMode dither;
+	bool swap;
+} ;
+
+static const Case cases[] =
+{
+	{ "s16", SampleConverter::Format_S16, SampleConverter::Dither_None, false },
+	{ "s16 swapped", SampleConverter::Format_S16, SampleConverter::Dither_None, true },
+	{ "s16 tpdf", SampleConverter::Format_S16, SampleConverter::Dither_TPDF, false },
+	{ "s16 noise shaped", SampleConverter::Format_S16, SampleConverter::Dither_NoiseShaped, false },
+	{ "s24 tpdf", SampleConverter::Format_S24, SampleConverter::Dither_TPDF, false },
+	{ "s24 tpdf swapped", SampleConverter::Format_S24, SampleConverter::Dither_TPDF, true },
+	{ "s32", SampleConverter::Format_S32, SampleConverter::Dither_None, false },
+	{ "float", SampleConverter::Format_Float, SampleConverter::Dither_None, false },
+	{ "float unclipped", SampleConverter::Format_FloatUnclipped, SampleConverter::Dither_None, false }
+} ;
+
+static const int NumCases = sizeof( cases ) / sizeof( cases[0] );
+
+
+
+
+static void fillBuffer( surroundSampleFrame * buf, int frames, bool special )
+{
+	unsigned int seed = 1;
+	for( int f = 0; f < frames; ++f )
+	{
+		for( int ch = 0; ch < SURROUND_CHANNELS; ++ch )
+		{
+			seed = seed * 1103515245 + 12345;
+			buf[f][ch] = ( ( seed >> 8 ) & 0xffff ) / 32768.0f *
+								1.2f - 1.2f;
+		}
+	}
+	if( special && frames > 8 )
+	{
+		buf[1][0] = NAN;
+		buf[3][1] = INFINITY;
+		buf[6][0] = -INFINITY;
+	}
+}
+
+
+
+
+// what AudioDevice::convertToS16() did before using SampleConverter
+static void legacyToS16( const surroundSampleFrame * src, int frames,
+					float gain, int16_t * dst )
+{
+	for( int f = 0; f < frames; ++f )
+	{
+		for( int ch = 0; ch < SURROUND_CHANNELS; ++ch )
+		{
+			dst[f * SURROUND_CHANNELS + ch] = static_cast<int16_t>(
+				qBound( -1.0f, src[f][ch] * gain, 1.0f ) *
+								32767.0f );
+		}
+	}
+}
+
+
+
+
+// time per call in ns, kernels == NULL for legacy conversion
+static double timeCase( const SampleConversionKernels * kernels,
+				const Case & c, int frames, int iterations )
+{
+	surroundSampleFrame * src = new surroundSampleFrame[frames];
+	int32_t * dst = new int32_t[frames * SURROUND_CHANNELS];
+	fillBuffer( src, frames, false );
+
+	SampleConverter converter( c.format, c.dither );
+	SampleConversion::setCurrentKernels( kernels );
+
+	MicroTimer timer;
+	for( int i = 0; i < iterations; ++i )
+	{
+		if( kernels )
+		{
+			converter.convert( src, frames, SURROUND_CHANNELS,
+						0.8f, dst, c.swap );
+		}
+		else
+		{
+			legacyToS16( src, frames, 0.8f, (int16_t *) dst );
+		}
+	}
+	const double ns = timer.elapsed() * 1000.0 / iterations;
+
+	delete[] src;
+	delete[] dst;
+
+	return ns;
+}
+
+
+
+
+static bool matchesScalar( const SampleConversionKernels * kernels,
+						const Case & c, int frames )
+{
+	surroundSampleFrame * src = new surroundSampleFrame[frames];
+	int32_t * expected = new int32_t[frames * SURROUND_CHANNELS];
+	int32_t * result = new int32_t[frames * SURROUND_CHANNELS];
+	fillBuffer( src, frames, true );
+
+	SampleConverter ref( c.format, c.dither );
+	SampleConverter converter( c.format, c.dither );
+	bool same = true;
+	// twice, so dither state carried over is compared as well
+	for( int period = 0; period < 2; ++period )
+	{
+		SampleConversion::setCurrentKernels(
+					SampleConversion::scalarKernels() );
+		const int bytes = ref.convert( src, frames, SURROUND_CHANNELS,
+						0.8f, expected, c.swap );
+		SampleConversion::setCurrentKernels( kernels );
+		converter.convert( src, frames, SURROUND_CHANNELS, 0.8f,
+							result, c.swap );
+		same = same && memcmp( expected, result, bytes ) == 0;
+	}
+
+	delete[] src;
+	delete[] expected;
+	delete[] result;
+
+	return same;
+}
+
+
+
+
+int main( int argc, char * * argv )
+{
+	int frames = 256;
+	int iterations = 100000;
+
+	for( int i = 1; i < argc; ++i )
+	{
+		const bool hasValue = i + 1 < argc;
+		if( !strcmp( argv[i], "--frames" ) && hasValue )
+		{
+			frames = qMax( atoi( argv[++i] ), 1 );
+		}
+		else if( !strcmp( argv[i], "--iterations" ) && hasValue )
+		{
+			iterations = qMax( atoi( argv[++i] ), 1 );
+		}
+		else
+		{
+			printf( "usage: %s [--frames N] [--iterations I]\n", argv[0] );
+			return 1;
+		}
+	}
+
+	printf( "%d frames of %d channels per call, %d iterations\n", frames,
+					SURROUND_CHANNELS, iterations );
+	printf( "%-20s", "format" );
+	for( int k = 0; k < SampleConversion::numKernels(); ++k )
+	{
+		printf( " %16s", SampleConversion::kernels( k )->name );
+	}
+	printf( "\n" );
+
+	const Case legacy = cases[0];
+	printf( "%-20s %13.0fns\n", "s16 (convertToS16)",
+				timeCase( NULL, legacy, frames, iterations ) );
+
+	int ret = 0;
+	for( int c = 0; c < NumCases; ++c )
+	{
+		printf( "%-20s", cases[c].name );
+
+		double scalarTime = 0;
+		for( int k = 0; k < SampleConversion::numKernels(); ++k )
+		{
+			const SampleConversionKernels * kernels =
+						SampleConversion::kernels( k );
+			const double ns = timeCase( kernels, cases[c], frames,
+								iterations );
+			if( k == 0 )
+			{
+				scalarTime = ns;
+				printf( " %13.0fns", ns );
+				continue;
+			}
+
+			printf( " %6.0fns %5.2fx", ns, scalarTime / ns );
+			if( !matchesScalar( kernels, cases[c], frames + 3 ) )
+			{
+				printf( " (differs from scalar)" );
+				ret = 1;
+			}
+		}
+		printf( "\n" );
+	}
+
+	return ret;
+}
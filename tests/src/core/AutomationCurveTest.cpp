@@ -0,0 +1,191 @@
+/*
+ * AutomationCurveTest.cpp
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "QTestSuite.h"
+
+#include <cmath>
+
+#include "AutomationCurve.h"
+
+typedef AutomationPattern::timeMap timeMap;
+
+static const int Patterns = 300;
+
+static float randomValue( unsigned int & seed, float range )
+{
+	seed = seed * 1103515245 + 12345;
+	return ( ( seed >> 8 ) & 0xffff ) / 32768.0f * range - range;
+}
+
+// 1 to 16 points at random positions within 4 bars, values within -1..1
+// and tangents like AutomationPattern::generateTangents() would give
+static void randomPattern( unsigned int & seed, timeMap & values,
+							timeMap & tangents )
+{
+	values.clear();
+	tangents.clear();
+	const int points = 1 + (int) fabsf( randomValue( seed, 8.0f ) * 2 ) % 16;
+	for( int p = 0; p < points; ++p )
+	{
+		const int tick = (int) fabsf( randomValue( seed, 384.0f ) * 2 );
+		values[tick] = randomValue( seed, 1.0f );
+		tangents[tick] = randomValue( seed, 0.01f );
+	}
+}
+
+// how AutomationPattern::valueAt() evaluated the time map before it was
+// compiled into an AutomationCurve
+static float referenceValueAt( const timeMap & values, const timeMap & tangents,
+		AutomationPattern::ProgressionTypes progression, float tension,
+								int tick )
+{
+	if( values.isEmpty() )
+	{
+		return 0;
+	}
+	if( values.contains( tick ) )
+	{
+		return values[tick];
+	}
+
+	timeMap::ConstIterator v = values.lowerBound( tick );
+	if( v == values.begin() )
+	{
+		return 0;
+	}
+	if( v == values.end() )
+	{
+		return ( v - 1 ).value();
+	}
+	--v;
+
+	const int offset = tick - v.key();
+	if( progression == AutomationPattern::DiscreteProgression )
+	{
+		return v.value();
+	}
+	else if( progression == AutomationPattern::LinearProgression )
+	{
+		const float slope = ( ( v + 1 ).value() - v.value() ) /
+						( ( v + 1 ).key() - v.key() );
+		return v.value() + offset * slope;
+	}
+
+	const int numValues = ( v + 1 ).key() - v.key();
+	const float t = (float) offset / (float) numValues;
+	const float m1 = tangents[v.key()] * numValues * tension;
+	const float m2 = tangents[( v + 1 ).key()] * numValues * tension;
+	return ( 2 * pow( t, 3 ) - 3 * pow( t, 2 ) + 1 ) * v.value()
+			+ ( pow( t, 3 ) - 2 * pow( t, 2 ) + t ) * m1
+			+ ( -2 * pow( t, 3 ) + 3 * pow( t, 2 ) ) * ( v + 1 ).value()
+			+ ( pow( t, 3 ) - pow( t, 2 ) ) * m2;
+}
+
+static bool closeTo( float value, float expected )
+{
+	return fabsf( value - expected ) <= 1e-6f;
+}
+
+class AutomationCurveTest : QTestSuite
+{
+	Q_OBJECT
+private slots:
+	void emptyPattern()
+	{
+		const timeMap empty;
+		AutomationCurve curve( empty, empty,
+				AutomationPattern::LinearProgression, 1.0f );
+		QVERIFY( curve.isEmpty() );
+		QCOMPARE( curve.valueAt( 0.0f ), 0.0f );
+		QCOMPARE( curve.valueAt( 100.0f ), 0.0f );
+	}
+
+	void matchesTimeMapEvaluation()
+	{
+		const AutomationPattern::ProgressionTypes progressions[] =
+		{
+			AutomationPattern::DiscreteProgression,
+			AutomationPattern::LinearProgression,
+			AutomationPattern::CubicHermiteProgression
+		} ;
+
+		unsigned int seed = 1;
+		timeMap values;
+		timeMap tangents;
+		for( int p = 0; p < Patterns; ++p )
+		{
+			randomPattern( seed, values, tangents );
+			const float tension = fabsf( randomValue( seed, 0.5f ) ) * 2;
+			const int last = ( values.end() - 1 ).key();
+
+			for( int i = 0; i < 3; ++i )
+			{
+				AutomationCurve curve( values, tangents,
+						progressions[i], tension );
+				int cursor = -1;
+				for( int tick = -8; tick <= last + 8; ++tick )
+				{
+					const float expected = referenceValueAt(
+							values, tangents,
+							progressions[i], tension,
+									tick );
+					QVERIFY( closeTo( curve.valueAt( tick ),
+								expected ) );
+					// same with increasing positions
+					QVERIFY( closeTo( curve.valueAt( tick,
+							cursor ), expected ) );
+				}
+			}
+		}
+	}
+
+	void fillMatchesValueAt()
+	{
+		unsigned int seed = 2;
+		timeMap values;
+		timeMap tangents;
+		for( int p = 0; p < Patterns; ++p )
+		{
+			randomPattern( seed, values, tangents );
+			AutomationCurve curve( values, tangents,
+				AutomationPattern::CubicHermiteProgression, 1.0f );
+
+			// a period spanning several points at a fractional
+			// number of ticks per frame
+			const int frames = 256;
+			const float start = randomValue( seed, 200.0f ) + 200.0f;
+			const float ticksPerFrame = fabsf(
+					randomValue( seed, 1.0f ) ) + 0.01f;
+			float filled[frames];
+			int cursor = -1;
+			curve.fill( filled, frames, start, ticksPerFrame, cursor );
+
+			for( int f = 0; f < frames; ++f )
+			{
+				QVERIFY( closeTo( filled[f], curve.valueAt(
+					start + f * ticksPerFrame ) ) );
+			}
+		}
+	}
+} instance;
+
+#include "AutomationCurveTest.moc"
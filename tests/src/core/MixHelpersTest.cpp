@@ -0,0 +1,241 @@
+/*
+ * MixHelpersTest.cpp - check gain stages of MixHelpers against the
+ *                      loops they replaced
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "QTestSuite.h"
+
+#include <cstring>
+
+#include "MixHelpers.h"
+#include "MixKernels.h"
+#include "ValueBuffer.h"
+
+// odd number of frames, so remainder loops of all kernels are covered
+static const int Frames = 259;
+
+static float randomValue( unsigned int & seed, float range )
+{
+	seed = seed * 1103515245 + 12345;
+	return ( ( seed >> 8 ) & 0xffff ) / 32768.0f * range - range;
+}
+
+static void fillRandom( sampleFrame * buf, unsigned int seed )
+{
+	for( int f = 0; f < Frames; ++f )
+	{
+		buf[f][0] = randomValue( seed, 1.0f );
+		buf[f][1] = randomValue( seed, 1.0f );
+	}
+}
+
+// volume 0..200, panning -100..100 with some exact zeros and extremes
+static void fillVolumeAndPanning( ValueBuffer & vol, ValueBuffer & pan )
+{
+	unsigned int seed = 7;
+	for( int f = 0; f < Frames; ++f )
+	{
+		vol.values()[f] = randomValue( seed, 100.0f ) + 100.0f;
+		pan.values()[f] = f % 5 == 0 ? ( f % 3 - 1 ) * 100.0f :
+				f % 7 == 0 ? ( f % 2 ? 0.0f : -0.0f ) :
+						randomValue( seed, 100.0f );
+	}
+}
+
+// volume/panning stage of AudioPort::doProcessing() before it was moved
+// into MixHelpers
+static void referenceVolumeAndPanning( sampleFrame * buf, ValueBuffer * volBuf, float vol,
+					ValueBuffer * panBuf, float pan, bool hasPanning )
+{
+	if( hasPanning )
+	{
+		if( volBuf && panBuf )
+		{
+			for( int f = 0; f < Frames; ++f )
+			{
+				float v = volBuf->values()[ f ] * 0.01f;
+				float p = panBuf->values()[ f ] * 0.01f;
+				buf[f][0] *= ( p <= 0 ? 1.0f : 1.0f - p ) * v;
+				buf[f][1] *= ( p >= 0 ? 1.0f : 1.0f + p ) * v;
+			}
+		}
+		else if( volBuf )
+		{
+			float p = pan * 0.01f;
+			float l = ( p <= 0 ? 1.0f : 1.0f - p );
+			float r = ( p >= 0 ? 1.0f : 1.0f + p );
+			for( int f = 0; f < Frames; ++f )
+			{
+				float v = volBuf->values()[ f ] * 0.01f;
+				buf[f][0] *= v * l;
+				buf[f][1] *= v * r;
+			}
+		}
+		else if( panBuf )
+		{
+			float v = vol * 0.01f;
+			for( int f = 0; f < Frames; ++f )
+			{
+				float p = panBuf->values()[ f ] * 0.01f;
+				buf[f][0] *= ( p <= 0 ? 1.0f : 1.0f - p ) * v;
+				buf[f][1] *= ( p >= 0 ? 1.0f : 1.0f + p ) * v;
+			}
+		}
+		else
+		{
+			float p = pan * 0.01f;
+			float v = vol * 0.01f;
+			for( int f = 0; f < Frames; ++f )
+			{
+				buf[f][0] *= ( p <= 0 ? 1.0f : 1.0f - p ) * v;
+				buf[f][1] *= ( p >= 0 ? 1.0f : 1.0f + p ) * v;
+			}
+		}
+	}
+	else
+	{
+		float v = vol * 0.01f;
+		for( int f = 0; f < Frames; ++f )
+		{
+			const float fv = volBuf ? volBuf->values()[ f ] * 0.01f : v;
+			buf[f][0] *= fv;
+			buf[f][1] *= fv;
+		}
+	}
+}
+
+// send stage of FxChannel::doProcessing() before it was moved into
+// MixHelpers
+static void referenceSend( sampleFrame * dst, const sampleFrame * src,
+				float vol, ValueBuffer * volBuf,
+				float send, ValueBuffer * sendBuf, bool exporting )
+{
+	if( ! volBuf && ! sendBuf )
+	{
+		const float v = vol * send;
+		if( exporting ) { MixHelpers::addSanitizedMultiplied( dst, src, v, Frames ); }
+		else { MixHelpers::addMultiplied( dst, src, v, Frames ); }
+	}
+	else if( volBuf && sendBuf )
+	{
+		if( exporting ) { MixHelpers::addSanitizedMultipliedByBuffers( dst, src, volBuf, sendBuf, Frames ); }
+		else { MixHelpers::addMultipliedByBuffers( dst, src, volBuf, sendBuf, Frames ); }
+	}
+	else if( volBuf )
+	{
+		if( exporting ) { MixHelpers::addSanitizedMultipliedByBuffer( dst, src, send, volBuf, Frames ); }
+		else { MixHelpers::addMultipliedByBuffer( dst, src, send, volBuf, Frames ); }
+	}
+	else
+	{
+		if( exporting ) { MixHelpers::addSanitizedMultipliedByBuffer( dst, src, vol, sendBuf, Frames ); }
+		else { MixHelpers::addMultipliedByBuffer( dst, src, vol, sendBuf, Frames ); }
+	}
+}
+
+class MixHelpersTest : QTestSuite
+{
+	Q_OBJECT
+private slots:
+	void volumeAndPanningIsBitExact()
+	{
+		ValueBuffer vol( Frames );
+		ValueBuffer pan( Frames );
+		fillVolumeAndPanning( vol, pan );
+
+		const float constVolumes[] = { 0.0f, 37.5f, 100.0f, 173.0f };
+		const float constPannings[] = { -100.0f, -33.0f, -0.0f, 0.0f, 61.0f, 100.0f };
+
+		sampleFrame expected[Frames];
+		sampleFrame result[Frames];
+
+		const MixKernels * previous = MixHelpers::currentKernels();
+		for( int k = 0; k < MixHelpers::numKernels(); ++k )
+		{
+			MixHelpers::setCurrentKernels( MixHelpers::kernels( k ) );
+			for( int c = 0; c < 4; ++c )
+			{
+				ValueBuffer * volBuf = c & 1 ? &vol : NULL;
+				ValueBuffer * panBuf = c & 2 ? &pan : NULL;
+				for( unsigned int v = 0; v < sizeof( constVolumes ) / sizeof( float ); ++v )
+				{
+					for( unsigned int p = 0; p < sizeof( constPannings ) / sizeof( float ); ++p )
+					{
+						fillRandom( expected, v * 10 + p );
+						fillRandom( result, v * 10 + p );
+						referenceVolumeAndPanning( expected, volBuf, constVolumes[v],
+								panBuf, constPannings[p], true );
+						MixHelpers::multiplyByVolumeAndPanning( result, volBuf,
+							constVolumes[v], panBuf, constPannings[p], Frames );
+						QVERIFY2( memcmp( expected, result, sizeof( result ) ) == 0,
+								MixHelpers::instructionSet() );
+
+						// ports without panning model
+						fillRandom( expected, v );
+						fillRandom( result, v );
+						referenceVolumeAndPanning( expected, volBuf, constVolumes[v],
+									NULL, 0.0f, false );
+						MixHelpers::multiplyByVolumeAndPanning( result, volBuf,
+								constVolumes[v], NULL, 0.0f, Frames );
+						QVERIFY2( memcmp( expected, result, sizeof( result ) ) == 0,
+								MixHelpers::instructionSet() );
+					}
+				}
+			}
+		}
+		MixHelpers::setCurrentKernels( previous );
+	}
+
+	void addMultipliedByGainsIsBitExact()
+	{
+		ValueBuffer vol( Frames );
+		ValueBuffer send( Frames );
+		fillVolumeAndPanning( vol, send );
+
+		sampleFrame src[Frames];
+		sampleFrame expected[Frames];
+		sampleFrame result[Frames];
+		fillRandom( src, 1 );
+
+		const MixKernels * previous = MixHelpers::currentKernels();
+		for( int k = 0; k < MixHelpers::numKernels(); ++k )
+		{
+			MixHelpers::setCurrentKernels( MixHelpers::kernels( k ) );
+			for( int c = 0; c < 8; ++c )
+			{
+				ValueBuffer * volBuf = c & 1 ? &vol : NULL;
+				ValueBuffer * sendBuf = c & 2 ? &send : NULL;
+				const bool exporting = c & 4;
+
+				fillRandom( expected, c );
+				fillRandom( result, c );
+				referenceSend( expected, src, 0.8f, volBuf, 0.35f, sendBuf, exporting );
+				MixHelpers::addMultipliedByGains( result, src, 0.8f, volBuf,
+						0.35f, sendBuf, exporting, Frames );
+				QVERIFY2( memcmp( expected, result, sizeof( result ) ) == 0,
+							MixHelpers::instructionSet() );
+			}
+		}
+		MixHelpers::setCurrentKernels( previous );
+	}
+} instance;
+
+#include "MixHelpersTest.moc"
@@ -0,0 +1,261 @@
+/*
+ * SampleConverterTest.cpp
+ *
+ * This file is part of LMMS - http://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "QTestSuite.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "SampleConverter.h"
+
+// odd number of frames, so remainder loops of all kernels are covered
+static const int Frames = 259;
+
+static float randomValue( unsigned int & seed, float range )
+{
+	seed = seed * 1103515245 + 12345;
+	return ( ( seed >> 8 ) & 0xffff ) / 32768.0f * range - range;
+}
+
+// mostly within -1..1, some clipping, infs and NaNs
+static void fillRandom( surroundSampleFrame * buf, unsigned int seed )
+{
+	for( int f = 0; f < Frames; ++f )
+	{
+		for( int ch = 0; ch < SURROUND_CHANNELS; ++ch )
+		{
+			buf[f][ch] = randomValue( seed, 1.2f );
+		}
+	}
+	buf[3][0] = NAN;
+	buf[5][1] = INFINITY;
+	buf[8][0] = -INFINITY;
+	buf[13][1] = 1.0f;
+	buf[21][0] = -1.0f;
+}
+
+static int convertOne( SampleConverter::Format format, float value )
+{
+	surroundSampleFrame buf[1] = { { value, value } };
+	int32_t out[SURROUND_CHANNELS];
+	SampleConverter c( format );
+	c.convert( buf, 1, 1, 1.0f, out );
+	return format == SampleConverter::Format_S16 ? ( (int16_t *) out )[0] :
+									out[0];
+}
+
+class SampleConverterTest : QTestSuite
+{
+	Q_OBJECT
+private slots:
+	void kernelsAreBitExact()
+	{
+		surroundSampleFrame src[Frames];
+		fillRandom( src, 1 );
+
+		int32_t expected[Frames * SURROUND_CHANNELS];
+		int32_t result[Frames * SURROUND_CHANNELS];
+
+		const SampleConversionKernels * previous = SampleConversion::currentKernels();
+		for( int k = 0; k < SampleConversion::numKernels(); ++k )
+		{
+			for( int format = 0; format < SampleConverter::NumFormats; ++format )
+			{
+				for( int dither = 0; dither < SampleConverter::NumDitherModes; ++dither )
+				{
+					for( int swap = 0; swap < 2; ++swap )
+					{
+						SampleConverter ref( (SampleConverter::Format) format,
+								(SampleConverter::DitherMode) dither );
+						SampleConverter c( (SampleConverter::Format) format,
+								(SampleConverter::DitherMode) dither );
+
+						// two periods, so dither state is carried over
+						// the same way
+						const int bytes = Frames * SURROUND_CHANNELS *
+							SampleConverter::bytesPerSample( c.format() );
+						for( int period = 0; period < 2; ++period )
+						{
+							SampleConversion::setCurrentKernels(
+								SampleConversion::scalarKernels() );
+							QCOMPARE( ref.convert( src, Frames, SURROUND_CHANNELS,
+									0.8f, expected, swap ), bytes );
+							SampleConversion::setCurrentKernels(
+								SampleConversion::kernels( k ) );
+							QCOMPARE( c.convert( src, Frames, SURROUND_CHANNELS,
+									0.8f, result, swap ), bytes );
+							QVERIFY2( memcmp( expected, result, bytes ) == 0,
+								SampleConversion::instructionSet() );
+						}
+					}
+				}
+			}
+		}
+		SampleConversion::setCurrentKernels( previous );
+	}
+
+	void fullScaleAndClipping()
+	{
+		QCOMPARE( convertOne( SampleConverter::Format_S16, 1.0f ), 32767 );
+		QCOMPARE( convertOne( SampleConverter::Format_S16, -1.0f ), -32767 );
+		QCOMPARE( convertOne( SampleConverter::Format_S16, 3.0f ), 32767 );
+		QCOMPARE( convertOne( SampleConverter::Format_S16, -3.0f ), -32767 );
+		QCOMPARE( convertOne( SampleConverter::Format_S16, 0.0f ), 0 );
+		QCOMPARE( convertOne( SampleConverter::Format_S16, 0.4f / 32767 ), 0 );
+		QCOMPARE( convertOne( SampleConverter::Format_S16, 0.6f / 32767 ), 1 );
+		// rounded to nearest, not truncated towards zero
+		QCOMPARE( convertOne( SampleConverter::Format_S16, -0.6f / 32767 ), -1 );
+		QCOMPARE( convertOne( SampleConverter::Format_S16, 0.7f ), 22937 );
+
+		QCOMPARE( convertOne( SampleConverter::Format_S24, 1.0f ), 8388607 );
+		QCOMPARE( convertOne( SampleConverter::Format_S24, -1.0f ), -8388607 );
+		QCOMPARE( convertOne( SampleConverter::Format_S24, 0.5f ), 4194304 );
+
+		// must not wrap around
+		QCOMPARE( convertOne( SampleConverter::Format_S32, 1.0f ), 2147483520 );
+		QCOMPARE( convertOne( SampleConverter::Format_S32, 2.0f ), 2147483520 );
+		QCOMPARE( convertOne( SampleConverter::Format_S32, -1.0f ), (int) -2147483648LL );
+
+		surroundSampleFrame buf[1] = { { 2.0f, -0.25f } };
+		float out[2];
+		SampleConverter c( SampleConverter::Format_Float );
+		c.convert( buf, 1, 2, 2.0f, out );
+		QCOMPARE( out[0], 1.0f );
+		QCOMPARE( out[1], -0.5f );
+		c.setFormat( SampleConverter::Format_FloatUnclipped );
+		c.convert( buf, 1, 2, 2.0f, out );
+		QCOMPARE( out[0], 4.0f );
+	}
+
+	void ditherStaysWithinOneStep()
+	{
+		surroundSampleFrame src[Frames];
+		unsigned int seed = 3;
+		for( int f = 0; f < Frames; ++f )
+		{
+			src[f][0] = randomValue( seed, 0.001f );
+			src[f][1] = 0.0f;
+		}
+
+		for( int dither = SampleConverter::Dither_TPDF;
+				dither < SampleConverter::NumDitherModes; ++dither )
+		{
+			SampleConverter c( SampleConverter::Format_S16,
+					(SampleConverter::DitherMode) dither );
+			int16_t out[Frames * 2];
+			int nonZero = 0;
+			for( int period = 0; period < 20; ++period )
+			{
+				c.convert( src, Frames, 2, 1.0f, out );
+				for( int f = 0; f < Frames; ++f )
+				{
+					const float target = src[f][0] * 32767.0f;
+					// rounding, dither and for noise shaping
+					// twice the previous error of at most 2
+					const float limit = dither == SampleConverter::Dither_TPDF ?
+									1.5f : 7.5f;
+					QVERIFY( fabsf( out[f * 2] - target ) <= limit );
+					QVERIFY( abs( out[f * 2 + 1] ) <= limit );
+					nonZero += out[f * 2 + 1] != 0;
+				}
+			}
+			// silence has to be dithered as well
+			QVERIFY( nonZero > Frames );
+		}
+	}
+
+	void noiseShapingSurvivesClipping()
+	{
+		surroundSampleFrame src[Frames];
+		for( int f = 0; f < Frames; ++f )
+		{
+			src[f][0] = f % 64 < 32 ? 4.0f : -4.0f;
+			src[f][1] = 0.0f;
+		}
+		SampleConverter c( SampleConverter::Format_S16,
+					SampleConverter::Dither_NoiseShaped );
+		int16_t out[Frames * 2];
+		c.convert( src, Frames, 2, 1.0f, out );
+
+		// back to silence right after clipping
+		for( int f = 0; f < Frames; ++f )
+		{
+			src[f][0] = 0.0f;
+		}
+		c.convert( src, Frames, 2, 1.0f, out );
+		for( int f = 0; f < Frames * 2; ++f )
+		{
+			QVERIFY( abs( out[f] ) <= 8 );
+		}
+	}
+
+	void fewerChannelsThanMixer()
+	{
+		surroundSampleFrame src[Frames];
+		fillRandom( src, 5 );
+
+		int16_t all[Frames * SURROUND_CHANNELS];
+		int16_t mono[Frames];
+		SampleConverter( SampleConverter::Format_S16 ).convert( src, Frames,
+						SURROUND_CHANNELS, 0.5f, all );
+		QCOMPARE( SampleConverter( SampleConverter::Format_S16 ).convert(
+					src, Frames, 1, 0.5f, mono ), Frames * 2 );
+		for( int f = 0; f < Frames; ++f )
+		{
+			QCOMPARE( mono[f], all[f * SURROUND_CHANNELS] );
+		}
+	}
+
+	void endianSwap()
+	{
+		surroundSampleFrame src[Frames];
+		fillRandom( src, 7 );
+
+		int16_t s16[Frames * SURROUND_CHANNELS];
+		int16_t s16Swapped[Frames * SURROUND_CHANNELS];
+		SampleConverter( SampleConverter::Format_S16 ).convert( src, Frames,
+						SURROUND_CHANNELS, 1.0f, s16 );
+		SampleConverter( SampleConverter::Format_S16 ).convert( src, Frames,
+					SURROUND_CHANNELS, 1.0f, s16Swapped, true );
+		for( int i = 0; i < Frames * SURROUND_CHANNELS; ++i )
+		{
+			QCOMPARE( (uint16_t) s16Swapped[i], (uint16_t)
+				( ( (uint16_t) s16[i] >> 8 ) | ( (uint16_t) s16[i] << 8 ) ) );
+		}
+
+		int32_t s24[Frames * SURROUND_CHANNELS];
+		int32_t s24Swapped[Frames * SURROUND_CHANNELS];
+		SampleConverter( SampleConverter::Format_S24 ).convert( src, Frames,
+						SURROUND_CHANNELS, 1.0f, s24 );
+		SampleConverter( SampleConverter::Format_S24 ).convert( src, Frames,
+					SURROUND_CHANNELS, 1.0f, s24Swapped, true );
+		for( int i = 0; i < Frames * SURROUND_CHANNELS; ++i )
+		{
+			const uint32_t x = s24[i];
+			QCOMPARE( (uint32_t) s24Swapped[i], ( x >> 24 ) |
+				( ( x >> 8 ) & 0xff00 ) | ( ( x << 8 ) & 0xff0000 ) |
+								( x << 24 ) );
+		}
+	}
+} instance;
+
+#include "SampleConverterTest.moc"